@@ -1223,6 +1223,7 @@ void bta_av_str_opened(tBTA_AV_SCB* p_scb, tBTA_AV_DATA* p_data) {
 
   /* Set the media channel as high priority */
   L2CA_SetTxPriority(p_scb->l2c_cid, L2CAP_CHNL_PRIORITY_HIGH);
+  L2CA_SetTxLatencyTarget(p_scb->l2c_cid, BTA_AV_MEDIA_TX_LATENCY_TARGET_MS);
   L2CA_SetChnlFlushability(p_scb->l2c_cid, true);
 
   bta_sys_conn_open(BTA_ID_AV, p_scb->app_id, p_scb->PeerAddress());
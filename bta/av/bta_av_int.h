@@ -140,6 +140,10 @@ enum {
  * queued to L2CAP */
 #define BTA_AV_QUEUE_DATA_CHK_NUM L2CAP_HIGH_PRI_MIN_XMIT_QUOTA
 
+/* L2CAP transmit latency target of the media channel, about one media packet
+ * interval, after which it is served ahead of other channels on the link */
+#define BTA_AV_MEDIA_TX_LATENCY_TARGET_MS 20
+
 /* the number of ACL links with AVDT */
 #define BTA_AV_NUM_LINKS AVDT_NUM_LINKS
 
@@ -1118,7 +1118,7 @@ bool bta_av_link_role_ok(tBTA_AV_SCB* p_scb, uint8_t bits) {
  * Function         bta_av_dup_audio_buf
  *
  * Description      dup the audio data to the q_info.a2dp of other audio
- *                  channels
+ *                  channels able to decode it
  *
  * Returns          void
  *
@@ -1136,6 +1136,9 @@ void bta_av_dup_audio_buf(tBTA_AV_SCB* p_scb, BT_HDR* p_buf) {
       continue; /* Ignore if SCB is not used or started */
     if (!(bta_av_cb.conn_audio & BTA_AV_HNDL_TO_MSK(i)))
       continue; /* Audio is not connected */
+    if (!bta_av_co_audio_share_frames(p_scb->cfg.codec_info,
+                                      p_scbi->cfg.codec_info))
+      continue; /* The stream gets frames of its own */
 
     /* Enqueue the data */
     BT_HDR* p_new = (BT_HDR*)osi_malloc(copy_size);
@@ -33,6 +33,7 @@
 #include <unistd.h>
 
 #include "bt_common.h"
+#include "bta_gattc_cache_file.h"
 #include "bta_gattc_int.h"
 #include "bta_sys.h"
 #include "btm_api.h"
@@ -47,8 +48,6 @@
 using bluetooth::Uuid;
 using base::StringPrintf;
 
-static void bta_gattc_cache_write(const RawAddress& server_bda,
-                                  uint16_t num_attr, tBTA_GATTC_NV_ATTR* attr);
 static void bta_gattc_char_dscpt_disc_cmpl(uint16_t conn_id,
                                            tBTA_GATTC_SERV* p_srvc_cb);
 static tGATT_STATUS bta_gattc_sdp_service_disc(uint16_t conn_id,
@@ -60,16 +59,6 @@ tBTA_GATTC_CHARACTERISTIC* bta_gattc_get_characteristic_srcb(
 
 #define BTA_GATT_SDP_DB_SIZE 4096
 
-#define GATT_CACHE_PREFIX "/data/misc/bluetooth/gatt_cache_"
-#define GATT_CACHE_VERSION 4
-
-static void bta_gattc_generate_cache_file_name(char* buffer, size_t buffer_len,
-                                               const RawAddress& bda) {
-  snprintf(buffer, buffer_len, "%s%02x%02x%02x%02x%02x%02x", GATT_CACHE_PREFIX,
-           bda.address[0], bda.address[1], bda.address[2], bda.address[3],
-           bda.address[4], bda.address[5]);
-}
-
 /*****************************************************************************
  *  Constants and data types
  ****************************************************************************/
@@ -910,13 +899,20 @@ void bta_gattc_get_gatt_db(uint16_t conn_id, uint16_t start_handle,
 
 /* rebuild server cache from NV cache */
 void bta_gattc_rebuild_cache(tBTA_GATTC_SERV* p_srvc_cb, uint16_t num_attr,
-                             tBTA_GATTC_NV_ATTR* p_attr) {
+                             const tBTA_GATTC_NV_ATTR* p_attr) {
   /* first attribute loading, initialize buffer */
   LOG(INFO) << __func__ << " " << num_attr;
 
   // clear reallocating
   std::vector<tBTA_GATTC_SERVICE>().swap(p_srvc_cb->srvc_cache);
 
+  /* services are stored first, size the database once up front */
+  size_t num_srvc = 0;
+  while (p_attr != NULL && num_srvc < num_attr &&
+         p_attr[num_srvc].attr_type == BTA_GATTC_ATTR_TYPE_SRVC)
+    num_srvc++;
+  p_srvc_cb->srvc_cache.reserve(num_srvc);
+
   while (num_attr > 0 && p_attr != NULL) {
     switch (p_attr->attr_type) {
       case BTA_GATTC_ATTR_TYPE_SRVC:
@@ -1012,15 +1008,23 @@ void bta_gattc_cache_save(tBTA_GATTC_SERV* p_srvc_cb, uint16_t conn_id) {
     }
   }
 
-  bta_gattc_cache_write(p_srvc_cb->server_bda, db_size, nv_attr);
+  bta_gattc_cache_file_write(p_srvc_cb->server_bda, db_size,
+                             p_srvc_cb->srvc_cache.size(), nv_attr);
   osi_free(nv_attr);
 }
 
+static void bta_gattc_cache_load_cback(void* p_context, uint16_t num_attr,
+                                       const tBTA_GATTC_NV_ATTR* p_attr) {
+  bta_gattc_rebuild_cache(static_cast<tBTA_GATTC_SERV*>(p_context), num_attr,
+                          p_attr);
+}
+
 /*******************************************************************************
  *
  * Function         bta_gattc_cache_load
  *
- * Description      Load GATT cache from storage for server.
+ * Description      Load GATT cache from storage for server. The service
+ *                  database is rebuilt directly from the file mapping.
  *
  * Parameter        p_clcb: pointer to server clcb, that will
  *                          be filled from storage
@@ -1028,101 +1032,8 @@ void bta_gattc_cache_save(tBTA_GATTC_SERV* p_srvc_cb, uint16_t conn_id) {
  *
  ******************************************************************************/
 bool bta_gattc_cache_load(tBTA_GATTC_CLCB* p_clcb) {
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname),
-                                     p_clcb->p_srcb->server_bda);
-
-  FILE* fd = fopen(fname, "rb");
-  if (!fd) {
-    LOG(ERROR) << __func__ << ": can't open GATT cache file " << fname
-               << " for reading, error: " << strerror(errno);
-    return false;
-  }
-
-  uint16_t cache_ver = 0;
-  tBTA_GATTC_NV_ATTR* attr = NULL;
-  bool success = false;
-  uint16_t num_attr = 0;
-
-  if (fread(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't read GATT cache version from: " << fname;
-    goto done;
-  }
-
-  if (cache_ver != GATT_CACHE_VERSION) {
-    LOG(ERROR) << __func__ << ": wrong GATT cache version: " << fname;
-    goto done;
-  }
-
-  if (fread(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't read number of GATT attributes: " << fname;
-    goto done;
-  }
-
-  attr = (tBTA_GATTC_NV_ATTR*)osi_malloc(sizeof(tBTA_GATTC_NV_ATTR) * num_attr);
-
-  if (fread(attr, sizeof(tBTA_GATTC_NV_ATTR), num_attr, fd) != num_attr) {
-    LOG(ERROR) << __func__ << "s: can't read GATT attributes: " << fname;
-    goto done;
-  }
-
-  bta_gattc_rebuild_cache(p_clcb->p_srcb, num_attr, attr);
-
-  success = true;
-
-done:
-  osi_free(attr);
-  fclose(fd);
-  return success;
-}
-
-/*******************************************************************************
- *
- * Function         bta_gattc_cache_write
- *
- * Description      This callout function is executed by GATT when a server
- *                  cache is available to save.
- *
- * Parameter        server_bda: server bd address of this cache belongs to
- *                  num_attr: number of attribute to be save.
- *                  attr: pointer to the list of attributes to save.
- * Returns
- *
- ******************************************************************************/
-static void bta_gattc_cache_write(const RawAddress& server_bda,
-                                  uint16_t num_attr, tBTA_GATTC_NV_ATTR* attr) {
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
-
-  FILE* fd = fopen(fname, "wb");
-  if (!fd) {
-    LOG(ERROR) << __func__
-               << ": can't open GATT cache file for writing: " << fname;
-    return;
-  }
-
-  uint16_t cache_ver = GATT_CACHE_VERSION;
-  if (fwrite(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache version: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  if (fwrite(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't write GATT cache attribute count: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  if (fwrite(attr, sizeof(tBTA_GATTC_NV_ATTR), num_attr, fd) != num_attr) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache attributes: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  fclose(fd);
+  return bta_gattc_cache_file_load(p_clcb->p_srcb->server_bda,
+                                   bta_gattc_cache_load_cback, p_clcb->p_srcb);
 }
 
 /*******************************************************************************
@@ -1139,7 +1050,5 @@ static void bta_gattc_cache_write(const RawAddress& server_bda,
  ******************************************************************************/
 void bta_gattc_cache_reset(const RawAddress& server_bda) {
   VLOG(1) << __func__;
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
-  unlink(fname);
+  bta_gattc_cache_file_reset(server_bda);
 }
@@ -0,0 +1,297 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the on-disk storage of the GATT client cache. The
+ *  database is stored once per database hash and each device file is a hard
+ *  link to it.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_bta_gattc"
+
+#include "bta_gattc_cache_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <base/logging.h>
+
+#include "osi/include/osi.h"
+#include "osi/include/time.h"
+
+static std::string gatt_cache_dir = GATT_CACHE_DIR;
+
+void bta_gattc_cache_file_set_dir(const char* dir) { gatt_cache_dir = dir; }
+
+void bta_gattc_cache_file_name(char* buffer, size_t buffer_len,
+                               const RawAddress& bda) {
+  snprintf(buffer, buffer_len, "%sgatt_cache_%02x%02x%02x%02x%02x%02x",
+           gatt_cache_dir.c_str(), bda.address[0], bda.address[1],
+           bda.address[2], bda.address[3], bda.address[4], bda.address[5]);
+}
+
+void bta_gattc_cache_hash_file_name(char* buffer, size_t buffer_len,
+                                    uint64_t hash) {
+  snprintf(buffer, buffer_len, "%sgatt_hash_%016" PRIx64,
+           gatt_cache_dir.c_str(), hash);
+}
+
+/* FNV-1a over the serialized attribute records. Used as the database hash for
+ * naming shared cache files and to validate a mapped cache before use. */
+uint64_t bta_gattc_cache_hash(const tBTA_GATTC_NV_ATTR* attr,
+                              uint16_t num_attr) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(attr);
+  size_t len = num_attr * sizeof(tBTA_GATTC_NV_ATTR);
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  while (len--) {
+    hash ^= *p++;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_file_load
+ *
+ * Description      Load GATT cache from storage for server. The file is
+ *                  mapped read-only and its attributes are handed to
+ *                  |p_cback| directly from the mapping, without an
+ *                  intermediate copy.
+ *
+ * Parameter        server_bda: server bd address of the cache to load
+ *                  p_cback: called with the attributes once validated
+ *                  p_context: passed to |p_cback|
+ * Returns          true on success, false otherwise
+ *
+ ******************************************************************************/
+bool bta_gattc_cache_file_load(const RawAddress& server_bda,
+                               tBTA_GATTC_CACHE_LOAD_CBACK* p_cback,
+                               void* p_context) {
+  char fname[255] = {0};
+  bta_gattc_cache_file_name(fname, sizeof(fname), server_bda);
+
+  uint64_t start_us = time_get_os_boottime_us();
+
+  int fd = open(fname, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG(ERROR) << __func__ << ": can't open GATT cache file " << fname
+               << " for reading, error: " << strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(tBTA_GATTC_NV_HDR)) {
+    LOG(ERROR) << __func__ << ": can't read GATT cache header from: " << fname;
+    close(fd);
+    return false;
+  }
+
+  size_t len = st.st_size;
+  void* map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    LOG(ERROR) << __func__ << ": can't map GATT cache file " << fname
+               << ", error: " << strerror(errno);
+    return false;
+  }
+
+  const tBTA_GATTC_NV_HDR* hdr = static_cast<const tBTA_GATTC_NV_HDR*>(map);
+  const tBTA_GATTC_NV_ATTR* attr =
+      reinterpret_cast<const tBTA_GATTC_NV_ATTR*>(hdr + 1);
+  bool success = false;
+
+  if (hdr->magic != GATT_CACHE_MAGIC || hdr->version != GATT_CACHE_VERSION) {
+    LOG(ERROR) << __func__ << ": wrong GATT cache version: " << fname;
+    goto done;
+  }
+
+  if (len != sizeof(tBTA_GATTC_NV_HDR) +
+                 hdr->num_attr * sizeof(tBTA_GATTC_NV_ATTR) ||
+      hdr->num_srvc > hdr->num_attr) {
+    LOG(ERROR) << __func__ << ": truncated GATT cache file: " << fname;
+    goto done;
+  }
+
+  if (bta_gattc_cache_hash(attr, hdr->num_attr) != hdr->db_hash) {
+    LOG(ERROR) << __func__ << ": GATT cache hash mismatch: " << fname;
+    goto done;
+  }
+
+  (*p_cback)(p_context, hdr->num_attr, attr);
+
+  LOG(INFO) << __func__ << ": loaded " << +hdr->num_attr
+            << " attributes in " << (time_get_os_boottime_us() - start_us)
+            << " us";
+  success = true;
+
+done:
+  munmap(map, len);
+  return success;
+}
+
+/* Read the database hash stored in the header of |fname|. */
+static bool bta_gattc_cache_read_hash(const char* fname, uint64_t* p_hash) {
+  int fd = open(fname, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  tBTA_GATTC_NV_HDR hdr;
+  ssize_t ret;
+  OSI_NO_INTR(ret = read(fd, &hdr, sizeof(hdr)));
+  close(fd);
+
+  if (ret != sizeof(hdr) || hdr.magic != GATT_CACHE_MAGIC) return false;
+  *p_hash = hdr.db_hash;
+  return true;
+}
+
+/* Remove the shared database file for |hash| once no device refers to it. */
+static void bta_gattc_cache_release_hash(uint64_t hash) {
+  char hname[255] = {0};
+  bta_gattc_cache_hash_file_name(hname, sizeof(hname), hash);
+
+  struct stat st;
+  if (stat(hname, &st) == 0 && st.st_nlink <= 1) unlink(hname);
+}
+
+/* Write a complete cache file to |fname| through a temporary file, so that
+ * readers never observe a partially written database. */
+static bool bta_gattc_cache_write_file(const char* fname,
+                                       const tBTA_GATTC_NV_HDR* hdr,
+                                       const tBTA_GATTC_NV_ATTR* attr) {
+  std::string tmp_name = std::string(fname) + ".tmp";
+
+  FILE* fd = fopen(tmp_name.c_str(), "wb");
+  if (!fd) {
+    LOG(ERROR) << __func__
+               << ": can't open GATT cache file for writing: " << tmp_name;
+    return false;
+  }
+
+  if (fwrite(hdr, sizeof(tBTA_GATTC_NV_HDR), 1, fd) != 1) {
+    LOG(ERROR) << __func__ << ": can't write GATT cache header: " << tmp_name;
+    fclose(fd);
+    unlink(tmp_name.c_str());
+    return false;
+  }
+
+  if (fwrite(attr, sizeof(tBTA_GATTC_NV_ATTR), hdr->num_attr, fd) !=
+      hdr->num_attr) {
+    LOG(ERROR) << __func__
+               << ": can't write GATT cache attributes: " << tmp_name;
+    fclose(fd);
+    unlink(tmp_name.c_str());
+    return false;
+  }
+
+  fclose(fd);
+
+  if (rename(tmp_name.c_str(), fname) != 0) {
+    LOG(ERROR) << __func__ << ": can't rename GATT cache file " << tmp_name
+               << ", error: " << strerror(errno);
+    unlink(tmp_name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_file_write
+ *
+ * Description      This callout function is executed by GATT when a server
+ *                  cache is available to save. The database is stored once
+ *                  per database hash and the per-device file is a hard link
+ *                  to it, so devices exposing an identical database share
+ *                  one file.
+ *
+ * Parameter        server_bda: server bd address of this cache belongs to
+ *                  num_attr: number of attribute to be save.
+ *                  num_srvc: number of leading service attributes.
+ *                  attr: pointer to the list of attributes to save.
+ * Returns
+ *
+ ******************************************************************************/
+void bta_gattc_cache_file_write(const RawAddress& server_bda,
+                                uint16_t num_attr, uint16_t num_srvc,
+                                const tBTA_GATTC_NV_ATTR* attr) {
+  char fname[255] = {0};
+  char hname[255] = {0};
+  bta_gattc_cache_file_name(fname, sizeof(fname), server_bda);
+
+  tBTA_GATTC_NV_HDR hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = GATT_CACHE_MAGIC;
+  hdr.version = GATT_CACHE_VERSION;
+  hdr.num_attr = num_attr;
+  hdr.num_srvc = num_srvc;
+  hdr.db_hash = bta_gattc_cache_hash(attr, num_attr);
+
+  uint64_t old_hash;
+  bool had_old = bta_gattc_cache_read_hash(fname, &old_hash);
+  if (had_old && old_hash == hdr.db_hash) return;
+
+  bta_gattc_cache_hash_file_name(hname, sizeof(hname), hdr.db_hash);
+
+  struct stat st;
+  bool shared = stat(hname, &st) == 0 ||
+                bta_gattc_cache_write_file(hname, &hdr, attr);
+
+  unlink(fname);
+  if (had_old) bta_gattc_cache_release_hash(old_hash);
+
+  if (shared && link(hname, fname) == 0) return;
+
+  /* Hard links unavailable, fall back to a private copy */
+  LOG(WARNING) << __func__ << ": can't share GATT cache file " << hname;
+  bta_gattc_cache_write_file(fname, &hdr, attr);
+  if (shared) bta_gattc_cache_release_hash(hdr.db_hash);
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_file_reset
+ *
+ * Description      This callout function is executed by GATTC to reset cache in
+ *                  application
+ *
+ * Parameter        server_bda: server bd address of this cache belongs to
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+void bta_gattc_cache_file_reset(const RawAddress& server_bda) {
+  char fname[255] = {0};
+  bta_gattc_cache_file_name(fname, sizeof(fname), server_bda);
+
+  uint64_t hash;
+  bool had_hash = bta_gattc_cache_read_hash(fname, &hash);
+  unlink(fname);
+  if (had_hash) bta_gattc_cache_release_hash(hash);
+}
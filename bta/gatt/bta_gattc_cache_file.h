@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the on-disk storage of the GATT client cache.
+ *
+ ******************************************************************************/
+
+#ifndef BTA_GATTC_CACHE_FILE_H
+#define BTA_GATTC_CACHE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bta/include/bta_gatt_api.h"
+#include "types/raw_address.h"
+
+#define GATT_CACHE_DIR "/data/misc/bluetooth/"
+#define GATT_CACHE_MAGIC 0x43544147 /* "GATC" */
+#define GATT_CACHE_VERSION 5
+
+/* Called with the attributes of a loaded cache file. |p_attr| points into the
+ * file mapping and is only valid for the duration of the call. */
+typedef void(tBTA_GATTC_CACHE_LOAD_CBACK)(void* p_context, uint16_t num_attr,
+                                          const tBTA_GATTC_NV_ATTR* p_attr);
+
+/* Store the cache files in |dir| instead of GATT_CACHE_DIR. |dir| must end
+ * with a path separator. Used by tests. */
+extern void bta_gattc_cache_file_set_dir(const char* dir);
+
+extern void bta_gattc_cache_file_name(char* buffer, size_t buffer_len,
+                                      const RawAddress& bda);
+extern void bta_gattc_cache_hash_file_name(char* buffer, size_t buffer_len,
+                                           uint64_t hash);
+
+/* Hash of the serialized attribute records, stored in the file header */
+extern uint64_t bta_gattc_cache_hash(const tBTA_GATTC_NV_ATTR* attr,
+                                     uint16_t num_attr);
+
+/* Map the cache file of |server_bda| and pass its attributes to |p_cback|
+ * once the file is validated.
+ * Returns true if the file was loaded. */
+extern bool bta_gattc_cache_file_load(const RawAddress& server_bda,
+                                      tBTA_GATTC_CACHE_LOAD_CBACK* p_cback,
+                                      void* p_context);
+
+/* Store |num_attr| attributes, the first |num_srvc| of them services, as the
+ * cache of |server_bda|. */
+extern void bta_gattc_cache_file_write(const RawAddress& server_bda,
+                                       uint16_t num_attr, uint16_t num_srvc,
+                                       const tBTA_GATTC_NV_ATTR* attr);
+
+/* Remove the cache file of |server_bda| */
+extern void bta_gattc_cache_file_reset(const RawAddress& server_bda);
+
+#endif /* BTA_GATTC_CACHE_FILE_H */
@@ -17,6 +17,7 @@
 #include "bta_gatt_queue.h"
 
 #include <list>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -27,14 +28,16 @@ constexpr uint8_t GATT_READ_DESC = 2;
 constexpr uint8_t GATT_WRITE_CHAR = 3;
 constexpr uint8_t GATT_WRITE_DESC = 4;
 
+/* Callbacks of all reads served by one ATT request */
 struct gatt_read_op_data {
-  GATT_READ_OP_CB cb;
-  void* cb_data;
+  std::vector<std::pair<GATT_READ_OP_CB, void*>> cbs;
 };
 
 std::unordered_map<uint16_t, std::list<gatt_operation>>
     BtaGattQueue::gatt_op_queue;
 std::unordered_set<uint16_t> BtaGattQueue::gatt_op_queue_executing;
+std::unordered_map<uint16_t, BtaGattQueue::gatt_queue_stats>
+    BtaGattQueue::gatt_op_queue_stats;
 
 void BtaGattQueue::mark_as_not_executing(uint16_t conn_id) {
   gatt_op_queue_executing.erase(conn_id);
@@ -43,18 +46,13 @@ void BtaGattQueue::mark_as_not_executing(uint16_t conn_id) {
 void BtaGattQueue::gatt_read_op_finished(uint16_t conn_id, tGATT_STATUS status,
                                          uint16_t handle, uint16_t len,
                                          uint8_t* value, void* data) {
-  gatt_read_op_data* tmp = (gatt_read_op_data*)data;
-  GATT_READ_OP_CB tmp_cb = tmp->cb;
-  void* tmp_cb_data = tmp->cb_data;
-
-  osi_free(data);
+  std::unique_ptr<gatt_read_op_data> tmp((gatt_read_op_data*)data);
 
   mark_as_not_executing(conn_id);
   gatt_execute_next_op(conn_id);
 
-  if (tmp_cb) {
-    tmp_cb(conn_id, status, handle, len, value, tmp_cb_data);
-    return;
+  for (const auto& cb : tmp->cbs) {
+    if (cb.first) cb.first(conn_id, status, handle, len, value, cb.second);
   }
 }
 
@@ -104,24 +102,36 @@ void BtaGattQueue::gatt_execute_next_op(uint16_t conn_id) {
   std::list<gatt_operation>& gatt_ops = map_ptr->second;
 
   gatt_operation& op = gatt_ops.front();
-
-  if (op.type == GATT_READ_CHAR) {
-    gatt_read_op_data* data =
-        (gatt_read_op_data*)osi_malloc(sizeof(gatt_read_op_data));
-    data->cb = op.read_cb;
-    data->cb_data = op.read_cb_data;
-    BTA_GATTC_ReadCharacteristic(conn_id, op.handle, GATT_AUTH_REQ_NONE,
-                                 gatt_read_op_finished, data);
-
-  } else if (op.type == GATT_READ_DESC) {
-    gatt_read_op_data* data =
-        (gatt_read_op_data*)osi_malloc(sizeof(gatt_read_op_data));
-    data->cb = op.read_cb;
-    data->cb_data = op.read_cb_data;
-    BTA_GATTC_ReadCharDescr(conn_id, op.handle, GATT_AUTH_REQ_NONE,
-                            gatt_read_op_finished, data);
+  gatt_op_queue_stats[conn_id].ops_issued++;
+
+  if (op.type == GATT_READ_CHAR || op.type == GATT_READ_DESC) {
+    gatt_read_op_data* data = new gatt_read_op_data();
+    data->cbs.emplace_back(op.read_cb, op.read_cb_data);
+
+    /* Serve the reads of the same attribute queued right behind this one with
+     * this request. Anything else queued in between, a write in particular,
+     * ends the run so callbacks keep their order */
+    auto it = std::next(gatt_ops.begin());
+    while (it != gatt_ops.end() && it->type == op.type &&
+           it->handle == op.handle) {
+      data->cbs.emplace_back(it->read_cb, it->read_cb_data);
+      gatt_op_queue_stats[conn_id].reads_coalesced++;
+      it = gatt_ops.erase(it);
+    }
+
+    if (op.type == GATT_READ_CHAR) {
+      BTA_GATTC_ReadCharacteristic(conn_id, op.handle, GATT_AUTH_REQ_NONE,
+                                   gatt_read_op_finished, data);
+    } else {
+      BTA_GATTC_ReadCharDescr(conn_id, op.handle, GATT_AUTH_REQ_NONE,
+                              gatt_read_op_finished, data);
+    }
 
   } else if (op.type == GATT_WRITE_CHAR) {
+    /* Writes without response are not issued back to back: BTA GATTC keeps a
+     * single pending command per connection and drops, without a callback,
+     * any command issued while one is pending. This costs no ATT round trip
+     * though, GATT completes a write command once L2CAP took the PDU. */
     gatt_write_op_data* data =
         (gatt_write_op_data*)osi_malloc(sizeof(gatt_write_op_data));
     data->cb = op.write_cb;
@@ -143,50 +153,74 @@ void BtaGattQueue::gatt_execute_next_op(uint16_t conn_id) {
 }
 
 void BtaGattQueue::Clean(uint16_t conn_id) {
+  auto stats = gatt_op_queue_stats.find(conn_id);
+  if (stats != gatt_op_queue_stats.end()) {
+    APPL_TRACE_DEBUG(
+        "%s: conn_id=%d queued=%u issued=%u coalesced=%u max_depth=%u",
+        __func__, conn_id, stats->second.ops_queued, stats->second.ops_issued,
+        stats->second.reads_coalesced, stats->second.max_queue_depth);
+    gatt_op_queue_stats.erase(stats);
+  }
+
   gatt_op_queue.erase(conn_id);
   gatt_op_queue_executing.erase(conn_id);
 }
 
+const BtaGattQueue::gatt_queue_stats* BtaGattQueue::GetStats(
+    uint16_t conn_id) {
+  auto stats = gatt_op_queue_stats.find(conn_id);
+  if (stats == gatt_op_queue_stats.end()) return nullptr;
+  return &stats->second;
+}
+
+void BtaGattQueue::gatt_enqueue_op(uint16_t conn_id, gatt_operation op) {
+  std::list<gatt_operation>& gatt_ops = gatt_op_queue[conn_id];
+  gatt_ops.push_back(std::move(op));
+
+  gatt_queue_stats& stats = gatt_op_queue_stats[conn_id];
+  stats.ops_queued++;
+  if (gatt_ops.size() > stats.max_queue_depth)
+    stats.max_queue_depth = gatt_ops.size();
+
+  gatt_execute_next_op(conn_id);
+}
+
 void BtaGattQueue::ReadCharacteristic(uint16_t conn_id, uint16_t handle,
                                       GATT_READ_OP_CB cb, void* cb_data) {
-  gatt_op_queue[conn_id].push_back({.type = GATT_READ_CHAR,
-                                    .handle = handle,
-                                    .read_cb = cb,
-                                    .read_cb_data = cb_data});
-  gatt_execute_next_op(conn_id);
+  gatt_enqueue_op(conn_id, {.type = GATT_READ_CHAR,
+                            .handle = handle,
+                            .read_cb = cb,
+                            .read_cb_data = cb_data});
 }
 
 void BtaGattQueue::ReadDescriptor(uint16_t conn_id, uint16_t handle,
                                   GATT_READ_OP_CB cb, void* cb_data) {
-  gatt_op_queue[conn_id].push_back({.type = GATT_READ_DESC,
-                                    .handle = handle,
-                                    .read_cb = cb,
-                                    .read_cb_data = cb_data});
-  gatt_execute_next_op(conn_id);
+  gatt_enqueue_op(conn_id, {.type = GATT_READ_DESC,
+                            .handle = handle,
+                            .read_cb = cb,
+                            .read_cb_data = cb_data});
 }
 
 void BtaGattQueue::WriteCharacteristic(uint16_t conn_id, uint16_t handle,
                                        std::vector<uint8_t> value,
                                        tGATT_WRITE_TYPE write_type,
                                        GATT_WRITE_OP_CB cb, void* cb_data) {
-  gatt_op_queue[conn_id].push_back({.type = GATT_WRITE_CHAR,
-                                    .handle = handle,
-                                    .write_type = write_type,
-                                    .write_cb = cb,
-                                    .write_cb_data = cb_data,
-                                    .value = std::move(value)});
-  gatt_execute_next_op(conn_id);
+  gatt_enqueue_op(conn_id, {.type = GATT_WRITE_CHAR,
+                            .handle = handle,
+                            .write_type = write_type,
+                            .write_cb = cb,
+                            .write_cb_data = cb_data,
+                            .value = std::move(value)});
 }
 
 void BtaGattQueue::WriteDescriptor(uint16_t conn_id, uint16_t handle,
                                    std::vector<uint8_t> value,
                                    tGATT_WRITE_TYPE write_type,
                                    GATT_WRITE_OP_CB cb, void* cb_data) {
-  gatt_op_queue[conn_id].push_back({.type = GATT_WRITE_DESC,
-                                    .handle = handle,
-                                    .write_type = write_type,
-                                    .write_cb = cb,
-                                    .write_cb_data = cb_data,
-                                    .value = std::move(value)});
-  gatt_execute_next_op(conn_id);
+  gatt_enqueue_op(conn_id, {.type = GATT_WRITE_DESC,
+                            .handle = handle,
+                            .write_type = write_type,
+                            .write_cb = cb,
+                            .write_cb_data = cb_data,
+                            .value = std::move(value)});
 }
@@ -193,6 +193,20 @@ BT_HDR* bta_av_co_audio_source_data_path(const uint8_t* p_codec_info,
 void bta_av_co_audio_drop(tBTA_AV_HNDL bta_av_handle,
                           const RawAddress& peer_address);
 
+/*******************************************************************************
+ *
+ * Function         bta_av_co_audio_share_frames
+ *
+ * Description      This function is called to check whether the audio frames
+ *                  read for a stream configured with p_codec_info are to be
+ *                  copied to a stream configured with p_other_codec_info.
+ *
+ * Returns          true if the other stream shares the frames.
+ *
+ ******************************************************************************/
+bool bta_av_co_audio_share_frames(const uint8_t* p_codec_info,
+                                  const uint8_t* p_other_codec_info);
+
 /*******************************************************************************
  *
  * Function         bta_av_co_audio_delay
@@ -116,6 +116,20 @@ typedef struct {
   uint16_t incl_srvc_handle; /* used when attribute type is included service */
 } tBTA_GATTC_NV_ATTR;
 
+/* Header of the on-disk GATT client cache. It is immediately followed by
+ * |num_attr| tBTA_GATTC_NV_ATTR records, services first, so the whole file
+ * can be mapped and walked in place. |db_hash| identifies the database
+ * content, files with equal hashes are shared between devices. */
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t num_attr;
+  uint16_t num_srvc;
+  uint16_t reserved;
+  uint32_t reserved2;
+  uint64_t db_hash;
+} tBTA_GATTC_NV_HDR;
+
 /* callback data structure */
 typedef struct {
   tGATT_STATUS status;
@@ -31,6 +31,10 @@
  *
  * If you decide to use those methods in your app, make sure to not mix it with
  * existing BTA_GATTC_* API.
+ *
+ * Consecutive reads of the same attribute waiting in the queue are coalesced
+ * into a single ATT request whose result is delivered to every caller, in the
+ * order they were queued.
  */
 class BtaGattQueue {
  public:
@@ -62,8 +66,20 @@ class BtaGattQueue {
     std::vector<uint8_t> value;
   };
 
+  /* Per connection queue statistics */
+  struct gatt_queue_stats {
+    uint32_t ops_queued;
+    uint32_t ops_issued;
+    uint32_t reads_coalesced;
+    uint32_t max_queue_depth;
+  };
+
+  /* Returns statistics for |conn_id|, or nullptr if nothing was queued */
+  static const gatt_queue_stats* GetStats(uint16_t conn_id);
+
  private:
   static void mark_as_not_executing(uint16_t conn_id);
+  static void gatt_enqueue_op(uint16_t conn_id, gatt_operation op);
   static void gatt_execute_next_op(uint16_t conn_id);
   static void gatt_read_op_finished(uint16_t conn_id, tGATT_STATUS status,
                                     uint16_t handle, uint16_t len,
@@ -75,4 +91,6 @@ class BtaGattQueue {
   static std::unordered_map<uint16_t, std::list<gatt_operation>> gatt_op_queue;
   // contain connection ids that currently execute operations
   static std::unordered_set<uint16_t> gatt_op_queue_executing;
+  // maps connection id to queue statistics
+  static std::unordered_map<uint16_t, gatt_queue_stats> gatt_op_queue_stats;
 };
\ No newline at end of file
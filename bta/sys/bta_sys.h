@@ -43,6 +43,9 @@ typedef bool(tBTA_SYS_VS_EVT_HDLR)(uint16_t evt, void* p);
 /* event handler function type */
 typedef bool(tBTA_SYS_EVT_HDLR)(BT_HDR* p_msg);
 
+/* handler function type for messages posted to the bta thread */
+typedef void(tBTA_SYS_MSG_HDLR)(BT_HDR* p_msg);
+
 /* disable function type */
 typedef void(tBTA_SYS_DISABLE)(void);
 
@@ -224,6 +227,10 @@ extern void bta_sys_deregister(uint8_t id);
 extern bool bta_sys_is_register(uint8_t id);
 extern uint16_t bta_sys_get_sys_features(void);
 extern void bta_sys_sendmsg(void* p_msg);
+extern bt_status_t bta_sys_post_msg(const tracked_objects::Location& from_here,
+                                    tBTA_SYS_MSG_HDLR* p_hdlr, BT_HDR* p_msg);
+extern void bta_sys_work_start(void);
+extern void bta_sys_work_stop(void);
 extern void bta_sys_start_timer(alarm_t* alarm, period_ms_t interval,
                                 uint16_t event, uint16_t layer_specific);
 extern void bta_sys_disable(tBTA_SYS_HW_MODULE module);
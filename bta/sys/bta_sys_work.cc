@@ -0,0 +1,179 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This is the queue of the messages and closures posted to the bta thread.
+ *
+ ******************************************************************************/
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <base/threading/thread.h>
+
+#include <deque>
+#include <mutex>
+
+#include "bt_common.h"
+#include "bta_closure_api.h"
+#include "bta_sys.h"
+#include "btu.h"
+#include "osi/include/allocator.h"
+
+/* Work queued for the bta thread, either a message for |p_hdlr| or a
+ * closure. */
+typedef struct {
+  tBTA_SYS_MSG_HDLR* p_hdlr;
+  BT_HDR* p_msg;
+  base::OnceClosure task;
+} tBTA_SYS_WORK;
+
+/* Messages don't get a closure of their own: they are queued as they are and
+ * one task posted to the message loop runs everything queued by the time it
+ * gets to run. Closures posted to the bta thread go through the same queue so
+ * that they stay in order with the messages. */
+static std::mutex bta_sys_work_mutex;
+static std::deque<tBTA_SYS_WORK> bta_sys_work_queue;
+static bool bta_sys_work_open = false;    /* the message loop is running */
+static bool bta_sys_work_pending = false; /* a task to run it is posted */
+
+static void bta_sys_run_work(void) {
+  std::deque<tBTA_SYS_WORK> work;
+  {
+    std::lock_guard<std::mutex> lock(bta_sys_work_mutex);
+    work.swap(bta_sys_work_queue);
+    bta_sys_work_pending = false;
+  }
+
+  for (tBTA_SYS_WORK& item : work) {
+    if (item.p_msg != NULL) {
+      item.p_hdlr(item.p_msg);
+    } else {
+      std::move(item.task).Run();
+    }
+  }
+}
+
+static bt_status_t bta_sys_post_work(
+    const tracked_objects::Location& from_here, tBTA_SYS_WORK work) {
+  std::lock_guard<std::mutex> lock(bta_sys_work_mutex);
+
+  base::MessageLoop* bta_message_loop = get_message_loop();
+  if (!bta_sys_work_open || !bta_message_loop) {
+    APPL_TRACE_ERROR("%s: MessageLooper not initialized", __func__);
+    return BT_STATUS_FAIL;
+  }
+
+  bta_sys_work_queue.push_back(std::move(work));
+  if (bta_sys_work_pending) return BT_STATUS_SUCCESS;
+
+  /* Posted with the lock held, so anyone finding a task pending knows it is
+   * already ahead of whatever they post to the message loop next */
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner =
+      bta_message_loop->task_runner();
+  if (!task_runner.get() ||
+      !task_runner->PostTask(from_here, base::Bind(&bta_sys_run_work))) {
+    APPL_TRACE_ERROR("%s: Post task to task runner failed!", __func__);
+    bta_sys_work_queue.pop_back();
+    return BT_STATUS_FAIL;
+  }
+  bta_sys_work_pending = true;
+  return BT_STATUS_SUCCESS;
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_sys_work_start
+ *
+ * Description      Starts accepting messages and closures for the bta thread.
+ *                  Called on the bta thread once its message loop exists.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void bta_sys_work_start(void) {
+  std::lock_guard<std::mutex> lock(bta_sys_work_mutex);
+  bta_sys_work_open = true;
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_sys_work_stop
+ *
+ * Description      Stops accepting messages and closures for the bta thread,
+ *                  and drops whatever didn't get to run. Called on the bta
+ *                  thread once its message loop has stopped running.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void bta_sys_work_stop(void) {
+  std::deque<tBTA_SYS_WORK> work;
+  {
+    std::lock_guard<std::mutex> lock(bta_sys_work_mutex);
+    bta_sys_work_open = false;
+    bta_sys_work_pending = false;
+    work.swap(bta_sys_work_queue);
+  }
+
+  for (tBTA_SYS_WORK& item : work) osi_free(item.p_msg);
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_sys_post_msg
+ *
+ * Description      Post a message to be handled by |p_hdlr| in the bta thread,
+ *                  in order with messages and closures posted to it before.
+ *
+ * Returns          BT_STATUS_SUCCESS on success
+ *
+ ******************************************************************************/
+bt_status_t bta_sys_post_msg(const tracked_objects::Location& from_here,
+                             tBTA_SYS_MSG_HDLR* p_hdlr, BT_HDR* p_msg) {
+  CHECK(p_msg != NULL);
+  return bta_sys_post_work(from_here, {p_hdlr, p_msg, base::OnceClosure()});
+}
+
+/*******************************************************************************
+ *
+ * Function         do_in_bta_thread
+ *
+ * Description      Post a closure to be ran in the bta thread
+ *
+ * Returns          BT_STATUS_SUCCESS on success
+ *
+ ******************************************************************************/
+bt_status_t do_in_bta_thread(const tracked_objects::Location& from_here,
+                             const base::Closure& task) {
+  return bta_sys_post_work(from_here, {NULL, NULL, base::OnceClosure(task)});
+}
+
+/*******************************************************************************
+ *
+ * Function         do_in_bta_thread_once
+ *
+ * Description      Post a closure to be ran in the bta thread once
+ *
+ * Returns          BT_STATUS_SUCCESS on success
+ *
+ ******************************************************************************/
+bt_status_t do_in_bta_thread_once(const tracked_objects::Location& from_here,
+                                  base::OnceClosure task) {
+  return bta_sys_post_work(from_here, {NULL, NULL, std::move(task)});
+}
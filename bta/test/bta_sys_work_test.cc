@@ -0,0 +1,166 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <base/bind.h>
+#include <base/message_loop/message_loop.h>
+#include <base/run_loop.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "bta_closure_api.h"
+#include "bta_sys.h"
+#include "osi/include/allocation_tracker.h"
+#include "osi/include/allocator.h"
+
+uint8_t appl_trace_level = BT_TRACE_LEVEL_WARNING;
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+namespace {
+
+base::MessageLoop* message_loop = nullptr;
+
+/* Messages and closures that ran, by event or closure id */
+std::vector<int> ran;
+
+class TaskCounter : public base::MessageLoop::TaskObserver {
+ public:
+  void WillProcessTask(const base::PendingTask& pending_task) override {}
+  void DidProcessTask(const base::PendingTask& pending_task) override {
+    count++;
+  }
+
+  int count = 0;
+};
+
+BT_HDR* NewMsg(uint16_t event) {
+  BT_HDR* p_msg = (BT_HDR*)osi_malloc(sizeof(BT_HDR));
+  p_msg->event = event;
+  return p_msg;
+}
+
+void HandleMsg(BT_HDR* p_msg) {
+  ran.push_back(p_msg->event);
+  osi_free(p_msg);
+}
+
+/* Posts the next message from inside the handler, the first time only */
+void HandleMsgAndPost(BT_HDR* p_msg) {
+  HandleMsg(p_msg);
+  if (ran.size() == 1) bta_sys_post_msg(FROM_HERE, &HandleMsg, NewMsg(2));
+}
+
+void RunClosure(int id) { ran.push_back(id); }
+
+}  // namespace
+
+base::MessageLoop* get_message_loop() { return message_loop; }
+
+class BtaSysWorkTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    allocation_tracker_init();
+    allocation_tracker_reset();
+    ran.clear();
+    message_loop = new base::MessageLoop();
+    message_loop->AddTaskObserver(&tasks_);
+    bta_sys_work_start();
+  }
+
+  void TearDown() override {
+    bta_sys_work_stop();
+    message_loop->RemoveTaskObserver(&tasks_);
+    delete message_loop;
+    message_loop = nullptr;
+    EXPECT_EQ(0U, allocation_tracker_expect_no_allocations())
+        << "not all memory freed";
+  }
+
+  void RunUntilIdle() { base::RunLoop().RunUntilIdle(); }
+
+  TaskCounter tasks_;
+};
+
+TEST_F(BtaSysWorkTest, messages_and_closures_run_in_fifo_order) {
+  EXPECT_EQ(BT_STATUS_SUCCESS, bta_sys_post_msg(FROM_HERE, &HandleMsg,
+                                                NewMsg(1)));
+  EXPECT_EQ(BT_STATUS_SUCCESS,
+            do_in_bta_thread(FROM_HERE, base::Bind(&RunClosure, 2)));
+  EXPECT_EQ(BT_STATUS_SUCCESS, bta_sys_post_msg(FROM_HERE, &HandleMsg,
+                                                NewMsg(3)));
+  EXPECT_EQ(BT_STATUS_SUCCESS,
+            do_in_bta_thread_once(FROM_HERE, base::Bind(&RunClosure, 4)));
+  RunUntilIdle();
+
+  std::vector<int> expected = {1, 2, 3, 4};
+  EXPECT_EQ(expected, ran);
+}
+
+TEST_F(BtaSysWorkTest, burst_is_run_by_a_single_task) {
+  for (uint16_t event = 0; event < 10; event++)
+    bta_sys_post_msg(FROM_HERE, &HandleMsg, NewMsg(event));
+  do_in_bta_thread(FROM_HERE, base::Bind(&RunClosure, 10));
+  RunUntilIdle();
+
+  EXPECT_EQ(11u, ran.size());
+  EXPECT_EQ(1, tasks_.count);
+
+  /* Work posted once the queue ran gets a task of its own */
+  bta_sys_post_msg(FROM_HERE, &HandleMsg, NewMsg(11));
+  RunUntilIdle();
+  EXPECT_EQ(12u, ran.size());
+  EXPECT_EQ(2, tasks_.count);
+}
+
+TEST_F(BtaSysWorkTest, post_from_a_handler_gets_a_new_task) {
+  bta_sys_post_msg(FROM_HERE, &HandleMsgAndPost, NewMsg(1));
+  do_in_bta_thread(FROM_HERE, base::Bind(&RunClosure, 3));
+  RunUntilIdle();
+
+  /* The message posted by the handler goes behind what was already queued */
+  std::vector<int> expected = {1, 3, 2};
+  EXPECT_EQ(expected, ran);
+  EXPECT_EQ(2, tasks_.count);
+}
+
+TEST_F(BtaSysWorkTest, stop_frees_queued_messages) {
+  bta_sys_post_msg(FROM_HERE, &HandleMsg, NewMsg(1));
+  do_in_bta_thread(FROM_HERE, base::Bind(&RunClosure, 2));
+  bta_sys_post_msg(FROM_HERE, &HandleMsg, NewMsg(3));
+
+  bta_sys_work_stop();
+  EXPECT_EQ(0U, allocation_tracker_expect_no_allocations());
+
+  /* The task already posted finds nothing left to run */
+  RunUntilIdle();
+  EXPECT_TRUE(ran.empty());
+}
+
+TEST_F(BtaSysWorkTest, post_after_stop_fails) {
+  bta_sys_work_stop();
+
+  BT_HDR* p_msg = NewMsg(1);
+  EXPECT_EQ(BT_STATUS_FAIL, bta_sys_post_msg(FROM_HERE, &HandleMsg, p_msg));
+  EXPECT_EQ(BT_STATUS_FAIL,
+            do_in_bta_thread(FROM_HERE, base::Bind(&RunClosure, 2)));
+  osi_free(p_msg);
+
+  RunUntilIdle();
+  EXPECT_TRUE(ran.empty());
+  EXPECT_EQ(0, tasks_.count);
+}
@@ -18,12 +18,57 @@
 
 #include <gtest/gtest.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
 #include <base/logging.h>
 #include <base/strings/string_number_conversions.h>
+#include "bta/gatt/bta_gattc_cache_file.h"
 #include "bta/include/bta_gatt_api.h"
 
 using bluetooth::Uuid;
 
+namespace {
+
+const RawAddress kDevice1({0x11, 0x22, 0x33, 0x44, 0x55, 0x66});
+const RawAddress kDevice2({0x66, 0x55, 0x44, 0x33, 0x22, 0x11});
+
+tBTA_GATTC_NV_ATTR NvAttr(uint8_t attr_type, uint16_t s_handle,
+                          uint16_t e_handle, const char* uuid) {
+  tBTA_GATTC_NV_ATTR attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.uuid = Uuid::FromString(uuid);
+  attr.s_handle = s_handle;
+  attr.e_handle = e_handle;
+  attr.attr_type = attr_type;
+  attr.is_primary = attr_type == BTA_GATTC_ATTR_TYPE_SRVC;
+  return attr;
+}
+
+/* Two services, the second with a characteristic and its descriptor */
+std::vector<tBTA_GATTC_NV_ATTR> TestDatabase(uint16_t last_handle) {
+  return {
+      NvAttr(BTA_GATTC_ATTR_TYPE_SRVC, 0x0001, 0x0005, "1800"),
+      NvAttr(BTA_GATTC_ATTR_TYPE_SRVC, 0x0006, last_handle, "180f"),
+      NvAttr(BTA_GATTC_ATTR_TYPE_CHAR, 0x0008, 0, "2a19"),
+      NvAttr(BTA_GATTC_ATTR_TYPE_CHAR_DESCR, 0x0009, 0, "2902"),
+  };
+}
+
+void CollectAttrs(void* p_context, uint16_t num_attr,
+                  const tBTA_GATTC_NV_ATTR* p_attr) {
+  static_cast<std::vector<tBTA_GATTC_NV_ATTR>*>(p_context)->assign(
+      p_attr, p_attr + num_attr);
+}
+
+}  // namespace
+
 /* This test makes sure that v3 cache element is properly encoded into file*/
 TEST(GattCacheTest, nv_attr_to_binary_test) {
   tBTA_GATTC_NV_ATTR attr{
@@ -47,3 +92,195 @@ TEST(GattCacheTest, nv_attr_to_binary_test) {
   // LOG(ERROR) << " " << base::HexEncode(binary_form, len);
   EXPECT_EQ(memcmp(binary_form, &attr, len), 0);
 }
+
+/* This test makes sure that the v5 cache header layout is stable, so that
+ * files can be mapped and shared between devices */
+TEST(GattCacheTest, nv_hdr_to_binary_test) {
+  tBTA_GATTC_NV_HDR hdr{
+      .magic = 0x43544147,
+      .version = 0x0005,
+      .num_attr = 0x0102,
+      .num_srvc = 0x0003,
+      .reserved = 0,
+      .reserved2 = 0,
+      .db_hash = 0x0807060504030201,
+  };
+
+  constexpr size_t len = sizeof(tBTA_GATTC_NV_HDR);
+  uint8_t binary_form[len] = {0x47, 0x41, 0x54, 0x43, 0x05, 0x00, 0x02, 0x01,
+                              0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                              0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+
+  EXPECT_EQ(memcmp(binary_form, &hdr, len), 0);
+  /* attribute records following the header must stay naturally aligned */
+  EXPECT_EQ(len % alignof(tBTA_GATTC_NV_ATTR), 0u);
+}
+
+class GattCacheFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+#if defined(OS_GENERIC)
+    tmp_dir_ = "/tmp/btgcXXXXXX";
+#else
+    tmp_dir_ = "/data/local/tmp/btgcXXXXXX";
+#endif  // !defined(OS_GENERIC)
+    ASSERT_NE(nullptr, mkdtemp(&tmp_dir_[0]));
+    tmp_dir_ += "/";
+    bta_gattc_cache_file_set_dir(tmp_dir_.c_str());
+  }
+
+  void TearDown() override {
+    bta_gattc_cache_file_reset(kDevice1);
+    bta_gattc_cache_file_reset(kDevice2);
+    bta_gattc_cache_file_set_dir(GATT_CACHE_DIR);
+
+    /* A corrupt header leaves the shared file behind */
+    DIR* dir = opendir(tmp_dir_.c_str());
+    ASSERT_NE(nullptr, dir);
+    while (struct dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') unlink((tmp_dir_ + entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(tmp_dir_.c_str());
+  }
+
+  void Write(const RawAddress& bda, const std::vector<tBTA_GATTC_NV_ATTR>& db) {
+    bta_gattc_cache_file_write(bda, db.size(), 2, db.data());
+  }
+
+  bool Load(const RawAddress& bda, std::vector<tBTA_GATTC_NV_ATTR>* p_db) {
+    p_db->clear();
+    return bta_gattc_cache_file_load(bda, CollectAttrs, p_db);
+  }
+
+  std::string FileName(const RawAddress& bda) {
+    char fname[255];
+    bta_gattc_cache_file_name(fname, sizeof(fname), bda);
+    return fname;
+  }
+
+  std::string HashFileName(const std::vector<tBTA_GATTC_NV_ATTR>& db) {
+    char hname[255];
+    bta_gattc_cache_hash_file_name(hname, sizeof(hname),
+                                   bta_gattc_cache_hash(db.data(), db.size()));
+    return hname;
+  }
+
+  /* Overwrite the file of |bda| with |len| bytes of |data| at |offset| */
+  void Patch(const RawAddress& bda, off_t offset, const void* data,
+             size_t len) {
+    int fd = open(FileName(bda).c_str(), O_WRONLY);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ((ssize_t)len, pwrite(fd, data, len, offset));
+    close(fd);
+  }
+
+  std::string tmp_dir_;
+};
+
+TEST_F(GattCacheFileTest, load_maps_written_database) {
+  std::vector<tBTA_GATTC_NV_ATTR> db = TestDatabase(0x0009);
+  Write(kDevice1, db);
+
+  struct stat st;
+  ASSERT_EQ(0, stat(FileName(kDevice1).c_str(), &st));
+  EXPECT_EQ(sizeof(tBTA_GATTC_NV_HDR) + db.size() * sizeof(tBTA_GATTC_NV_ATTR),
+            (size_t)st.st_size);
+
+  std::vector<tBTA_GATTC_NV_ATTR> loaded;
+  ASSERT_TRUE(Load(kDevice1, &loaded));
+  ASSERT_EQ(db.size(), loaded.size());
+  EXPECT_EQ(0, memcmp(db.data(), loaded.data(),
+                      db.size() * sizeof(tBTA_GATTC_NV_ATTR)));
+}
+
+TEST_F(GattCacheFileTest, load_without_file_fails) {
+  std::vector<tBTA_GATTC_NV_ATTR> loaded;
+  EXPECT_FALSE(Load(kDevice1, &loaded));
+  EXPECT_TRUE(loaded.empty());
+}
+
+TEST_F(GattCacheFileTest, load_rejects_corrupt_attributes) {
+  Write(kDevice1, TestDatabase(0x0009));
+
+  /* Change the end handle of the second service */
+  uint16_t e_handle = 0x00ff;
+  Patch(kDevice1,
+        sizeof(tBTA_GATTC_NV_HDR) + sizeof(tBTA_GATTC_NV_ATTR) +
+            offsetof(tBTA_GATTC_NV_ATTR, e_handle),
+        &e_handle, sizeof(e_handle));
+
+  std::vector<tBTA_GATTC_NV_ATTR> loaded;
+  EXPECT_FALSE(Load(kDevice1, &loaded));
+  EXPECT_TRUE(loaded.empty());
+}
+
+TEST_F(GattCacheFileTest, load_rejects_bad_db_hash) {
+  Write(kDevice1, TestDatabase(0x0009));
+
+  uint64_t db_hash = 0x0123456789abcdef;
+  Patch(kDevice1, offsetof(tBTA_GATTC_NV_HDR, db_hash), &db_hash,
+        sizeof(db_hash));
+
+  std::vector<tBTA_GATTC_NV_ATTR> loaded;
+  EXPECT_FALSE(Load(kDevice1, &loaded));
+  EXPECT_TRUE(loaded.empty());
+}
+
+TEST_F(GattCacheFileTest, load_rejects_truncated_file) {
+  std::vector<tBTA_GATTC_NV_ATTR> db = TestDatabase(0x0009);
+  Write(kDevice1, db);
+  ASSERT_EQ(0, truncate(FileName(kDevice1).c_str(),
+                        sizeof(tBTA_GATTC_NV_HDR) +
+                            (db.size() - 1) * sizeof(tBTA_GATTC_NV_ATTR)));
+
+  std::vector<tBTA_GATTC_NV_ATTR> loaded;
+  EXPECT_FALSE(Load(kDevice1, &loaded));
+}
+
+TEST_F(GattCacheFileTest, identical_databases_share_one_file) {
+  std::vector<tBTA_GATTC_NV_ATTR> db = TestDatabase(0x0009);
+  Write(kDevice1, db);
+  Write(kDevice2, db);
+
+  struct stat st1, st2, sth;
+  ASSERT_EQ(0, stat(FileName(kDevice1).c_str(), &st1));
+  ASSERT_EQ(0, stat(FileName(kDevice2).c_str(), &st2));
+  ASSERT_EQ(0, stat(HashFileName(db).c_str(), &sth));
+  EXPECT_EQ(sth.st_ino, st1.st_ino);
+  EXPECT_EQ(sth.st_ino, st2.st_ino);
+  EXPECT_EQ(3u, (unsigned)sth.st_nlink);
+
+  std::vector<tBTA_GATTC_NV_ATTR> loaded;
+  ASSERT_TRUE(Load(kDevice2, &loaded));
+  EXPECT_EQ(db.size(), loaded.size());
+
+  /* The shared file stays until the last device drops it */
+  bta_gattc_cache_file_reset(kDevice1);
+  EXPECT_TRUE(Load(kDevice2, &loaded));
+  EXPECT_EQ(0, access(HashFileName(db).c_str(), F_OK));
+
+  bta_gattc_cache_file_reset(kDevice2);
+  EXPECT_NE(0, access(HashFileName(db).c_str(), F_OK));
+}
+
+TEST_F(GattCacheFileTest, changed_database_releases_shared_file) {
+  std::vector<tBTA_GATTC_NV_ATTR> old_db = TestDatabase(0x0009);
+  std::vector<tBTA_GATTC_NV_ATTR> new_db = TestDatabase(0x000c);
+  Write(kDevice1, old_db);
+  Write(kDevice2, old_db);
+
+  Write(kDevice1, new_db);
+  std::vector<tBTA_GATTC_NV_ATTR> loaded;
+  ASSERT_TRUE(Load(kDevice1, &loaded));
+  EXPECT_EQ(0x000c, loaded[1].e_handle);
+  EXPECT_EQ(0, access(HashFileName(old_db).c_str(), F_OK));
+
+  Write(kDevice2, new_db);
+  EXPECT_NE(0, access(HashFileName(old_db).c_str(), F_OK));
+
+  struct stat st1, st2;
+  ASSERT_EQ(0, stat(FileName(kDevice1).c_str(), &st1));
+  ASSERT_EQ(0, stat(FileName(kDevice2).c_str(), &st2));
+  EXPECT_EQ(st1.st_ino, st2.st_ino);
+}
@@ -0,0 +1,242 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <vector>
+
+#include "bta/include/bta_gatt_queue.h"
+
+uint8_t appl_trace_level = BT_TRACE_LEVEL_WARNING;
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+namespace {
+
+constexpr uint16_t kConnId = 3;
+constexpr uint16_t kHandleA = 0x0010;
+constexpr uint16_t kHandleB = 0x0020;
+
+/* An ATT request handed to BTA GATTC by the queue */
+struct Request {
+  bool is_read;
+  uint16_t handle;
+  GATT_READ_OP_CB read_cb;
+  GATT_WRITE_OP_CB write_cb;
+  void* cb_data;
+};
+
+std::deque<Request> requests;
+
+/* Callbacks the queue delivered, as (caller, handle) */
+std::vector<std::pair<int, uint16_t>> callbacks;
+
+void ReadCb(uint16_t conn_id, tGATT_STATUS status, uint16_t handle,
+            uint16_t len, uint8_t* value, void* data) {
+  callbacks.emplace_back(*static_cast<int*>(data), handle);
+}
+
+void WriteCb(uint16_t conn_id, tGATT_STATUS status, uint16_t handle,
+             void* data) {
+  callbacks.emplace_back(*static_cast<int*>(data), handle);
+}
+
+/* Completes the request BTA GATTC is executing */
+void CompleteRequest() {
+  ASSERT_FALSE(requests.empty());
+  Request request = requests.front();
+  requests.pop_front();
+  if (request.is_read) {
+    uint8_t value[] = {0x42};
+    request.read_cb(kConnId, GATT_SUCCESS, request.handle, sizeof(value),
+                    value, request.cb_data);
+  } else {
+    request.write_cb(kConnId, GATT_SUCCESS, request.handle, request.cb_data);
+  }
+}
+
+}  // namespace
+
+void BTA_GATTC_ReadCharacteristic(uint16_t conn_id, uint16_t handle,
+                                  tGATT_AUTH_REQ auth_req,
+                                  GATT_READ_OP_CB callback, void* cb_data) {
+  requests.push_back({true, handle, callback, nullptr, cb_data});
+}
+
+void BTA_GATTC_ReadCharDescr(uint16_t conn_id, uint16_t handle,
+                             tGATT_AUTH_REQ auth_req, GATT_READ_OP_CB callback,
+                             void* cb_data) {
+  requests.push_back({true, handle, callback, nullptr, cb_data});
+}
+
+void BTA_GATTC_WriteCharValue(uint16_t conn_id, uint16_t handle,
+                              tGATT_WRITE_TYPE write_type,
+                              std::vector<uint8_t> value,
+                              tGATT_AUTH_REQ auth_req,
+                              GATT_WRITE_OP_CB callback, void* cb_data) {
+  requests.push_back({false, handle, nullptr, callback, cb_data});
+}
+
+void BTA_GATTC_WriteCharDescr(uint16_t conn_id, uint16_t handle,
+                              std::vector<uint8_t> value,
+                              tGATT_AUTH_REQ auth_req,
+                              GATT_WRITE_OP_CB callback, void* cb_data) {
+  requests.push_back({false, handle, nullptr, callback, cb_data});
+}
+
+class BtaGattQueueTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    requests.clear();
+    callbacks.clear();
+    for (int i = 0; i < 8; i++) callers_[i] = i;
+  }
+
+  void TearDown() override { BtaGattQueue::Clean(kConnId); }
+
+  void Read(int caller, uint16_t handle) {
+    BtaGattQueue::ReadCharacteristic(kConnId, handle, ReadCb,
+                                     &callers_[caller]);
+  }
+
+  void Write(int caller, uint16_t handle) {
+    BtaGattQueue::WriteCharacteristic(kConnId, handle, {0x01},
+                                      GATT_WRITE_NO_RSP, WriteCb,
+                                      &callers_[caller]);
+  }
+
+  /* Completes requests until the queue has nothing left to send */
+  size_t Drain() {
+    size_t sent = 0;
+    while (!requests.empty()) {
+      CompleteRequest();
+      sent++;
+    }
+    return sent;
+  }
+
+  int callers_[8];
+};
+
+TEST_F(BtaGattQueueTest, consecutive_reads_are_merged) {
+  /* The first read goes out right away, the next ones wait behind it */
+  Read(0, kHandleA);
+  Read(1, kHandleA);
+  Read(2, kHandleA);
+  Read(3, kHandleA);
+
+  EXPECT_EQ(2u, Drain());
+
+  const BtaGattQueue::gatt_queue_stats* stats =
+      BtaGattQueue::GetStats(kConnId);
+  ASSERT_NE(nullptr, stats);
+  EXPECT_EQ(4u, stats->ops_queued);
+  EXPECT_EQ(2u, stats->ops_issued);
+  EXPECT_EQ(2u, stats->reads_coalesced);
+  ASSERT_EQ(4u, callbacks.size());
+}
+
+TEST_F(BtaGattQueueTest, write_between_reads_prevents_merging) {
+  Read(0, kHandleA);
+  Read(1, kHandleA);
+  Read(2, kHandleA);
+  Write(3, kHandleB);
+  Read(4, kHandleA);
+
+  EXPECT_EQ(4u, Drain());
+  EXPECT_EQ(1u, BtaGattQueue::GetStats(kConnId)->reads_coalesced);
+
+  std::vector<std::pair<int, uint16_t>> expected = {{0, kHandleA},
+                                                    {1, kHandleA},
+                                                    {2, kHandleA},
+                                                    {3, kHandleB},
+                                                    {4, kHandleA}};
+  EXPECT_EQ(expected, callbacks);
+}
+
+TEST_F(BtaGattQueueTest, read_of_other_attribute_prevents_merging) {
+  Read(0, kHandleA);
+  Read(1, kHandleA);
+  Read(2, kHandleA);
+  Read(3, kHandleB);
+  Read(4, kHandleA);
+
+  EXPECT_EQ(4u, Drain());
+  EXPECT_EQ(1u, BtaGattQueue::GetStats(kConnId)->reads_coalesced);
+
+  std::vector<std::pair<int, uint16_t>> expected = {{0, kHandleA},
+                                                    {1, kHandleA},
+                                                    {2, kHandleA},
+                                                    {3, kHandleB},
+                                                    {4, kHandleA}};
+  EXPECT_EQ(expected, callbacks);
+}
+
+TEST_F(BtaGattQueueTest, merged_read_calls_back_in_queue_order) {
+  Read(0, kHandleA);
+  Read(1, kHandleB);
+  Read(2, kHandleB);
+  Read(3, kHandleB);
+  Write(4, kHandleA);
+
+  EXPECT_EQ(3u, Drain());
+
+  std::vector<std::pair<int, uint16_t>> expected = {{0, kHandleA},
+                                                    {1, kHandleB},
+                                                    {2, kHandleB},
+                                                    {3, kHandleB},
+                                                    {4, kHandleA}};
+  EXPECT_EQ(expected, callbacks);
+}
+
+TEST_F(BtaGattQueueTest, char_and_descr_reads_are_not_merged) {
+  Read(0, kHandleA);
+  Read(1, kHandleB);
+  BtaGattQueue::ReadDescriptor(kConnId, kHandleB, ReadCb, &callers_[2]);
+
+  EXPECT_EQ(3u, Drain());
+  EXPECT_EQ(0u, BtaGattQueue::GetStats(kConnId)->reads_coalesced);
+}
+
+TEST_F(BtaGattQueueTest, write_commands_are_issued_one_at_a_time) {
+  /* BTA GATTC drops a command issued while another one is pending */
+  Write(0, kHandleA);
+  Write(1, kHandleA);
+  Write(2, kHandleB);
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(1u, requests.size());
+    CompleteRequest();
+  }
+  EXPECT_TRUE(requests.empty());
+
+  std::vector<std::pair<int, uint16_t>> expected = {
+      {0, kHandleA}, {1, kHandleA}, {2, kHandleB}};
+  EXPECT_EQ(expected, callbacks);
+}
+
+TEST_F(BtaGattQueueTest, clean_drops_stats) {
+  Read(0, kHandleA);
+  EXPECT_NE(nullptr, BtaGattQueue::GetStats(kConnId));
+  BtaGattQueue::Clean(kConnId);
+  EXPECT_EQ(nullptr, BtaGattQueue::GetStats(kConnId));
+
+  /* The read already sent still completes */
+  EXPECT_EQ(1u, Drain());
+  EXPECT_EQ(1u, callbacks.size());
+}
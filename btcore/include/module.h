@@ -57,6 +57,21 @@ void module_shut_down(const module_t* module);
 // If not initialized, does nothing.
 void module_clean_up(const module_t* module);
 
+// Initialize every module in the NULL terminated array |modules|. A module is
+// only initialized once the modules it lists as dependencies that are also in
+// |modules| have been; modules that don't depend on each other are
+// initialized concurrently on a small pool of worker threads. Dependencies
+// outside of |modules| must already be initialized. Modules depending on one
+// that failed are skipped. Returns true if every module was initialized.
+bool module_init_all(const module_t* const* modules);
+// Start up every module in the NULL terminated array |modules|, in dependency
+// order and concurrently like |module_init_all|. Returns true if every module
+// was started.
+bool module_start_up_all(const module_t* const* modules);
+
+// Dumps how long each module took to initialize and to start up to |fd|.
+void module_debug_dump(int fd);
+
 // Temporary callbacked wrapper for module start up, so real modules can be
 // spliced into the current janky startup sequence. Runs on a separate thread,
 // which terminates when the module start up has finished. When module startup
@@ -20,15 +20,24 @@
 
 #include <base/logging.h>
 #include <dlfcn.h>
+#include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "btcore/include/module.h"
 #include "osi/include/allocator.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/time.h"
+
+// Upper bound on the threads module_init_all and module_start_up_all run
+// lifecycle functions on
+#define MODULE_WORKER_COUNT 3
 
 typedef enum {
   MODULE_STATE_NONE = 0,
@@ -36,19 +45,33 @@ typedef enum {
   MODULE_STATE_STARTED = 2
 } module_state_t;
 
+typedef struct {
+  const module_t* module;
+  uint32_t init_ms;
+  uint32_t start_up_ms;
+} module_timing_t;
+
 static std::unordered_map<const module_t*, module_state_t> metadata;
 
+// Kept in the order modules were first initialized or started
+static std::vector<module_timing_t> timings;
+
 // TODO(jamuraa): remove this lock after the startup sequence is clean
 static std::mutex metadata_mutex;
 
 static bool call_lifecycle_function(module_lifecycle_fn function);
 static module_state_t get_module_state(const module_t* module);
 static void set_module_state(const module_t* module, module_state_t state);
+static module_timing_t* get_module_timing(const module_t* module);
+static bool run_in_dependency_order(const module_t* const* modules,
+                                    bool (*action)(const module_t*));
 
 void module_management_start(void) {}
 
 void module_management_stop(void) {
+  std::lock_guard<std::mutex> lock(metadata_mutex);
   metadata.clear();
+  timings.clear();
 }
 
 const module_t* get_module(const char* name) {
@@ -61,7 +84,14 @@ bool module_init(const module_t* module) {
   CHECK(module != NULL);
   CHECK(get_module_state(module) == MODULE_STATE_NONE);
 
-  if (!call_lifecycle_function(module->init)) {
+  uint32_t start_ms = time_get_os_boottime_ms();
+  bool success = call_lifecycle_function(module->init);
+  {
+    std::lock_guard<std::mutex> lock(metadata_mutex);
+    get_module_timing(module)->init_ms = time_get_os_boottime_ms() - start_ms;
+  }
+
+  if (!success) {
     LOG_ERROR(LOG_TAG, "%s Failed to initialize module \"%s\"", __func__,
               module->name);
     return false;
@@ -82,7 +112,15 @@ bool module_start_up(const module_t* module) {
         module->init == NULL);
 
   LOG_INFO(LOG_TAG, "%s Starting module \"%s\"", __func__, module->name);
-  if (!call_lifecycle_function(module->start_up)) {
+  uint32_t start_ms = time_get_os_boottime_ms();
+  bool success = call_lifecycle_function(module->start_up);
+  {
+    std::lock_guard<std::mutex> lock(metadata_mutex);
+    get_module_timing(module)->start_up_ms =
+        time_get_os_boottime_ms() - start_ms;
+  }
+
+  if (!success) {
     LOG_ERROR(LOG_TAG, "%s Failed to start up module \"%s\"", __func__,
               module->name);
     return false;
@@ -132,6 +170,25 @@ void module_clean_up(const module_t* module) {
   set_module_state(module, MODULE_STATE_NONE);
 }
 
+bool module_init_all(const module_t* const* modules) {
+  return run_in_dependency_order(modules, module_init);
+}
+
+bool module_start_up_all(const module_t* const* modules) {
+  return run_in_dependency_order(modules, module_start_up);
+}
+
+void module_debug_dump(int fd) {
+  std::lock_guard<std::mutex> lock(metadata_mutex);
+
+  dprintf(fd, "\nBluetooth Modules:\n");
+  dprintf(fd, "  %-24s %10s %10s\n", "Name", "Init ms", "Start ms");
+  for (const module_timing_t& timing : timings) {
+    dprintf(fd, "  %-24s %10u %10u\n", timing.module->name, timing.init_ms,
+            timing.start_up_ms);
+  }
+}
+
 static bool call_lifecycle_function(module_lifecycle_fn function) {
   // A NULL lifecycle function means it isn't needed, so assume success
   if (!function) return true;
@@ -157,6 +214,154 @@ static void set_module_state(const module_t* module, module_state_t state) {
   metadata[module] = state;
 }
 
+// Must be called with |metadata_mutex| held
+static module_timing_t* get_module_timing(const module_t* module) {
+  for (module_timing_t& timing : timings) {
+    if (timing.module == module) return &timing;
+  }
+
+  timings.push_back({module, 0, 0});
+  return &timings.back();
+}
+
+// Dependency ordered, concurrent lifecycle runs
+
+namespace {
+
+struct lifecycle_run_t;
+
+typedef struct {
+  lifecycle_run_t* run;
+  size_t index;
+} lifecycle_job_t;
+
+struct lifecycle_run_t {
+  bool (*action)(const module_t*);
+  std::vector<const module_t*> modules;
+  std::vector<lifecycle_job_t> jobs;
+  // How many of its dependencies each module is still waiting for
+  std::vector<size_t> waiting_for;
+  // The modules waiting for each module
+  std::vector<std::vector<size_t>> dependents;
+  // Set once a dependency of the module failed
+  std::vector<bool> skipped;
+
+  std::vector<thread_t*> workers;
+  size_t next_worker = 0;
+
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t remaining = 0;
+  bool success = true;
+};
+
+}  // namespace
+
+static void run_job(void* context);
+
+// Must be called with |run->mutex| held
+static void post_job(lifecycle_run_t* run, size_t index) {
+  thread_t* worker = run->workers[run->next_worker++ % run->workers.size()];
+  thread_post(worker, run_job, &run->jobs[index]);
+}
+
+// Must be called with |run->mutex| held
+static void finish_job(lifecycle_run_t* run, size_t index, bool success) {
+  if (!success) run->success = false;
+
+  for (size_t dependent : run->dependents[index]) {
+    if (!success) run->skipped[dependent] = true;
+    if (--run->waiting_for[dependent] > 0) continue;
+
+    if (run->skipped[dependent]) {
+      LOG_ERROR(LOG_TAG, "%s Skipping module \"%s\", a dependency failed",
+                __func__, run->modules[dependent]->name);
+      finish_job(run, dependent, false);
+    } else {
+      post_job(run, dependent);
+    }
+  }
+
+  if (--run->remaining == 0) run->done.notify_all();
+}
+
+static void run_job(void* context) {
+  CHECK(context);
+
+  lifecycle_job_t* job = (lifecycle_job_t*)context;
+  lifecycle_run_t* run = job->run;
+  bool success = run->action(run->modules[job->index]);
+
+  std::lock_guard<std::mutex> lock(run->mutex);
+  finish_job(run, job->index, success);
+}
+
+static bool run_in_dependency_order(const module_t* const* modules,
+                                    bool (*action)(const module_t*)) {
+  CHECK(modules != NULL);
+
+  lifecycle_run_t run;
+  run.action = action;
+  for (const module_t* const* module = modules; *module; module++)
+    run.modules.push_back(*module);
+
+  size_t count = run.modules.size();
+  if (count == 0) return true;
+
+  run.waiting_for.resize(count, 0);
+  run.dependents.resize(count);
+  run.skipped.resize(count, false);
+  for (size_t i = 0; i < count; i++) {
+    run.jobs.push_back({&run, i});
+
+    for (size_t d = 0; d < BTCORE_MAX_MODULE_DEPENDENCIES &&
+                       run.modules[i]->dependencies[d] != NULL;
+         d++) {
+      for (size_t j = 0; j < count; j++) {
+        if (strcmp(run.modules[j]->name, run.modules[i]->dependencies[d]))
+          continue;
+        CHECK(j != i) << "module \"" << run.modules[i]->name
+                      << "\" depends on itself";
+        run.waiting_for[i]++;
+        run.dependents[j].push_back(i);
+      }
+    }
+  }
+
+  // Kahn's algorithm, purely to reject dependency cycles up front
+  std::vector<size_t> waiting_for = run.waiting_for;
+  std::vector<size_t> ready;
+  for (size_t i = 0; i < count; i++) {
+    if (waiting_for[i] == 0) ready.push_back(i);
+  }
+  for (size_t sorted = 0; sorted < ready.size(); sorted++) {
+    for (size_t dependent : run.dependents[ready[sorted]]) {
+      if (--waiting_for[dependent] == 0) ready.push_back(dependent);
+    }
+  }
+  CHECK(ready.size() == count) << "module dependency cycle";
+
+  size_t worker_count = std::min<size_t>(count, MODULE_WORKER_COUNT);
+  for (size_t i = 0; i < worker_count; i++) {
+    thread_t* worker = thread_new("module_worker");
+    CHECK(worker != NULL);
+    run.workers.push_back(worker);
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(run.mutex);
+    run.remaining = count;
+    for (size_t i = 0; i < count; i++) {
+      if (run.waiting_for[i] == 0) post_job(&run, i);
+    }
+    run.done.wait(lock, [&run] { return run.remaining == 0; });
+  }
+
+  for (thread_t* worker : run.workers) thread_free(worker);
+
+  return run.success;
+}
+
 // TODO(zachoverflow): remove when everything modulized
 // Temporary callback-wrapper-related code
 
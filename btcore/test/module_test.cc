@@ -0,0 +1,189 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "osi/test/AllocationTestHarness.h"
+
+#include "btcore/include/module.h"
+
+namespace {
+
+std::atomic<int> running;
+std::atomic<int> max_running;
+std::atomic<int> finished;
+std::atomic<bool> first_done;
+std::atomic<bool> second_saw_first_done;
+
+void track_running() {
+  int now = ++running;
+  int max = max_running;
+  while (now > max && !max_running.compare_exchange_weak(max, now)) {
+  }
+}
+
+// Waits a while for the other modules to get going as well
+future_t* slow_lifecycle(void) {
+  track_running();
+  for (int i = 0; i < 100 && max_running < 3; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  running--;
+  finished++;
+  return NULL;
+}
+
+future_t* first_lifecycle(void) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  first_done = true;
+  return NULL;
+}
+
+future_t* second_lifecycle(void) {
+  second_saw_first_done = first_done.load();
+  finished++;
+  return NULL;
+}
+
+future_t* failing_lifecycle(void) {
+  return future_new_immediate(FUTURE_FAIL);
+}
+
+const module_t slow_a = {.name = "slow_a",
+                         .init = slow_lifecycle,
+                         .start_up = slow_lifecycle,
+                         .shut_down = NULL,
+                         .clean_up = NULL,
+                         .dependencies = {NULL}};
+const module_t slow_b = {.name = "slow_b",
+                         .init = slow_lifecycle,
+                         .start_up = slow_lifecycle,
+                         .shut_down = NULL,
+                         .clean_up = NULL,
+                         .dependencies = {NULL}};
+const module_t slow_c = {.name = "slow_c",
+                         .init = slow_lifecycle,
+                         .start_up = slow_lifecycle,
+                         .shut_down = NULL,
+                         .clean_up = NULL,
+                         .dependencies = {NULL}};
+
+const module_t first = {.name = "first",
+                        .init = first_lifecycle,
+                        .start_up = first_lifecycle,
+                        .shut_down = NULL,
+                        .clean_up = NULL,
+                        .dependencies = {NULL}};
+const module_t second = {.name = "second",
+                         .init = second_lifecycle,
+                         .start_up = second_lifecycle,
+                         .shut_down = NULL,
+                         .clean_up = NULL,
+                         .dependencies = {"first", NULL}};
+
+const module_t failing = {.name = "failing",
+                          .init = failing_lifecycle,
+                          .start_up = failing_lifecycle,
+                          .shut_down = NULL,
+                          .clean_up = NULL,
+                          .dependencies = {NULL}};
+const module_t after_failing = {.name = "after_failing",
+                                .init = second_lifecycle,
+                                .start_up = second_lifecycle,
+                                .shut_down = NULL,
+                                .clean_up = NULL,
+                                .dependencies = {"failing", NULL}};
+
+}  // namespace
+
+class ModuleTest : public AllocationTestHarness {
+ protected:
+  void SetUp() override {
+    AllocationTestHarness::SetUp();
+    module_management_start();
+    running = 0;
+    max_running = 0;
+    finished = 0;
+    first_done = false;
+    second_saw_first_done = false;
+  }
+
+  void TearDown() override {
+    module_management_stop();
+    AllocationTestHarness::TearDown();
+  }
+};
+
+TEST_F(ModuleTest, test_independent_modules_run_concurrently) {
+  const module_t* modules[] = {&slow_a, &slow_b, &slow_c, NULL};
+
+  EXPECT_TRUE(module_init_all(modules));
+  EXPECT_EQ(3, finished);
+  EXPECT_EQ(3, max_running);
+
+  max_running = 0;
+  EXPECT_TRUE(module_start_up_all(modules));
+  EXPECT_EQ(6, finished);
+  EXPECT_EQ(3, max_running);
+}
+
+TEST_F(ModuleTest, test_dependencies_run_first) {
+  // Listed in the wrong order on purpose
+  const module_t* modules[] = {&second, &first, NULL};
+
+  EXPECT_TRUE(module_init_all(modules));
+  EXPECT_TRUE(second_saw_first_done);
+
+  first_done = false;
+  second_saw_first_done = false;
+  EXPECT_TRUE(module_start_up_all(modules));
+  EXPECT_TRUE(second_saw_first_done);
+}
+
+TEST_F(ModuleTest, test_dependents_of_failed_module_are_skipped) {
+  const module_t* modules[] = {&after_failing, &failing, &first, NULL};
+
+  EXPECT_FALSE(module_init_all(modules));
+  EXPECT_EQ(0, finished);
+  EXPECT_TRUE(first_done);
+
+  // Nothing was initialized but |first|, so everything else can be retried
+  EXPECT_TRUE(module_init(&after_failing));
+}
+
+TEST_F(ModuleTest, test_debug_dump_lists_modules) {
+  const module_t* modules[] = {&first, &second, NULL};
+  EXPECT_TRUE(module_init_all(modules));
+
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  module_debug_dump(fileno(file));
+
+  std::string dump(4096, '\0');
+  rewind(file);
+  dump.resize(fread(&dump[0], 1, dump.size(), file));
+  fclose(file);
+
+  EXPECT_NE(std::string::npos, dump.find("first"));
+  EXPECT_NE(std::string::npos, dump.find("second"));
+}
@@ -341,6 +341,21 @@ class BtaAvCo {
   BT_HDR* GetNextSourceDataPacket(const uint8_t* p_codec_info,
                                   uint32_t* p_timestamp);
 
+  /**
+   * Check whether the encoded audio data packets read for a stream are
+   * copied to another stream.
+   * In multi-stream mode the streams able to decode the active peer's frames
+   * share them, and so do the streams able to decode the frames of the same
+   * extra encoding. Otherwise all streams share the active peer's frames.
+   *
+   * @param p_codec_info the codec configuration of the stream the packets
+   * were read for
+   * @param p_other_codec_info the codec configuration of the other stream
+   * @return true if the other stream shares the packets
+   */
+  bool SharesSourceDataPackets(const uint8_t* p_codec_info,
+                               const uint8_t* p_other_codec_info);
+
   /**
    * An audio packet has been dropped.
    * This signal can be used by the encoder to reduce the encoder bit rate
@@ -1309,10 +1324,33 @@ void BtaAvCo::ProcessStop(tBTA_AV_HNDL bta_av_handle,
 BT_HDR* BtaAvCo::GetNextSourceDataPacket(const uint8_t* p_codec_info,
                                          uint32_t* p_timestamp) {
   BT_HDR* p_buf;
+  const BtaAvCoPeer* p_peer = active_peer_;
 
   APPL_TRACE_DEBUG("%s: codec: %s", __func__, A2DP_CodecName(p_codec_info));
 
-  p_buf = btif_a2dp_source_audio_readbuf();
+  if (btif_a2dp_source_multi_stream_enabled()) {
+    std::lock_guard<std::recursive_mutex> lock(codec_lock_);
+    if (active_peer_ != nullptr &&
+        !A2DP_CodecFramesCompatible(active_peer_->codec_config,
+                                    p_codec_info)) {
+      // A sink that cannot decode the active peer's frames
+      p_peer = nullptr;
+      for (size_t i = 0; i < BTA_AV_CO_NUM_ELEMENTS(peers_); i++) {
+        if (peers_[i].opened &&
+            A2DP_CodecEquals(peers_[i].codec_config, p_codec_info)) {
+          p_peer = &peers_[i];
+          break;
+        }
+      }
+      if (p_peer == nullptr) return nullptr;
+    }
+  }
+
+  if (p_peer != nullptr && p_peer != active_peer_) {
+    p_buf = btif_a2dp_source_extra_audio_readbuf(p_peer->addr, p_codec_info);
+  } else {
+    p_buf = btif_a2dp_source_audio_readbuf();
+  }
   if (p_buf == nullptr) return nullptr;
 
   /*
@@ -1330,8 +1368,8 @@ BT_HDR* BtaAvCo::GetNextSourceDataPacket(const uint8_t* p_codec_info,
                      A2DP_GetCodecType(p_codec_info));
   }
 
-  if (ContentProtectEnabled() && (active_peer_ != nullptr) &&
-      active_peer_->ContentProtectActive()) {
+  if (ContentProtectEnabled() && (p_peer != nullptr) &&
+      p_peer->ContentProtectActive()) {
     p_buf->len++;
     p_buf->offset--;
     uint8_t* p = (uint8_t*)(p_buf + 1) + p_buf->offset;
@@ -1341,6 +1379,26 @@ BT_HDR* BtaAvCo::GetNextSourceDataPacket(const uint8_t* p_codec_info,
   return p_buf;
 }
 
+bool BtaAvCo::SharesSourceDataPackets(const uint8_t* p_codec_info,
+                                      const uint8_t* p_other_codec_info) {
+  if (!btif_a2dp_source_multi_stream_enabled()) return true;
+
+  bool active_frames;
+  bool other_active_frames;
+  {
+    std::lock_guard<std::recursive_mutex> lock(codec_lock_);
+    if (active_peer_ == nullptr) return true;
+    active_frames =
+        A2DP_CodecFramesCompatible(active_peer_->codec_config, p_codec_info);
+    other_active_frames = A2DP_CodecFramesCompatible(
+        active_peer_->codec_config, p_other_codec_info);
+  }
+  if (active_frames || other_active_frames)
+    return active_frames && other_active_frames;
+  return btif_a2dp_source_extra_stream_shared(p_codec_info,
+                                              p_other_codec_info);
+}
+
 void BtaAvCo::DataPacketWasDropped(tBTA_AV_HNDL bta_av_handle,
                                    const RawAddress& peer_address) {
   APPL_TRACE_ERROR("%s: peer %s dropped audio packet on handle 0x%x", __func__,
@@ -2114,6 +2172,12 @@ void bta_av_co_audio_drop(tBTA_AV_HNDL bta_av_handle,
   bta_av_co_cb.DataPacketWasDropped(bta_av_handle, peer_address);
 }
 
+bool bta_av_co_audio_share_frames(const uint8_t* p_codec_info,
+                                  const uint8_t* p_other_codec_info) {
+  return bta_av_co_cb.SharesSourceDataPackets(p_codec_info,
+                                              p_other_codec_info);
+}
+
 void bta_av_co_audio_delay(tBTA_AV_HNDL bta_av_handle,
                            const RawAddress& peer_address, uint16_t delay) {
   bta_av_co_cb.ProcessAudioDelay(bta_av_handle, peer_address, delay);
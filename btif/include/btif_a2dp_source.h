@@ -117,6 +117,24 @@ void btif_a2dp_source_set_tx_flush(bool enable);
 // Returns the next A2DP buffer to send if available, otherwise NULL.
 BT_HDR* btif_a2dp_source_audio_readbuf(void);
 
+// Checks whether multi-stream mode is enabled: the audio is then also
+// encoded for the sinks that cannot decode the active peer's frames.
+bool btif_a2dp_source_multi_stream_enabled(void);
+
+// Get the next A2DP buffer to send to |peer_address|, whose stream is
+// configured with |p_codec_info| and cannot decode the active peer's frames.
+// Such streams are only encoded in multi-stream mode. The first request for
+// a configuration sets its encoding up, the sinks able to decode its frames
+// share it.
+// Returns the next A2DP buffer to send if available, otherwise NULL.
+BT_HDR* btif_a2dp_source_extra_audio_readbuf(const RawAddress& peer_address,
+                                             const uint8_t* p_codec_info);
+
+// Checks whether the streams configured with |p_codec_info| and
+// |p_other_codec_info| take their frames from the same extra encoding.
+bool btif_a2dp_source_extra_stream_shared(const uint8_t* p_codec_info,
+                                          const uint8_t* p_other_codec_info);
+
 // Dump debug-related information for the A2DP Source module.
 // |fd| is the file descriptor to use for writing the ASCII formatted
 // information.
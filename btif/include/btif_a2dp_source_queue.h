@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_A2DP_SOURCE_QUEUE_H
+#define BTIF_A2DP_SOURCE_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <mutex>
+
+#include "bt_types.h"
+
+// Encoded A2DP packets waiting for the BTA data path to send them.
+//
+// The queue is bounded by how much audio it holds rather than by how many
+// packets: when a new packet does not fit, only as many of the oldest
+// packets as needed are dropped to make room for it. The time every packet
+// spent queued is counted in a histogram.
+//
+// Packets are queued by the media task and taken by the BTA data path, all
+// methods may be called from either thread.
+class BtifA2dpSourceQueue {
+ public:
+  // Queueing delays are counted in buckets of increasing upper limits, see
+  // DelayHistogramLimitUs(). The last bucket counts the longer delays.
+  static constexpr size_t kDelayHistogramSize = 9;
+
+  struct Stats {
+    size_t enqueued_packets = 0;
+    size_t dequeued_packets = 0;
+    size_t dropped_packets = 0;
+    uint64_t dropped_audio_us = 0;
+    size_t flushed_packets = 0;
+    uint64_t total_delay_us = 0;
+    uint64_t max_delay_us = 0;
+    size_t delay_histogram[kDelayHistogramSize] = {};
+  };
+
+  BtifA2dpSourceQueue();
+  ~BtifA2dpSourceQueue();
+
+  // Limits the queue to |max_packets| packets holding at most |max_audio_us|
+  // of audio. A zero |max_audio_us| leaves only the packet limit.
+  void SetLimits(size_t max_packets, uint64_t max_audio_us);
+
+  // Queues |p_buf|, holding |audio_us| of audio, at time |now_us|.
+  // Returns the number of queued packets dropped to make room for it.
+  size_t Enqueue(BT_HDR* p_buf, uint64_t audio_us, uint64_t now_us);
+
+  // Takes the oldest packet out of the queue at time |now_us|.
+  // Returns the packet if there is one, otherwise nullptr.
+  BT_HDR* Dequeue(uint64_t now_us);
+
+  // Frees all queued packets.
+  // Returns the number of packets freed.
+  size_t Flush();
+
+  size_t Length() const;
+
+  // Returns how much audio the queued packets hold.
+  uint64_t QueuedAudioUs() const;
+
+  Stats GetStats() const;
+  void ResetStats();
+
+  // Returns the upper limit of the delays counted in |bucket|.
+  static uint64_t DelayHistogramLimitUs(size_t bucket);
+
+ private:
+  struct Packet {
+    BT_HDR* p_buf;
+    uint64_t audio_us;
+    uint64_t enqueue_us;
+  };
+
+  mutable std::mutex mutex_;
+  std::deque<Packet> packets_;
+  size_t max_packets_;
+  uint64_t max_audio_us_;
+  uint64_t queued_audio_us_;
+  Stats stats_;
+};
+
+#endif /* BTIF_A2DP_SOURCE_QUEUE_H */
@@ -0,0 +1,140 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_A2DP_SOURCE_STREAMS_H
+#define BTIF_A2DP_SOURCE_STREAMS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "avdt_api.h"
+#include "raw_address.h"
+
+// The PCM read from the audio HAL for the active peer, kept for the extra
+// encoders of multi-stream mode.
+//
+// Every reader keeps its own position in the audio. Positions count the
+// bytes written since the tap was created, so they stay valid when older
+// audio is forgotten. The tap holds at most |max_bytes| of audio: a reader
+// that falls further behind loses its oldest audio.
+//
+// Not thread-safe, the media task is the only user.
+class BtifA2dpSourcePcmTap {
+ public:
+  explicit BtifA2dpSourcePcmTap(size_t max_bytes);
+
+  // Appends |len| bytes from |p_buf|, forgetting the oldest audio beyond
+  // the size limit.
+  void Write(const uint8_t* p_buf, size_t len);
+
+  // Copies at most |len| bytes from position |*p_offset| to |p_buf| and
+  // advances the position. A position before the oldest kept byte first
+  // skips ahead to it, the bytes skipped are added to |*p_lost_bytes|.
+  // Returns the number of bytes copied.
+  size_t Read(uint64_t* p_offset, uint8_t* p_buf, size_t len,
+              size_t* p_lost_bytes);
+
+  // Forgets the audio before position |offset|, once all readers are past
+  // it.
+  void Discard(uint64_t offset);
+
+  // Forgets all audio. Positions keep counting from End().
+  void Clear();
+
+  // Position of the oldest kept byte.
+  uint64_t Start() const { return start_; }
+  // Position of the next byte written.
+  uint64_t End() const { return start_ + pcm_.size(); }
+  size_t Size() const { return pcm_.size(); }
+
+ private:
+  size_t max_bytes_;
+  std::vector<uint8_t> pcm_;
+  uint64_t start_;
+};
+
+// The extra streams of multi-stream mode, for the sinks that cannot decode
+// the frames encoded for the active peer.
+//
+// A stream is set up for the codec configuration of the first sink asking
+// for it. Other sinks able to decode its frames share it, BTA copies the
+// frames to each of them. A stream no sink asked frames from for |idle_us|
+// is idle and should be released.
+//
+// Not thread-safe, the caller serializes the media task and the BTA data
+// path.
+class BtifA2dpSourceStreams {
+ public:
+  static constexpr size_t kNoStream = static_cast<size_t>(-1);
+
+  enum State {
+    kStreamUnused,
+    kStreamPending,        // Asked for by the data path, not set up yet
+    kStreamEncoding,       // Encoded on every media tick
+    kStreamReconfiguring,  // Cannot be encoded, the sink is reconfigured
+  };
+
+  struct Stream {
+    State state;
+    uint8_t codec_info[AVDT_CODEC_SIZE];
+    RawAddress peer_address;  // The sink that asked for the stream first
+    uint64_t last_read_us;    // When a sink last asked for frames
+  };
+
+  // Tells whether a sink configured with |p_codec_info_sink| can decode the
+  // frames encoded for |p_codec_info_frames|.
+  using FramesCompatibleCallback =
+      std::function<bool(const uint8_t* p_codec_info_frames,
+                         const uint8_t* p_codec_info_sink)>;
+
+  BtifA2dpSourceStreams(size_t max_streams, uint64_t idle_us,
+                        FramesCompatibleCallback frames_compatible);
+
+  // Finds the stream a sink configured with |p_codec_info| takes its frames
+  // from and marks it read at |now_us|. If there is none, a free stream is
+  // taken for |peer_address| in state kStreamPending and |*p_added| is set.
+  // Returns the index of the stream, or kNoStream if all are taken.
+  size_t Request(const uint8_t* p_codec_info, const RawAddress& peer_address,
+                 uint64_t now_us, bool* p_added);
+
+  // Returns the index of the stream a sink configured with |p_codec_info|
+  // takes its frames from, or kNoStream if there is none.
+  size_t Find(const uint8_t* p_codec_info) const;
+
+  // Returns the indexes of the streams in use that are idle at |now_us|.
+  std::vector<size_t> IdleStreams(uint64_t now_us) const;
+
+  void SetState(size_t index, State state);
+  void Release(size_t index);
+  void ReleaseAll();
+
+  const Stream& Get(size_t index) const { return streams_[index]; }
+  size_t Size() const { return streams_.size(); }
+
+  static const char* StateName(State state);
+
+ private:
+  uint64_t idle_us_;
+  FramesCompatibleCallback frames_compatible_;
+  std::vector<Stream> streams_;
+};
+
+#endif /* BTIF_A2DP_SOURCE_STREAMS_H */
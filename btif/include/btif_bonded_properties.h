@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_BONDED_PROPERTIES_H
+#define BTIF_BONDED_PROPERTIES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "types/raw_address.h"
+
+// Reports the remote properties of the bonded devices on the JNI thread,
+// kBatchSize devices per task. Each batch posts the next one behind whatever
+// is already queued, so a long list doesn't hold up the JNI thread.
+//
+// The adapter is reported on without waiting for the reports: the keys are
+// with BTM and the bonded device list with Java by then, only the names,
+// classes and services of the devices follow.
+//
+// All methods are called on the JNI thread.
+class BtifBondedPropertiesReporter {
+ public:
+  static constexpr size_t kBatchSize = 16;
+
+  // Runs |task| on the JNI thread after the tasks already queued there
+  using PostCallback = std::function<void(std::function<void()> task)>;
+  // Reports the remote properties of |bd_addr|
+  using ReportCallback = std::function<void(const RawAddress& bd_addr)>;
+
+  BtifBondedPropertiesReporter(PostCallback post, ReportCallback report);
+
+  // Starts reporting |devices|, replacing the ones not reported yet from an
+  // earlier Start().
+  void Start(std::vector<RawAddress> devices);
+
+  // Drops the devices not reported yet.
+  void Stop();
+
+  bool IsReporting() const { return reporting_; }
+
+ private:
+  void ReportBatch(uint32_t generation);
+
+  PostCallback post_;
+  ReportCallback report_;
+  std::vector<RawAddress> devices_;
+  size_t next_ = 0;
+  bool reporting_ = false;
+  // Bumped whenever a report starts or stops, so a batch posted for an
+  // earlier one does nothing
+  uint32_t generation_ = 0;
+};
+
+#endif /* BTIF_BONDED_PROPERTIES_H */
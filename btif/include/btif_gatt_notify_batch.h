@@ -0,0 +1,107 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_GATT_NOTIFY_BATCH_H
+#define BTIF_GATT_NOTIFY_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "types/raw_address.h"
+
+// GATT client notifications on their way from the BTA thread to the JNI
+// thread, batched per connection.
+//
+// The first notification of a batch schedules its delivery after the latency
+// budget. Notifications arriving before then join the batch, until it holds
+// kMaxNotifications notifications or kMaxBytes of values: it is then closed
+// and scheduled for delivery right away, and the next notification starts a
+// new batch. Flush() closes all batches, so that a notification never joins
+// a batch scheduled ahead of another event.
+//
+// A scheduled delivery only covers the batches started before it was
+// scheduled, and batches of a connection are delivered in the order they
+// were started.
+//
+// Add() and Flush() are called on the BTA thread, Deliver() on the JNI
+// thread.
+class BtifGattNotifyBatcher {
+ public:
+  static constexpr size_t kMaxNotifications = 32;
+  static constexpr size_t kMaxBytes = 8 * 1024;
+
+  struct Notification {
+    RawAddress bda;
+    uint16_t handle;
+    bool is_notify;
+    const uint8_t* value;
+    uint16_t len;
+  };
+
+  // Schedules Deliver(|conn_id|, |batch_id|) on the delivering thread in
+  // |delay_ms|
+  using PostCallback =
+      std::function<void(uint16_t conn_id, uint64_t batch_id, int delay_ms)>;
+  using NotifyCallback =
+      std::function<void(uint16_t conn_id, const Notification& notification)>;
+
+  BtifGattNotifyBatcher(PostCallback post, int latency_ms);
+
+  void Add(uint16_t conn_id, const Notification& notification);
+
+  // Passes the notifications of the batches of |conn_id| up to |batch_id| to
+  // |notify|. Does nothing if they were delivered already.
+  void Deliver(uint16_t conn_id, uint64_t batch_id,
+               const NotifyCallback& notify);
+
+  // Schedules every pending batch for delivery right away.
+  void Flush();
+
+  // Returns the number of batches of |conn_id| waiting for delivery.
+  size_t PendingBatches(uint16_t conn_id) const;
+
+ private:
+  struct Entry {
+    RawAddress bda;
+    uint16_t handle;
+    bool is_notify;
+    uint16_t len;
+    size_t offset;
+  };
+
+  struct Batch {
+    std::vector<Entry> entries;
+    std::vector<uint8_t> payload;
+    uint64_t id = 0;
+    bool closed = false;
+  };
+
+  PostCallback post_;
+  int latency_ms_;
+  uint64_t next_batch_id_ = 1;
+  mutable std::mutex mutex_;
+  std::unordered_map<uint16_t, std::deque<Batch>> batches_;
+};
+
+#endif /* BTIF_GATT_NOTIFY_BATCH_H */
@@ -152,6 +152,19 @@ bt_status_t btif_storage_remove_bonded_device(const RawAddress* remote_bd_addr);
  ******************************************************************************/
 bt_status_t btif_storage_load_bonded_devices(void);
 
+/*******************************************************************************
+ *
+ * Function         btif_storage_stop_loading_bonded_devices
+ *
+ * Description      BTIF storage API - Stops reporting the remote properties
+ *                  of bonded devices still pending from
+ *                  btif_storage_load_bonded_devices.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btif_storage_stop_loading_bonded_devices(void);
+
 /*******************************************************************************
  *
  * Function         btif_storage_add_hid_device_info
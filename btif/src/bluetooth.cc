@@ -51,6 +51,7 @@
 #include "bt_utils.h"
 #include "bta/include/bta_hearing_aid_api.h"
 #include "bta/include/bta_hf_client_api.h"
+#include "btcore/include/module.h"
 #include "btif_a2dp.h"
 #include "btif_api.h"
 #include "btif_av.h"
@@ -60,9 +61,12 @@
 #include "btif_debug_conn.h"
 #include "btif_hf.h"
 #include "btif_storage.h"
+#include "btm_ble_api.h"
 #include "btsnoop.h"
 #include "btsnoop_mem.h"
+#include "btu.h"
 #include "device/include/interop.h"
+#include "l2c_api.h"
 #include "osi/include/alarm.h"
 #include "osi/include/allocation_tracker.h"
 #include "osi/include/log.h"
@@ -316,9 +320,13 @@ static void dump(int fd, const char** arguments) {
   btif_debug_av_dump(fd);
   bta_debug_av_dump(fd);
   stack_debug_avdtp_api_dump(fd);
+  stack_debug_l2cap_api_dump(fd);
+  btu_hcif_debug_dump(fd);
+  btm_ble_privacy_debug_dump(fd);
   bluetooth::avrcp::AvrcpService::DebugDump(fd);
   btif_debug_config_dump(fd);
   BTA_HfClientDumpStatistics(fd);
+  module_debug_dump(fd);
   wakelock_debug_dump(fd);
   osi_allocator_debug_dump(fd);
   alarm_debug_dump(fd);
@@ -27,6 +27,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <string.h>
+#include <time.h>
 #include <algorithm>
 
 #include "audio_a2dp_hw/include/audio_a2dp_hw.h"
@@ -36,19 +37,22 @@
 #include "btif_a2dp_audio_interface.h"
 #include "btif_a2dp_control.h"
 #include "btif_a2dp_source.h"
+#include "btif_a2dp_source_queue.h"
+#include "btif_a2dp_source_streams.h"
 #include "btif_av.h"
 #include "btif_av_co.h"
 #include "btif_util.h"
-#include "osi/include/fixed_queue.h"
 #include "osi/include/log.h"
 #include "osi/include/metrics.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 #include "osi/include/thread.h"
 #include "osi/include/time.h"
 #include "uipc.h"
 
 #include <condition_variable>
 #include <mutex>
+#include <vector>
 
 using system_bt_osi::BluetoothMetricsLogger;
 using system_bt_osi::A2dpSessionMetrics;
@@ -62,6 +66,38 @@ extern std::unique_ptr<tUIPC_STATE> a2dp_uipc;
  */
 #define MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
 
+/**
+ * How much audio the tx queue may hold. When the link cannot keep up the
+ * oldest packets are dropped, so the audio the sink plays never lags more
+ * than this behind the audio being encoded.
+ */
+#define MAX_OUTPUT_A2DP_QUEUE_DELAY_MS 240
+
+/* The link is looked into at most this often while the tx queue overflows */
+#define A2DP_SOURCE_LINK_INFO_INTERVAL_MS 1000
+
+/**
+ * In multi-stream mode the audio is also encoded for the sinks that cannot
+ * decode the frames encoded for the active peer. Sinks able to decode the
+ * same frames share them: BTA copies the frames to each of their AVDTP
+ * streams, which queue and drop them per stream. With the mode off all
+ * sinks get the active peer's frames.
+ */
+#define A2DP_SOURCE_MULTI_STREAM_PROPERTY \
+  "persist.bluetooth.a2dp_source.multi_stream"
+
+/**
+ * Encoders keep their state per codec type, so every extra stream needs a
+ * codec type of its own. This bounds how many there can be at once.
+ */
+#define MAX_EXTRA_A2DP_SOURCE_STREAMS 3
+
+/* The PCM kept for extra streams that fall behind the active peer's */
+#define MAX_A2DP_SOURCE_PCM_TAP_SZ (AUDIO_STREAM_OUTPUT_BUFFER_SZ * 8)
+
+/* An extra stream no sink has asked frames from for this long is released */
+#define A2DP_SOURCE_EXTRA_STREAM_IDLE_MS 1000
+
 class SchedulingStats {
  public:
   SchedulingStats() { Reset(); }
@@ -254,6 +290,37 @@ class BtWorkerThread {
   std::condition_variable start_up_cv_;
 };
 
+// The encoder of an extra stream of multi-stream mode. The streams
+// themselves are kept by BtifA2dpSourceStreams, at the same index.
+class BtifA2dpSourceExtraEncoder {
+ public:
+  BtifA2dpSourceExtraEncoder() { Reset(); }
+
+  void Reset() {
+    encoder_interface = nullptr;
+    tx_audio_queue.Flush();
+    tx_audio_queue.ResetStats();
+    pcm_offset = 0;
+    tx_queue_total_frames = 0;
+    tx_queue_total_dropped_messages = 0;
+    tx_queue_dropouts = 0;
+    media_read_total_underflow_bytes = 0;
+    pcm_tap_lost_bytes = 0;
+    encode_cpu_us = 0;
+  }
+
+  const tA2DP_ENCODER_INTERFACE* encoder_interface; /* Set while encoding */
+  BtifA2dpSourceQueue tx_audio_queue;
+  uint64_t pcm_offset; /* Position of the next PCM byte to encode */
+
+  size_t tx_queue_total_frames;
+  size_t tx_queue_total_dropped_messages;
+  size_t tx_queue_dropouts;
+  size_t media_read_total_underflow_bytes;
+  size_t pcm_tap_lost_bytes;
+  uint64_t encode_cpu_us;
+};
+
 class BtifA2dpSource {
  public:
   enum RunState {
@@ -264,23 +331,42 @@ class BtifA2dpSource {
   };
 
   BtifA2dpSource()
-      : tx_audio_queue(nullptr),
+      : pcm_bytes_per_sec(0),
+        last_link_info_us(0),
         tx_flush(false),
         media_alarm(nullptr),
         encoder_interface(nullptr),
         encoder_interval_ms(0),
+        encode_cpu_us(0),
+        multi_stream(false),
+        extra_streams(MAX_EXTRA_A2DP_SOURCE_STREAMS,
+                      A2DP_SOURCE_EXTRA_STREAM_IDLE_MS * 1000,
+                      A2DP_CodecFramesCompatible),
+        extra_streams_encoding(0),
+        extra_encoder(nullptr),
+        pcm_tap(MAX_A2DP_SOURCE_PCM_TAP_SZ),
         state_(kStateOff) {}
 
   void Reset() {
-    fixed_queue_free(tx_audio_queue, nullptr);
-    tx_audio_queue = nullptr;
+    tx_audio_queue.Flush();
+    tx_audio_queue.ResetStats();
+    last_session_queue_stats = BtifA2dpSourceQueue::Stats();
+    pcm_bytes_per_sec = 0;
+    last_link_info_us = 0;
     tx_flush = false;
     alarm_free(media_alarm);
     media_alarm = nullptr;
     encoder_interface = nullptr;
     encoder_interval_ms = 0;
+    encode_cpu_us = 0;
     stats.Reset();
     accumulated_stats.Reset();
+    multi_stream = false;
+    extra_streams.ReleaseAll();
+    for (BtifA2dpSourceExtraEncoder& encoder : extra_encoders) encoder.Reset();
+    extra_streams_encoding = 0;
+    extra_encoder = nullptr;
+    pcm_tap.Clear();
     state_ = kStateOff;
   }
 
@@ -300,14 +386,30 @@ class BtifA2dpSource {
 
   void SetState(BtifA2dpSource::RunState state) { state_ = state; }
 
-  fixed_queue_t* tx_audio_queue;
+  BtifA2dpSourceQueue tx_audio_queue;
+  /* The queue statistics of the last audio session */
+  BtifA2dpSourceQueue::Stats last_session_queue_stats;
+  uint32_t pcm_bytes_per_sec; /* Used to tell how much audio a packet holds */
+  uint64_t last_link_info_us; /* When the link info was last read */
   bool tx_flush; /* Discards any outgoing data when true */
   alarm_t* media_alarm;
   const tA2DP_ENCODER_INTERFACE* encoder_interface;
   period_ms_t encoder_interval_ms; /* Local copy of the encoder interval */
+  uint64_t encode_cpu_us; /* CPU time spent encoding, multi-stream only */
   BtifMediaStats stats;
   BtifMediaStats accumulated_stats;
 
+  bool multi_stream; /* Encode for sinks with a configuration of their own */
+  /* The extra streams are guarded by the mutex, they are changed in the
+   * media task and looked up by the BTA data path. */
+  std::mutex extra_streams_mutex;
+  BtifA2dpSourceStreams extra_streams;
+  BtifA2dpSourceExtraEncoder extra_encoders[MAX_EXTRA_A2DP_SOURCE_STREAMS];
+  size_t extra_streams_encoding;
+  BtifA2dpSourceExtraEncoder* extra_encoder; /* Extra encoder running */
+  /* The PCM read for the active peer, kept for the extra encoders */
+  BtifA2dpSourcePcmTap pcm_tap;
+
  private:
   BtifA2dpSource::RunState state_;
 };
@@ -343,9 +445,23 @@ static void btif_a2dp_source_audio_handle_timer(void);
 static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len);
 static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
                                               uint32_t bytes_read);
+static void btif_a2dp_source_extra_stream_setup_event(size_t index);
+static void btif_a2dp_source_release_extra_stream(size_t index);
+static void btif_a2dp_source_release_extra_streams(void);
+static void btif_a2dp_source_encode_extra_streams(uint64_t timestamp_us);
+static uint32_t btif_a2dp_source_extra_read_callback(uint8_t* p_buf,
+                                                     uint32_t len);
+static bool btif_a2dp_source_extra_enqueue_callback(BT_HDR* p_buf,
+                                                    size_t frames_n,
+                                                    uint32_t bytes_read);
+static uint64_t btif_a2dp_source_pcm_duration_us(uint32_t bytes_read);
+static void btif_a2dp_source_log_tx_queue_overflow(const RawAddress& peer_bda);
+static uint64_t thread_cpu_time_us(void);
 static void log_tstamps_us(const char* comment, uint64_t timestamp_us);
 static void update_scheduling_stats(SchedulingStats* stats, uint64_t now_us,
                                     uint64_t expected_delta);
+static void btif_a2dp_source_dump_queue_stats(
+    int fd, const char* title, const BtifA2dpSourceQueue::Stats& stats);
 // Update the A2DP Source related metrics.
 // This function should be called before collecting the metrics.
 static void btif_a2dp_source_update_metrics(void);
@@ -430,7 +546,10 @@ bool btif_a2dp_source_startup(void) {
 
   btif_a2dp_source_cb.Reset();
   btif_a2dp_source_cb.SetState(BtifA2dpSource::kStateStartingUp);
-  btif_a2dp_source_cb.tx_audio_queue = fixed_queue_new(SIZE_MAX);
+  btif_a2dp_source_cb.tx_audio_queue.SetLimits(
+      MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ, MAX_OUTPUT_A2DP_QUEUE_DELAY_MS * 1000);
+  btif_a2dp_source_cb.multi_stream =
+      osi_property_get_bool(A2DP_SOURCE_MULTI_STREAM_PROPERTY, false);
 
   // Schedule the rest of the operations
   btif_a2dp_source_thread.DoInThread(
@@ -564,11 +683,11 @@ static void btif_a2dp_source_shutdown_delayed(void) {
   alarm_free(btif_a2dp_source_cb.media_alarm);
   btif_a2dp_source_cb.media_alarm = nullptr;
 
+  btif_a2dp_source_release_extra_streams();
   btif_a2dp_control_cleanup();
   if (btif_av_is_a2dp_offload_enabled())
     btif_a2dp_audio_interface_end_session();
-  fixed_queue_free(btif_a2dp_source_cb.tx_audio_queue, nullptr);
-  btif_a2dp_source_cb.tx_audio_queue = nullptr;
+  btif_a2dp_source_cb.tx_audio_queue.Flush();
 
   btif_a2dp_source_cb.SetState(BtifA2dpSource::kStateOff);
 }
@@ -626,6 +745,9 @@ static void btif_a2dp_source_setup_codec_delayed(
            peer_address.ToString().c_str(),
            btif_a2dp_source_cb.StateStr().c_str());
 
+  // The extra streams were set up next to the old encoder
+  btif_a2dp_source_release_extra_streams();
+
   tA2DP_ENCODER_INIT_PEER_PARAMS peer_params;
   bta_av_co_get_peer_params(peer_address, &peer_params);
 
@@ -652,6 +774,19 @@ static void btif_a2dp_source_setup_codec_delayed(
       &peer_params, a2dp_codec_config, btif_a2dp_source_read_callback,
       btif_a2dp_source_enqueue_callback);
 
+  // The tx queue is bounded by how much audio the packets hold
+  uint8_t codec_info[AVDT_CODEC_SIZE];
+  btif_a2dp_source_cb.pcm_bytes_per_sec = 0;
+  if (a2dp_codec_config->copyOutOtaCodecConfig(codec_info)) {
+    int sample_rate = A2DP_GetTrackSampleRate(codec_info);
+    int channel_count = A2DP_GetTrackChannelCount(codec_info);
+    if (sample_rate > 0 && channel_count > 0) {
+      btif_a2dp_source_cb.pcm_bytes_per_sec =
+          sample_rate * channel_count *
+          (a2dp_codec_config->getAudioBitsPerSample() / 8);
+    }
+  }
+
   // Save a local copy of the encoder_interval_ms
   btif_a2dp_source_cb.encoder_interval_ms =
       btif_a2dp_source_cb.encoder_interface->get_encoder_interval_ms();
@@ -813,6 +948,7 @@ static void btif_a2dp_source_audio_tx_start_event(void) {
             btif_a2dp_source_alarm_cb, nullptr);
 
   btif_a2dp_source_cb.stats.Reset();
+  btif_a2dp_source_cb.tx_audio_queue.ResetStats();
   // Assign session_start_us to 1 when time_get_os_boottime_us() is 0 to
   // indicate btif_a2dp_source_start_audio_req() has been called
   btif_a2dp_source_cb.stats.session_start_us = time_get_os_boottime_us();
@@ -839,6 +975,8 @@ static void btif_a2dp_source_audio_tx_stop_event(void) {
   btif_a2dp_source_update_metrics();
   btif_a2dp_source_accumulate_stats(&btif_a2dp_source_cb.stats,
                                     &btif_a2dp_source_cb.accumulated_stats);
+  btif_a2dp_source_cb.last_session_queue_stats =
+      btif_a2dp_source_cb.tx_audio_queue.GetStats();
 
   uint8_t p_buf[AUDIO_STREAM_OUTPUT_BUFFER_SZ * 2];
   uint16_t event;
@@ -851,6 +989,8 @@ static void btif_a2dp_source_audio_tx_stop_event(void) {
   alarm_free(btif_a2dp_source_cb.media_alarm);
   btif_a2dp_source_cb.media_alarm = nullptr;
 
+  btif_a2dp_source_release_extra_streams();
+
   UIPC_Close(*a2dp_uipc, UIPC_CH_ID_AV_AUDIO);
 
   /*
@@ -893,8 +1033,7 @@ static void btif_a2dp_source_audio_handle_timer(void) {
     return;
   }
   CHECK(btif_a2dp_source_cb.encoder_interface != nullptr);
-  size_t transmit_queue_length =
-      fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+  size_t transmit_queue_length = btif_a2dp_source_cb.tx_audio_queue.Length();
 #ifndef OS_GENERIC
   ATRACE_INT("btif TX queue", transmit_queue_length);
 #endif
@@ -903,7 +1042,14 @@ static void btif_a2dp_source_audio_handle_timer(void) {
     btif_a2dp_source_cb.encoder_interface->set_transmit_queue_length(
         transmit_queue_length);
   }
-  btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
+  if (btif_a2dp_source_cb.multi_stream) {
+    uint64_t cpu_start_us = thread_cpu_time_us();
+    btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
+    btif_a2dp_source_cb.encode_cpu_us += thread_cpu_time_us() - cpu_start_us;
+    btif_a2dp_source_encode_extra_streams(timestamp_us);
+  } else {
+    btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
+  }
   bta_av_ci_src_data_ready(BTA_AV_CHNL_AUDIO);
   update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_enqueue_stats,
                           timestamp_us,
@@ -925,6 +1071,10 @@ static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
         time_get_os_boottime_us();
   }
 
+  // Keep the audio for the extra streams to encode as well
+  if (btif_a2dp_source_cb.extra_streams_encoding > 0)
+    btif_a2dp_source_cb.pcm_tap.Write(p_buf, bytes_read);
+
   return bytes_read;
 }
 
@@ -944,69 +1094,45 @@ static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
     LOG_VERBOSE(LOG_TAG, "%s: tx suspended, discarded frame", __func__);
 
     btif_a2dp_source_cb.stats.tx_queue_total_flushed_messages +=
-        fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+        btif_a2dp_source_cb.tx_audio_queue.Flush();
     btif_a2dp_source_cb.stats.tx_queue_last_flushed_us = now_us;
-    fixed_queue_flush(btif_a2dp_source_cb.tx_audio_queue, osi_free);
 
     osi_free(p_buf);
     return false;
   }
 
-  // Check for TX queue overflow
-  // TODO: Using frames_n here is probably wrong: should be "+ 1" instead.
-  if (fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue) + frames_n >
-      MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ) {
-    LOG_WARN(LOG_TAG, "%s: TX queue buffer size now=%u adding=%u max=%d",
-             __func__,
-             (uint32_t)fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue),
-             (uint32_t)frames_n, MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ);
+  /* Update the statistics */
+  btif_a2dp_source_cb.stats.tx_queue_total_frames += frames_n;
+  btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet = std::max(
+      frames_n, btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet);
+  CHECK(btif_a2dp_source_cb.encoder_interface != nullptr);
+
+  // When the queue is full only the oldest packets are dropped, as many as
+  // needed to make room for this one
+  size_t drop_n = btif_a2dp_source_cb.tx_audio_queue.Enqueue(
+      p_buf, btif_a2dp_source_pcm_duration_us(bytes_read), now_us);
+  if (drop_n > 0) {
+    LOG_WARN(LOG_TAG,
+             "%s: TX queue overflow: dropped=%zu now=%zu queued=%" PRIu64
+             " us",
+             __func__, drop_n, btif_a2dp_source_cb.tx_audio_queue.Length(),
+             btif_a2dp_source_cb.tx_audio_queue.QueuedAudioUs());
     // Keep track of drop-outs
     btif_a2dp_source_cb.stats.tx_queue_dropouts++;
     btif_a2dp_source_cb.stats.tx_queue_last_dropouts_us = now_us;
-
-    // Flush all queued buffers
-    size_t drop_n = fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+    btif_a2dp_source_cb.stats.tx_queue_total_dropped_messages += drop_n;
     btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages = std::max(
         drop_n, btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages);
-    while (fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue)) {
-      btif_a2dp_source_cb.stats.tx_queue_total_dropped_messages++;
-      osi_free(fixed_queue_try_dequeue(btif_a2dp_source_cb.tx_audio_queue));
-    }
 
-    // Request additional debug info if we had to flush buffers
-    RawAddress peer_bda = btif_av_source_active_peer();
-    tBTM_STATUS status = BTM_ReadRSSI(peer_bda, btm_read_rssi_cb);
-    if (status != BTM_CMD_STARTED) {
-      LOG_WARN(LOG_TAG, "%s: Cannot read RSSI: status %d", __func__, status);
-    }
-    status = BTM_ReadFailedContactCounter(peer_bda,
-                                          btm_read_failed_contact_counter_cb);
-    if (status != BTM_CMD_STARTED) {
-      LOG_WARN(LOG_TAG, "%s: Cannot read Failed Contact Counter: status %d",
-               __func__, status);
-    }
-    status = BTM_ReadAutomaticFlushTimeout(peer_bda,
-                                           btm_read_automatic_flush_timeout_cb);
-    if (status != BTM_CMD_STARTED) {
-      LOG_WARN(LOG_TAG, "%s: Cannot read Automatic Flush Timeout: status %d",
-               __func__, status);
-    }
-    status =
-        BTM_ReadTxPower(peer_bda, BT_TRANSPORT_BR_EDR, btm_read_tx_power_cb);
-    if (status != BTM_CMD_STARTED) {
-      LOG_WARN(LOG_TAG, "%s: Cannot read Tx Power: status %d", __func__,
-               status);
+    // Request additional debug info, at most once a second while packets
+    // keep being dropped
+    if (now_us - btif_a2dp_source_cb.last_link_info_us >
+        A2DP_SOURCE_LINK_INFO_INTERVAL_MS * 1000) {
+      btif_a2dp_source_cb.last_link_info_us = now_us;
+      btif_a2dp_source_log_tx_queue_overflow(btif_av_source_active_peer());
     }
   }
 
-  /* Update the statistics */
-  btif_a2dp_source_cb.stats.tx_queue_total_frames += frames_n;
-  btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet = std::max(
-      frames_n, btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet);
-  CHECK(btif_a2dp_source_cb.encoder_interface != nullptr);
-
-  fixed_queue_enqueue(btif_a2dp_source_cb.tx_audio_queue, p_buf);
-
   return true;
 }
 
@@ -1019,11 +1145,13 @@ static void btif_a2dp_source_audio_tx_flush_event(void) {
   if (btif_a2dp_source_cb.encoder_interface != nullptr)
     btif_a2dp_source_cb.encoder_interface->feeding_flush();
 
+  // The extra streams are set up again for the sinks still streaming
+  btif_a2dp_source_release_extra_streams();
+
   btif_a2dp_source_cb.stats.tx_queue_total_flushed_messages +=
-      fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+      btif_a2dp_source_cb.tx_audio_queue.Flush();
   btif_a2dp_source_cb.stats.tx_queue_last_flushed_us =
       time_get_os_boottime_us();
-  fixed_queue_flush(btif_a2dp_source_cb.tx_audio_queue, osi_free);
 
   UIPC_Ioctl(*a2dp_uipc, UIPC_CH_ID_AV_AUDIO, UIPC_REQ_RX_FLUSH, nullptr);
 }
@@ -1039,8 +1167,7 @@ static bool btif_a2dp_source_audio_tx_flush_req(void) {
 
 BT_HDR* btif_a2dp_source_audio_readbuf(void) {
   uint64_t now_us = time_get_os_boottime_us();
-  BT_HDR* p_buf =
-      (BT_HDR*)fixed_queue_try_dequeue(btif_a2dp_source_cb.tx_audio_queue);
+  BT_HDR* p_buf = btif_a2dp_source_cb.tx_audio_queue.Dequeue(now_us);
 
   btif_a2dp_source_cb.stats.tx_queue_total_readbuf_calls++;
   btif_a2dp_source_cb.stats.tx_queue_last_readbuf_us = now_us;
@@ -1054,12 +1181,303 @@ BT_HDR* btif_a2dp_source_audio_readbuf(void) {
   return p_buf;
 }
 
+bool btif_a2dp_source_multi_stream_enabled(void) {
+  return btif_a2dp_source_cb.multi_stream;
+}
+
+bool btif_a2dp_source_extra_stream_shared(const uint8_t* p_codec_info,
+                                          const uint8_t* p_other_codec_info) {
+  std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+  size_t index = btif_a2dp_source_cb.extra_streams.Find(p_codec_info);
+  return index != BtifA2dpSourceStreams::kNoStream &&
+         index == btif_a2dp_source_cb.extra_streams.Find(p_other_codec_info);
+}
+
+BT_HDR* btif_a2dp_source_extra_audio_readbuf(const RawAddress& peer_address,
+                                             const uint8_t* p_codec_info) {
+  if (!btif_a2dp_source_cb.multi_stream) return nullptr;
+
+  uint64_t now_us = time_get_os_boottime_us();
+  std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+  bool added = false;
+  size_t index = btif_a2dp_source_cb.extra_streams.Request(
+      p_codec_info, peer_address, now_us, &added);
+  // All extra streams are taken by other codec types
+  if (index == BtifA2dpSourceStreams::kNoStream) return nullptr;
+
+  if (added) {
+    // The encoder for the new configuration is set up by the media task, the
+    // sink gets its first frames on one of the next ticks
+    if (!btif_a2dp_source_thread.DoInThread(
+            FROM_HERE,
+            base::Bind(&btif_a2dp_source_extra_stream_setup_event, index))) {
+      btif_a2dp_source_cb.extra_streams.Release(index);
+    }
+    return nullptr;
+  }
+
+  if (btif_a2dp_source_cb.extra_streams.Get(index).state !=
+      BtifA2dpSourceStreams::kStreamEncoding) {
+    return nullptr;
+  }
+  return btif_a2dp_source_cb.extra_encoders[index].tx_audio_queue.Dequeue(
+      now_us);
+}
+
+// Asks |peer_address| to stream with the active peer's configuration, so
+// that it can decode the active peer's frames.
+static void btif_a2dp_source_reconfigure_extra_peer(
+    const RawAddress& peer_address, A2dpCodecConfig* active_codec_config) {
+  btav_a2dp_codec_config_t codec_user_config =
+      active_codec_config->getCodecConfig();
+  // Leave the codec priorities of the peer as they are
+  codec_user_config.codec_priority = BTAV_A2DP_CODEC_PRIORITY_DEFAULT;
+  if (!bta_av_co_set_codec_user_config(peer_address, codec_user_config)) {
+    LOG_ERROR(LOG_TAG, "%s: cannot reconfigure peer %s", __func__,
+              peer_address.ToString().c_str());
+  }
+}
+
+static void btif_a2dp_source_extra_stream_setup_event(size_t index) {
+  BtifA2dpSourceExtraEncoder* encoder =
+      &btif_a2dp_source_cb.extra_encoders[index];
+  uint8_t codec_info[AVDT_CODEC_SIZE];
+  RawAddress peer_address;
+  {
+    std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+    const BtifA2dpSourceStreams::Stream& stream =
+        btif_a2dp_source_cb.extra_streams.Get(index);
+    if (stream.state != BtifA2dpSourceStreams::kStreamPending) return;
+    memcpy(codec_info, stream.codec_info, sizeof(codec_info));
+    peer_address = stream.peer_address;
+  }
+
+  LOG_INFO(LOG_TAG, "%s: peer_address=%s codec=%s state=%s", __func__,
+           peer_address.ToString().c_str(), A2DP_CodecName(codec_info),
+           btif_a2dp_source_cb.StateStr().c_str());
+
+  if (!alarm_is_scheduled(btif_a2dp_source_cb.media_alarm)) {
+    std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+    btif_a2dp_source_release_extra_stream(index);
+    return;
+  }
+
+  const tA2DP_ENCODER_INTERFACE* encoder_interface =
+      A2DP_GetEncoderInterface(codec_info);
+  A2dpCodecConfig* codec_config =
+      bta_av_get_a2dp_peer_current_codec(peer_address);
+  A2dpCodecConfig* active_codec_config = bta_av_get_a2dp_current_codec();
+  const char* reason = nullptr;
+  if (encoder_interface == nullptr || codec_config == nullptr ||
+      active_codec_config == nullptr) {
+    reason = "no source encoder";
+  } else if (encoder_interface == btif_a2dp_source_cb.encoder_interface) {
+    reason = "its encoder is used for the active peer";
+  } else {
+    for (const BtifA2dpSourceExtraEncoder& other :
+         btif_a2dp_source_cb.extra_encoders) {
+      if (other.encoder_interface == encoder_interface)
+        reason = "its encoder is used for another stream";
+    }
+    // All streams encode the PCM read for the active peer
+    btav_a2dp_codec_config_t config = codec_config->getCodecConfig();
+    btav_a2dp_codec_config_t active_config =
+        active_codec_config->getCodecConfig();
+    if (config.sample_rate != active_config.sample_rate ||
+        config.bits_per_sample != active_config.bits_per_sample ||
+        config.channel_mode != active_config.channel_mode) {
+      reason = "its audio format differs from the active peer's";
+    }
+  }
+  if (reason != nullptr) {
+    // The stream stays reconfiguring until the sink stops asking for frames
+    // in its old configuration, and is released as idle
+    LOG_WARN(LOG_TAG,
+             "%s: Cannot encode %s for peer %s: %s. Reconfiguring the peer "
+             "to the active peer's configuration",
+             __func__, A2DP_CodecName(codec_info),
+             peer_address.ToString().c_str(), reason);
+    {
+      std::lock_guard<std::mutex> lock(
+          btif_a2dp_source_cb.extra_streams_mutex);
+      btif_a2dp_source_cb.extra_streams.SetState(
+          index, BtifA2dpSourceStreams::kStreamReconfiguring);
+    }
+    if (active_codec_config != nullptr)
+      btif_a2dp_source_reconfigure_extra_peer(peer_address,
+                                              active_codec_config);
+    return;
+  }
+
+  tA2DP_ENCODER_INIT_PEER_PARAMS peer_params;
+  bta_av_co_get_peer_params(peer_address, &peer_params);
+  encoder_interface->encoder_init(&peer_params, codec_config,
+                                  btif_a2dp_source_extra_read_callback,
+                                  btif_a2dp_source_extra_enqueue_callback);
+  encoder_interface->feeding_reset();
+
+  std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+  encoder->encoder_interface = encoder_interface;
+  encoder->tx_audio_queue.SetLimits(MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ,
+                                    MAX_OUTPUT_A2DP_QUEUE_DELAY_MS * 1000);
+  encoder->pcm_offset = btif_a2dp_source_cb.pcm_tap.End();
+  btif_a2dp_source_cb.extra_streams.SetState(
+      index, BtifA2dpSourceStreams::kStreamEncoding);
+  btif_a2dp_source_cb.extra_streams_encoding++;
+}
+
+// Must be called with the extra streams mutex held.
+static void btif_a2dp_source_release_extra_stream(size_t index) {
+  const BtifA2dpSourceStreams::Stream& stream =
+      btif_a2dp_source_cb.extra_streams.Get(index);
+  BtifA2dpSourceExtraEncoder* encoder =
+      &btif_a2dp_source_cb.extra_encoders[index];
+  LOG_INFO(LOG_TAG, "%s: peer_address=%s stream_state=%s", __func__,
+           stream.peer_address.ToString().c_str(),
+           BtifA2dpSourceStreams::StateName(stream.state));
+
+  if (stream.state == BtifA2dpSourceStreams::kStreamEncoding) {
+    encoder->encoder_interface->encoder_cleanup();
+    btif_a2dp_source_cb.extra_streams_encoding--;
+    if (btif_a2dp_source_cb.extra_streams_encoding == 0)
+      btif_a2dp_source_cb.pcm_tap.Clear();
+  }
+  encoder->Reset();
+  btif_a2dp_source_cb.extra_streams.Release(index);
+}
+
+static void btif_a2dp_source_release_extra_streams(void) {
+  std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+  for (size_t i = 0; i < btif_a2dp_source_cb.extra_streams.Size(); i++) {
+    if (btif_a2dp_source_cb.extra_streams.Get(i).state !=
+        BtifA2dpSourceStreams::kStreamUnused) {
+      btif_a2dp_source_release_extra_stream(i);
+    }
+  }
+}
+
+static void btif_a2dp_source_encode_extra_streams(uint64_t timestamp_us) {
+  BtifA2dpSourceExtraEncoder* encoders[MAX_EXTRA_A2DP_SOURCE_STREAMS];
+  size_t encoders_n = 0;
+  {
+    std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+    // The sinks of these streams stopped or changed their configuration
+    for (size_t index :
+         btif_a2dp_source_cb.extra_streams.IdleStreams(timestamp_us)) {
+      btif_a2dp_source_release_extra_stream(index);
+    }
+    for (size_t i = 0; i < btif_a2dp_source_cb.extra_streams.Size(); i++) {
+      if (btif_a2dp_source_cb.extra_streams.Get(i).state ==
+          BtifA2dpSourceStreams::kStreamEncoding) {
+        encoders[encoders_n++] = &btif_a2dp_source_cb.extra_encoders[i];
+      }
+    }
+  }
+  if (encoders_n == 0) return;
+
+  // Only the media task releases streams, so they stay valid while encoded
+  uint64_t keep_from = btif_a2dp_source_cb.pcm_tap.End();
+  for (size_t i = 0; i < encoders_n; i++) {
+    BtifA2dpSourceExtraEncoder* encoder = encoders[i];
+    uint64_t cpu_start_us = thread_cpu_time_us();
+    btif_a2dp_source_cb.extra_encoder = encoder;
+    if (encoder->encoder_interface->set_transmit_queue_length != nullptr) {
+      encoder->encoder_interface->set_transmit_queue_length(
+          encoder->tx_audio_queue.Length());
+    }
+    encoder->encoder_interface->send_frames(timestamp_us);
+    btif_a2dp_source_cb.extra_encoder = nullptr;
+    encoder->encode_cpu_us += thread_cpu_time_us() - cpu_start_us;
+    keep_from = std::min(keep_from, encoder->pcm_offset);
+  }
+
+  // Forget the PCM every encoder has read
+  btif_a2dp_source_cb.pcm_tap.Discard(keep_from);
+}
+
+static uint32_t btif_a2dp_source_extra_read_callback(uint8_t* p_buf,
+                                                     uint32_t len) {
+  BtifA2dpSourceExtraEncoder* encoder = btif_a2dp_source_cb.extra_encoder;
+  CHECK(encoder != nullptr);
+
+  // An encoder that fell too far behind loses its oldest audio
+  uint32_t bytes_read = btif_a2dp_source_cb.pcm_tap.Read(
+      &encoder->pcm_offset, p_buf, len, &encoder->pcm_tap_lost_bytes);
+  if (bytes_read < len)
+    encoder->media_read_total_underflow_bytes += (len - bytes_read);
+
+  return bytes_read;
+}
+
+static bool btif_a2dp_source_extra_enqueue_callback(BT_HDR* p_buf,
+                                                    size_t frames_n,
+                                                    uint32_t bytes_read) {
+  BtifA2dpSourceExtraEncoder* encoder = btif_a2dp_source_cb.extra_encoder;
+  CHECK(encoder != nullptr);
+
+  /* Frames are discarded for all streams alike */
+  if (btif_a2dp_source_cb.tx_flush) {
+    encoder->tx_audio_queue.Flush();
+    osi_free(p_buf);
+    return false;
+  }
+
+  // Same overflow policy as the active peer's queue
+  encoder->tx_queue_total_frames += frames_n;
+  size_t drop_n = encoder->tx_audio_queue.Enqueue(
+      p_buf, btif_a2dp_source_pcm_duration_us(bytes_read),
+      time_get_os_boottime_us());
+  if (drop_n > 0) {
+    LOG_WARN(LOG_TAG, "%s: extra stream TX queue overflow: dropped=%zu now=%zu",
+             __func__, drop_n, encoder->tx_audio_queue.Length());
+    encoder->tx_queue_dropouts++;
+    encoder->tx_queue_total_dropped_messages += drop_n;
+  }
+  return true;
+}
+
+// Returns how much audio |bytes_read| bytes of PCM hold
+static uint64_t btif_a2dp_source_pcm_duration_us(uint32_t bytes_read) {
+  if (btif_a2dp_source_cb.pcm_bytes_per_sec == 0) return 0;
+  return (uint64_t)bytes_read * 1000000 / btif_a2dp_source_cb.pcm_bytes_per_sec;
+}
+
+static void btif_a2dp_source_log_tx_queue_overflow(
+    const RawAddress& peer_bda) {
+  tBTM_STATUS status = BTM_ReadRSSI(peer_bda, btm_read_rssi_cb);
+  if (status != BTM_CMD_STARTED) {
+    LOG_WARN(LOG_TAG, "%s: Cannot read RSSI: status %d", __func__, status);
+  }
+  status = BTM_ReadFailedContactCounter(peer_bda,
+                                        btm_read_failed_contact_counter_cb);
+  if (status != BTM_CMD_STARTED) {
+    LOG_WARN(LOG_TAG, "%s: Cannot read Failed Contact Counter: status %d",
+             __func__, status);
+  }
+  status = BTM_ReadAutomaticFlushTimeout(peer_bda,
+                                         btm_read_automatic_flush_timeout_cb);
+  if (status != BTM_CMD_STARTED) {
+    LOG_WARN(LOG_TAG, "%s: Cannot read Automatic Flush Timeout: status %d",
+             __func__, status);
+  }
+  status = BTM_ReadTxPower(peer_bda, BT_TRANSPORT_BR_EDR, btm_read_tx_power_cb);
+  if (status != BTM_CMD_STARTED) {
+    LOG_WARN(LOG_TAG, "%s: Cannot read Tx Power: status %d", __func__, status);
+  }
+}
+
+static uint64_t thread_cpu_time_us(void) {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static void log_tstamps_us(const char* comment, uint64_t timestamp_us) {
   static uint64_t prev_us = 0;
   APPL_TRACE_DEBUG("%s: [%s] ts %08" PRIu64 ", diff : %08" PRIu64
                    ", queue sz %zu",
                    __func__, comment, timestamp_us, timestamp_us - prev_us,
-                   fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue));
+                   btif_a2dp_source_cb.tx_audio_queue.Length());
   prev_us = timestamp_us;
 }
 
@@ -1265,6 +1683,88 @@ void btif_a2dp_source_debug_dump(int fd) {
       (unsigned long long)dequeue_stats->max_premature_scheduling_delta_us /
           1000,
       (unsigned long long)ave_time_us / 1000);
+
+  btif_a2dp_source_dump_queue_stats(
+      fd, "  TX queue, current session",
+      btif_a2dp_source_cb.tx_audio_queue.GetStats());
+  btif_a2dp_source_dump_queue_stats(
+      fd, "  TX queue, last session",
+      btif_a2dp_source_cb.last_session_queue_stats);
+
+  dprintf(fd,
+          "  Multi-stream                                            : %s\n",
+          btif_a2dp_source_cb.multi_stream ? "enabled" : "disabled");
+  if (!btif_a2dp_source_cb.multi_stream) return;
+
+  dprintf(fd,
+          "  Active peer encoding CPU time in ms                     : %llu\n",
+          (unsigned long long)btif_a2dp_source_cb.encode_cpu_us / 1000);
+  std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.extra_streams_mutex);
+  for (size_t i = 0; i < btif_a2dp_source_cb.extra_streams.Size(); i++) {
+    const BtifA2dpSourceStreams::Stream& stream =
+        btif_a2dp_source_cb.extra_streams.Get(i);
+    const BtifA2dpSourceExtraEncoder& encoder =
+        btif_a2dp_source_cb.extra_encoders[i];
+    if (stream.state == BtifA2dpSourceStreams::kStreamUnused) continue;
+    dprintf(fd, "  Extra stream for peer %s : %s %s\n",
+            stream.peer_address.ToString().c_str(),
+            A2DP_CodecName(stream.codec_info),
+            BtifA2dpSourceStreams::StateName(stream.state));
+    dprintf(fd,
+            "    Frames / dropouts / dropped messages                  : %zu / "
+            "%zu / %zu\n",
+            encoder.tx_queue_total_frames, encoder.tx_queue_dropouts,
+            encoder.tx_queue_total_dropped_messages);
+    dprintf(fd,
+            "    Underflow bytes / lost PCM bytes                      : %zu / "
+            "%zu\n",
+            encoder.media_read_total_underflow_bytes,
+            encoder.pcm_tap_lost_bytes);
+    dprintf(fd,
+            "    Encoding CPU time in ms                               : "
+            "%llu\n",
+            (unsigned long long)encoder.encode_cpu_us / 1000);
+  }
+}
+
+static void btif_a2dp_source_dump_queue_stats(
+    int fd, const char* title, const BtifA2dpSourceQueue::Stats& stats) {
+  uint64_t ave_delay_us = 0;
+  if (stats.dequeued_packets != 0)
+    ave_delay_us = stats.total_delay_us / stats.dequeued_packets;
+
+  dprintf(fd, "%s\n", title);
+  dprintf(fd,
+          "    Packets (sent/dropped/flushed)                        : %zu / "
+          "%zu / %zu\n",
+          stats.dequeued_packets, stats.dropped_packets,
+          stats.flushed_packets);
+  dprintf(fd,
+          "    Dropped audio in ms                                   : %llu\n",
+          (unsigned long long)stats.dropped_audio_us / 1000);
+  dprintf(fd,
+          "    Queueing time in ms (max/ave)                         : %llu / "
+          "%llu\n",
+          (unsigned long long)stats.max_delay_us / 1000,
+          (unsigned long long)ave_delay_us / 1000);
+
+  std::string histogram;
+  for (size_t i = 0; i < BtifA2dpSourceQueue::kDelayHistogramSize; i++) {
+    char bucket[32];
+    if (i + 1 < BtifA2dpSourceQueue::kDelayHistogramSize) {
+      snprintf(bucket, sizeof(bucket), " <%llu:%zu",
+               (unsigned long long)
+                       BtifA2dpSourceQueue::DelayHistogramLimitUs(i) /
+                   1000,
+               stats.delay_histogram[i]);
+    } else {
+      snprintf(bucket, sizeof(bucket), " more:%zu", stats.delay_histogram[i]);
+    }
+    histogram += bucket;
+  }
+  dprintf(fd,
+          "    Queueing time histogram in ms                         :%s\n",
+          histogram.c_str());
 }
 
 static void btif_a2dp_source_update_metrics(void) {
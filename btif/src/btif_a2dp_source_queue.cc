@@ -0,0 +1,127 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btif_a2dp_source_queue.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "osi/include/allocator.h"
+
+// Upper limits of the delay histogram buckets but the last one
+static const uint64_t kDelayHistogramLimitsUs[] = {
+    20000, 40000, 60000, 80000, 100000, 150000, 200000, 300000};
+static_assert(sizeof(kDelayHistogramLimitsUs) /
+                      sizeof(kDelayHistogramLimitsUs[0]) ==
+                  BtifA2dpSourceQueue::kDelayHistogramSize - 1,
+              "Delay histogram limits do not match its size");
+
+BtifA2dpSourceQueue::BtifA2dpSourceQueue()
+    : max_packets_(std::numeric_limits<size_t>::max()),
+      max_audio_us_(0),
+      queued_audio_us_(0) {}
+
+BtifA2dpSourceQueue::~BtifA2dpSourceQueue() { Flush(); }
+
+void BtifA2dpSourceQueue::SetLimits(size_t max_packets,
+                                    uint64_t max_audio_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_packets_ = std::max<size_t>(max_packets, 1);
+  max_audio_us_ = max_audio_us;
+}
+
+size_t BtifA2dpSourceQueue::Enqueue(BT_HDR* p_buf, uint64_t audio_us,
+                                    uint64_t now_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t dropped = 0;
+  while (!packets_.empty() &&
+         (packets_.size() >= max_packets_ ||
+          (max_audio_us_ != 0 &&
+           queued_audio_us_ + audio_us > max_audio_us_))) {
+    const Packet& oldest = packets_.front();
+    queued_audio_us_ -= oldest.audio_us;
+    stats_.dropped_audio_us += oldest.audio_us;
+    osi_free(oldest.p_buf);
+    packets_.pop_front();
+    dropped++;
+  }
+  stats_.dropped_packets += dropped;
+
+  packets_.push_back({p_buf, audio_us, now_us});
+  queued_audio_us_ += audio_us;
+  stats_.enqueued_packets++;
+  return dropped;
+}
+
+BT_HDR* BtifA2dpSourceQueue::Dequeue(uint64_t now_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (packets_.empty()) return nullptr;
+
+  Packet packet = packets_.front();
+  packets_.pop_front();
+  queued_audio_us_ -= packet.audio_us;
+
+  uint64_t delay_us =
+      (now_us > packet.enqueue_us) ? (now_us - packet.enqueue_us) : 0;
+  size_t bucket = 0;
+  while (bucket < kDelayHistogramSize - 1 &&
+         delay_us >= kDelayHistogramLimitsUs[bucket]) {
+    bucket++;
+  }
+  stats_.delay_histogram[bucket]++;
+  stats_.dequeued_packets++;
+  stats_.total_delay_us += delay_us;
+  stats_.max_delay_us = std::max(stats_.max_delay_us, delay_us);
+  return packet.p_buf;
+}
+
+size_t BtifA2dpSourceQueue::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t flushed = packets_.size();
+  for (const Packet& packet : packets_) osi_free(packet.p_buf);
+  packets_.clear();
+  queued_audio_us_ = 0;
+  stats_.flushed_packets += flushed;
+  return flushed;
+}
+
+size_t BtifA2dpSourceQueue::Length() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return packets_.size();
+}
+
+uint64_t BtifA2dpSourceQueue::QueuedAudioUs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queued_audio_us_;
+}
+
+BtifA2dpSourceQueue::Stats BtifA2dpSourceQueue::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void BtifA2dpSourceQueue::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_ = Stats();
+}
+
+uint64_t BtifA2dpSourceQueue::DelayHistogramLimitUs(size_t bucket) {
+  if (bucket >= kDelayHistogramSize - 1)
+    return std::numeric_limits<uint64_t>::max();
+  return kDelayHistogramLimitsUs[bucket];
+}
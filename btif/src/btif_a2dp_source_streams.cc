@@ -0,0 +1,142 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btif_a2dp_source_streams.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+BtifA2dpSourcePcmTap::BtifA2dpSourcePcmTap(size_t max_bytes)
+    : max_bytes_(max_bytes), start_(0) {}
+
+void BtifA2dpSourcePcmTap::Write(const uint8_t* p_buf, size_t len) {
+  pcm_.insert(pcm_.end(), p_buf, p_buf + len);
+  if (pcm_.size() > max_bytes_) Discard(End() - max_bytes_);
+}
+
+size_t BtifA2dpSourcePcmTap::Read(uint64_t* p_offset, uint8_t* p_buf,
+                                  size_t len, size_t* p_lost_bytes) {
+  if (*p_offset < start_) {
+    *p_lost_bytes += start_ - *p_offset;
+    *p_offset = start_;
+  }
+  if (*p_offset >= End()) return 0;
+
+  size_t bytes_read = std::min<uint64_t>(len, End() - *p_offset);
+  memcpy(p_buf, pcm_.data() + (*p_offset - start_), bytes_read);
+  *p_offset += bytes_read;
+  return bytes_read;
+}
+
+void BtifA2dpSourcePcmTap::Discard(uint64_t offset) {
+  if (offset <= start_) return;
+  offset = std::min(offset, End());
+  pcm_.erase(pcm_.begin(), pcm_.begin() + (offset - start_));
+  start_ = offset;
+}
+
+void BtifA2dpSourcePcmTap::Clear() { Discard(End()); }
+
+constexpr size_t BtifA2dpSourceStreams::kNoStream;
+
+BtifA2dpSourceStreams::BtifA2dpSourceStreams(
+    size_t max_streams, uint64_t idle_us,
+    FramesCompatibleCallback frames_compatible)
+    : idle_us_(idle_us),
+      frames_compatible_(std::move(frames_compatible)),
+      streams_(max_streams) {
+  ReleaseAll();
+}
+
+size_t BtifA2dpSourceStreams::Request(const uint8_t* p_codec_info,
+                                      const RawAddress& peer_address,
+                                      uint64_t now_us, bool* p_added) {
+  *p_added = false;
+  size_t index = Find(p_codec_info);
+  if (index != kNoStream) {
+    streams_[index].last_read_us = now_us;
+    return index;
+  }
+
+  for (index = 0; index < streams_.size(); index++) {
+    Stream& stream = streams_[index];
+    if (stream.state != kStreamUnused) continue;
+    stream.state = kStreamPending;
+    memcpy(stream.codec_info, p_codec_info, sizeof(stream.codec_info));
+    stream.peer_address = peer_address;
+    stream.last_read_us = now_us;
+    *p_added = true;
+    return index;
+  }
+  return kNoStream;
+}
+
+size_t BtifA2dpSourceStreams::Find(const uint8_t* p_codec_info) const {
+  for (size_t index = 0; index < streams_.size(); index++) {
+    const Stream& stream = streams_[index];
+    if (stream.state != kStreamUnused &&
+        frames_compatible_(stream.codec_info, p_codec_info)) {
+      return index;
+    }
+  }
+  return kNoStream;
+}
+
+std::vector<size_t> BtifA2dpSourceStreams::IdleStreams(uint64_t now_us) const {
+  std::vector<size_t> idle;
+  for (size_t index = 0; index < streams_.size(); index++) {
+    const Stream& stream = streams_[index];
+    if (stream.state != kStreamUnused &&
+        now_us > stream.last_read_us + idle_us_) {
+      idle.push_back(index);
+    }
+  }
+  return idle;
+}
+
+void BtifA2dpSourceStreams::SetState(size_t index, State state) {
+  streams_[index].state = state;
+}
+
+void BtifA2dpSourceStreams::Release(size_t index) {
+  Stream& stream = streams_[index];
+  stream.state = kStreamUnused;
+  memset(stream.codec_info, 0, sizeof(stream.codec_info));
+  stream.peer_address = RawAddress::kEmpty;
+  stream.last_read_us = 0;
+}
+
+void BtifA2dpSourceStreams::ReleaseAll() {
+  for (size_t index = 0; index < streams_.size(); index++) Release(index);
+}
+
+const char* BtifA2dpSourceStreams::StateName(State state) {
+  switch (state) {
+    case kStreamUnused:
+      return "STREAM_UNUSED";
+    case kStreamPending:
+      return "STREAM_PENDING";
+    case kStreamEncoding:
+      return "STREAM_ENCODING";
+    case kStreamReconfiguring:
+      return "STREAM_RECONFIGURING";
+  }
+  return "UNKNOWN";
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btif_bonded_properties.h"
+
+#include <algorithm>
+#include <utility>
+
+constexpr size_t BtifBondedPropertiesReporter::kBatchSize;
+
+BtifBondedPropertiesReporter::BtifBondedPropertiesReporter(
+    PostCallback post, ReportCallback report)
+    : post_(std::move(post)), report_(std::move(report)) {}
+
+void BtifBondedPropertiesReporter::Start(std::vector<RawAddress> devices) {
+  devices_ = std::move(devices);
+  next_ = 0;
+  reporting_ = true;
+  uint32_t generation = ++generation_;
+  post_([this, generation] { ReportBatch(generation); });
+}
+
+void BtifBondedPropertiesReporter::Stop() {
+  generation_++;
+  devices_.clear();
+  next_ = 0;
+  reporting_ = false;
+}
+
+void BtifBondedPropertiesReporter::ReportBatch(uint32_t generation) {
+  if (generation != generation_) return;
+
+  size_t end = std::min(devices_.size(), next_ + kBatchSize);
+  for (; next_ < end; next_++) report_(devices_[next_]);
+
+  if (next_ < devices_.size()) {
+    post_([this, generation] { ReportBatch(generation); });
+    return;
+  }
+
+  devices_.clear();
+  next_ = 0;
+  reporting_ = false;
+}
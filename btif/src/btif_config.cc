@@ -32,6 +32,7 @@
 
 #include "bt_types.h"
 #include "btcore/include/module.h"
+#include "btcore/include/osi_module.h"
 #include "btif_api.h"
 #include "btif_common.h"
 #include "btif_config_transcode.h"
@@ -224,11 +225,13 @@ static future_t* clean_up(void) {
   return future_new_immediate(FUTURE_SUCCESS);
 }
 
-EXPORT_SYMBOL module_t btif_config_module = {.name = BTIF_CONFIG_MODULE,
-                                             .init = init,
-                                             .start_up = NULL,
-                                             .shut_down = shut_down,
-                                             .clean_up = clean_up};
+EXPORT_SYMBOL module_t btif_config_module = {
+    .name = BTIF_CONFIG_MODULE,
+    .init = init,
+    .start_up = NULL,
+    .shut_down = shut_down,
+    .clean_up = clean_up,
+    .dependencies = {OSI_MODULE, NULL}};
 
 bool btif_config_has_section(const char* section) {
   CHECK(config != NULL);
@@ -543,8 +543,6 @@ bt_status_t btif_cleanup_bluetooth(void) {
   thread_free(bt_jni_workqueue_thread);
   bt_jni_workqueue_thread = NULL;
 
-  bte_main_cleanup();
-
   btif_dut_mode = 0;
 
   LOG_INFO(LOG_TAG, "%s finished", __func__);
@@ -1645,6 +1645,7 @@ static void btif_dm_upstreams_evt(uint16_t event, char* p_param) {
           btif_in_execute_service_request(i, false);
         }
       }
+      btif_storage_stop_loading_bonded_devices();
       btif_disable_bluetooth_evt();
       break;
 
@@ -46,9 +46,11 @@
 #include "btif_config.h"
 #include "btif_dm.h"
 #include "btif_gatt.h"
+#include "btif_gatt_notify_batch.h"
 #include "btif_gatt_util.h"
 #include "btif_storage.h"
 #include "osi/include/log.h"
+#include "osi/include/properties.h"
 #include "vendor_api.h"
 
 using base::Bind;
@@ -115,25 +117,6 @@ void btif_gattc_upstreams_evt(uint16_t event, char* p_param) {
       break;
     }
 
-    case BTA_GATTC_NOTIF_EVT: {
-      btgatt_notify_params_t data;
-
-      data.bda = p_data->notify.bda;
-      memcpy(data.value, p_data->notify.value, p_data->notify.len);
-
-      data.handle = p_data->notify.handle;
-      data.is_notify = p_data->notify.is_notify;
-      data.len = p_data->notify.len;
-
-      HAL_CBACK(bt_gatt_callbacks, client->notify_cb, p_data->notify.conn_id,
-                data);
-
-      if (!p_data->notify.is_notify)
-        BTA_GATTC_SendIndConfirm(p_data->notify.conn_id, p_data->notify.handle);
-
-      break;
-    }
-
     case BTA_GATTC_OPEN_EVT: {
       DVLOG(1) << "BTA_GATTC_OPEN_EVT " << p_data->open.remote_bda;
       HAL_CBACK(bt_gatt_callbacks, client->open_cb, p_data->open.conn_id,
@@ -197,7 +180,65 @@ void btif_gattc_upstreams_evt(uint16_t event, char* p_param) {
   }
 }
 
+/* Notifications bypass btif_transfer_context(), which copies the whole
+ * tBTA_GATTC union per event. They are batched per connection on their way to
+ * the JNI thread, see BtifGattNotifyBatcher.
+ * persist.bluetooth.gatt_notify_batch_ms adds a latency budget during which
+ * a batch is held back to collect more notifications. */
+void btif_gattc_notify_batch_deliver(uint16_t conn_id, uint64_t batch_id);
+
+void btif_gattc_notify_batch_post(uint16_t conn_id, uint64_t batch_id,
+                                  int delay_ms) {
+  base::Closure task =
+      Bind(&btif_gattc_notify_batch_deliver, conn_id, batch_id);
+  base::MessageLoop* message_loop = get_jni_message_loop();
+  if (delay_ms > 0 && message_loop) {
+    message_loop->task_runner()->PostDelayedTask(
+        FROM_HERE, task, base::TimeDelta::FromMilliseconds(delay_ms));
+  } else {
+    do_in_jni_thread(task);
+  }
+}
+
+BtifGattNotifyBatcher& notify_batcher() {
+  static BtifGattNotifyBatcher batcher(
+      btif_gattc_notify_batch_post,
+      osi_property_get_int32("persist.bluetooth.gatt_notify_batch_ms", 0));
+  return batcher;
+}
+
+void btif_gattc_notify_cb(uint16_t conn_id,
+                          const BtifGattNotifyBatcher::Notification& notify) {
+  btgatt_notify_params_t data;
+  data.bda = notify.bda;
+  memcpy(data.value, notify.value, notify.len);
+  data.handle = notify.handle;
+  data.is_notify = notify.is_notify;
+  data.len = notify.len;
+
+  HAL_CBACK(bt_gatt_callbacks, client->notify_cb, conn_id, data);
+
+  if (!notify.is_notify) BTA_GATTC_SendIndConfirm(conn_id, notify.handle);
+}
+
+void btif_gattc_notify_batch_deliver(uint16_t conn_id, uint64_t batch_id) {
+  notify_batcher().Deliver(conn_id, batch_id, btif_gattc_notify_cb);
+}
+
 void bta_gattc_cback(tBTA_GATTC_EVT event, tBTA_GATTC* p_data) {
+  if (event == BTA_GATTC_NOTIF_EVT) {
+    const tBTA_GATTC_NOTIFY& notify = p_data->notify;
+    notify_batcher().Add(notify.conn_id, {notify.bda, notify.handle,
+                                          notify.is_notify, notify.value,
+                                          notify.len});
+    return;
+  }
+
+  /* Deliver pending notifications ahead of any other event, so that the
+   * upper layer never sees a notification after e.g. the close of its
+   * connection. */
+  notify_batcher().Flush();
+
   bt_status_t status =
       btif_transfer_context(btif_gattc_upstreams_evt, (uint16_t)event,
                             (char*)p_data, sizeof(tBTA_GATTC), NULL);
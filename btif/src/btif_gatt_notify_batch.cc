@@ -0,0 +1,103 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btif_gatt_notify_batch.h"
+
+constexpr size_t BtifGattNotifyBatcher::kMaxNotifications;
+constexpr size_t BtifGattNotifyBatcher::kMaxBytes;
+
+BtifGattNotifyBatcher::BtifGattNotifyBatcher(PostCallback post,
+                                             int latency_ms)
+    : post_(std::move(post)), latency_ms_(latency_ms) {}
+
+void BtifGattNotifyBatcher::Add(uint16_t conn_id,
+                                const Notification& notification) {
+  uint64_t batch_id;
+  int delay_ms = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::deque<Batch>& batches = batches_[conn_id];
+    if (batches.empty() || batches.back().closed) {
+      batches.emplace_back();
+      batches.back().id = next_batch_id_++;
+      delay_ms = latency_ms_;
+    }
+
+    Batch& batch = batches.back();
+    batch_id = batch.id;
+    batch.entries.push_back(Entry{notification.bda, notification.handle,
+                                  notification.is_notify, notification.len,
+                                  batch.payload.size()});
+    batch.payload.insert(batch.payload.end(), notification.value,
+                         notification.value + notification.len);
+
+    if (batch.entries.size() >= kMaxNotifications ||
+        batch.payload.size() >= kMaxBytes) {
+      batch.closed = true;
+      // Do not wait for the rest of the latency budget
+      if (latency_ms_ > 0) delay_ms = 0;
+    }
+  }
+
+  if (delay_ms >= 0) post_(conn_id, batch_id, delay_ms);
+}
+
+void BtifGattNotifyBatcher::Deliver(uint16_t conn_id, uint64_t batch_id,
+                                    const NotifyCallback& notify) {
+  std::deque<Batch> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = batches_.find(conn_id);
+    if (it == batches_.end()) return;
+
+    std::deque<Batch>& batches = it->second;
+    while (!batches.empty() && batches.front().id <= batch_id) {
+      ready.push_back(std::move(batches.front()));
+      batches.pop_front();
+    }
+    if (batches.empty()) batches_.erase(it);
+  }
+
+  for (const Batch& batch : ready) {
+    for (const Entry& entry : batch.entries) {
+      notify(conn_id, Notification{entry.bda, entry.handle, entry.is_notify,
+                                   batch.payload.data() + entry.offset,
+                                   entry.len});
+    }
+  }
+}
+
+void BtifGattNotifyBatcher::Flush() {
+  std::vector<std::pair<uint16_t, uint64_t>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& it : batches_) {
+      if (it.second.empty() || it.second.back().closed) continue;
+      it.second.back().closed = true;
+      pending.emplace_back(it.first, it.second.back().id);
+    }
+  }
+
+  for (const auto& it : pending) post_(it.first, it.second, 0);
+}
+
+size_t BtifGattNotifyBatcher::PendingBatches(uint16_t conn_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = batches_.find(conn_id);
+  return it == batches_.end() ? 0 : it->second.size();
+}
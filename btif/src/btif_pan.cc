@@ -42,10 +42,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
-#include <sys/poll.h>
 #include <sys/prctl.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -88,8 +88,6 @@
                        __func__, #s, __LINE__)                           \
   } while (0)
 
-#define MIN(x, y) (((x) < (y)) ? (x) : (y))
-
 btpan_cb_t btpan_cb;
 
 static bool jni_initialized;
@@ -131,6 +129,7 @@ void btif_pan_init() {
 
   if (jni_initialized && !btpan_cb.enabled) {
     BTIF_TRACE_DEBUG("Enabling PAN....");
+    osi_free_and_reset((void**)&btpan_cb.congest_buf);
     memset(&btpan_cb, 0, sizeof(btpan_cb));
     btpan_cb.tap_fd = INVALID_FD;
     btpan_cb.flow = 1;
@@ -150,6 +149,8 @@ static void pan_disable() {
       btpan_tap_close(btpan_cb.tap_fd);
       btpan_cb.tap_fd = INVALID_FD;
     }
+    // A frame kept for the closed TAP must not go out on the next one
+    osi_free_and_reset((void**)&btpan_cb.congest_buf);
   }
 }
 
@@ -417,18 +418,22 @@ int btpan_tap_send(int tap_fd, const RawAddress& src, const RawAddress& dst,
     eth_hdr.h_dest = dst;
     eth_hdr.h_src = src;
     eth_hdr.h_proto = htons(proto);
-    char packet[TAP_MAX_PKT_WRITE_LEN + sizeof(tETH_HDR)];
-    memcpy(packet, &eth_hdr, sizeof(tETH_HDR));
     if (len > TAP_MAX_PKT_WRITE_LEN) {
       LOG_ERROR(LOG_TAG, "btpan_tap_send eth packet size:%d is exceeded limit!",
                 len);
       return -1;
     }
-    memcpy(packet + sizeof(tETH_HDR), buf, len);
 
-    /* Send data to network interface */
+    /* Send data to network interface, the TAP driver takes each write as one
+     * frame so the header and payload are gathered instead of copied */
+    struct iovec iov[2];
+    iov[0].iov_base = &eth_hdr;
+    iov[0].iov_len = sizeof(tETH_HDR);
+    iov[1].iov_base = const_cast<char*>(buf);
+    iov[1].iov_len = len;
+
     ssize_t ret;
-    OSI_NO_INTR(ret = write(tap_fd, packet, len + sizeof(tETH_HDR)));
+    OSI_NO_INTR(ret = writev(tap_fd, iov, 2));
     BTIF_TRACE_DEBUG("ret:%d", ret);
     return (int)ret;
   }
@@ -500,6 +505,7 @@ static void btpan_close_conn(btpan_conn_t* conn) {
         btpan_tap_close(btpan_cb.tap_fd);
         btpan_cb.tap_fd = INVALID_FD;
       }
+      osi_free_and_reset((void**)&btpan_cb.congest_buf);
     }
   }
 }
@@ -665,89 +671,78 @@ static void bta_pan_callback(tBTA_PAN_EVT event, tBTA_PAN* p_data) {
                         sizeof(tBTA_PAN), NULL);
 }
 
-#define IS_EXCEPTION(e) ((e) & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL))
 static void btu_exec_tap_fd_read(int fd) {
-  struct pollfd ufd;
+  if (fd == INVALID_FD || fd != btpan_cb.tap_fd) {
+    // The TAP device went away, drop the frame that was waiting for it.
+    osi_free_and_reset((void**)&btpan_cb.congest_buf);
+    return;
+  }
 
-  if (fd == INVALID_FD || fd != btpan_cb.tap_fd) return;
+  BT_HDR* buffer = NULL;
 
   // Don't occupy BTU context too long, avoid buffer overruns and
   // give other profiles a chance to run by limiting the amount of memory
   // PAN can use.
   for (int i = 0; i < PAN_BUF_MAX && btif_is_enabled() && btpan_cb.flow; i++) {
-    BT_HDR* buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
-    buffer->offset = PAN_MINIMUM_OFFSET;
-    buffer->len = PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset;
-
-    uint8_t* packet = (uint8_t*)buffer + sizeof(BT_HDR) + buffer->offset;
-
-    // If we don't have an undelivered packet left over, pull one from the TAP
-    // driver.
-    // We save it in the congest_packet right away in case we can't deliver it
-    // in this
-    // attempt.
-    if (!btpan_cb.congest_packet_size) {
+    tETH_HDR hdr;
+
+    if (btpan_cb.congest_buf) {
+      // Retry the frame BNEP had no room for before pulling a new one.
+      buffer = btpan_cb.congest_buf;
+      hdr = btpan_cb.congest_eth_hdr;
+      btpan_cb.congest_buf = NULL;
+    } else {
+      // Reuse the buffer of a dropped frame rather than allocating again.
+      if (buffer == NULL) buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
+
+      // The ethernet header is scattered out of the frame by the read itself,
+      // the payload lands where PAN_WriteBuf expects it and BNEP prepends its
+      // own header in front of it.
+      buffer->offset = PAN_MINIMUM_OFFSET + sizeof(tETH_HDR);
+      struct iovec iov[2];
+      iov[0].iov_base = &hdr;
+      iov[0].iov_len = sizeof(tETH_HDR);
+      iov[1].iov_base = (uint8_t*)(buffer + 1) + buffer->offset;
+      iov[1].iov_len = PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset;
+
+      // The TAP fd is non-blocking, so keep reading until it runs dry instead
+      // of polling between frames.
       ssize_t ret;
-      OSI_NO_INTR(ret = read(fd, btpan_cb.congest_packet,
-                             sizeof(btpan_cb.congest_packet)));
-      switch (ret) {
-        case -1:
-          BTIF_TRACE_ERROR("%s unable to read from driver: %s", __func__,
-                           strerror(errno));
-          osi_free(buffer);
-          // add fd back to monitor thread to try it again later
-          btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
-          return;
-        case 0:
-          BTIF_TRACE_WARNING("%s end of file reached.", __func__);
-          osi_free(buffer);
-          // add fd back to monitor thread to process the exception
-          btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
-          return;
-        default:
-          btpan_cb.congest_packet_size = ret;
-          break;
+      OSI_NO_INTR(ret = readv(fd, iov, 2));
+      if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if (ret == -1) {
+        BTIF_TRACE_ERROR("%s unable to read from driver: %s", __func__,
+                         strerror(errno));
+        break;
+      }
+      if (ret == 0) {
+        BTIF_TRACE_WARNING("%s end of file reached.", __func__);
+        break;
       }
-    }
 
-    memcpy(packet, btpan_cb.congest_packet,
-           MIN(btpan_cb.congest_packet_size, buffer->len));
-    buffer->len = MIN(btpan_cb.congest_packet_size, buffer->len);
-
-    if (buffer->len > sizeof(tETH_HDR) && should_forward((tETH_HDR*)packet)) {
-      // Extract the ethernet header from the buffer since the PAN_WriteBuf
-      // inside
-      // forward_bnep can't handle two pointers that point inside the same GKI
-      // buffer.
-      tETH_HDR hdr;
-      memcpy(&hdr, packet, sizeof(tETH_HDR));
-
-      // Skip the ethernet header.
-      buffer->len -= sizeof(tETH_HDR);
-      buffer->offset += sizeof(tETH_HDR);
-      if (forward_bnep(&hdr, buffer) != FORWARD_CONGEST)
-        btpan_cb.congest_packet_size = 0;
-    } else {
-      BTIF_TRACE_WARNING("%s dropping packet of length %d", __func__,
-                         buffer->len);
-      btpan_cb.congest_packet_size = 0;
-      osi_free(buffer);
+      if ((size_t)ret <= sizeof(tETH_HDR) || !should_forward(&hdr)) {
+        BTIF_TRACE_WARNING("%s dropping packet of length %zd", __func__, ret);
+        continue;
+      }
+      buffer->len = ret - sizeof(tETH_HDR);
     }
 
-    // Bail out of the loop if reading from the TAP fd would block.
-    ufd.fd = fd;
-    ufd.events = POLLIN;
-    ufd.revents = 0;
-
-    int ret;
-    OSI_NO_INTR(ret = poll(&ufd, 1, 0));
-    if (ret <= 0 || IS_EXCEPTION(ufd.revents)) break;
+    int result = forward_bnep(&hdr, buffer);
+    if (result == FORWARD_CONGEST) {
+      // BNEP handed the buffer back, keep it for the next attempt.
+      btpan_cb.congest_buf = buffer;
+      btpan_cb.congest_eth_hdr = hdr;
+      buffer = NULL;
+      break;
+    }
+    buffer = NULL;
   }
 
-  if (btpan_cb.flow) {
-    // add fd back to monitor thread when the flow is on
-    btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
-  }
+  osi_free(buffer);
+
+  // add fd back to monitor thread when the flow is on, a read error or end of
+  // file is picked up there as well
+  if (btpan_cb.flow) btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
 }
 
 static void btif_pan_close_all_conns() {
@@ -771,6 +766,7 @@ static void btpan_tap_fd_signaled(int fd, int type, int flags,
   if (flags & SOCK_THREAD_FD_EXCEPTION) {
     btpan_cb.tap_fd = INVALID_FD;
     btpan_tap_close(fd);
+    osi_free_and_reset((void**)&btpan_cb.congest_buf);
     btif_pan_close_all_conns();
   } else if (flags & SOCK_THREAD_FD_RD) {
     do_in_bta_thread(FROM_HERE, base::Bind(btu_exec_tap_fd_read, fd));
@@ -26,9 +26,11 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <mutex>
+#include <unordered_map>
 
 #include <hardware/bluetooth.h>
 #include <hardware/bt_sock.h>
@@ -67,6 +69,9 @@ using bluetooth::Uuid;
 // Maximum number of devices we can have an RFCOMM connection with.
 #define MAX_RFC_SESSION 7
 
+// Maximum number of queued buffers handed to the app socket per sendmsg().
+#define MAX_RFC_SEND_IOV 16
+
 typedef struct {
   int outgoing_congest : 1;
   int pending_sdp_request : 1;
@@ -103,6 +108,9 @@ static rfc_slot_t rfc_slots[MAX_RFC_CHANNEL];
 static uint32_t rfc_slot_id;
 static volatile int pth = -1;  // poll thread handle
 static std::recursive_mutex slot_lock;
+// In-use slots by id, so that the per-packet data callbacks do not scan
+// |rfc_slots|. Guarded by |slot_lock|.
+static std::unordered_map<uint32_t, rfc_slot_t*> slot_by_id;
 static uid_set_t* uid_set = NULL;
 
 static rfc_slot_t* find_free_slot(void);
@@ -119,6 +127,7 @@ bt_status_t btsock_rfc_init(int poll_thread_handle, uid_set_t* set) {
   uid_set = set;
 
   memset(rfc_slots, 0, sizeof(rfc_slots));
+  slot_by_id.clear();
   for (size_t i = 0; i < ARRAY_SIZE(rfc_slots); ++i) {
     rfc_slots[i].scn = -1;
     rfc_slots[i].sdp_handle = 0;
@@ -145,6 +154,7 @@ void btsock_rfc_cleanup(void) {
     list_free(rfc_slots[i].incoming_queue);
     rfc_slots[i].incoming_queue = NULL;
   }
+  slot_by_id.clear();
 }
 
 static rfc_slot_t* find_free_slot(void) {
@@ -156,8 +166,8 @@ static rfc_slot_t* find_free_slot(void) {
 static rfc_slot_t* find_rfc_slot_by_id(uint32_t id) {
   CHECK(id != 0);
 
-  for (size_t i = 0; i < ARRAY_SIZE(rfc_slots); ++i)
-    if (rfc_slots[i].id == id) return &rfc_slots[i];
+  auto it = slot_by_id.find(id);
+  if (it != slot_by_id.end()) return it->second;
 
   LOG_ERROR(LOG_TAG, "%s unable to find RFCOMM slot id: %u", __func__, id);
   return NULL;
@@ -229,6 +239,7 @@ static rfc_slot_t* alloc_rfc_slot(const RawAddress* addr, const char* name,
 
   slot->id = rfc_slot_id;
   slot->f.server = server;
+  slot_by_id[slot->id] = slot;
 
   return slot;
 }
@@ -434,6 +445,7 @@ static void cleanup_rfc_slot(rfc_slot_t* slot) {
 
   slot->rfc_port_handle = 0;
   memset(&slot->f, 0, sizeof(slot->f));
+  if (slot->id) slot_by_id.erase(slot->id);
   slot->id = 0;
   slot->scn_notified = false;
 }
@@ -770,10 +782,57 @@ static sent_status_t send_data_to_app(int fd, BT_HDR* p_buf) {
   return SENT_PARTIAL;
 }
 
+// Sends queued buffers to the app, up to MAX_RFC_SEND_IOV of them with a
+// single sendmsg(), and drops what was fully sent from |incoming_queue|.
+static sent_status_t send_queue_to_app(rfc_slot_t* slot) {
+  struct iovec iov[MAX_RFC_SEND_IOV];
+  int iovcnt = 0;
+  size_t total = 0;
+  for (const list_node_t* node = list_begin(slot->incoming_queue);
+       node != list_end(slot->incoming_queue) && iovcnt < MAX_RFC_SEND_IOV;
+       node = list_next(node)) {
+    BT_HDR* p_buf = (BT_HDR*)list_node(node);
+    iov[iovcnt].iov_base = p_buf->data + p_buf->offset;
+    iov[iovcnt].iov_len = p_buf->len;
+    total += p_buf->len;
+    iovcnt++;
+  }
+
+  ssize_t sent = 0;
+  if (total > 0) {
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    OSI_NO_INTR(sent = sendmsg(slot->fd, &msg, MSG_DONTWAIT));
+
+    if (sent == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return SENT_NONE;
+      LOG_ERROR(LOG_TAG, "%s error writing RFCOMM data back to app: %s",
+                __func__, strerror(errno));
+      return SENT_FAILED;
+    }
+
+    if (sent == 0) return SENT_FAILED;
+  }
+
+  size_t remaining = sent;
+  for (int i = 0; i < iovcnt; i++) {
+    BT_HDR* p_buf = (BT_HDR*)list_front(slot->incoming_queue);
+    if (p_buf->len > remaining) {
+      p_buf->offset += remaining;
+      p_buf->len -= remaining;
+      break;
+    }
+    remaining -= p_buf->len;
+    list_remove(slot->incoming_queue, p_buf);
+  }
+
+  return ((size_t)sent == total) ? SENT_ALL : SENT_PARTIAL;
+}
+
 static bool flush_incoming_que_on_wr_signal(rfc_slot_t* slot) {
   while (!list_is_empty(slot->incoming_queue)) {
-    BT_HDR* p_buf = (BT_HDR*)list_front(slot->incoming_queue);
-    switch (send_data_to_app(slot->fd, p_buf)) {
+    switch (send_queue_to_app(slot)) {
       case SENT_NONE:
       case SENT_PARTIAL:
         // monitor the fd to get callback when app is ready to receive data
@@ -782,11 +841,9 @@ static bool flush_incoming_que_on_wr_signal(rfc_slot_t* slot) {
         return true;
 
       case SENT_ALL:
-        list_remove(slot->incoming_queue, p_buf);
         break;
 
       case SENT_FAILED:
-        list_remove(slot->incoming_queue, p_buf);
         return false;
     }
   }
@@ -899,6 +956,30 @@ int bta_co_rfc_data_outgoing_size(uint32_t id, int* size) {
   return true;
 }
 
+int bta_co_rfc_data_outgoing_iov(uint32_t id, const struct iovec* iov,
+                                 int iovcnt) {
+  std::unique_lock<std::recursive_mutex> lock(slot_lock);
+  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  if (!slot) return false;
+
+  size_t size = 0;
+  for (int i = 0; i < iovcnt; i++) size += iov[i].iov_len;
+
+  // The stack only asks for bytes FIONREAD reported, so one readv() fills
+  // every buffer unless the socket failed.
+  ssize_t received;
+  OSI_NO_INTR(received = readv(slot->fd, iov, iovcnt));
+
+  if (received < 0 || (size_t)received != size) {
+    LOG_ERROR(LOG_TAG, "%s error receiving RFCOMM data from app: %s", __func__,
+              strerror(errno));
+    cleanup_rfc_slot(slot);
+    return false;
+  }
+
+  return true;
+}
+
 int bta_co_rfc_data_outgoing(uint32_t id, uint8_t* buf, uint16_t size) {
   std::unique_lock<std::recursive_mutex> lock(slot_lock);
   rfc_slot_t* slot = find_rfc_slot_by_id(id);
@@ -40,12 +40,16 @@
 #include <string.h>
 #include <time.h>
 
+#include <functional>
+#include <vector>
+
 #include "bt_common.h"
 #include "bta_closure_api.h"
 #include "bta_hd_api.h"
 #include "bta_hearing_aid_api.h"
 #include "bta_hh_api.h"
 #include "btif_api.h"
+#include "btif_bonded_properties.h"
 #include "btif_config.h"
 #include "btif_hd.h"
 #include "btif_hh.h"
@@ -834,6 +838,74 @@ static void remove_devices_with_sample_ltk() {
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         btif_in_report_bonded_device_properties
+ *
+ * Description      Internal helper function to report the remote properties
+ *                  of a bonded device from the config
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void btif_in_report_bonded_device_properties(
+    const RawAddress& remote_addr) {
+  /* Unbonded before we got to it */
+  if (!btif_config_has_section(remote_addr.ToString().c_str())) return;
+
+  RawAddress addr = remote_addr;
+  RawAddress* p_remote_addr = &addr;
+  bt_property_t remote_properties[8];
+  bt_bdname_t name, alias;
+  Uuid remote_uuids[BT_MAX_NUM_UUIDS];
+
+  /*
+   * TODO: improve handling of missing fields in NVRAM.
+   */
+  uint32_t cod = 0;
+  uint32_t devtype = 0;
+
+  uint32_t num_props = 0;
+  memset(remote_properties, 0, sizeof(remote_properties));
+  BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_BDNAME, &name,
+                               sizeof(name), remote_properties[num_props]);
+  num_props++;
+
+  BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_REMOTE_FRIENDLY_NAME,
+                               &alias, sizeof(alias),
+                               remote_properties[num_props]);
+  num_props++;
+
+  BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_CLASS_OF_DEVICE,
+                               &cod, sizeof(cod), remote_properties[num_props]);
+  num_props++;
+
+  BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_TYPE_OF_DEVICE,
+                               &devtype, sizeof(devtype),
+                               remote_properties[num_props]);
+  num_props++;
+
+  BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_UUIDS, remote_uuids,
+                               sizeof(remote_uuids),
+                               remote_properties[num_props]);
+  num_props++;
+
+  btif_remote_properties_evt(BT_STATUS_SUCCESS, p_remote_addr, num_props,
+                             remote_properties);
+}
+
+static void btif_in_run_task(std::function<void()> task) { task(); }
+
+/* Only used on the JNI thread */
+static BtifBondedPropertiesReporter& bonded_properties_reporter() {
+  static BtifBondedPropertiesReporter reporter(
+      [](std::function<void()> task) {
+        do_in_jni_thread(FROM_HERE, Bind(&btif_in_run_task, std::move(task)));
+      },
+      btif_in_report_bonded_device_properties);
+  return reporter;
+}
+
 /*******************************************************************************
  *
  * Function         btif_storage_load_bonded_devices
@@ -842,7 +914,10 @@ static void remove_devices_with_sample_ltk() {
  *                  and adds to the BTA.
  *                  Additionally, this API also invokes the adaper_properties_cb
  *                  and remote_device_properties_cb for each of the bonded
- *                  devices.
+ *                  devices. The keys are added to the BTA and the adapter
+ *                  properties reported before returning, the remote device
+ *                  properties are reported in batches from the JNI thread
+ *                  afterwards, also after the adapter is reported on.
  *
  * Returns          BT_STATUS_SUCCESS if successful, BT_STATUS_FAIL otherwise
  *
@@ -852,13 +927,11 @@ bt_status_t btif_storage_load_bonded_devices(void) {
   uint32_t i = 0;
   bt_property_t adapter_props[6];
   uint32_t num_props = 0;
-  bt_property_t remote_properties[8];
   RawAddress addr;
-  bt_bdname_t name, alias;
+  bt_bdname_t name;
   bt_scan_mode_t mode;
   uint32_t disc_timeout;
   Uuid local_uuids[BT_MAX_NUM_UUIDS];
-  Uuid remote_uuids[BT_MAX_NUM_UUIDS];
   bt_status_t status;
 
   remove_devices_with_sample_ltk();
@@ -926,50 +999,31 @@ bt_status_t btif_storage_load_bonded_devices(void) {
   BTIF_TRACE_EVENT("%s: %d bonded devices found", __func__,
                    bonded_devices.num_devices);
 
-  {
-    for (i = 0; i < bonded_devices.num_devices; i++) {
-      RawAddress* p_remote_addr;
-
-      /*
-       * TODO: improve handling of missing fields in NVRAM.
-       */
-      uint32_t cod = 0;
-      uint32_t devtype = 0;
-
-      num_props = 0;
-      p_remote_addr = &bonded_devices.devices[i];
-      memset(remote_properties, 0, sizeof(remote_properties));
-      BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_BDNAME, &name,
-                                   sizeof(name), remote_properties[num_props]);
-      num_props++;
-
-      BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr,
-                                   BT_PROPERTY_REMOTE_FRIENDLY_NAME, &alias,
-                                   sizeof(alias), remote_properties[num_props]);
-      num_props++;
-
-      BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_CLASS_OF_DEVICE,
-                                   &cod, sizeof(cod),
-                                   remote_properties[num_props]);
-      num_props++;
-
-      BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_TYPE_OF_DEVICE,
-                                   &devtype, sizeof(devtype),
-                                   remote_properties[num_props]);
-      num_props++;
-
-      BTIF_STORAGE_GET_REMOTE_PROP(p_remote_addr, BT_PROPERTY_UUIDS,
-                                   remote_uuids, sizeof(remote_uuids),
-                                   remote_properties[num_props]);
-      num_props++;
-
-      btif_remote_properties_evt(BT_STATUS_SUCCESS, p_remote_addr, num_props,
-                                 remote_properties);
-    }
-  }
+  /* The keys are with BTM already and Java has the bonded device list, so
+   * link key requests and bond states are answered the same way before the
+   * remote properties arrive. Those only fill in names, classes and services,
+   * and lookups made in the meantime read them from the config. */
+  bonded_properties_reporter().Start(std::vector<RawAddress>(
+      bonded_devices.devices,
+      bonded_devices.devices + bonded_devices.num_devices));
   return BT_STATUS_SUCCESS;
 }
 
+/*******************************************************************************
+ *
+ * Function         btif_storage_stop_loading_bonded_devices
+ *
+ * Description      BTIF storage API - Stops reporting the remote properties
+ *                  of bonded devices still pending from
+ *                  btif_storage_load_bonded_devices.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btif_storage_stop_loading_bonded_devices(void) {
+  bonded_properties_reporter().Stop();
+}
+
 /*******************************************************************************
  *
  * Function         btif_storage_add_ble_bonding_key
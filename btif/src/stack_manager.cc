@@ -27,10 +27,13 @@
 #include "btif_api.h"
 #include "btif_common.h"
 #include "device/include/controller.h"
+#include "device/include/interop.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/semaphore.h"
 #include "osi/include/thread.h"
+#include "osi/include/time.h"
+#include "stack_config.h"
 
 // Temp includes
 #include "bt_utils.h"
@@ -105,9 +108,15 @@ static void event_init_stack(void* context) {
   } else {
     module_management_start();
 
-    module_init(get_module(OSI_MODULE));
-    module_init(get_module(BT_UTILS_MODULE));
-    module_init(get_module(BTIF_CONFIG_MODULE));
+    // Loading the config files is the bulk of the work here, modules are
+    // initialized concurrently as far as their dependencies allow
+    const module_t* modules[] = {get_module(OSI_MODULE),
+                                 get_module(BT_UTILS_MODULE),
+                                 get_module(BTIF_CONFIG_MODULE),
+                                 get_module(STACK_CONFIG_MODULE),
+                                 get_module(INTEROP_MODULE),
+                                 NULL};
+    module_init_all(modules);
     btif_init_bluetooth();
 
     // stack init is synchronous, so no waiting necessary here
@@ -138,6 +147,7 @@ static void event_start_up_stack(UNUSED_ATTR void* context) {
   ensure_stack_is_initialized();
 
   LOG_INFO(LOG_TAG, "%s is bringing up the stack", __func__);
+  uint32_t start_ms = time_get_os_boottime_ms();
   future_t* local_hack_future = future_new();
   hack_future = local_hack_future;
 
@@ -153,7 +163,8 @@ static void event_start_up_stack(UNUSED_ATTR void* context) {
   }
 
   stack_is_running = true;
-  LOG_INFO(LOG_TAG, "%s finished", __func__);
+  LOG_INFO(LOG_TAG, "%s finished in %u ms", __func__,
+           time_get_os_boottime_ms() - start_ms);
   btif_thread_post(event_signal_stack_up, NULL);
 }
 
@@ -205,6 +216,8 @@ static void event_clean_up_stack(void* context) {
   stack_is_initialized = false;
 
   btif_cleanup_bluetooth();
+  module_clean_up(get_module(INTEROP_MODULE));
+  module_clean_up(get_module(STACK_CONFIG_MODULE));
   module_clean_up(get_module(BTIF_CONFIG_MODULE));
   module_clean_up(get_module(BT_UTILS_MODULE));
   module_clean_up(get_module(OSI_MODULE));
@@ -0,0 +1,235 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "btif/include/btif_a2dp_source_queue.h"
+#include "osi/include/allocator.h"
+
+namespace {
+
+// The media task encodes a packet of this much audio every tick
+constexpr uint64_t kTickUs = 20000;
+constexpr uint64_t kPacketAudioUs = 20000;
+
+constexpr size_t kMaxPackets = 28;
+constexpr uint64_t kMaxAudioUs = 240000;
+constexpr size_t kMaxAudioPackets = kMaxAudioUs / kPacketAudioUs;
+
+BT_HDR* NewPacket(uint16_t sequence) {
+  BT_HDR* p_buf = static_cast<BT_HDR*>(osi_calloc(sizeof(BT_HDR)));
+  p_buf->layer_specific = sequence;
+  return p_buf;
+}
+
+// Feeds the queue the way the media task does and drains it through a link
+// that can send a varying number of packets every tick.
+class SimulatedLink {
+ public:
+  explicit SimulatedLink(BtifA2dpSourceQueue* queue) : queue_(queue) {}
+
+  // Runs |ticks| ticks, the link sending up to |capacity| packets each.
+  void Run(size_t ticks, size_t capacity) {
+    for (size_t i = 0; i < ticks; i++) {
+      now_us_ += kTickUs;
+      dropped_ += queue_->Enqueue(NewPacket(produced_++), kPacketAudioUs,
+                                  now_us_);
+      max_queued_audio_us_ =
+          std::max(max_queued_audio_us_, queue_->QueuedAudioUs());
+      max_length_ = std::max(max_length_, queue_->Length());
+
+      for (size_t n = 0; n < capacity; n++) {
+        BT_HDR* p_buf = queue_->Dequeue(now_us_);
+        if (p_buf == nullptr) break;
+        sent_.push_back(p_buf->layer_specific);
+        osi_free(p_buf);
+      }
+    }
+  }
+
+  // Returns how many times the sent audio skipped ahead
+  size_t Gaps() const {
+    size_t gaps = 0;
+    for (size_t i = 1; i < sent_.size(); i++) {
+      if (sent_[i] != sent_[i - 1] + 1) gaps++;
+    }
+    return gaps;
+  }
+
+  bool SentInOrder() const {
+    return std::is_sorted(sent_.begin(), sent_.end()) &&
+           std::adjacent_find(sent_.begin(), sent_.end()) == sent_.end();
+  }
+
+  size_t produced() const { return produced_; }
+  size_t dropped() const { return dropped_; }
+  const std::vector<uint16_t>& sent() const { return sent_; }
+  uint64_t max_queued_audio_us() const { return max_queued_audio_us_; }
+  size_t max_length() const { return max_length_; }
+
+ private:
+  BtifA2dpSourceQueue* queue_;
+  uint64_t now_us_ = 0;
+  uint16_t produced_ = 0;
+  size_t dropped_ = 0;
+  std::vector<uint16_t> sent_;
+  uint64_t max_queued_audio_us_ = 0;
+  size_t max_length_ = 0;
+};
+
+size_t HistogramTotal(const BtifA2dpSourceQueue::Stats& stats) {
+  size_t total = 0;
+  for (size_t count : stats.delay_histogram) total += count;
+  return total;
+}
+
+}  // namespace
+
+class BtifA2dpSourceQueueTest : public ::testing::Test {
+ protected:
+  void SetUp() override { queue_.SetLimits(kMaxPackets, kMaxAudioUs); }
+
+  BtifA2dpSourceQueue queue_;
+};
+
+TEST_F(BtifA2dpSourceQueueTest, link_keeping_up_adds_no_delay) {
+  SimulatedLink link(&queue_);
+  link.Run(100, 1);
+
+  EXPECT_EQ(0u, link.dropped());
+  EXPECT_EQ(link.produced(), link.sent().size());
+  EXPECT_EQ(0u, link.Gaps());
+
+  BtifA2dpSourceQueue::Stats stats = queue_.GetStats();
+  EXPECT_EQ(100u, stats.dequeued_packets);
+  EXPECT_EQ(100u, stats.delay_histogram[0]);
+  EXPECT_EQ(0u, stats.max_delay_us);
+}
+
+TEST_F(BtifA2dpSourceQueueTest, stalled_link_drops_only_the_oldest_audio) {
+  SimulatedLink link(&queue_);
+  link.Run(50, 1);
+  // The link stalls for 600 ms, then catches up
+  link.Run(30, 0);
+  link.Run(50, 2);
+
+  EXPECT_LE(link.max_queued_audio_us(), kMaxAudioUs);
+  EXPECT_TRUE(link.SentInOrder());
+  EXPECT_EQ(link.produced(), link.sent().size() + link.dropped());
+
+  // The audio skips ahead once, over just the audio that did not fit
+  EXPECT_EQ(1u, link.Gaps());
+  EXPECT_EQ(30u - kMaxAudioPackets + 1, link.dropped());
+
+  BtifA2dpSourceQueue::Stats stats = queue_.GetStats();
+  EXPECT_EQ(link.dropped(), stats.dropped_packets);
+  EXPECT_EQ(link.dropped() * kPacketAudioUs, stats.dropped_audio_us);
+  EXPECT_LE(stats.max_delay_us, kMaxAudioUs);
+  EXPECT_EQ(stats.dequeued_packets, HistogramTotal(stats));
+  EXPECT_EQ(0u, queue_.Length());
+}
+
+TEST_F(BtifA2dpSourceQueueTest, slow_link_keeps_delay_bounded) {
+  SimulatedLink link(&queue_);
+  // Half the capacity needed for a while
+  for (size_t i = 0; i < 100; i++) {
+    link.Run(1, 1);
+    link.Run(1, 0);
+  }
+
+  EXPECT_LE(link.max_queued_audio_us(), kMaxAudioUs);
+  EXPECT_LE(link.max_length(), kMaxAudioPackets);
+  EXPECT_TRUE(link.SentInOrder());
+  EXPECT_EQ(link.produced(), link.sent().size() + link.dropped() +
+                                 queue_.Length());
+
+  BtifA2dpSourceQueue::Stats stats = queue_.GetStats();
+  EXPECT_LE(stats.max_delay_us, kMaxAudioUs);
+  EXPECT_EQ(stats.dequeued_packets, HistogramTotal(stats));
+}
+
+TEST_F(BtifA2dpSourceQueueTest, bursty_link_keeps_the_audio_whole) {
+  SimulatedLink link(&queue_);
+  // The link sends one packet a tick on average, in bursts
+  const size_t capacities[] = {0, 0, 3, 1, 0, 2, 1, 0, 0, 0, 4, 1};
+  for (size_t i = 0; i < 20; i++) {
+    for (size_t capacity : capacities) link.Run(1, capacity);
+  }
+
+  EXPECT_EQ(0u, link.dropped());
+  EXPECT_EQ(0u, link.Gaps());
+  EXPECT_TRUE(link.SentInOrder());
+
+  BtifA2dpSourceQueue::Stats stats = queue_.GetStats();
+  EXPECT_EQ(stats.dequeued_packets, HistogramTotal(stats));
+  EXPECT_GT(stats.max_delay_us, 0u);
+  EXPECT_LE(stats.max_delay_us, kMaxAudioUs);
+}
+
+TEST_F(BtifA2dpSourceQueueTest, packet_limit_applies_without_audio_duration) {
+  for (uint16_t i = 0; i < kMaxPackets + 10; i++) {
+    queue_.Enqueue(NewPacket(i), 0, 0);
+  }
+  EXPECT_EQ(kMaxPackets, queue_.Length());
+  EXPECT_EQ(10u, queue_.GetStats().dropped_packets);
+
+  BT_HDR* p_buf = queue_.Dequeue(0);
+  ASSERT_NE(nullptr, p_buf);
+  EXPECT_EQ(10u, p_buf->layer_specific);
+  osi_free(p_buf);
+}
+
+TEST_F(BtifA2dpSourceQueueTest, flush_frees_all_packets) {
+  for (uint16_t i = 0; i < 5; i++) {
+    queue_.Enqueue(NewPacket(i), kPacketAudioUs, 0);
+  }
+  EXPECT_EQ(5u * kPacketAudioUs, queue_.QueuedAudioUs());
+
+  EXPECT_EQ(5u, queue_.Flush());
+  EXPECT_EQ(0u, queue_.Length());
+  EXPECT_EQ(0u, queue_.QueuedAudioUs());
+  EXPECT_EQ(nullptr, queue_.Dequeue(0));
+  EXPECT_EQ(5u, queue_.GetStats().flushed_packets);
+
+  queue_.ResetStats();
+  EXPECT_EQ(0u, queue_.GetStats().flushed_packets);
+}
+
+TEST_F(BtifA2dpSourceQueueTest, delays_are_counted_in_their_bucket) {
+  const size_t last = BtifA2dpSourceQueue::kDelayHistogramSize - 1;
+  for (size_t bucket = 0; bucket < last; bucket++) {
+    // Right below the limit of the bucket, and right at it
+    uint64_t limit_us = BtifA2dpSourceQueue::DelayHistogramLimitUs(bucket);
+    queue_.Enqueue(NewPacket(0), 0, 0);
+    osi_free(queue_.Dequeue(limit_us - 1));
+    queue_.Enqueue(NewPacket(0), 0, 0);
+    osi_free(queue_.Dequeue(limit_us));
+  }
+
+  BtifA2dpSourceQueue::Stats stats = queue_.GetStats();
+  EXPECT_EQ(1u, stats.delay_histogram[0]);
+  for (size_t bucket = 1; bucket < last; bucket++) {
+    EXPECT_EQ(2u, stats.delay_histogram[bucket]) << "bucket " << bucket;
+  }
+  EXPECT_EQ(1u, stats.delay_histogram[last]);
+  EXPECT_EQ(BtifA2dpSourceQueue::DelayHistogramLimitUs(last - 1),
+            stats.max_delay_us);
+}
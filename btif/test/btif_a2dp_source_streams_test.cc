@@ -0,0 +1,231 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "btif/include/btif_a2dp_source_streams.h"
+
+namespace {
+
+constexpr size_t kMaxTapBytes = 64;
+constexpr size_t kMaxStreams = 2;
+constexpr uint64_t kIdleUs = 1000000;
+
+const RawAddress kPeer1({0x11, 0x22, 0x33, 0x44, 0x55, 0x66});
+const RawAddress kPeer2({0x11, 0x22, 0x33, 0x44, 0x55, 0x77});
+
+// PCM whose byte at position |i| is |i|, so a read shows where it was from
+std::vector<uint8_t> Pcm(uint64_t start, size_t len) {
+  std::vector<uint8_t> pcm(len);
+  for (size_t i = 0; i < len; i++) pcm[i] = static_cast<uint8_t>(start + i);
+  return pcm;
+}
+
+// A fake codec configuration: the frames of a configuration can be decoded
+// by the sinks with the same format and at least the same bitpool
+struct CodecInfo {
+  uint8_t info[AVDT_CODEC_SIZE] = {};
+  CodecInfo(uint8_t format, uint8_t max_bitpool) {
+    info[0] = format;
+    info[1] = max_bitpool;
+  }
+};
+
+bool FramesCompatible(const uint8_t* p_codec_info_frames,
+                      const uint8_t* p_codec_info_sink) {
+  return p_codec_info_frames[0] == p_codec_info_sink[0] &&
+         p_codec_info_frames[1] <= p_codec_info_sink[1];
+}
+
+}  // namespace
+
+class BtifA2dpSourcePcmTapTest : public ::testing::Test {
+ protected:
+  BtifA2dpSourcePcmTapTest() : tap_(kMaxTapBytes) {}
+
+  void Write(size_t len) {
+    std::vector<uint8_t> pcm = Pcm(tap_.End(), len);
+    tap_.Write(pcm.data(), pcm.size());
+  }
+
+  // Reads |len| bytes at |*p_offset|, expecting the audio written there
+  void ExpectRead(uint64_t* p_offset, size_t len, size_t expected_len) {
+    std::vector<uint8_t> buf(len);
+    uint64_t expected_offset = std::max(*p_offset, tap_.Start());
+    ASSERT_EQ(expected_len, tap_.Read(p_offset, buf.data(), len, &lost_));
+    buf.resize(expected_len);
+    EXPECT_EQ(Pcm(expected_offset, expected_len), buf);
+    EXPECT_EQ(expected_offset + expected_len, *p_offset);
+  }
+
+  BtifA2dpSourcePcmTap tap_;
+  size_t lost_ = 0;
+};
+
+TEST_F(BtifA2dpSourcePcmTapTest, readers_keep_their_own_offsets) {
+  uint64_t reader1 = tap_.End();
+  uint64_t reader2 = tap_.End();
+  Write(32);
+
+  ExpectRead(&reader1, 10, 10);
+  ExpectRead(&reader1, 10, 10);
+  ExpectRead(&reader2, 32, 32);
+  EXPECT_EQ(20u, reader1);
+  EXPECT_EQ(32u, reader2);
+
+  // A reader at the end underflows until more audio is written
+  ExpectRead(&reader2, 8, 0);
+  Write(8);
+  ExpectRead(&reader2, 16, 8);
+  ExpectRead(&reader1, 32, 20);
+  EXPECT_EQ(0u, lost_);
+}
+
+TEST_F(BtifA2dpSourcePcmTapTest, discard_keeps_offsets) {
+  uint64_t reader = 0;
+  Write(32);
+  tap_.Discard(16);
+  EXPECT_EQ(16u, tap_.Start());
+  EXPECT_EQ(32u, tap_.End());
+  EXPECT_EQ(16u, tap_.Size());
+
+  reader = 16;
+  ExpectRead(&reader, 8, 8);
+
+  // Discarding behind the start or past the end does no harm
+  tap_.Discard(4);
+  EXPECT_EQ(16u, tap_.Start());
+  tap_.Discard(100);
+  EXPECT_EQ(32u, tap_.Start());
+  EXPECT_EQ(0u, tap_.Size());
+}
+
+TEST_F(BtifA2dpSourcePcmTapTest, write_trims_to_the_size_limit) {
+  uint64_t reader = tap_.End();
+  Write(kMaxTapBytes - 8);
+  Write(24);
+  EXPECT_EQ(kMaxTapBytes, tap_.Size());
+  EXPECT_EQ(16u, tap_.Start());
+  EXPECT_EQ(kMaxTapBytes + 16, tap_.End());
+
+  // The lagging reader lost the oldest audio and reads on from the start
+  ExpectRead(&reader, 8, 8);
+  EXPECT_EQ(16u, lost_);
+  EXPECT_EQ(24u, reader);
+}
+
+TEST_F(BtifA2dpSourcePcmTapTest, clear_continues_offsets) {
+  Write(32);
+  tap_.Clear();
+  EXPECT_EQ(0u, tap_.Size());
+  EXPECT_EQ(32u, tap_.Start());
+
+  uint64_t reader = tap_.End();
+  Write(8);
+  ExpectRead(&reader, 8, 8);
+  EXPECT_EQ(40u, reader);
+  EXPECT_EQ(0u, lost_);
+}
+
+class BtifA2dpSourceStreamsTest : public ::testing::Test {
+ protected:
+  BtifA2dpSourceStreamsTest()
+      : streams_(kMaxStreams, kIdleUs, FramesCompatible) {}
+
+  size_t Request(const CodecInfo& codec, const RawAddress& peer,
+                 uint64_t now_us, bool expect_added) {
+    bool added = !expect_added;
+    size_t index = streams_.Request(codec.info, peer, now_us, &added);
+    EXPECT_EQ(expect_added, added);
+    return index;
+  }
+
+  BtifA2dpSourceStreams streams_;
+};
+
+TEST_F(BtifA2dpSourceStreamsTest, first_request_adds_a_pending_stream) {
+  CodecInfo codec(1, 53);
+  size_t index = Request(codec, kPeer1, 100, true);
+  ASSERT_NE(BtifA2dpSourceStreams::kNoStream, index);
+
+  const BtifA2dpSourceStreams::Stream& stream = streams_.Get(index);
+  EXPECT_EQ(BtifA2dpSourceStreams::kStreamPending, stream.state);
+  EXPECT_EQ(kPeer1, stream.peer_address);
+  EXPECT_EQ(100u, stream.last_read_us);
+  EXPECT_EQ(0, memcmp(codec.info, stream.codec_info, AVDT_CODEC_SIZE));
+
+  // The same configuration finds the stream again
+  EXPECT_EQ(index, Request(codec, kPeer1, 200, false));
+  EXPECT_EQ(200u, streams_.Get(index).last_read_us);
+}
+
+TEST_F(BtifA2dpSourceStreamsTest, compatible_sinks_share_a_stream) {
+  size_t index = Request(CodecInfo(1, 35), kPeer1, 0, true);
+  streams_.SetState(index, BtifA2dpSourceStreams::kStreamEncoding);
+
+  // A sink accepting a higher bitpool decodes the frames as well
+  EXPECT_EQ(index, Request(CodecInfo(1, 53), kPeer2, 0, false));
+  EXPECT_EQ(index, streams_.Find(CodecInfo(1, 53).info));
+  EXPECT_EQ(kPeer1, streams_.Get(index).peer_address);
+
+  // One that cannot decode them gets a stream of its own
+  size_t other = Request(CodecInfo(1, 20), kPeer2, 0, true);
+  EXPECT_NE(index, other);
+  EXPECT_NE(BtifA2dpSourceStreams::kNoStream, other);
+}
+
+TEST_F(BtifA2dpSourceStreamsTest, no_stream_when_all_are_taken) {
+  Request(CodecInfo(1, 53), kPeer1, 0, true);
+  Request(CodecInfo(2, 53), kPeer2, 0, true);
+
+  EXPECT_EQ(BtifA2dpSourceStreams::kNoStream,
+            Request(CodecInfo(3, 53), kPeer2, 0, false));
+  EXPECT_EQ(BtifA2dpSourceStreams::kNoStream,
+            streams_.Find(CodecInfo(3, 53).info));
+}
+
+TEST_F(BtifA2dpSourceStreamsTest, idle_streams_are_released) {
+  size_t index1 = Request(CodecInfo(1, 53), kPeer1, 0, true);
+  size_t index2 = Request(CodecInfo(2, 53), kPeer2, 0, true);
+  streams_.SetState(index2, BtifA2dpSourceStreams::kStreamReconfiguring);
+
+  EXPECT_TRUE(streams_.IdleStreams(kIdleUs).empty());
+
+  // Only the stream still read stays in use
+  Request(CodecInfo(1, 53), kPeer1, kIdleUs, false);
+  std::vector<size_t> idle = streams_.IdleStreams(kIdleUs + 1);
+  ASSERT_EQ(1u, idle.size());
+  EXPECT_EQ(index2, idle[0]);
+
+  streams_.Release(index2);
+  EXPECT_EQ(BtifA2dpSourceStreams::kStreamUnused, streams_.Get(index2).state);
+  EXPECT_TRUE(streams_.IdleStreams(kIdleUs + 1).empty());
+  EXPECT_EQ(BtifA2dpSourceStreams::kNoStream,
+            streams_.Find(CodecInfo(2, 53).info));
+
+  // The released stream is taken again for the next configuration
+  EXPECT_EQ(index2, Request(CodecInfo(3, 53), kPeer2, kIdleUs, true));
+
+  streams_.ReleaseAll();
+  EXPECT_EQ(BtifA2dpSourceStreams::kStreamUnused, streams_.Get(index1).state);
+  EXPECT_EQ(BtifA2dpSourceStreams::kStreamUnused, streams_.Get(index2).state);
+}
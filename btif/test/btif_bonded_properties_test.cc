@@ -0,0 +1,142 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "btif/include/btif_bonded_properties.h"
+
+namespace {
+
+RawAddress Device(size_t i) {
+  RawAddress addr = RawAddress::kEmpty;
+  addr.address[4] = i >> 8;
+  addr.address[5] = i & 0xff;
+  return addr;
+}
+
+std::vector<RawAddress> Devices(size_t count) {
+  std::vector<RawAddress> devices;
+  for (size_t i = 0; i < count; i++) devices.push_back(Device(i));
+  return devices;
+}
+
+}  // namespace
+
+class BtifBondedPropertiesTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    reporter_.reset(new BtifBondedPropertiesReporter(
+        [this](std::function<void()> task) { tasks_.push_back(task); },
+        [this](const RawAddress& bd_addr) {
+          log_.push_back("report " + bd_addr.ToString());
+          reported_.push_back(bd_addr);
+        }));
+  }
+
+  // Runs the JNI thread until it has nothing left to do
+  size_t RunAll() {
+    size_t ran = 0;
+    while (!tasks_.empty()) {
+      std::function<void()> task = tasks_.front();
+      tasks_.pop_front();
+      task();
+      ran++;
+    }
+    return ran;
+  }
+
+  // Queues an unrelated JNI task, like an upstream event
+  void Post(const std::string& name) {
+    tasks_.push_back([this, name] { log_.push_back(name); });
+  }
+
+  std::unique_ptr<BtifBondedPropertiesReporter> reporter_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<RawAddress> reported_;
+  std::vector<std::string> log_;
+};
+
+TEST_F(BtifBondedPropertiesTest, no_bonds_report_nothing) {
+  reporter_->Start({});
+  EXPECT_TRUE(reporter_->IsReporting());
+
+  EXPECT_EQ(1u, RunAll());
+  EXPECT_TRUE(log_.empty());
+  EXPECT_FALSE(reporter_->IsReporting());
+}
+
+TEST_F(BtifBondedPropertiesTest, state_on_does_not_wait_for_the_reports) {
+  const size_t count = 3 * BtifBondedPropertiesReporter::kBatchSize + 5;
+  reporter_->Start(Devices(count));
+  // The stack comes up right after the bonded devices are loaded
+  Post("state on");
+
+  RunAll();
+  ASSERT_EQ(Devices(count), reported_);
+  ASSERT_EQ(count + 1, log_.size());
+  EXPECT_EQ("state on", log_[BtifBondedPropertiesReporter::kBatchSize]);
+  EXPECT_FALSE(reporter_->IsReporting());
+}
+
+TEST_F(BtifBondedPropertiesTest, batches_let_other_tasks_run) {
+  const size_t count = 2 * BtifBondedPropertiesReporter::kBatchSize + 1;
+  reporter_->Start(Devices(count));
+  Post("upstream event");
+
+  RunAll();
+  ASSERT_EQ(count + 1, log_.size());
+  // The first batch was queued ahead of the event, the rest behind it
+  EXPECT_EQ("upstream event", log_[BtifBondedPropertiesReporter::kBatchSize]);
+  EXPECT_EQ(Devices(count), reported_);
+}
+
+TEST_F(BtifBondedPropertiesTest, reload_replaces_pending_devices) {
+  const size_t count = 2 * BtifBondedPropertiesReporter::kBatchSize;
+  reporter_->Start(Devices(count));
+
+  // One batch in, the bonded devices are loaded again
+  tasks_.front()();
+  tasks_.pop_front();
+  reporter_->Start(Devices(3));
+
+  RunAll();
+  std::vector<RawAddress> expected =
+      Devices(BtifBondedPropertiesReporter::kBatchSize);
+  for (const RawAddress& addr : Devices(3)) expected.push_back(addr);
+  EXPECT_EQ(expected, reported_);
+  EXPECT_FALSE(reporter_->IsReporting());
+}
+
+TEST_F(BtifBondedPropertiesTest, stop_drops_pending_devices) {
+  const size_t count = 2 * BtifBondedPropertiesReporter::kBatchSize;
+  reporter_->Start(Devices(count));
+
+  tasks_.front()();
+  tasks_.pop_front();
+  reporter_->Stop();
+  EXPECT_FALSE(reporter_->IsReporting());
+
+  RunAll();
+  EXPECT_EQ(BtifBondedPropertiesReporter::kBatchSize, reported_.size());
+}
@@ -0,0 +1,232 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "btif/include/btif_gatt_notify_batch.h"
+
+namespace {
+
+constexpr uint16_t kConn1 = 1;
+constexpr uint16_t kConn2 = 2;
+constexpr int kLatencyMs = 10;
+
+// Runs tasks like the JNI thread message loop: in order of due time, then in
+// the order they were posted
+class FakeLoop {
+ public:
+  void Post(std::function<void()> task, int delay_ms) {
+    tasks_.emplace(std::make_pair(now_ms_ + delay_ms, next_seq_++),
+                   std::move(task));
+  }
+
+  // Runs every task due up to |ms| from now
+  void RunFor(int ms) {
+    int end_ms = now_ms_ + ms;
+    while (!tasks_.empty() && tasks_.begin()->first.first <= end_ms) {
+      auto it = tasks_.begin();
+      now_ms_ = std::max(now_ms_, it->first.first);
+      std::function<void()> task = std::move(it->second);
+      tasks_.erase(it);
+      task();
+    }
+    now_ms_ = end_ms;
+  }
+
+  int now_ms() const { return now_ms_; }
+  size_t pending() const { return tasks_.size(); }
+
+ private:
+  int now_ms_ = 0;
+  int next_seq_ = 0;
+  std::map<std::pair<int, int>, std::function<void()>> tasks_;
+};
+
+struct Delivered {
+  uint16_t conn_id;
+  uint16_t handle;
+  std::vector<uint8_t> value;
+  int at_ms;
+};
+
+}  // namespace
+
+class BtifGattNotifyBatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override { SetLatency(kLatencyMs); }
+
+  void SetLatency(int latency_ms) {
+    batcher_.reset(new BtifGattNotifyBatcher(
+        [this](uint16_t conn_id, uint64_t batch_id, int delay_ms) {
+          posts_++;
+          loop_.Post(
+              [this, conn_id, batch_id] {
+                delivers_++;
+                batcher_->Deliver(
+                    conn_id, batch_id,
+                    [this](uint16_t conn_id,
+                           const BtifGattNotifyBatcher::Notification& n) {
+                      delivered_.push_back(
+                          {conn_id, n.handle,
+                           std::vector<uint8_t>(n.value, n.value + n.len),
+                           loop_.now_ms()});
+                    });
+              },
+              delay_ms);
+        },
+        latency_ms));
+  }
+
+  void Notify(uint16_t conn_id, uint16_t handle, uint16_t len = 2) {
+    std::vector<uint8_t> value(len, static_cast<uint8_t>(handle));
+    batcher_->Add(conn_id, {RawAddress::kAny, handle, true, value.data(),
+                            static_cast<uint16_t>(value.size())});
+  }
+
+  // Another client event, posted the way bta_gattc_cback does
+  void Event(const std::string& name) {
+    batcher_->Flush();
+    loop_.Post([this, name] { events_.emplace_back(name, delivered_.size()); },
+               0);
+  }
+
+  FakeLoop loop_;
+  std::unique_ptr<BtifGattNotifyBatcher> batcher_;
+  std::vector<Delivered> delivered_;
+  // Events with how many notifications were delivered before them
+  std::vector<std::pair<std::string, size_t>> events_;
+  size_t posts_ = 0;
+  size_t delivers_ = 0;
+};
+
+TEST_F(BtifGattNotifyBatcherTest, notifications_join_one_batch) {
+  for (uint16_t handle = 1; handle <= 5; handle++) Notify(kConn1, handle);
+
+  EXPECT_EQ(1u, posts_);
+  EXPECT_EQ(1u, batcher_->PendingBatches(kConn1));
+
+  loop_.RunFor(kLatencyMs);
+  EXPECT_EQ(1u, delivers_);
+  ASSERT_EQ(5u, delivered_.size());
+  for (uint16_t i = 0; i < 5; i++) {
+    EXPECT_EQ(i + 1, delivered_[i].handle);
+    EXPECT_EQ(std::vector<uint8_t>(2, i + 1), delivered_[i].value);
+  }
+  EXPECT_EQ(0u, batcher_->PendingBatches(kConn1));
+}
+
+TEST_F(BtifGattNotifyBatcherTest, batch_waits_for_latency_budget) {
+  Notify(kConn1, 1);
+  loop_.RunFor(kLatencyMs - 1);
+  EXPECT_TRUE(delivered_.empty());
+
+  Notify(kConn1, 2);
+  loop_.RunFor(1);
+  ASSERT_EQ(2u, delivered_.size());
+  EXPECT_EQ(kLatencyMs, delivered_[0].at_ms);
+  EXPECT_EQ(kLatencyMs, delivered_[1].at_ms);
+}
+
+TEST_F(BtifGattNotifyBatcherTest, zero_latency_delivers_right_away) {
+  SetLatency(0);
+  Notify(kConn1, 1);
+  Notify(kConn1, 2);
+  EXPECT_EQ(1u, posts_);
+
+  loop_.RunFor(0);
+  ASSERT_EQ(2u, delivered_.size());
+  EXPECT_EQ(0, delivered_[1].at_ms);
+}
+
+TEST_F(BtifGattNotifyBatcherTest, full_batch_is_delivered_right_away) {
+  const size_t count = BtifGattNotifyBatcher::kMaxNotifications + 3;
+  for (size_t i = 0; i < count; i++) Notify(kConn1, i + 1);
+  EXPECT_EQ(2u, batcher_->PendingBatches(kConn1));
+
+  loop_.RunFor(0);
+  ASSERT_EQ(BtifGattNotifyBatcher::kMaxNotifications, delivered_.size());
+
+  loop_.RunFor(kLatencyMs);
+  ASSERT_EQ(count, delivered_.size());
+  for (size_t i = 0; i < count; i++) EXPECT_EQ(i + 1, delivered_[i].handle);
+  EXPECT_EQ(0u, loop_.pending());
+}
+
+TEST_F(BtifGattNotifyBatcherTest, batch_is_capped_by_bytes) {
+  const uint16_t len = 600;
+  const size_t per_batch = (BtifGattNotifyBatcher::kMaxBytes + len - 1) / len;
+  for (size_t i = 0; i < per_batch + 1; i++) Notify(kConn1, i + 1, len);
+  EXPECT_EQ(2u, batcher_->PendingBatches(kConn1));
+
+  loop_.RunFor(0);
+  EXPECT_EQ(per_batch, delivered_.size());
+  loop_.RunFor(kLatencyMs);
+  EXPECT_EQ(per_batch + 1, delivered_.size());
+}
+
+TEST_F(BtifGattNotifyBatcherTest, connections_are_batched_separately) {
+  Notify(kConn1, 1);
+  Notify(kConn2, 1);
+  Notify(kConn1, 2);
+  Notify(kConn2, 2);
+  Notify(kConn1, 3);
+  EXPECT_EQ(2u, posts_);
+
+  loop_.RunFor(kLatencyMs);
+  ASSERT_EQ(5u, delivered_.size());
+
+  std::map<uint16_t, std::vector<uint16_t>> handles;
+  for (const Delivered& d : delivered_) handles[d.conn_id].push_back(d.handle);
+  EXPECT_EQ(std::vector<uint16_t>({1, 2, 3}), handles[kConn1]);
+  EXPECT_EQ(std::vector<uint16_t>({1, 2}), handles[kConn2]);
+}
+
+TEST_F(BtifGattNotifyBatcherTest, other_events_keep_their_order) {
+  Notify(kConn1, 1);
+  Notify(kConn2, 1);
+  Event("close");
+  // Arrives before the JNI thread got to the flush
+  Notify(kConn1, 2);
+
+  loop_.RunFor(kLatencyMs);
+  ASSERT_EQ(3u, delivered_.size());
+  ASSERT_EQ(1u, events_.size());
+  // Both notifications queued ahead of the close went out before it, the
+  // later one after it
+  EXPECT_EQ(2u, events_[0].second);
+  EXPECT_EQ(2u, delivered_[2].handle);
+  EXPECT_EQ(kConn1, delivered_[2].conn_id);
+}
+
+TEST_F(BtifGattNotifyBatcherTest, late_delivery_finds_nothing) {
+  Notify(kConn1, 1);
+  Event("mtu");
+  loop_.RunFor(kLatencyMs);
+
+  // The delayed delivery of the flushed batch found it gone
+  EXPECT_EQ(2u, delivers_);
+  EXPECT_EQ(1u, delivered_.size());
+}
@@ -29,6 +29,8 @@
 #include "btcore/include/version.h"
 #include "hcimsgs.h"
 #include "osi/include/future.h"
+#include "osi/include/log.h"
+#include "osi/include/time.h"
 #include "stack/include/btm_ble_api.h"
 
 const bt_event_mask_t BLE_EVENT_MASK = {
@@ -81,50 +83,83 @@ static bool ble_supported;
 static bool simple_pairing_supported;
 static bool secure_connections_supported;
 
-#define AWAIT_COMMAND(command) \
-  static_cast<BT_HDR*>(future_await(hci->transmit_command_futured(command)))
+#define SEND_COMMAND(command) hci->transmit_command_futured(command)
+
+#define AWAIT_RESPONSE(future) static_cast<BT_HDR*>(future_await(future))
+
+#define AWAIT_COMMAND(command) AWAIT_RESPONSE(SEND_COMMAND(command))
+
+// Start up is split into stages. Only the commands a stage needs the answers
+// of earlier stages for have to wait; everything inside a stage is handed to
+// the HCI layer at once, which releases the commands as the controller hands
+// out credits. Responses are still parsed in the order the commands were
+// sent, so the resulting state is the same as for one command at a time.
+enum {
+  STAGE_RESET,
+  STAGE_LOCAL_INFO,
+  STAGE_HOST_SUPPORT,
+  STAGE_FEATURE_PAGES,
+  STAGE_CONFIGURE,
+  STAGE_LE_EXTENSIONS,
+  STAGE_COUNT
+};
+
+static const char* const stage_names[STAGE_COUNT] = {
+    "reset", "local info", "host support", "feature pages", "configure",
+    "le extensions"};
 
 // Module lifecycle functions
 
 static future_t* start_up(void) {
   BT_HDR* response;
+  uint32_t stage_ms[STAGE_COUNT] = {0};
+  uint32_t start_ms = time_get_os_boottime_ms();
+  uint32_t stage_start_ms = start_ms;
 
-  // Send the initial reset command
+  // Send the initial reset command, nothing else may go out before it is done
   response = AWAIT_COMMAND(packet_factory->make_reset());
   packet_parser->parse_generic_command_complete(response);
 
-  // Request the classic buffer size next
-  response = AWAIT_COMMAND(packet_factory->make_read_buffer_size());
-  packet_parser->parse_read_buffer_size_response(
-      response, &acl_data_size_classic, &acl_buffer_count_classic);
+  stage_ms[STAGE_RESET] = time_get_os_boottime_ms() - stage_start_ms;
+  stage_start_ms = time_get_os_boottime_ms();
 
-  // Tell the controller about our buffer sizes and buffer counts next
+  // Ask for the classic buffer size, the local version info, the bluetooth
+  // address, the supported commands and page 0 of the controller features,
+  // and tell the controller about our buffer sizes and buffer counts.
   // TODO(zachoverflow): factor this out. eww l2cap contamination. And why just
   // a hardcoded 10?
-  response = AWAIT_COMMAND(packet_factory->make_host_buffer_size(
-      L2CAP_MTU_SIZE, SCO_HOST_BUFFER_SIZE, L2CAP_HOST_FC_ACL_BUFS, 10));
+  future_t* read_buffer_size =
+      SEND_COMMAND(packet_factory->make_read_buffer_size());
+  future_t* host_buffer_size =
+      SEND_COMMAND(packet_factory->make_host_buffer_size(
+          L2CAP_MTU_SIZE, SCO_HOST_BUFFER_SIZE, L2CAP_HOST_FC_ACL_BUFS, 10));
+  future_t* read_version =
+      SEND_COMMAND(packet_factory->make_read_local_version_info());
+  future_t* read_address = SEND_COMMAND(packet_factory->make_read_bd_addr());
+  future_t* read_commands =
+      SEND_COMMAND(packet_factory->make_read_local_supported_commands());
+  future_t* read_features_page_0 =
+      SEND_COMMAND(packet_factory->make_read_local_extended_features(0));
+
+  response = AWAIT_RESPONSE(read_buffer_size);
+  packet_parser->parse_read_buffer_size_response(
+      response, &acl_data_size_classic, &acl_buffer_count_classic);
 
+  response = AWAIT_RESPONSE(host_buffer_size);
   packet_parser->parse_generic_command_complete(response);
 
-  // Read the local version info off the controller next, including
-  // information such as manufacturer and supported HCI version
-  response = AWAIT_COMMAND(packet_factory->make_read_local_version_info());
+  response = AWAIT_RESPONSE(read_version);
   packet_parser->parse_read_local_version_info_response(response, &bt_version);
 
-  // Read the bluetooth address off the controller next
-  response = AWAIT_COMMAND(packet_factory->make_read_bd_addr());
+  response = AWAIT_RESPONSE(read_address);
   packet_parser->parse_read_bd_addr_response(response, &address);
 
-  // Request the controller's supported commands next
-  response =
-      AWAIT_COMMAND(packet_factory->make_read_local_supported_commands());
+  response = AWAIT_RESPONSE(read_commands);
   packet_parser->parse_read_local_supported_commands_response(
       response, supported_commands, HCI_SUPPORTED_COMMANDS_ARRAY_SIZE);
 
-  // Read page 0 of the controller features next
   uint8_t page_number = 0;
-  response = AWAIT_COMMAND(
-      packet_factory->make_read_local_extended_features(page_number));
+  response = AWAIT_RESPONSE(read_features_page_0);
   packet_parser->parse_read_local_extended_features_response(
       response, &page_number, &last_features_classic_page_index,
       features_classic, MAX_FEATURES_CLASSIC_PAGE_COUNT);
@@ -132,16 +167,21 @@ static future_t* start_up(void) {
   CHECK(page_number == 0);
   page_number++;
 
+  stage_ms[STAGE_LOCAL_INFO] = time_get_os_boottime_ms() - stage_start_ms;
+  stage_start_ms = time_get_os_boottime_ms();
+
   // Inform the controller what page 0 features we support, based on what
   // it told us it supports. We need to do this first before we request the
   // next page, because the controller's response for page 1 may be
   // dependent on what we configure from page 0
+  future_t* write_simple_pairing = NULL;
+  future_t* write_le_host_support = NULL;
+
   simple_pairing_supported =
       HCI_SIMPLE_PAIRING_SUPPORTED(features_classic[0].as_array);
   if (simple_pairing_supported) {
-    response = AWAIT_COMMAND(
+    write_simple_pairing = SEND_COMMAND(
         packet_factory->make_write_simple_pairing_mode(HCI_SP_MODE_ENABLED));
-    packet_parser->parse_generic_command_complete(response);
   }
 
   if (HCI_LE_SPT_SUPPORTED(features_classic[0].as_array)) {
@@ -149,9 +189,18 @@ static future_t* start_up(void) {
         HCI_SIMUL_LE_BREDR_SUPPORTED(features_classic[0].as_array)
             ? BTM_BLE_SIMULTANEOUS_HOST
             : 0;
-    response = AWAIT_COMMAND(packet_factory->make_ble_write_host_support(
-        BTM_BLE_HOST_SUPPORT, simultaneous_le_host));
+    write_le_host_support = SEND_COMMAND(
+        packet_factory->make_ble_write_host_support(BTM_BLE_HOST_SUPPORT,
+                                                    simultaneous_le_host));
+  }
+
+  if (write_simple_pairing) {
+    response = AWAIT_RESPONSE(write_simple_pairing);
+    packet_parser->parse_generic_command_complete(response);
+  }
 
+  if (write_le_host_support) {
+    response = AWAIT_RESPONSE(write_le_host_support);
     packet_parser->parse_generic_command_complete(response);
 
     // If we modified the BT_HOST_SUPPORT, we will need ext. feat. page 1
@@ -159,8 +208,29 @@ static future_t* start_up(void) {
       last_features_classic_page_index = 1;
   }
 
+  stage_ms[STAGE_HOST_SUPPORT] = time_get_os_boottime_ms() - stage_start_ms;
+  stage_start_ms = time_get_os_boottime_ms();
+
   // Done telling the controller about what page 0 features we support
-  // Request the remaining feature pages
+  // Request the remaining feature pages page 0 told us about in one go
+  future_t* read_features_pages[MAX_FEATURES_CLASSIC_PAGE_COUNT] = {NULL};
+  uint8_t first_page = page_number;
+  while (page_number <= last_features_classic_page_index &&
+         page_number < MAX_FEATURES_CLASSIC_PAGE_COUNT) {
+    read_features_pages[page_number] = SEND_COMMAND(
+        packet_factory->make_read_local_extended_features(page_number));
+    page_number++;
+  }
+
+  for (uint8_t i = first_page; i < page_number; i++) {
+    uint8_t response_page_number;
+    response = AWAIT_RESPONSE(read_features_pages[i]);
+    packet_parser->parse_read_local_extended_features_response(
+        response, &response_page_number, &last_features_classic_page_index,
+        features_classic, MAX_FEATURES_CLASSIC_PAGE_COUNT);
+  }
+
+  // A later page may report more pages than page 0 did, fetch those one by one
   while (page_number <= last_features_classic_page_index &&
          page_number < MAX_FEATURES_CLASSIC_PAGE_COUNT) {
     response = AWAIT_COMMAND(
@@ -172,103 +242,168 @@ static future_t* start_up(void) {
     page_number++;
   }
 
+  stage_ms[STAGE_FEATURE_PAGES] = time_get_os_boottime_ms() - stage_start_ms;
+  stage_start_ms = time_get_os_boottime_ms();
+
+  // With all feature pages known, send everything that only depends on them
+  future_t* write_secure_connections = NULL;
+  future_t* read_white_list_size = NULL;
+  future_t* read_ble_buffer_size = NULL;
+  future_t* read_ble_supported_states = NULL;
+  future_t* read_ble_features = NULL;
+  future_t* set_ble_event_mask = NULL;
+  future_t* set_event_mask = NULL;
+  future_t* read_codecs = NULL;
+
 #if (SC_MODE_INCLUDED == TRUE)
   secure_connections_supported =
       HCI_SC_CTRLR_SUPPORTED(features_classic[2].as_array);
   if (secure_connections_supported) {
-    response = AWAIT_COMMAND(
-        packet_factory->make_write_secure_connections_host_support(
+    write_secure_connections =
+        SEND_COMMAND(packet_factory->make_write_secure_connections_host_support(
             HCI_SC_MODE_ENABLED));
-    packet_parser->parse_generic_command_complete(response);
   }
 #endif
 
   ble_supported = last_features_classic_page_index >= 1 &&
                   HCI_LE_HOST_SUPPORTED(features_classic[1].as_array);
   if (ble_supported) {
-    // Request the ble white list size next
-    response = AWAIT_COMMAND(packet_factory->make_ble_read_white_list_size());
+    read_white_list_size =
+        SEND_COMMAND(packet_factory->make_ble_read_white_list_size());
+    read_ble_buffer_size =
+        SEND_COMMAND(packet_factory->make_ble_read_buffer_size());
+    read_ble_supported_states =
+        SEND_COMMAND(packet_factory->make_ble_read_supported_states());
+    read_ble_features =
+        SEND_COMMAND(packet_factory->make_ble_read_local_supported_features());
+    set_ble_event_mask =
+        SEND_COMMAND(packet_factory->make_ble_set_event_mask(&BLE_EVENT_MASK));
+  }
+
+  if (simple_pairing_supported) {
+    set_event_mask =
+        SEND_COMMAND(packet_factory->make_set_event_mask(&CLASSIC_EVENT_MASK));
+  }
+
+  // read local supported codecs
+  if (HCI_READ_LOCAL_CODECS_SUPPORTED(supported_commands)) {
+    read_codecs =
+        SEND_COMMAND(packet_factory->make_read_local_supported_codecs());
+  }
+
+  if (write_secure_connections) {
+    response = AWAIT_RESPONSE(write_secure_connections);
+    packet_parser->parse_generic_command_complete(response);
+  }
+
+  if (ble_supported) {
+    response = AWAIT_RESPONSE(read_white_list_size);
     packet_parser->parse_ble_read_white_list_size_response(
         response, &ble_white_list_size);
 
-    // Request the ble buffer size next
-    response = AWAIT_COMMAND(packet_factory->make_ble_read_buffer_size());
+    response = AWAIT_RESPONSE(read_ble_buffer_size);
     packet_parser->parse_ble_read_buffer_size_response(
         response, &acl_data_size_ble, &acl_buffer_count_ble);
 
     // Response of 0 indicates ble has the same buffer size as classic
     if (acl_data_size_ble == 0) acl_data_size_ble = acl_data_size_classic;
 
-    // Request the ble supported states next
-    response = AWAIT_COMMAND(packet_factory->make_ble_read_supported_states());
+    response = AWAIT_RESPONSE(read_ble_supported_states);
     packet_parser->parse_ble_read_supported_states_response(
         response, ble_supported_states, sizeof(ble_supported_states));
 
-    // Request the ble supported features next
-    response =
-        AWAIT_COMMAND(packet_factory->make_ble_read_local_supported_features());
+    response = AWAIT_RESPONSE(read_ble_features);
     packet_parser->parse_ble_read_local_supported_features_response(
         response, &features_ble);
 
+    response = AWAIT_RESPONSE(set_ble_event_mask);
+    packet_parser->parse_generic_command_complete(response);
+  }
+
+  if (set_event_mask) {
+    response = AWAIT_RESPONSE(set_event_mask);
+    packet_parser->parse_generic_command_complete(response);
+  }
+
+  if (read_codecs) {
+    response = AWAIT_RESPONSE(read_codecs);
+    packet_parser->parse_read_local_supported_codecs_response(
+        response, &number_of_local_supported_codecs, local_supported_codecs);
+  }
+
+  stage_ms[STAGE_CONFIGURE] = time_get_os_boottime_ms() - stage_start_ms;
+  stage_start_ms = time_get_os_boottime_ms();
+
+  // Finally read what the LE features page says the controller can tell us
+  if (ble_supported) {
+    future_t* read_resolving_list_size = NULL;
+    future_t* read_maximum_data_length = NULL;
+    future_t* read_suggested_data_length = NULL;
+    future_t* read_advertising_data_length = NULL;
+    future_t* read_advertising_sets = NULL;
+
     if (HCI_LE_ENHANCED_PRIVACY_SUPPORTED(features_ble.as_array)) {
-      response =
-          AWAIT_COMMAND(packet_factory->make_ble_read_resolving_list_size());
+      read_resolving_list_size =
+          SEND_COMMAND(packet_factory->make_ble_read_resolving_list_size());
+    }
+
+    if (HCI_LE_DATA_LEN_EXT_SUPPORTED(features_ble.as_array)) {
+      read_maximum_data_length =
+          SEND_COMMAND(packet_factory->make_ble_read_maximum_data_length());
+      read_suggested_data_length = SEND_COMMAND(
+          packet_factory->make_ble_read_suggested_default_data_length());
+    }
+
+    if (HCI_LE_EXTENDED_ADVERTISING_SUPPORTED(features_ble.as_array)) {
+      read_advertising_data_length = SEND_COMMAND(
+          packet_factory->make_ble_read_maximum_advertising_data_length());
+      read_advertising_sets = SEND_COMMAND(
+          packet_factory->make_ble_read_number_of_supported_advertising_sets());
+    } else {
+      /* If LE Excended Advertising is not supported, use the default value */
+      ble_maxium_advertising_data_length = 31;
+    }
+
+    if (read_resolving_list_size) {
+      response = AWAIT_RESPONSE(read_resolving_list_size);
       packet_parser->parse_ble_read_resolving_list_size_response(
           response, &ble_resolving_list_max_size);
     }
 
-    if (HCI_LE_DATA_LEN_EXT_SUPPORTED(features_ble.as_array)) {
-      response =
-          AWAIT_COMMAND(packet_factory->make_ble_read_maximum_data_length());
+    if (read_maximum_data_length) {
+      response = AWAIT_RESPONSE(read_maximum_data_length);
       packet_parser->parse_ble_read_maximum_data_length_response(
           response, &ble_supported_max_tx_octets, &ble_supported_max_tx_time,
           &ble_supported_max_rx_octets, &ble_supported_max_rx_time);
 
-      response = AWAIT_COMMAND(
-          packet_factory->make_ble_read_suggested_default_data_length());
+      response = AWAIT_RESPONSE(read_suggested_data_length);
       packet_parser->parse_ble_read_suggested_default_data_length_response(
           response, &ble_suggested_default_data_length);
     }
 
-    if (HCI_LE_EXTENDED_ADVERTISING_SUPPORTED(features_ble.as_array)) {
-      response = AWAIT_COMMAND(
-          packet_factory->make_ble_read_maximum_advertising_data_length());
+    if (read_advertising_data_length) {
+      response = AWAIT_RESPONSE(read_advertising_data_length);
       packet_parser->parse_ble_read_maximum_advertising_data_length(
           response, &ble_maxium_advertising_data_length);
 
-      response = AWAIT_COMMAND(
-          packet_factory->make_ble_read_number_of_supported_advertising_sets());
+      response = AWAIT_RESPONSE(read_advertising_sets);
       packet_parser->parse_ble_read_number_of_supported_advertising_sets(
           response, &ble_number_of_supported_advertising_sets);
-    } else {
-      /* If LE Excended Advertising is not supported, use the default value */
-      ble_maxium_advertising_data_length = 31;
     }
-
-    // Set the ble event mask next
-    response =
-        AWAIT_COMMAND(packet_factory->make_ble_set_event_mask(&BLE_EVENT_MASK));
-    packet_parser->parse_generic_command_complete(response);
   }
 
-  if (simple_pairing_supported) {
-    response =
-        AWAIT_COMMAND(packet_factory->make_set_event_mask(&CLASSIC_EVENT_MASK));
-    packet_parser->parse_generic_command_complete(response);
-  }
-
-  // read local supported codecs
-  if (HCI_READ_LOCAL_CODECS_SUPPORTED(supported_commands)) {
-    response =
-        AWAIT_COMMAND(packet_factory->make_read_local_supported_codecs());
-    packet_parser->parse_read_local_supported_codecs_response(
-        response, &number_of_local_supported_codecs, local_supported_codecs);
-  }
+  stage_ms[STAGE_LE_EXTENSIONS] = time_get_os_boottime_ms() - stage_start_ms;
 
   if (!HCI_READ_ENCR_KEY_SIZE_SUPPORTED(supported_commands)) {
     LOG(FATAL) << " Controller must support Read Encryption Key Size command";
   }
 
+  LOG_INFO(LOG_TAG, "%s controller ready in %u ms", __func__,
+           time_get_os_boottime_ms() - start_ms);
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    LOG_INFO(LOG_TAG, "%s   %s: %u ms", __func__, stage_names[i], stage_ms[i]);
+  }
+
   readable = true;
   return future_new_immediate(FUTURE_SUCCESS);
 }
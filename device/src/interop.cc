@@ -21,6 +21,9 @@
 #include <base/logging.h>
 #include <string.h>  // For memcmp
 
+#include <map>
+#include <mutex>
+
 #include "btcore/include/module.h"
 #include "device/include/interop.h"
 #include "device/include/interop_database.h"
@@ -32,15 +35,31 @@
   case const:                  \
     return #const;
 
+// Upper bound on the number of peers whose verdicts are kept around
+#define INTEROP_CACHE_MAX_SIZE 64
+
+#define INTEROP_FEATURE_MASK(feature) (1u << (feature))
+
+static_assert(INTEROP_DISABLE_ROLE_SWITCH < 32,
+              "interop features must fit in the per peer feature mask");
+
 static list_t* interop_list = NULL;
 
+// Features each recently looked up peer matches, so the databases only get
+// scanned the first time a peer is seen. Dropped whenever the dynamic
+// database changes.
+static std::map<RawAddress, uint32_t> interop_cache;
+
+// Guards |interop_list| and |interop_cache|, lookups come from several
+// threads.
+static std::mutex interop_mutex;
+
 static const char* interop_feature_string_(const interop_feature_t feature);
 static void interop_free_entry_(void* data);
 static void interop_lazy_init_(void);
-static bool interop_match_fixed_(const interop_feature_t feature,
-                                 const RawAddress* addr);
-static bool interop_match_dynamic_(const interop_feature_t feature,
-                                   const RawAddress* addr);
+static uint32_t interop_lookup_(const RawAddress* addr);
+static uint32_t interop_match_fixed_(const RawAddress* addr);
+static uint32_t interop_match_dynamic_(const RawAddress* addr);
 
 // Interface functions
 
@@ -48,25 +67,19 @@ bool interop_match_addr(const interop_feature_t feature,
                         const RawAddress* addr) {
   CHECK(addr);
 
-  if (interop_match_fixed_(feature, addr) ||
-      interop_match_dynamic_(feature, addr)) {
-    LOG_WARN(LOG_TAG, "%s() Device %s is a match for interop workaround %s.",
-             __func__, addr->ToString().c_str(),
-             interop_feature_string_(feature));
-    return true;
-  }
-
-  return false;
+  std::lock_guard<std::mutex> lock(interop_mutex);
+  return (interop_lookup_(addr) & INTEROP_FEATURE_MASK(feature)) != 0;
 }
 
 bool interop_match_name(const interop_feature_t feature, const char* name) {
   CHECK(name);
 
+  const size_t name_length = strlen(name);
   const size_t db_size =
       sizeof(interop_name_database) / sizeof(interop_name_entry_t);
   for (size_t i = 0; i != db_size; ++i) {
     if (feature == interop_name_database[i].feature &&
-        strlen(name) >= interop_name_database[i].length &&
+        name_length >= interop_name_database[i].length &&
         strncmp(name, interop_name_database[i].name,
                 interop_name_database[i].length) == 0) {
       return true;
@@ -88,19 +101,25 @@ void interop_database_add(uint16_t feature, const RawAddress* addr,
   entry->feature = static_cast<interop_feature_t>(feature);
   entry->length = length;
 
+  std::lock_guard<std::mutex> lock(interop_mutex);
   interop_lazy_init_();
   list_append(interop_list, entry);
+  interop_cache.clear();
 }
 
 void interop_database_clear() {
+  std::lock_guard<std::mutex> lock(interop_mutex);
   if (interop_list) list_clear(interop_list);
+  interop_cache.clear();
 }
 
 // Module life-cycle functions
 
 static future_t* interop_clean_up(void) {
+  std::lock_guard<std::mutex> lock(interop_mutex);
   list_free(interop_list);
   interop_list = NULL;
+  interop_cache.clear();
   return future_new_immediate(FUTURE_SUCCESS);
 }
 
@@ -144,38 +163,57 @@ static void interop_lazy_init_(void) {
   }
 }
 
-static bool interop_match_dynamic_(const interop_feature_t feature,
-                                   const RawAddress* addr) {
-  if (interop_list == NULL || list_length(interop_list) == 0) return false;
+// Returns the features |addr| matches, from the cache if it's been looked up
+// before. Must be called with |interop_mutex| held.
+static uint32_t interop_lookup_(const RawAddress* addr) {
+  const auto& it = interop_cache.find(*addr);
+  if (it != interop_cache.end()) return it->second;
+
+  uint32_t features = interop_match_fixed_(addr) | interop_match_dynamic_(addr);
+  for (uint32_t feature = 0; feature < 32; feature++) {
+    if (features & INTEROP_FEATURE_MASK(feature)) {
+      LOG_WARN(LOG_TAG, "%s() Device %s is a match for interop workaround %s.",
+               __func__, addr->ToString().c_str(),
+               interop_feature_string_((interop_feature_t)feature));
+    }
+  }
+
+  if (interop_cache.size() >= INTEROP_CACHE_MAX_SIZE) interop_cache.clear();
+  interop_cache[*addr] = features;
+  return features;
+}
+
+static uint32_t interop_match_dynamic_(const RawAddress* addr) {
+  if (interop_list == NULL || list_length(interop_list) == 0) return 0;
 
+  uint32_t features = 0;
   const list_node_t* node = list_begin(interop_list);
   while (node != list_end(interop_list)) {
     interop_addr_entry_t* entry =
         static_cast<interop_addr_entry_t*>(list_node(node));
     CHECK(entry);
 
-    if (feature == entry->feature &&
-        memcmp(addr, &entry->addr, entry->length) == 0)
-      return true;
+    // Entries for features this build doesn't know can never match
+    if (entry->feature < 32 && memcmp(addr, &entry->addr, entry->length) == 0)
+      features |= INTEROP_FEATURE_MASK(entry->feature);
 
     node = list_next(node);
   }
-  return false;
+  return features;
 }
 
-static bool interop_match_fixed_(const interop_feature_t feature,
-                                 const RawAddress* addr) {
+static uint32_t interop_match_fixed_(const RawAddress* addr) {
   CHECK(addr);
 
+  uint32_t features = 0;
   const size_t db_size =
       sizeof(interop_addr_database) / sizeof(interop_addr_entry_t);
   for (size_t i = 0; i != db_size; ++i) {
-    if (feature == interop_addr_database[i].feature &&
-        memcmp(addr, &interop_addr_database[i].addr,
+    if (memcmp(addr, &interop_addr_database[i].addr,
                interop_addr_database[i].length) == 0) {
-      return true;
+      features |= INTEROP_FEATURE_MASK(interop_addr_database[i].feature);
     }
   }
 
-  return false;
+  return features;
 }
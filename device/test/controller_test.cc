@@ -0,0 +1,407 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "btcore/include/module.h"
+#include "device/include/controller.h"
+#include "hci_internals.h"
+#include "hci_layer.h"
+#include "hci_packet_factory.h"
+#include "hci_packet_parser.h"
+#include "hcidefs.h"
+#include "osi/include/allocator.h"
+#include "osi/include/future.h"
+#include "osi/include/osi.h"
+#include "stack/include/bt_types.h"
+
+extern const module_t controller_module;
+
+namespace {
+
+// How long the fake controller waits for more commands before it answers the
+// ones it has, so that commands sent back to back are seen together.
+constexpr std::chrono::milliseconds kQuietPeriod(20);
+
+// What the fake controller reports about itself
+const RawAddress kAddress = {{0xbb, 0xbb, 0xbb, 0xba, 0xd0, 0x01}};
+constexpr uint8_t kHciVersion = HCI_PROTO_VERSION_5_0;
+constexpr uint16_t kHciRevision = 0x0102;
+constexpr uint8_t kLmpVersion = HCI_PROTO_VERSION_5_0;
+constexpr uint16_t kManufacturer = 0x00e0;
+constexpr uint16_t kLmpSubversion = 0x0304;
+constexpr uint16_t kAclDataSize = 1021;
+constexpr uint16_t kAclBufferCount = 8;
+constexpr uint16_t kLeDataSize = 251;
+constexpr uint8_t kLeBufferCount = 4;
+constexpr uint8_t kWhiteListSize = 16;
+constexpr uint8_t kResolvingListSize = 12;
+constexpr uint16_t kMaxDataLength = 251;
+constexpr uint16_t kDefaultDataLength = 27;
+constexpr uint16_t kMaxAdvertisingDataLength = 1650;
+constexpr uint8_t kAdvertisingSets = 10;
+constexpr uint64_t kLeSupportedStates = 0x000003ffffffffffULL;
+const std::vector<uint8_t> kCodecs = {0x00, 0x02};
+
+// Simple pairing, LE and simultaneous LE / BR/EDR on page 0, secure
+// connections on page 2. Page 1 only reports the host features written.
+constexpr uint8_t kMaxFeaturesPage = 2;
+constexpr uint64_t kFeaturesPage0 = (0x40ULL << (8 * 4)) | (0x0aULL << (8 * 6));
+constexpr uint64_t kFeaturesPage2 = 0x01ULL << (8 * 1);
+// Enhanced privacy, data length extension and extended advertising
+constexpr uint64_t kLeFeatures = 0x60ULL | (0x10ULL << 8);
+
+// Answers the commands controller start up sends the way a controller with
+// the properties above would, tracking the host support written to it.
+class FakeController {
+ public:
+  // Returns the Command Complete event for |command|
+  BT_HDR* Execute(const BT_HDR* command) {
+    const uint8_t* stream = command->data + command->offset;
+    uint16_t opcode = stream[0] | (stream[1] << 8);
+    const uint8_t* params = stream + HCI_COMMAND_PREAMBLE_SIZE;
+
+    std::vector<uint8_t> result = {HCI_SUCCESS};
+    switch (opcode) {
+      case HCI_WRITE_SIMPLE_PAIRING_MODE:
+        ssp_host_support_ = params[0] == HCI_SP_MODE_ENABLED;
+        break;
+      case HCI_WRITE_LE_HOST_SUPPORT:
+        le_host_support_ = params[0] != 0;
+        break;
+      case HCI_READ_BUFFER_SIZE:
+        Append16(&result, kAclDataSize);
+        result.push_back(64);  // SCO data size
+        Append16(&result, kAclBufferCount);
+        Append16(&result, 8);  // SCO buffer count
+        break;
+      case HCI_READ_LOCAL_VERSION_INFO:
+        result.push_back(kHciVersion);
+        Append16(&result, kHciRevision);
+        result.push_back(kLmpVersion);
+        Append16(&result, kManufacturer);
+        Append16(&result, kLmpSubversion);
+        break;
+      case HCI_READ_BD_ADDR:
+        for (int i = RawAddress::kLength - 1; i >= 0; i--)
+          result.push_back(kAddress.address[i]);
+        break;
+      case HCI_READ_LOCAL_SUPPORTED_CMDS: {
+        std::vector<uint8_t> commands(64, 0);
+        commands[20] |= 0x10;  // Read Encryption Key Size
+        commands[29] |= 0x20;  // Read Local Supported Codecs
+        result.insert(result.end(), commands.begin(), commands.end());
+        break;
+      }
+      case HCI_READ_LOCAL_EXT_FEATURES:
+        result.push_back(params[0]);
+        result.push_back(kMaxFeaturesPage);
+        Append64(&result, FeaturesPage(params[0]));
+        break;
+      case HCI_BLE_READ_WHITE_LIST_SIZE:
+        result.push_back(kWhiteListSize);
+        break;
+      case HCI_BLE_READ_BUFFER_SIZE:
+        Append16(&result, kLeDataSize);
+        result.push_back(kLeBufferCount);
+        break;
+      case HCI_BLE_READ_SUPPORTED_STATES:
+        Append64(&result, kLeSupportedStates);
+        break;
+      case HCI_BLE_READ_LOCAL_SPT_FEAT:
+        Append64(&result, kLeFeatures);
+        break;
+      case HCI_READ_LOCAL_SUPPORTED_CODECS:
+        result.push_back(kCodecs.size());
+        result.insert(result.end(), kCodecs.begin(), kCodecs.end());
+        result.push_back(0);  // vendor specific codecs
+        break;
+      case HCI_BLE_READ_RESOLVING_LIST_SIZE:
+        result.push_back(kResolvingListSize);
+        break;
+      case HCI_BLE_READ_MAXIMUM_DATA_LENGTH:
+        for (int i = 0; i < 2; i++) {
+          Append16(&result, kMaxDataLength);
+          Append16(&result, 2120);  // time
+        }
+        break;
+      case HCI_BLE_READ_DEFAULT_DATA_LENGTH:
+        Append16(&result, kDefaultDataLength);
+        Append16(&result, 328);  // time
+        break;
+      case HCI_LE_READ_MAXIMUM_ADVERTISING_DATA_LENGTH:
+        Append16(&result, kMaxAdvertisingDataLength);
+        break;
+      case HCI_LE_READ_NUMBER_OF_SUPPORTED_ADVERTISING_SETS:
+        result.push_back(kAdvertisingSets);
+        break;
+      default:
+        // Reset, buffer sizes, event masks and secure connections support
+        break;
+    }
+
+    BT_HDR* event =
+        static_cast<BT_HDR*>(osi_calloc(sizeof(BT_HDR) + 5 + result.size()));
+    event->event = MSG_HC_TO_STACK_HCI_EVT;
+    event->len = 5 + result.size();
+    uint8_t* p = event->data;
+    UINT8_TO_STREAM(p, HCI_COMMAND_COMPLETE_EVT);
+    UINT8_TO_STREAM(p, 3 + result.size());
+    UINT8_TO_STREAM(p, 1);  // command credits
+    UINT16_TO_STREAM(p, opcode);
+    ARRAY_TO_STREAM(p, result.data(), static_cast<int>(result.size()));
+    return event;
+  }
+
+  // The page 1 host features as last written, like a real controller reports
+  uint64_t FeaturesPage(uint8_t page) const {
+    switch (page) {
+      case 0:
+        return kFeaturesPage0;
+      case 1:
+        return (ssp_host_support_ ? 0x01 : 0) | (le_host_support_ ? 0x02 : 0);
+      case 2:
+        return kFeaturesPage2;
+      default:
+        return 0;
+    }
+  }
+
+ private:
+  static void Append16(std::vector<uint8_t>* v, uint16_t value) {
+    v->push_back(value & 0xff);
+    v->push_back(value >> 8);
+  }
+
+  static void Append64(std::vector<uint8_t>* v, uint64_t value) {
+    for (int i = 0; i < 8; i++) v->push_back(value >> (8 * i));
+  }
+
+  bool ssp_host_support_ = false;
+  bool le_host_support_ = false;
+};
+
+// Stands in for the HCI layer. Commands are answered by the fake controller
+// on a thread of their own, the way the real controller answers them
+// asynchronously.
+class FakeHci {
+ public:
+  FakeHci() { responder_ = std::thread(&FakeHci::Respond, this); }
+
+  ~FakeHci() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    cv_.notify_all();
+    responder_.join();
+  }
+
+  future_t* Transmit(BT_HDR* command) {
+    future_t* future = future_new();
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push({command, future});
+    opcodes_.push_back(GetOpcode(command));
+    max_in_flight_ = std::max(max_in_flight_, pending_.size());
+    cv_.notify_all();
+    return future;
+  }
+
+  const std::vector<uint16_t>& opcodes() const { return opcodes_; }
+  size_t max_in_flight() const { return max_in_flight_; }
+  size_t round_trips() const { return round_trips_; }
+  const FakeController& controller() const { return controller_; }
+
+ private:
+  struct Pending {
+    BT_HDR* command;
+    future_t* future;
+  };
+
+  static uint16_t GetOpcode(const BT_HDR* command) {
+    const uint8_t* stream = command->data + command->offset;
+    return stream[0] | (stream[1] << 8);
+  }
+
+  void Respond() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!done_) {
+      if (pending_.empty()) {
+        cv_.wait(lock);
+        continue;
+      }
+
+      size_t seen = pending_.size();
+      if (cv_.wait_for(lock, kQuietPeriod, [this, seen] {
+            return done_ || pending_.size() != seen;
+          }))
+        continue;
+
+      round_trips_++;
+      while (!pending_.empty()) {
+        Pending pending = pending_.front();
+        pending_.pop();
+        BT_HDR* event = controller_.Execute(pending.command);
+        osi_free(pending.command);
+        future_ready(pending.future, event);
+      }
+    }
+  }
+
+  FakeController controller_;
+
+  std::thread responder_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::queue<Pending> pending_;
+  bool done_ = false;
+
+  std::vector<uint16_t> opcodes_;
+  size_t max_in_flight_ = 0;
+  size_t round_trips_ = 0;
+};
+
+FakeHci* fake_hci;
+
+future_t* transmit_command_futured(BT_HDR* command) {
+  return fake_hci->Transmit(command);
+}
+
+const hci_t hci_interface = {
+    .set_data_cb = NULL,
+    .transmit_command = NULL,
+    .transmit_command_futured = transmit_command_futured,
+    .transmit_downward = NULL,
+};
+
+class ControllerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    fake_hci = new FakeHci();
+    controller_ = controller_get_test_interface(
+        &hci_interface, hci_packet_factory_get_interface(),
+        hci_packet_parser_get_interface());
+  }
+
+  void TearDown() override {
+    future_await(controller_module.shut_down());
+    delete fake_hci;
+    fake_hci = NULL;
+  }
+
+  static bool PageEquals(const bt_device_features_t* page, uint64_t features) {
+    for (size_t i = 0; i < sizeof(page->as_array); i++) {
+      if (page->as_array[i] != static_cast<uint8_t>(features >> (8 * i)))
+        return false;
+    }
+    return true;
+  }
+
+  const controller_t* controller_;
+};
+
+TEST_F(ControllerTest, start_up_reaches_controller_state) {
+  EXPECT_EQ(FUTURE_SUCCESS, future_await(controller_module.start_up()));
+  ASSERT_TRUE(controller_->get_is_ready());
+
+  EXPECT_EQ(kAddress, *controller_->get_address());
+
+  const bt_version_t* version = controller_->get_bt_version();
+  EXPECT_EQ(kHciVersion, version->hci_version);
+  EXPECT_EQ(kHciRevision, version->hci_revision);
+  EXPECT_EQ(kLmpVersion, version->lmp_version);
+  EXPECT_EQ(kManufacturer, version->manufacturer);
+  EXPECT_EQ(kLmpSubversion, version->lmp_subversion);
+
+  EXPECT_EQ(kAclDataSize, controller_->get_acl_data_size_classic());
+  EXPECT_EQ(kAclBufferCount, controller_->get_acl_buffer_count_classic());
+
+  EXPECT_EQ(kMaxFeaturesPage, controller_->get_last_features_classic_index());
+  for (int page = 0; page <= kMaxFeaturesPage; page++) {
+    EXPECT_TRUE(PageEquals(controller_->get_features_classic(page),
+                           fake_hci->controller().FeaturesPage(page)))
+        << "page " << page;
+  }
+  EXPECT_TRUE(controller_->supports_simple_pairing());
+  EXPECT_TRUE(controller_->supports_simultaneous_le_bredr());
+
+  ASSERT_TRUE(controller_->supports_ble());
+  EXPECT_EQ(kLeDataSize, controller_->get_acl_data_size_ble());
+  EXPECT_EQ(kLeBufferCount, controller_->get_acl_buffer_count_ble());
+  EXPECT_EQ(kWhiteListSize, controller_->get_ble_white_list_size());
+  EXPECT_TRUE(PageEquals(controller_->get_features_ble(), kLeFeatures));
+  const uint8_t* states = controller_->get_ble_supported_states();
+  for (size_t i = 0; i < 8; i++) {
+    EXPECT_EQ(static_cast<uint8_t>(kLeSupportedStates >> (8 * i)), states[i]);
+  }
+
+  EXPECT_EQ(kResolvingListSize,
+            controller_->get_ble_resolving_list_max_size());
+  EXPECT_EQ(kMaxDataLength, controller_->get_ble_maximum_tx_data_length());
+  EXPECT_EQ(kDefaultDataLength,
+            controller_->get_ble_default_data_packet_length());
+  EXPECT_EQ(kMaxAdvertisingDataLength,
+            controller_->get_ble_maxium_advertising_data_length());
+  EXPECT_EQ(kAdvertisingSets,
+            controller_->get_ble_number_of_supported_advertising_sets());
+
+  uint8_t number_of_codecs = 0;
+  const uint8_t* codecs =
+      controller_->get_local_supported_codecs(&number_of_codecs);
+  ASSERT_EQ(kCodecs.size(), number_of_codecs);
+  EXPECT_EQ(kCodecs, std::vector<uint8_t>(codecs, codecs + number_of_codecs));
+}
+
+TEST_F(ControllerTest, start_up_keeps_dependent_commands_ordered) {
+  EXPECT_EQ(FUTURE_SUCCESS, future_await(controller_module.start_up()));
+
+  const std::vector<uint16_t>& opcodes = fake_hci->opcodes();
+  ASSERT_FALSE(opcodes.empty());
+  EXPECT_EQ(HCI_RESET, opcodes.front());
+
+  auto position = [&opcodes](uint16_t opcode, size_t nth) {
+    for (size_t i = 0; i < opcodes.size(); i++) {
+      if (opcodes[i] == opcode && nth-- == 0) return i;
+    }
+    return opcodes.size();
+  };
+
+  // Page 1 must only be read once the host support has been written
+  size_t page_1 = position(HCI_READ_LOCAL_EXT_FEATURES, 1);
+  ASSERT_LT(page_1, opcodes.size());
+  EXPECT_LT(position(HCI_WRITE_SIMPLE_PAIRING_MODE, 0), page_1);
+  EXPECT_LT(position(HCI_WRITE_LE_HOST_SUPPORT, 0), page_1);
+  EXPECT_LT(page_1, position(HCI_BLE_READ_LOCAL_SPT_FEAT, 0));
+}
+
+TEST_F(ControllerTest, start_up_pipelines_independent_commands) {
+  EXPECT_EQ(FUTURE_SUCCESS, future_await(controller_module.start_up()));
+
+  // Sent one at a time every command would be a round trip of its own
+  EXPECT_GT(fake_hci->max_in_flight(), 1u);
+  EXPECT_LT(fake_hci->round_trips(), fake_hci->opcodes().size() / 2);
+}
+
+}  // namespace
@@ -80,3 +80,28 @@ TEST(InteropTest, test_name_miss) {
   EXPECT_FALSE(interop_match_name(INTEROP_DISABLE_AUTO_PAIRING, "audi"));
   EXPECT_FALSE(interop_match_name(INTEROP_AUTO_RETRY_PAIRING, "BMW M3"));
 }
+
+TEST(InteropTest, test_dynamic_after_cached_lookup) {
+  RawAddress test_address;
+  RawAddress::FromString("38:2c:4a:e6:12:34", test_address);
+
+  // Cache the static verdicts for the device first
+  EXPECT_TRUE(
+      interop_match_addr(INTEROP_DISABLE_LE_SECURE_CONNECTIONS, &test_address));
+  EXPECT_TRUE(
+      interop_match_addr(INTEROP_HID_PREF_CONN_SUP_TIMEOUT_3S, &test_address));
+  EXPECT_FALSE(interop_match_addr(INTEROP_DISABLE_AVDTP_RECONFIGURE,
+                                  &test_address));
+
+  interop_database_add(INTEROP_DISABLE_AVDTP_RECONFIGURE, &test_address, 4);
+  EXPECT_TRUE(
+      interop_match_addr(INTEROP_DISABLE_AVDTP_RECONFIGURE, &test_address));
+  EXPECT_TRUE(
+      interop_match_addr(INTEROP_DISABLE_LE_SECURE_CONNECTIONS, &test_address));
+
+  interop_database_clear();
+  EXPECT_FALSE(interop_match_addr(INTEROP_DISABLE_AVDTP_RECONFIGURE,
+                                  &test_address));
+  EXPECT_TRUE(
+      interop_match_addr(INTEROP_HID_PREF_CONN_SUP_TIMEOUT_3S, &test_address));
+}
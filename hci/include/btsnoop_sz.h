@@ -0,0 +1,103 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Streaming compressed btsnoop capture ("btsnoopz").
+//
+// The file starts with a btsnoop_sz_file_header_t, followed by chunks. Each
+// chunk is a btsnoop_sz_chunk_header_t followed by |compressed_length| bytes
+// of an independent zlib stream. Decompressed, a chunk is a run of ordinary
+// btsnoop records (big endian record header + packet), so it can be appended
+// to a btsnoop file as-is.
+//
+// When the file is closed, an index with one btsnoop_sz_index_entry_t per
+// chunk is appended, followed by a btsnoop_sz_trailer_t. Readers locate the
+// index from the end of the file and seek straight to the chunks covering a
+// time range. A file without a trailer (e.g. after a crash) can still be read
+// by walking the chunk headers. All multi-byte fields are little endian,
+// except inside the compressed btsnoop records.
+
+#define BTSNOOP_SZ_FILE_MAGIC "btsnoopz"
+#define BTSNOOP_SZ_VERSION 1
+#define BTSNOOP_SZ_DATALINK_HCI_UART 1002
+#define BTSNOOP_SZ_CHUNK_MAGIC 0x43525a42  // "BZRC"
+#define BTSNOOP_SZ_INDEX_MAGIC 0x49525a42  // "BZRI"
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t datalink;
+} __attribute__((__packed__)) btsnoop_sz_file_header_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t compressed_length;
+  uint32_t uncompressed_length;
+  uint32_t packet_count;
+  uint64_t first_packet;  // index of the first packet in the file
+  uint64_t first_timestamp_us;
+  uint64_t last_timestamp_us;
+} __attribute__((__packed__)) btsnoop_sz_chunk_header_t;
+
+typedef struct {
+  uint64_t offset;  // file offset of the chunk header
+  uint64_t first_packet;
+  uint64_t first_timestamp_us;
+  uint64_t last_timestamp_us;
+  uint32_t packet_count;
+  uint32_t reserved;
+} __attribute__((__packed__)) btsnoop_sz_index_entry_t;
+
+typedef struct {
+  uint64_t index_offset;
+  uint32_t entry_count;
+  uint32_t magic;
+} __attribute__((__packed__)) btsnoop_sz_trailer_t;
+
+typedef struct btsnoop_sz_t btsnoop_sz_t;
+
+// Starts a compressed capture on |fd|, which must be empty and open for
+// writing. Records are buffered until |chunk_size| uncompressed bytes have
+// accumulated. Returns NULL if the file header cannot be written.
+btsnoop_sz_t* btsnoop_sz_open(int fd, size_t chunk_size);
+
+// Appends one btsnoop record, made of |iovcnt| buffers in |iov|, captured at
+// |timestamp_us| (microseconds since the Unix epoch).
+void btsnoop_sz_write(btsnoop_sz_t* sz, uint64_t timestamp_us,
+                      const struct iovec* iov, int iovcnt);
+
+// Compresses and writes out the records buffered so far as a chunk.
+void btsnoop_sz_flush(btsnoop_sz_t* sz);
+
+// Flushes the buffered records if the oldest of them was captured
+// |max_age_us| or longer before |now_us|, so that a quiet link doesn't keep
+// them out of the file indefinitely. Returns true if a chunk was written.
+bool btsnoop_sz_flush_if_older(btsnoop_sz_t* sz, uint64_t now_us,
+                               uint64_t max_age_us);
+
+// Returns the number of bytes written to the file so far.
+size_t btsnoop_sz_file_size(const btsnoop_sz_t* sz);
+
+// Flushes buffered records, writes the index and frees |sz|. The file
+// descriptor is left open.
+void btsnoop_sz_close(btsnoop_sz_t* sz);
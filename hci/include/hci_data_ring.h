@@ -0,0 +1,66 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Bounded multi-producer / single consumer ring the HCI layer queues outgoing
+// ACL and SCO packets on.
+//
+// Any thread may Push(). Only the packet that finds no drain pending gets
+// true from RequestDrain() and posts a drain task. The task calls BeginDrain()
+// before it starts popping, so a packet pushed after the drain has stopped
+// looking always requests another one.
+class HciDataRing {
+ public:
+  static constexpr size_t kSize = 1024;  // must be a power of two
+
+  HciDataRing();
+
+  // Returns false if the ring is full.
+  bool Push(void* packet);
+
+  // Like Push(), but waits up to |timeout_ms| for the consumer to make room.
+  bool PushWait(void* packet, uint64_t timeout_ms);
+
+  // Returns nullptr if there is nothing (more) to drain. Consumer only.
+  void* Pop();
+
+  // Returns true if the caller has to schedule a drain.
+  bool RequestDrain();
+
+  // Marks the requested drain as running. Consumer only.
+  void BeginDrain();
+
+ private:
+  struct Slot {
+    // 2 * lap while the slot is free for that lap, 2 * lap + 1 once the
+    // packet for that lap is in it. Starts at zero, free for the first lap.
+    std::atomic<uint64_t> turn;
+    void* packet;
+  };
+
+  Slot slots_[kSize];
+  std::atomic<uint64_t> head_;  // next position to fill
+  uint64_t tail_;               // next position to drain
+  std::atomic<bool> drain_pending_;
+};
@@ -18,6 +18,8 @@
 
 #define LOG_TAG "bt_snoop"
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 #include <arpa/inet.h>
@@ -26,10 +28,12 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/uio.h>
@@ -38,7 +42,9 @@
 #include "bt_types.h"
 #include "hci/include/btsnoop.h"
 #include "hci/include/btsnoop_mem.h"
+#include "hci/include/btsnoop_sz.h"
 #include "hci_layer.h"
+#include "osi/include/allocator.h"
 #include "osi/include/log.h"
 #include "osi/include/properties.h"
 #include "osi/include/time.h"
@@ -54,6 +60,30 @@
 #define BTSNOOP_PATH_PROPERTY "persist.bluetooth.btsnooppath"
 #define DEFAULT_BTSNOOP_PATH "/data/misc/bluetooth/logs/btsnoop_hci.log"
 #define BTSNOOP_MAX_PACKETS_PROPERTY "persist.bluetooth.btsnoopsize"
+#define BTSNOOP_ASYNC_PROPERTY "persist.bluetooth.btsnoopasync"
+
+// Compressed capture (see btsnoop_sz.h). Files are rotated once they reach a
+// size budget instead of a packet count, and get a ".sz" suffix. Compression
+// always runs on the writer thread below, and records are not kept buffered
+// for longer than BTSNOOP_SZ_MAX_CHUNK_AGE_MS.
+#define BTSNOOP_COMPRESSED_PROPERTY "persist.bluetooth.btsnoopcompressed"
+#define BTSNOOP_SZ_MAX_BYTES_PROPERTY "persist.bluetooth.btsnoopszbytes"
+#define DEFAULT_BTSNOOP_SZ_MAX_BYTES (32 * 1024 * 1024)
+#define BTSNOOP_SZ_CHUNK_SIZE (64 * 1024)
+#define BTSNOOP_SZ_MAX_CHUNK_AGE_MS 1000
+#define BTSNOOP_SZ_SUFFIX ".sz"
+#define BTSNOOP_PATH_MAX (PROPERTY_VALUE_MAX + sizeof(BTSNOOP_SZ_SUFFIX))
+#define BTSNOOP_LAST_PATH_MAX (BTSNOOP_PATH_MAX + sizeof(".last"))
+
+// Asynchronous capture. The capturing thread only copies each packet into a
+// record and pushes it on a single producer / single consumer ring; a writer
+// thread drains the ring in batches to the net listener and the log file.
+// Packets that find the ring full are dropped and counted in the
+// |dropped_packets| field of the records that follow.
+#define BTSNOOP_RING_SIZE 1024  // must be a power of two
+#define BTSNOOP_WRITE_BATCH 64
+#define BTSNOOP_WRITER_IDLE_MS 100
+static const char* BTSNOOP_WRITER_THREAD_NAME = "btsnoop_writer";
 
 typedef enum {
   kCommandPacket = 1,
@@ -71,6 +101,39 @@ static std::mutex btsnoop_mutex;
 static int32_t packets_per_file;
 static int32_t packet_counter;
 
+static bool compressed_log;
+static int32_t sz_bytes_per_file;
+static btsnoop_sz_t* snoop_sz;
+
+typedef struct {
+  uint32_t length_original;
+  uint32_t length_captured;
+  uint32_t flags;
+  uint32_t dropped_packets;
+  uint64_t timestamp;
+  uint8_t type;
+} __attribute__((__packed__)) btsnoop_header_t;
+
+typedef struct {
+  btsnoop_header_t header;
+  uint64_t timestamp_us;
+  uint32_t length;  // bytes in |data|
+  uint8_t data[];
+} snoop_record_t;
+
+// Producers are serialized by |btsnoop_mutex|, the writer is the only consumer
+static snoop_record_t* snoop_ring[BTSNOOP_RING_SIZE];
+static std::atomic<uint32_t> snoop_ring_head;  // next slot to fill
+static std::atomic<uint32_t> snoop_ring_tail;  // next slot to drain
+static std::atomic<uint32_t> snoop_dropped_packets;
+
+static bool async_capture;  // guarded by |btsnoop_mutex|
+static pthread_t writer_thread;
+static std::mutex writer_mutex;
+static std::condition_variable writer_cv;
+static std::atomic<bool> writer_idle;
+static std::atomic<bool> writer_stop;
+
 // TODO(zachoverflow): merge btsnoop and btsnoop_net together
 void btsnoop_net_open();
 void btsnoop_net_close();
@@ -81,8 +144,13 @@ static bool is_btsnoop_enabled();
 static char* get_btsnoop_log_path(char* log_path);
 static char* get_btsnoop_last_log_path(char* last_log_path, char* log_path);
 static void open_next_snoop_file();
+static void close_snoop_file();
 static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
                                  bool is_received, uint64_t timestamp_us);
+static void btsnoop_queue_packet(packet_type_t type, uint8_t* packet,
+                                 bool is_received, uint64_t timestamp_us);
+static void start_writer_thread();
+static void stop_writer_thread();
 
 // Module lifecycle functions
 
@@ -92,10 +160,16 @@ static future_t* start_up(void) {
   if (!is_btsnoop_enabled()) {
     delete_btsnoop_files();
   } else {
+    compressed_log = osi_property_get_bool(BTSNOOP_COMPRESSED_PROPERTY, false);
+    sz_bytes_per_file = osi_property_get_int32(BTSNOOP_SZ_MAX_BYTES_PROPERTY,
+                                               DEFAULT_BTSNOOP_SZ_MAX_BYTES);
     open_next_snoop_file();
     packets_per_file = osi_property_get_int32(BTSNOOP_MAX_PACKETS_PROPERTY,
                                               DEFAULT_BTSNOOP_SIZE);
     btsnoop_net_open();
+    // Don't deflate on the thread capturing the packets
+    if (compressed_log || osi_property_get_bool(BTSNOOP_ASYNC_PROPERTY, false))
+      start_writer_thread();
   }
 
   return NULL;
@@ -104,12 +178,13 @@ static future_t* start_up(void) {
 static future_t* shut_down(void) {
   std::lock_guard<std::mutex> lock(btsnoop_mutex);
 
+  if (async_capture) stop_writer_thread();
+
   if (!is_btsnoop_enabled()) {
     delete_btsnoop_files();
   }
 
-  if (logfile_fd != INVALID_FD) close(logfile_fd);
-  logfile_fd = INVALID_FD;
+  close_snoop_file();
 
   btsnoop_net_close();
 
@@ -132,22 +207,26 @@ static void capture(const BT_HDR* buffer, bool is_received) {
   uint64_t timestamp_us = time_gettimeofday_us();
   btsnoop_mem_capture(buffer, timestamp_us);
 
-  if (logfile_fd == INVALID_FD) return;
+  // In asynchronous mode the log file belongs to the writer thread
+  if (!async_capture && logfile_fd == INVALID_FD) return;
+
+  auto write_packet =
+      async_capture ? btsnoop_queue_packet : btsnoop_write_packet;
 
   switch (buffer->event & MSG_EVT_MASK) {
     case MSG_HC_TO_STACK_HCI_EVT:
-      btsnoop_write_packet(kEventPacket, p, false, timestamp_us);
+      write_packet(kEventPacket, p, false, timestamp_us);
       break;
     case MSG_HC_TO_STACK_HCI_ACL:
     case MSG_STACK_TO_HC_HCI_ACL:
-      btsnoop_write_packet(kAclPacket, p, is_received, timestamp_us);
+      write_packet(kAclPacket, p, is_received, timestamp_us);
       break;
     case MSG_HC_TO_STACK_HCI_SCO:
     case MSG_STACK_TO_HC_HCI_SCO:
-      btsnoop_write_packet(kScoPacket, p, is_received, timestamp_us);
+      write_packet(kScoPacket, p, is_received, timestamp_us);
       break;
     case MSG_STACK_TO_HC_HCI_CMD:
-      btsnoop_write_packet(kCommandPacket, p, true, timestamp_us);
+      write_packet(kCommandPacket, p, true, timestamp_us);
       break;
   }
 }
@@ -161,12 +240,17 @@ const btsnoop_t* btsnoop_get_interface() {
 // Internal functions
 static void delete_btsnoop_files() {
   LOG_VERBOSE(LOG_TAG, "Deleting snoop log if it exists");
-  char log_path[PROPERTY_VALUE_MAX];
-  char last_log_path[PROPERTY_VALUE_MAX + sizeof(".last")];
+  char log_path[BTSNOOP_PATH_MAX];
+  char last_log_path[BTSNOOP_LAST_PATH_MAX];
   get_btsnoop_log_path(log_path);
   get_btsnoop_last_log_path(last_log_path, log_path);
   remove(log_path);
   remove(last_log_path);
+
+  strcat(log_path, BTSNOOP_SZ_SUFFIX);
+  get_btsnoop_last_log_path(last_log_path, log_path);
+  remove(log_path);
+  remove(last_log_path);
 }
 
 static bool is_btsnoop_enabled() {
@@ -182,22 +266,31 @@ static char* get_btsnoop_log_path(char* btsnoop_path) {
 
 static char* get_btsnoop_last_log_path(char* last_log_path,
                                        char* btsnoop_path) {
-  snprintf(last_log_path, PROPERTY_VALUE_MAX + sizeof(".last"), "%s.last",
-           btsnoop_path);
+  snprintf(last_log_path, BTSNOOP_LAST_PATH_MAX, "%s.last", btsnoop_path);
   return last_log_path;
 }
 
-static void open_next_snoop_file() {
-  packet_counter = 0;
+static void close_snoop_file() {
+  if (snoop_sz != NULL) {
+    btsnoop_sz_close(snoop_sz);
+    snoop_sz = NULL;
+  }
 
   if (logfile_fd != INVALID_FD) {
     close(logfile_fd);
     logfile_fd = INVALID_FD;
   }
+}
 
-  char log_path[PROPERTY_VALUE_MAX];
-  char last_log_path[PROPERTY_VALUE_MAX + sizeof(".last")];
+static void open_next_snoop_file() {
+  packet_counter = 0;
+
+  close_snoop_file();
+
+  char log_path[BTSNOOP_PATH_MAX];
+  char last_log_path[BTSNOOP_LAST_PATH_MAX];
   get_btsnoop_log_path(log_path);
+  if (compressed_log) strcat(log_path, BTSNOOP_SZ_SUFFIX);
   get_btsnoop_last_log_path(last_log_path, log_path);
 
   if (rename(log_path, last_log_path) != 0 && errno != ENOENT)
@@ -214,17 +307,26 @@ static void open_next_snoop_file() {
     return;
   }
 
+  if (compressed_log) {
+    snoop_sz = btsnoop_sz_open(logfile_fd, BTSNOOP_SZ_CHUNK_SIZE);
+    if (snoop_sz == NULL) {
+      close(logfile_fd);
+      logfile_fd = INVALID_FD;
+    }
+    return;
+  }
+
   write(logfile_fd, "btsnoop\0\0\0\0\1\0\0\x3\xea", 16);
 }
 
-typedef struct {
-  uint32_t length_original;
-  uint32_t length_captured;
-  uint32_t flags;
-  uint32_t dropped_packets;
-  uint64_t timestamp;
-  uint8_t type;
-} __attribute__((__packed__)) btsnoop_header_t;
+// Accounts for one more packet in the current file and returns true if the
+// file has to be rotated before that packet is written.
+static bool is_rotation_due() {
+  if (compressed_log)
+    return btsnoop_sz_file_size(snoop_sz) >= (size_t)sz_bytes_per_file;
+
+  return ++packet_counter > packets_per_file;
+}
 
 static uint64_t htonll(uint64_t ll) {
   const uint32_t l = 1;
@@ -235,8 +337,11 @@ static uint64_t htonll(uint64_t ll) {
   return ll;
 }
 
-static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
-                                 bool is_received, uint64_t timestamp_us) {
+// Fills |header| for |packet| and returns the number of packet bytes that
+// follow the header in the log record.
+static uint32_t btsnoop_make_header(packet_type_t type, const uint8_t* packet,
+                                    bool is_received, uint64_t timestamp_us,
+                                    btsnoop_header_t* header) {
   uint32_t length_he = 0;
   uint32_t flags = 0;
 
@@ -259,25 +364,191 @@ static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
       break;
   }
 
+  header->length_original = htonl(length_he);
+  header->length_captured = header->length_original;
+  header->flags = htonl(flags);
+  header->dropped_packets = 0;
+  header->timestamp = htonll(timestamp_us + BTSNOOP_EPOCH_DELTA);
+  header->type = type;
+
+  return length_he - 1;
+}
+
+static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
+                                 bool is_received, uint64_t timestamp_us) {
   btsnoop_header_t header;
-  header.length_original = htonl(length_he);
-  header.length_captured = header.length_original;
-  header.flags = htonl(flags);
-  header.dropped_packets = 0;
-  header.timestamp = htonll(timestamp_us + BTSNOOP_EPOCH_DELTA);
-  header.type = type;
+  uint32_t length =
+      btsnoop_make_header(type, packet, is_received, timestamp_us, &header);
 
   btsnoop_net_write(&header, sizeof(btsnoop_header_t));
-  btsnoop_net_write(packet, length_he - 1);
+  btsnoop_net_write(packet, length);
 
   if (logfile_fd != INVALID_FD) {
-    packet_counter++;
-    if (packet_counter > packets_per_file) {
+    if (is_rotation_due()) {
       open_next_snoop_file();
+      if (logfile_fd == INVALID_FD) return;
     }
 
     iovec iov[] = {{&header, sizeof(btsnoop_header_t)},
-                   {reinterpret_cast<void*>(packet), length_he - 1}};
-    TEMP_FAILURE_RETRY(writev(logfile_fd, iov, 2));
+                   {reinterpret_cast<void*>(packet), length}};
+    if (compressed_log) {
+      btsnoop_sz_write(snoop_sz, timestamp_us, iov, 2);
+      btsnoop_sz_flush_if_older(snoop_sz, timestamp_us,
+                                BTSNOOP_SZ_MAX_CHUNK_AGE_MS * 1000ULL);
+    } else {
+      TEMP_FAILURE_RETRY(writev(logfile_fd, iov, 2));
+    }
   }
 }
+
+// Called with |btsnoop_mutex| held, which makes this the only producer.
+static void btsnoop_queue_packet(packet_type_t type, uint8_t* packet,
+                                 bool is_received, uint64_t timestamp_us) {
+  uint32_t head = snoop_ring_head.load(std::memory_order_relaxed);
+  if (head - snoop_ring_tail.load(std::memory_order_acquire) >=
+      BTSNOOP_RING_SIZE) {
+    snoop_dropped_packets.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  btsnoop_header_t header;
+  uint32_t length =
+      btsnoop_make_header(type, packet, is_received, timestamp_us, &header);
+
+  snoop_record_t* record =
+      static_cast<snoop_record_t*>(osi_malloc(sizeof(snoop_record_t) + length));
+  record->header = header;
+  record->timestamp_us = timestamp_us;
+  record->length = length;
+  memcpy(record->data, packet, length);
+
+  snoop_ring[head & (BTSNOOP_RING_SIZE - 1)] = record;
+  snoop_ring_head.store(head + 1, std::memory_order_seq_cst);
+
+  if (writer_idle.exchange(false)) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    writer_cv.notify_one();
+  }
+}
+
+static snoop_record_t* snoop_ring_pop() {
+  uint32_t tail = snoop_ring_tail.load(std::memory_order_relaxed);
+  if (tail == snoop_ring_head.load(std::memory_order_seq_cst)) return nullptr;
+
+  snoop_record_t* record = snoop_ring[tail & (BTSNOOP_RING_SIZE - 1)];
+  snoop_ring_tail.store(tail + 1, std::memory_order_release);
+  return record;
+}
+
+// Writes out up to BTSNOOP_WRITE_BATCH records with as few writev() calls as
+// file rotation allows. Returns the number of records written.
+static size_t writer_drain_batch() {
+  snoop_record_t* records[BTSNOOP_WRITE_BATCH];
+  iovec iov[2 * BTSNOOP_WRITE_BATCH];
+  size_t count = 0;
+  int iovcnt = 0;
+
+  while (count < BTSNOOP_WRITE_BATCH) {
+    snoop_record_t* record = snoop_ring_pop();
+    if (record == nullptr) break;
+    records[count++] = record;
+
+    record->header.dropped_packets =
+        htonl(snoop_dropped_packets.load(std::memory_order_relaxed));
+
+    btsnoop_net_write(&record->header, sizeof(btsnoop_header_t));
+    btsnoop_net_write(record->data, record->length);
+
+    if (logfile_fd == INVALID_FD) continue;
+
+    if (is_rotation_due()) {
+      if (iovcnt) TEMP_FAILURE_RETRY(writev(logfile_fd, iov, iovcnt));
+      iovcnt = 0;
+      open_next_snoop_file();
+      if (logfile_fd == INVALID_FD) continue;
+    }
+
+    if (compressed_log) {
+      iovec record_iov[] = {{&record->header, sizeof(btsnoop_header_t)},
+                            {record->data, record->length}};
+      btsnoop_sz_write(snoop_sz, record->timestamp_us, record_iov, 2);
+      continue;
+    }
+
+    iov[iovcnt++] = {&record->header, sizeof(btsnoop_header_t)};
+    iov[iovcnt++] = {record->data, record->length};
+  }
+
+  if (iovcnt && logfile_fd != INVALID_FD)
+    TEMP_FAILURE_RETRY(writev(logfile_fd, iov, iovcnt));
+
+  for (size_t i = 0; i < count; i++) osi_free(records[i]);
+
+  return count;
+}
+
+static void* writer_thread_fn(UNUSED_ATTR void* context) {
+  prctl(PR_SET_NAME, (unsigned long)BTSNOOP_WRITER_THREAD_NAME, 0, 0, 0);
+
+  while (true) {
+    size_t written = writer_drain_batch();
+
+    // Checked after every batch, so a slow but steady stream still reaches
+    // the file, and on every idle wake up
+    if (snoop_sz != NULL) {
+      btsnoop_sz_flush_if_older(snoop_sz, time_gettimeofday_us(),
+                                BTSNOOP_SZ_MAX_CHUNK_AGE_MS * 1000ULL);
+    }
+
+    if (written != 0) continue;
+
+    if (writer_stop.load()) break;
+
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    writer_idle.store(true);
+    // Re-check after announcing idleness so a concurrent push is not missed
+    if (snoop_ring_head.load() != snoop_ring_tail.load()) {
+      writer_idle.store(false);
+      continue;
+    }
+    writer_cv.wait_for(lock,
+                       std::chrono::milliseconds(BTSNOOP_WRITER_IDLE_MS),
+                       [] { return !writer_idle.load() || writer_stop.load(); });
+    writer_idle.store(false);
+  }
+
+  return NULL;
+}
+
+// Called with |btsnoop_mutex| held.
+static void start_writer_thread() {
+  writer_stop = false;
+  writer_idle = false;
+  snoop_dropped_packets = 0;
+
+  if (pthread_create(&writer_thread, NULL, writer_thread_fn, NULL) != 0) {
+    LOG_ERROR(LOG_TAG, "%s pthread_create failed: %s", __func__,
+              strerror(errno));
+    return;
+  }
+
+  async_capture = true;
+}
+
+// Called with |btsnoop_mutex| held, so no packet is queued concurrently. The
+// writer drains everything that is left before exiting.
+static void stop_writer_thread() {
+  {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    writer_stop = true;
+    writer_cv.notify_one();
+  }
+  pthread_join(writer_thread, NULL);
+
+  uint32_t dropped = snoop_dropped_packets.load();
+  if (dropped)
+    LOG_WARN(LOG_TAG, "%s dropped %u packets in asynchronous capture",
+             __func__, dropped);
+
+  async_capture = false;
+}
@@ -0,0 +1,206 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_snoop_sz"
+
+#include "hci/include/btsnoop_sz.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <vector>
+
+#include "osi/include/allocator.h"
+#include "osi/include/log.h"
+#include "osi/include/osi.h"
+
+// Large enough for the biggest HCI packet plus its btsnoop record header, so a
+// single record always fits in an empty chunk.
+#define BTSNOOP_SZ_MAX_RECORD_SIZE (24 + 5 + 0xffff)
+
+struct btsnoop_sz_t {
+  int fd;
+  size_t chunk_size;
+  size_t file_size;
+
+  z_stream zs;
+
+  // Records of the chunk being assembled
+  uint8_t* chunk;
+  size_t chunk_capacity;
+  size_t chunk_length;
+  uint32_t chunk_packets;
+  uint64_t chunk_first_timestamp_us;
+  uint64_t chunk_last_timestamp_us;
+
+  uint8_t* compressed;
+  size_t compressed_capacity;
+
+  uint64_t packet_count;
+  std::vector<btsnoop_sz_index_entry_t> index;
+};
+
+static bool write_all(btsnoop_sz_t* sz, const void* data, size_t length) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  while (length > 0) {
+    ssize_t ret;
+    OSI_NO_INTR(ret = write(sz->fd, p, length));
+    if (ret < 0) {
+      LOG_ERROR(LOG_TAG, "%s write failed: %s", __func__, strerror(errno));
+      return false;
+    }
+    p += ret;
+    length -= ret;
+    sz->file_size += ret;
+  }
+  return true;
+}
+
+btsnoop_sz_t* btsnoop_sz_open(int fd, size_t chunk_size) {
+  btsnoop_sz_t* sz = new btsnoop_sz_t();
+  sz->fd = fd;
+  sz->chunk_size = chunk_size;
+
+  sz->zs.zalloc = Z_NULL;
+  sz->zs.zfree = Z_NULL;
+  sz->zs.opaque = Z_NULL;
+  if (deflateInit(&sz->zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    LOG_ERROR(LOG_TAG, "%s deflateInit failed", __func__);
+    delete sz;
+    return NULL;
+  }
+
+  sz->chunk_capacity = chunk_size + BTSNOOP_SZ_MAX_RECORD_SIZE;
+  sz->chunk = static_cast<uint8_t*>(osi_malloc(sz->chunk_capacity));
+  sz->compressed_capacity = deflateBound(&sz->zs, sz->chunk_capacity);
+  sz->compressed = static_cast<uint8_t*>(osi_malloc(sz->compressed_capacity));
+
+  btsnoop_sz_file_header_t header;
+  memcpy(header.magic, BTSNOOP_SZ_FILE_MAGIC, sizeof(header.magic));
+  header.version = BTSNOOP_SZ_VERSION;
+  header.datalink = BTSNOOP_SZ_DATALINK_HCI_UART;
+  if (!write_all(sz, &header, sizeof(header))) {
+    deflateEnd(&sz->zs);
+    osi_free(sz->chunk);
+    osi_free(sz->compressed);
+    delete sz;
+    return NULL;
+  }
+
+  return sz;
+}
+
+void btsnoop_sz_write(btsnoop_sz_t* sz, uint64_t timestamp_us,
+                      const struct iovec* iov, int iovcnt) {
+  size_t length = 0;
+  for (int i = 0; i < iovcnt; i++) length += iov[i].iov_len;
+
+  if (length > BTSNOOP_SZ_MAX_RECORD_SIZE) {
+    LOG_ERROR(LOG_TAG, "%s record too large: %zu", __func__, length);
+    return;
+  }
+
+  if (sz->chunk_length + length > sz->chunk_capacity) btsnoop_sz_flush(sz);
+
+  for (int i = 0; i < iovcnt; i++) {
+    memcpy(sz->chunk + sz->chunk_length, iov[i].iov_base, iov[i].iov_len);
+    sz->chunk_length += iov[i].iov_len;
+  }
+
+  if (sz->chunk_packets == 0) sz->chunk_first_timestamp_us = timestamp_us;
+  sz->chunk_last_timestamp_us = timestamp_us;
+  sz->chunk_packets++;
+
+  if (sz->chunk_length >= sz->chunk_size) btsnoop_sz_flush(sz);
+}
+
+void btsnoop_sz_flush(btsnoop_sz_t* sz) {
+  if (sz->chunk_packets == 0) return;
+
+  deflateReset(&sz->zs);
+  sz->zs.next_in = sz->chunk;
+  sz->zs.avail_in = sz->chunk_length;
+  sz->zs.next_out = sz->compressed;
+  sz->zs.avail_out = sz->compressed_capacity;
+
+  // The output buffer is sized with deflateBound(), so one call finishes
+  if (deflate(&sz->zs, Z_FINISH) != Z_STREAM_END) {
+    LOG_ERROR(LOG_TAG, "%s deflate failed, dropping %u packets", __func__,
+              sz->chunk_packets);
+  } else {
+    btsnoop_sz_chunk_header_t header;
+    header.magic = BTSNOOP_SZ_CHUNK_MAGIC;
+    header.compressed_length = sz->compressed_capacity - sz->zs.avail_out;
+    header.uncompressed_length = sz->chunk_length;
+    header.packet_count = sz->chunk_packets;
+    header.first_packet = sz->packet_count;
+    header.first_timestamp_us = sz->chunk_first_timestamp_us;
+    header.last_timestamp_us = sz->chunk_last_timestamp_us;
+
+    btsnoop_sz_index_entry_t entry;
+    entry.offset = sz->file_size;
+    entry.first_packet = header.first_packet;
+    entry.first_timestamp_us = header.first_timestamp_us;
+    entry.last_timestamp_us = header.last_timestamp_us;
+    entry.packet_count = header.packet_count;
+    entry.reserved = 0;
+
+    if (write_all(sz, &header, sizeof(header)) &&
+        write_all(sz, sz->compressed, header.compressed_length)) {
+      sz->index.push_back(entry);
+    }
+  }
+
+  sz->packet_count += sz->chunk_packets;
+  sz->chunk_length = 0;
+  sz->chunk_packets = 0;
+}
+
+bool btsnoop_sz_flush_if_older(btsnoop_sz_t* sz, uint64_t now_us,
+                               uint64_t max_age_us) {
+  if (sz->chunk_packets == 0) return false;
+  if (now_us < sz->chunk_first_timestamp_us + max_age_us) return false;
+
+  btsnoop_sz_flush(sz);
+  return true;
+}
+
+size_t btsnoop_sz_file_size(const btsnoop_sz_t* sz) { return sz->file_size; }
+
+void btsnoop_sz_close(btsnoop_sz_t* sz) {
+  if (sz == NULL) return;
+
+  btsnoop_sz_flush(sz);
+
+  btsnoop_sz_trailer_t trailer;
+  trailer.index_offset = sz->file_size;
+  trailer.entry_count = sz->index.size();
+  trailer.magic = BTSNOOP_SZ_INDEX_MAGIC;
+
+  if (write_all(sz, sz->index.data(),
+                sz->index.size() * sizeof(btsnoop_sz_index_entry_t))) {
+    write_all(sz, &trailer, sizeof(trailer));
+  }
+
+  deflateEnd(&sz->zs);
+  osi_free(sz->chunk);
+  osi_free(sz->compressed);
+  delete sz;
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "hci_data_ring.h"
+
+#include <sched.h>
+
+#include <chrono>
+#include <thread>
+
+#define LAP(position) ((position) / HciDataRing::kSize)
+
+// Yields this many times before PushWait() starts sleeping
+#define PUSH_WAIT_YIELDS 64
+#define PUSH_WAIT_SLEEP_MAX_US 1000
+
+constexpr size_t HciDataRing::kSize;
+
+HciDataRing::HciDataRing() : head_(0), tail_(0), drain_pending_(false) {
+  for (Slot& slot : slots_) {
+    slot.turn = 0;
+    slot.packet = nullptr;
+  }
+}
+
+bool HciDataRing::Push(void* packet) {
+  uint64_t position = head_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[position & (kSize - 1)];
+    uint64_t free_turn = 2 * LAP(position);
+    uint64_t turn = slot->turn.load(std::memory_order_acquire);
+    if (turn == free_turn) {
+      if (head_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed))
+        break;
+    } else if (turn < free_turn) {
+      // The packet from the previous lap hasn't been drained yet
+      return false;
+    } else {
+      // Another producer took this position
+      position = head_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->packet = packet;
+  slot->turn.store(2 * LAP(position) + 1, std::memory_order_release);
+  return true;
+}
+
+bool HciDataRing::PushWait(void* packet, uint64_t timeout_ms) {
+  if (Push(packet)) return true;
+
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  int sleep_us = 1;
+  for (int attempt = 0; !Push(packet); attempt++) {
+    if (std::chrono::steady_clock::now() >= deadline) return false;
+    if (attempt < PUSH_WAIT_YIELDS) {
+      sched_yield();
+      continue;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+    if (sleep_us < PUSH_WAIT_SLEEP_MAX_US) sleep_us *= 2;
+  }
+  return true;
+}
+
+void* HciDataRing::Pop() {
+  Slot* slot = &slots_[tail_ & (kSize - 1)];
+  uint64_t lap = LAP(tail_);
+  if (slot->turn.load(std::memory_order_acquire) != 2 * lap + 1)
+    return nullptr;
+
+  void* packet = slot->packet;
+  slot->turn.store(2 * lap + 2, std::memory_order_release);
+  tail_++;
+  return packet;
+}
+
+bool HciDataRing::RequestDrain() {
+  // Sequentially consistent, ordered after the slot store of the packet just
+  // pushed; pairs with the fence in BeginDrain()
+  return !drain_pending_.exchange(true, std::memory_order_seq_cst);
+}
+
+void HciDataRing::BeginDrain() {
+  drain_pending_.store(false, std::memory_order_seq_cst);
+  // Keep the loads of the slots from moving ahead of the clear. Otherwise a
+  // producer could push, still see the flag set and skip scheduling, while
+  // this drain has already found its slot empty, and the packet would sit in
+  // the ring until the next unrelated push.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
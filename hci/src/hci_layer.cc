@@ -31,12 +31,14 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <chrono>
 #include <mutex>
 
 #include "btcore/include/module.h"
 #include "btsnoop.h"
 #include "buffer_allocator.h"
+#include "hci_data_ring.h"
 #include "hci_inject.h"
 #include "hci_internals.h"
 #include "hcidefs.h"
@@ -104,6 +106,16 @@ static int command_credits = 1;
 static std::mutex command_credits_mutex;
 static std::queue<base::Closure> command_queue;
 
+// ACL and SCO packets don't take the closure-per-packet path commands do. Any
+// thread pushes them on |data_ring|, and the drain task sends everything queued
+// by the time it runs. Drained on the HCI thread, or under
+// |message_loop_mutex| once the message loop is gone.
+static HciDataRing data_ring;
+// How long a producer waits for room in a full ring before dropping its packet
+#define DATA_RING_FULL_TIMEOUT_MS 1000
+static std::atomic<uint64_t> data_packets_queued;
+static std::atomic<uint64_t> data_drains;
+
 // Inbound-related
 static alarm_t* command_response_timer;
 static list_t* commands_pending_response;
@@ -124,7 +136,8 @@ static void startup_timer_expired(void* context);
 static void enqueue_command(waiting_command_t* wait_entry);
 static void event_command_ready(waiting_command_t* wait_entry);
 static void enqueue_packet(void* packet);
-static void event_packet_ready(void* packet);
+static void event_data_ready(void);
+static void free_queued_data(void);
 static void command_timed_out(void* context);
 
 static void update_command_response_timer(void);
@@ -183,7 +196,14 @@ void message_loop_run(UNUSED_ATTR void* context) {
     message_loop_ = nullptr;
     delete run_loop_;
     run_loop_ = nullptr;
+
+    // A pending drain went with the message loop
+    free_queued_data();
   }
+
+  LOG_INFO(LOG_TAG, "%s queued %llu data packets in %llu batches", __func__,
+           (unsigned long long)data_packets_queued.exchange(0),
+           (unsigned long long)data_drains.exchange(0));
 }
 
 static future_t* hci_module_start_up(void) {
@@ -433,21 +453,56 @@ static void event_command_ready(waiting_command_t* wait_entry) {
   update_command_response_timer();
 }
 
-static void enqueue_packet(void* packet) {
+// Called with |message_loop_mutex| held once the message loop is gone.
+static void free_queued_data(void) {
+  data_ring.BeginDrain();
+  void* packet;
+  while ((packet = data_ring.Pop()) != NULL) buffer_allocator->free(packet);
+}
+
+static void schedule_data_drain(void) {
   std::lock_guard<std::mutex> lock(message_loop_mutex);
   if (message_loop_ == nullptr) {
     // HCI Layer was shut down
-    buffer_allocator->free(packet);
+    free_queued_data();
     return;
   }
-  message_loop_->task_runner()->PostTask(
-      FROM_HERE, base::Bind(&event_packet_ready, packet));
+  message_loop_->task_runner()->PostTask(FROM_HERE,
+                                         base::Bind(&event_data_ready));
 }
 
-static void event_packet_ready(void* pkt) {
-  // The queue may be the command queue or the packet queue, we don't care
-  BT_HDR* packet = (BT_HDR*)pkt;
-  packet_fragmenter->fragment_and_dispatch(packet);
+static void enqueue_packet(void* packet) {
+  if (!data_ring.Push(packet)) {
+    // The HCI thread is a whole ring behind, which controller flow control
+    // should make impossible for ACL. Give it a chance to catch up.
+    LOG_WARN(LOG_TAG, "%s data ring full, waiting for the HCI thread",
+             __func__);
+    if (!data_ring.PushWait(packet, DATA_RING_FULL_TIMEOUT_MS)) {
+      LOG_ERROR(LOG_TAG, "%s HCI thread stuck for %d ms, dropping packet",
+                __func__, DATA_RING_FULL_TIMEOUT_MS);
+      buffer_allocator->free(packet);
+      return;
+    }
+  }
+  data_packets_queued.fetch_add(1, std::memory_order_relaxed);
+
+  if (data_ring.RequestDrain()) schedule_data_drain();
+}
+
+static void event_data_ready(void) {
+  // Before draining, so a packet pushed after the drain has stopped looking
+  // always schedules another one
+  data_ring.BeginDrain();
+  data_drains.fetch_add(1, std::memory_order_relaxed);
+
+  // Bound the batch so that a steady stream of data can't hold up commands
+  for (size_t i = 0; i < HciDataRing::kSize; i++) {
+    BT_HDR* packet = (BT_HDR*)data_ring.Pop();
+    if (packet == NULL) return;
+    packet_fragmenter->fragment_and_dispatch(packet);
+  }
+
+  if (data_ring.RequestDrain()) schedule_data_drain();
 }
 
 // Callback for the fragmenter to send a fragment
@@ -0,0 +1,179 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <vector>
+
+#include "hci/include/btsnoop_sz.h"
+
+class BtsnoopSzTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    file_ = tmpfile();
+    ASSERT_NE(file_, nullptr);
+  }
+
+  void TearDown() override { fclose(file_); }
+
+  std::vector<uint8_t> ReadFile() {
+    std::vector<uint8_t> contents;
+    uint8_t block[4096];
+    size_t read;
+    rewind(file_);
+    while ((read = fread(block, 1, sizeof(block), file_)) > 0)
+      contents.insert(contents.end(), block, block + read);
+    return contents;
+  }
+
+  // Writes |count| records of |length| bytes, returning their concatenation
+  std::vector<uint8_t> WriteRecords(btsnoop_sz_t* sz, int count,
+                                    size_t length) {
+    std::vector<uint8_t> expected;
+    for (int i = 0; i < count; i++) {
+      std::vector<uint8_t> record(length, static_cast<uint8_t>(i));
+      iovec iov[] = {{record.data(), 4}, {record.data() + 4, length - 4}};
+      btsnoop_sz_write(sz, 1000 + i, iov, 2);
+      expected.insert(expected.end(), record.begin(), record.end());
+    }
+    return expected;
+  }
+
+  FILE* file_;
+};
+
+TEST_F(BtsnoopSzTest, file_header) {
+  btsnoop_sz_t* sz = btsnoop_sz_open(fileno(file_), 1024);
+  ASSERT_NE(sz, nullptr);
+  btsnoop_sz_close(sz);
+
+  std::vector<uint8_t> contents = ReadFile();
+  ASSERT_EQ(contents.size(), sizeof(btsnoop_sz_file_header_t) +
+                                 sizeof(btsnoop_sz_trailer_t));
+
+  btsnoop_sz_file_header_t header;
+  memcpy(&header, contents.data(), sizeof(header));
+  EXPECT_EQ(memcmp(header.magic, BTSNOOP_SZ_FILE_MAGIC, 8), 0);
+  EXPECT_EQ(header.version, (uint32_t)BTSNOOP_SZ_VERSION);
+
+  btsnoop_sz_trailer_t trailer;
+  memcpy(&trailer, contents.data() + sizeof(header), sizeof(trailer));
+  EXPECT_EQ(trailer.magic, (uint32_t)BTSNOOP_SZ_INDEX_MAGIC);
+  EXPECT_EQ(trailer.entry_count, 0u);
+  EXPECT_EQ(trailer.index_offset, sizeof(header));
+}
+
+TEST_F(BtsnoopSzTest, chunks_are_indexed_and_decompress) {
+  btsnoop_sz_t* sz = btsnoop_sz_open(fileno(file_), 1024);
+  ASSERT_NE(sz, nullptr);
+  std::vector<uint8_t> expected = WriteRecords(sz, 100, 100);
+  btsnoop_sz_close(sz);
+
+  std::vector<uint8_t> contents = ReadFile();
+  btsnoop_sz_trailer_t trailer;
+  ASSERT_GT(contents.size(), sizeof(trailer));
+  memcpy(&trailer, contents.data() + contents.size() - sizeof(trailer),
+         sizeof(trailer));
+  ASSERT_EQ(trailer.magic, (uint32_t)BTSNOOP_SZ_INDEX_MAGIC);
+  // 1024 byte chunks of 100 byte records hold 11 records each
+  ASSERT_EQ(trailer.entry_count, 10u);
+
+  std::vector<uint8_t> decompressed;
+  uint64_t next_packet = 0;
+  for (uint32_t i = 0; i < trailer.entry_count; i++) {
+    btsnoop_sz_index_entry_t entry;
+    memcpy(&entry,
+           contents.data() + trailer.index_offset + i * sizeof(entry),
+           sizeof(entry));
+    EXPECT_EQ(entry.first_packet, next_packet);
+    EXPECT_EQ(entry.first_timestamp_us, 1000 + next_packet);
+    EXPECT_EQ(entry.last_timestamp_us,
+              1000 + next_packet + entry.packet_count - 1);
+    next_packet += entry.packet_count;
+
+    btsnoop_sz_chunk_header_t chunk;
+    memcpy(&chunk, contents.data() + entry.offset, sizeof(chunk));
+    EXPECT_EQ(chunk.magic, (uint32_t)BTSNOOP_SZ_CHUNK_MAGIC);
+    EXPECT_EQ(chunk.packet_count, entry.packet_count);
+
+    std::vector<uint8_t> out(chunk.uncompressed_length);
+    uLongf out_length = out.size();
+    ASSERT_EQ(uncompress(out.data(), &out_length,
+                         contents.data() + entry.offset + sizeof(chunk),
+                         chunk.compressed_length),
+              Z_OK);
+    ASSERT_EQ(out_length, out.size());
+    decompressed.insert(decompressed.end(), out.begin(), out.end());
+  }
+
+  EXPECT_EQ(next_packet, 100u);
+  EXPECT_EQ(decompressed, expected);
+}
+
+TEST_F(BtsnoopSzTest, file_size_tracks_written_chunks) {
+  btsnoop_sz_t* sz = btsnoop_sz_open(fileno(file_), 4096);
+  ASSERT_NE(sz, nullptr);
+  EXPECT_EQ(btsnoop_sz_file_size(sz), sizeof(btsnoop_sz_file_header_t));
+
+  // Buffered records are not on disk until the chunk is flushed
+  WriteRecords(sz, 10, 100);
+  EXPECT_EQ(btsnoop_sz_file_size(sz), sizeof(btsnoop_sz_file_header_t));
+
+  btsnoop_sz_flush(sz);
+  size_t size = btsnoop_sz_file_size(sz);
+  EXPECT_GT(size, sizeof(btsnoop_sz_file_header_t) +
+                      sizeof(btsnoop_sz_chunk_header_t));
+  EXPECT_EQ((size_t)lseek(fileno(file_), 0, SEEK_CUR), size);
+
+  btsnoop_sz_close(sz);
+}
+
+TEST_F(BtsnoopSzTest, old_records_are_flushed) {
+  btsnoop_sz_t* sz = btsnoop_sz_open(fileno(file_), 4096);
+  ASSERT_NE(sz, nullptr);
+  size_t header_size = btsnoop_sz_file_size(sz);
+
+  // Nothing buffered
+  EXPECT_FALSE(btsnoop_sz_flush_if_older(sz, 1000000, 500));
+
+  // Timestamps 1000 to 1009, the oldest is what counts
+  WriteRecords(sz, 10, 100);
+  EXPECT_FALSE(btsnoop_sz_flush_if_older(sz, 1499, 500));
+  EXPECT_EQ(btsnoop_sz_file_size(sz), header_size);
+
+  EXPECT_TRUE(btsnoop_sz_flush_if_older(sz, 1500, 500));
+  size_t size = btsnoop_sz_file_size(sz);
+  EXPECT_GT(size, header_size);
+
+  // The chunk went out, there is nothing left to flush
+  EXPECT_FALSE(btsnoop_sz_flush_if_older(sz, 1000000, 500));
+  EXPECT_EQ(btsnoop_sz_file_size(sz), size);
+
+  btsnoop_sz_close(sz);
+
+  std::vector<uint8_t> contents = ReadFile();
+  btsnoop_sz_trailer_t trailer;
+  memcpy(&trailer, contents.data() + contents.size() - sizeof(trailer),
+         sizeof(trailer));
+  EXPECT_EQ(trailer.entry_count, 1u);
+}
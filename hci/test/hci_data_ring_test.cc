@@ -0,0 +1,220 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hci/include/hci_data_ring.h"
+
+namespace {
+
+constexpr int kProducers = 4;
+constexpr uint64_t kPacketsPerProducer = 2 * 1024 * 1024;
+
+// Packets are never dereferenced, the pointer value carries the producer and
+// its sequence number
+void* MakePacket(uintptr_t producer, uintptr_t seq) {
+  return reinterpret_cast<void*>((producer << 24 | seq) + 1);
+}
+
+uintptr_t PacketProducer(void* packet) {
+  return (reinterpret_cast<uintptr_t>(packet) - 1) >> 24;
+}
+
+uintptr_t PacketSeq(void* packet) {
+  return (reinterpret_cast<uintptr_t>(packet) - 1) & 0xffffff;
+}
+
+// The HCI thread: runs posted drain tasks one at a time, like the message loop
+class Consumer {
+ public:
+  explicit Consumer(HciDataRing* ring)
+      : ring_(ring), next_seq_(kProducers, 0), thread_([this] { Run(); }) {}
+
+  ~Consumer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void ScheduleDrain() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      drains_posted_++;
+    }
+    cv_.notify_one();
+  }
+
+  // Waits for every posted drain, including reposted ones, to finish
+  void Stop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopping_ = true;
+    cv_.notify_one();
+    stopped_cv_.wait(lock, [this] { return stopped_; });
+  }
+
+  uint64_t received() const { return received_; }
+  uint64_t out_of_order() const { return out_of_order_; }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return drains_posted_ > 0 || stopping_; });
+      if (drains_posted_ == 0) break;
+      drains_posted_--;
+      lock.unlock();
+      Drain();
+      lock.lock();
+    }
+    stopped_ = true;
+    stopped_cv_.notify_all();
+  }
+
+  // Same shape as event_data_ready()
+  void Drain() {
+    ring_->BeginDrain();
+    for (size_t i = 0; i < HciDataRing::kSize; i++) {
+      void* packet = ring_->Pop();
+      if (packet == nullptr) return;
+      uintptr_t producer = PacketProducer(packet);
+      if (PacketSeq(packet) != next_seq_[producer]) out_of_order_++;
+      next_seq_[producer] = PacketSeq(packet) + 1;
+      received_++;
+    }
+    if (ring_->RequestDrain()) ScheduleDrain();
+  }
+
+  HciDataRing* ring_;
+  std::vector<uintptr_t> next_seq_;
+  uint64_t received_ = 0;
+  uint64_t out_of_order_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable stopped_cv_;
+  int drains_posted_ = 0;
+  bool stopping_ = false;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+}  // namespace
+
+class HciDataRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ring_.reset(new HciDataRing()); }
+
+  std::unique_ptr<HciDataRing> ring_;
+};
+
+TEST_F(HciDataRingTest, pops_in_push_order) {
+  EXPECT_EQ(nullptr, ring_->Pop());
+  for (uintptr_t i = 0; i < 10; i++) EXPECT_TRUE(ring_->Push(MakePacket(0, i)));
+  for (uintptr_t i = 0; i < 10; i++) EXPECT_EQ(MakePacket(0, i), ring_->Pop());
+  EXPECT_EQ(nullptr, ring_->Pop());
+}
+
+TEST_F(HciDataRingTest, wraps_around) {
+  uintptr_t seq = 0;
+  for (int lap = 0; lap < 5; lap++) {
+    for (size_t i = 0; i < HciDataRing::kSize - 1; i++)
+      ASSERT_TRUE(ring_->Push(MakePacket(0, seq + i)));
+    for (size_t i = 0; i < HciDataRing::kSize - 1; i++)
+      ASSERT_EQ(MakePacket(0, seq++), ring_->Pop());
+  }
+  EXPECT_EQ(nullptr, ring_->Pop());
+}
+
+TEST_F(HciDataRingTest, push_fails_when_full) {
+  for (size_t i = 0; i < HciDataRing::kSize; i++)
+    ASSERT_TRUE(ring_->Push(MakePacket(0, i)));
+  EXPECT_FALSE(ring_->Push(MakePacket(0, HciDataRing::kSize)));
+
+  ASSERT_EQ(MakePacket(0, 0), ring_->Pop());
+  EXPECT_TRUE(ring_->Push(MakePacket(0, HciDataRing::kSize)));
+}
+
+TEST_F(HciDataRingTest, push_wait_gives_up_on_stuck_consumer) {
+  for (size_t i = 0; i < HciDataRing::kSize; i++)
+    ASSERT_TRUE(ring_->Push(MakePacket(0, i)));
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(ring_->PushWait(MakePacket(0, HciDataRing::kSize), 20));
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(20));
+
+  // The dropped packet never made it in
+  for (size_t i = 0; i < HciDataRing::kSize; i++)
+    ASSERT_EQ(MakePacket(0, i), ring_->Pop());
+  EXPECT_EQ(nullptr, ring_->Pop());
+}
+
+TEST_F(HciDataRingTest, push_wait_succeeds_once_drained) {
+  for (size_t i = 0; i < HciDataRing::kSize; i++)
+    ASSERT_TRUE(ring_->Push(MakePacket(0, i)));
+
+  std::thread consumer([this] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ring_->Pop();
+  });
+  EXPECT_TRUE(ring_->PushWait(MakePacket(0, HciDataRing::kSize), 10000));
+  consumer.join();
+}
+
+TEST_F(HciDataRingTest, one_drain_requested_until_it_runs) {
+  EXPECT_TRUE(ring_->RequestDrain());
+  EXPECT_FALSE(ring_->RequestDrain());
+  EXPECT_FALSE(ring_->RequestDrain());
+
+  ring_->BeginDrain();
+  EXPECT_TRUE(ring_->RequestDrain());
+}
+
+// Several threads queue packets while the consumer drains them in posted
+// tasks. Every packet has to arrive, in order per producer, with no packet
+// left behind because its drain request was lost.
+TEST_F(HciDataRingTest, stress_multiple_producers) {
+  std::unique_ptr<Consumer> consumer(new Consumer(ring_.get()));
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([this, &consumer, p] {
+      for (uintptr_t seq = 0; seq < kPacketsPerProducer; seq++) {
+        ASSERT_TRUE(ring_->PushWait(MakePacket(p, seq), 10000));
+        if (ring_->RequestDrain()) consumer->ScheduleDrain();
+      }
+    });
+  }
+  for (std::thread& producer : producers) producer.join();
+
+  consumer->Stop();
+  EXPECT_EQ(kProducers * kPacketsPerProducer, consumer->received());
+  EXPECT_EQ(0u, consumer->out_of_order());
+  EXPECT_EQ(nullptr, ring_->Pop());
+}
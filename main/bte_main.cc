@@ -39,13 +39,13 @@
 #include "bt_common.h"
 #include "bt_hci_bdroid.h"
 #include "bt_utils.h"
+#include "bta/sys/bta_sys.h"
 #include "bta_api.h"
 #include "btcore/include/module.h"
 #include "bte.h"
 #include "btif_common.h"
 #include "btsnoop.h"
 #include "btu.h"
-#include "device/include/interop.h"
 #include "hci_layer.h"
 #include "hcimsgs.h"
 #include "osi/include/alarm.h"
@@ -54,7 +54,6 @@
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/thread.h"
-#include "stack_config.h"
 
 /*******************************************************************************
  *  Constants & Macros
@@ -99,15 +98,11 @@ extern void btu_hci_msg_process(BT_HDR* p_msg);
  *****************************************************************************/
 void post_to_hci_message_loop(const tracked_objects::Location& from_here,
                               BT_HDR* p_msg) {
-  base::MessageLoop* hci_message_loop = get_message_loop();
-  if (!hci_message_loop || !hci_message_loop->task_runner().get()) {
+  if (bta_sys_post_msg(from_here, &btu_hci_msg_process, p_msg) !=
+      BT_STATUS_SUCCESS) {
     LOG_ERROR(LOG_TAG, "%s: HCI message loop not running, accessed from %s",
               __func__, from_here.ToString().c_str());
-    return;
   }
-
-  hci_message_loop->task_runner()->PostTask(
-      from_here, base::Bind(&btu_hci_msg_process, p_msg));
 }
 
 /******************************************************************************
@@ -120,8 +115,6 @@ void post_to_hci_message_loop(const tracked_objects::Location& from_here,
  *
  *****************************************************************************/
 void bte_main_boot_entry(void) {
-  module_init(get_module(INTEROP_MODULE));
-
   hci = hci_layer_get_interface();
   if (!hci) {
     LOG_ERROR(LOG_TAG, "%s could not get hci layer interface.", __func__);
@@ -129,23 +122,6 @@ void bte_main_boot_entry(void) {
   }
 
   hci->set_data_cb(base::Bind(&post_to_hci_message_loop));
-
-  module_init(get_module(STACK_CONFIG_MODULE));
-}
-
-/******************************************************************************
- *
- * Function         bte_main_cleanup
- *
- * Description      BTE MAIN API - Cleanup code for BTE chip/stack
- *
- * Returns          None
- *
- *****************************************************************************/
-void bte_main_cleanup() {
-  module_clean_up(get_module(STACK_CONFIG_MODULE));
-
-  module_clean_up(get_module(INTEROP_MODULE));
 }
 
 /******************************************************************************
@@ -161,8 +137,9 @@ void bte_main_cleanup() {
 void bte_main_enable() {
   APPL_TRACE_DEBUG("%s", __func__);
 
-  module_start_up(get_module(BTSNOOP_MODULE));
-  module_start_up(get_module(HCI_MODULE));
+  const module_t* modules[] = {get_module(BTSNOOP_MODULE),
+                               get_module(HCI_MODULE), NULL};
+  module_start_up_all(modules);
 
   BTU_StartUp();
 }
@@ -104,7 +104,7 @@ bool GetElementAttributesResponseBuilder::AddAttributeEntry(
     return false;
   }
 
-  entries_.insert(entry);
+  if (entries_.insert(entry).second) entries_size_ += entry.size();
   return true;
 }
 
@@ -114,13 +114,7 @@ bool GetElementAttributesResponseBuilder::AddAttributeEntry(Attribute attribute,
 }
 
 size_t GetElementAttributesResponseBuilder::size() const {
-  size_t attr_list_size = 0;
-
-  for (auto& attribute_entry : entries_) {
-    attr_list_size += attribute_entry.size();
-  }
-
-  return VendorPacket::kMinSize() + 1 + attr_list_size;
+  return VendorPacket::kMinSize() + 1 + entries_size_;
 }
 
 bool GetElementAttributesResponseBuilder::Serialize(
@@ -132,7 +126,7 @@ bool GetElementAttributesResponseBuilder::Serialize(
   VendorPacketBuilder::PushHeader(pkt, size() - VendorPacket::kMinSize());
 
   AddPayloadOctets1(pkt, entries_.size());
-  for (auto attribute_entry : entries_) {
+  for (const auto& attribute_entry : entries_) {
     PushAttributeValue(pkt, attribute_entry);
   }
 
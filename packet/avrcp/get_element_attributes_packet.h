@@ -74,6 +74,8 @@ class GetElementAttributesResponseBuilder : public VendorPacketBuilder {
 
  private:
   std::set<AttributeEntry> entries_;
+  // Combined size of the entries, kept up to date as entries are added
+  size_t entries_size_ = 0;
   size_t mtu_;
 
   GetElementAttributesResponseBuilder(size_t mtu)
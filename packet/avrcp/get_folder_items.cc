@@ -61,9 +61,7 @@ size_t GetFolderItemsResponseBuilder::size() const {
 
   len += 2;  // UID Counter
   len += 2;  // Number of Items;
-  for (const auto& item : items_) {
-    len += item.size();
-  }
+  len += items_size_;
 
   return len;
 }
@@ -96,27 +94,30 @@ bool GetFolderItemsResponseBuilder::Serialize(
 bool GetFolderItemsResponseBuilder::AddMediaPlayer(MediaPlayerItem item) {
   CHECK(scope_ == Scope::MEDIA_PLAYER_LIST);
 
-  if (size() + item.size() > mtu_) return false;
-
-  items_.push_back(MediaListItem(item));
-  return true;
+  return AddItem(MediaListItem(item));
 }
 
 bool GetFolderItemsResponseBuilder::AddSong(MediaElementItem item) {
   CHECK(scope_ == Scope::VFS || scope_ == Scope::NOW_PLAYING);
 
-  if (size() + item.size() > mtu_) return false;
-
-  items_.push_back(MediaListItem(item));
-  return true;
+  return AddItem(MediaListItem(item));
 }
 
 bool GetFolderItemsResponseBuilder::AddFolder(FolderItem item) {
   CHECK(scope_ == Scope::VFS);
 
-  if (size() + item.size() > mtu_) return false;
+  return AddItem(MediaListItem(item));
+}
+
+bool GetFolderItemsResponseBuilder::AddItem(MediaListItem item) {
+  // The UID counter and item count are only sent once there are items, so
+  // the first item has to make room for them as well
+  size_t new_size = size() + item.size();
+  if (items_.empty()) new_size += 4;
+  if (new_size > mtu_) return false;
 
-  items_.push_back(MediaListItem(item));
+  items_size_ += item.size();
+  items_.push_back(item);
   return true;
 }
 
@@ -175,9 +176,7 @@ void GetFolderItemsResponseBuilder::PushMediaPlayerItem(
   uint16_t name_len = item.name_.size();
   AddPayloadOctets2(pkt, base::ByteSwap(name_len));
 
-  for (const uint8_t& byte : item.name_) {
-    AddPayloadOctets1(pkt, byte);
-  }
+  AddPayloadString(pkt, item.name_);
 }
 
 void GetFolderItemsResponseBuilder::PushFolderItem(
@@ -192,9 +191,7 @@ void GetFolderItemsResponseBuilder::PushFolderItem(
                     base::ByteSwap((uint16_t)0x006a));  // UTF-8 Character Set
   uint16_t name_len = item.name_.size();
   AddPayloadOctets2(pkt, base::ByteSwap(name_len));
-  for (const uint8_t& byte : item.name_) {
-    AddPayloadOctets1(pkt, byte);
-  }
+  AddPayloadString(pkt, item.name_);
 }
 
 void GetFolderItemsResponseBuilder::PushMediaElementItem(
@@ -209,9 +206,7 @@ void GetFolderItemsResponseBuilder::PushMediaElementItem(
                     base::ByteSwap((uint16_t)0x006a));  // UTF-8 Character Set
   uint16_t name_len = item.name_.size();
   AddPayloadOctets2(pkt, base::ByteSwap(name_len));
-  for (const uint8_t& byte : item.name_) {
-    AddPayloadOctets1(pkt, byte);
-  }
+  AddPayloadString(pkt, item.name_);
 
   AddPayloadOctets1(pkt, (uint8_t)item.attributes_.size());
   for (const auto& entry : item.attributes_) {
@@ -219,13 +214,11 @@ void GetFolderItemsResponseBuilder::PushMediaElementItem(
     AddPayloadOctets2(pkt,
                       base::ByteSwap((uint16_t)0x006a));  // UTF-8 Character Set
 
-    std::string attr_val = entry.value();
+    const std::string& attr_val = entry.value();
     uint16_t attr_len = attr_val.size();
 
     AddPayloadOctets2(pkt, base::ByteSwap(attr_len));
-    for (const uint8_t& byte : attr_val) {
-      AddPayloadOctets1(pkt, byte);
-    }
+    AddPayloadString(pkt, attr_val);
   }
 }
 
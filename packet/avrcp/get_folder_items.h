@@ -43,6 +43,9 @@ class GetFolderItemsResponseBuilder : public BrowsePacketBuilder {
  protected:
   Scope scope_;
   std::vector<MediaListItem> items_;
+  // Combined size of the items, kept up to date as items are added so that
+  // neither fitting items to the MTU nor serializing has to walk the list
+  size_t items_size_ = 0;
   Status status_;
   uint16_t uid_counter_;
   size_t mtu_;
@@ -56,6 +59,9 @@ class GetFolderItemsResponseBuilder : public BrowsePacketBuilder {
         mtu_(mtu){};
 
  private:
+  // Returns true if the item was added without exceeding the MTU
+  bool AddItem(MediaListItem item);
+
   void PushMediaListItem(const std::shared_ptr<::bluetooth::Packet>& pkt,
                          const MediaListItem& item);
   void PushMediaPlayerItem(const std::shared_ptr<::bluetooth::Packet>& pkt,
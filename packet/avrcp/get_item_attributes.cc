@@ -39,7 +39,7 @@ bool GetItemAttributesResponseBuilder::AddAttributeEntry(AttributeEntry entry) {
     return false;
   }
 
-  entries_.insert(entry);
+  if (entries_.insert(entry).second) entries_size_ += entry.size();
   return true;
 }
 
@@ -54,9 +54,7 @@ size_t GetItemAttributesResponseBuilder::size() const {
   if (status_ != Status::NO_ERROR) return len;
 
   len += 1;  // Number of attributes
-  for (const auto& entry : entries_) {
-    len += entry.size();
-  }
+  len += entries_size_;
   return len;
 }
 
@@ -70,15 +68,13 @@ bool GetItemAttributesResponseBuilder::Serialize(
   if (status_ != Status::NO_ERROR) return true;
 
   AddPayloadOctets1(pkt, entries_.size());
-  for (auto entry : entries_) {
+  for (const auto& entry : entries_) {
     AddPayloadOctets4(pkt, base::ByteSwap((uint32_t)entry.attribute()));
     uint16_t character_set = 0x006a;  // UTF-8
     AddPayloadOctets2(pkt, base::ByteSwap(character_set));
     uint16_t value_length = entry.value().length();
     AddPayloadOctets2(pkt, base::ByteSwap(value_length));
-    for (const uint8_t& byte : entry.value()) {
-      AddPayloadOctets1(pkt, byte);
-    }
+    AddPayloadString(pkt, entry.value());
   }
 
   return true;
@@ -41,6 +41,8 @@ class GetItemAttributesResponseBuilder : public BrowsePacketBuilder {
   Status status_;
   size_t mtu_;
   std::set<AttributeEntry> entries_;
+  // Combined size of the entries, kept up to date as entries are added
+  size_t entries_size_ = 0;
 
   GetItemAttributesResponseBuilder(Status status, size_t mtu)
       : BrowsePacketBuilder(BrowsePdu::GET_ITEM_ATTRIBUTES),
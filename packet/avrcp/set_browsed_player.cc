@@ -71,9 +71,7 @@ bool SetBrowsedPlayerResponseBuilder::Serialize(
   if (folder_depth_ == 0) return true;
   uint16_t folder_name_len = folder_name_.size();
   AddPayloadOctets2(pkt, base::ByteSwap(folder_name_len));
-  for (auto it = folder_name_.begin(); it != folder_name_.end(); it++) {
-    AddPayloadOctets1(pkt, *it);
-  }
+  AddPayloadString(pkt, folder_name_);
 
   return true;
 }
@@ -24,6 +24,7 @@ namespace bluetooth {
 
 Iterator::Iterator(std::shared_ptr<const Packet> packet, size_t i) {
   packet_ = packet;
+  data_ = packet->data_.get();
   index_ = i;
 
   CHECK_GE(index_, packet->packet_start_index_);
@@ -93,6 +94,7 @@ Iterator& Iterator::operator--() {
 
 Iterator& Iterator::operator=(const Iterator& itr) {
   packet_ = itr.packet_;
+  data_ = itr.data_;
   index_ = itr.index_;
 
   return *this;
@@ -123,7 +125,19 @@ bool Iterator::operator>=(const Iterator& itr) const {
 uint8_t Iterator::operator*() const {
   CHECK_NE(index_, packet_->packet_end_index_);
 
-  return packet_->get_at_index(index_);
+  return (*data_)[index_];
+}
+
+const uint8_t* Iterator::consume(size_t length) {
+  // Running off the end fails the same way dereferencing end() does
+  if (length > packet_->packet_end_index_ - index_) {
+    index_ = packet_->packet_end_index_;
+  }
+  CHECK_NE(index_, packet_->packet_end_index_);
+
+  const uint8_t* bytes = data_->data() + index_;
+  index_ += length;
+  return bytes;
 }
 
 }  // namespace bluetooth
\ No newline at end of file
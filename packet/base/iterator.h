@@ -16,8 +16,10 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iterator>
 #include <memory>
+#include <vector>
 
 namespace bluetooth {
 
@@ -62,10 +64,10 @@ class Iterator
     static_assert(std::is_integral<FixedWidthIntegerType>::value,
                   "Iterator::extract requires an integral type.");
 
+    const uint8_t* bytes = consume(sizeof(FixedWidthIntegerType));
     FixedWidthIntegerType extracted_value = 0;
     for (size_t i = 0; i < sizeof(FixedWidthIntegerType); i++) {
-      extracted_value |= static_cast<FixedWidthIntegerType>(**this) << i * 8;
-      (*this)++;
+      extracted_value |= static_cast<FixedWidthIntegerType>(bytes[i]) << i * 8;
     }
 
     return extracted_value;
@@ -77,7 +79,13 @@ class Iterator
   uint64_t extract64() { return extract<uint64_t>(); }
 
  private:
+  // Returns a pointer to the next |length| bytes of the packet, which are
+  // stored contiguously, and moves the iterator past them.
+  const uint8_t* consume(size_t length);
+
   std::shared_ptr<const Packet> packet_;
+  // The packet's backing store, read directly rather than through the packet
+  const std::vector<uint8_t>* data_;
   size_t index_;
 };  // Iterator
 
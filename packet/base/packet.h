@@ -17,6 +17,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -67,6 +68,9 @@ class Packet : public std::enable_shared_from_this<Packet> {
   // std::shared_ptr<AvrcpPacket> base;
   // std::shared_ptr<AvrcpVendorPacket> p =
   //    Packet::Specialize<AvrcpVendorPacket>(base);
+  //
+  // The new packet shares the data of the old one and is allocated together
+  // with its reference count, so specializing costs a single allocation.
   template <class T, class U>
   static std::shared_ptr<T> Specialize(const std::shared_ptr<U>& pkt) {
     static_assert(std::is_convertible<U*, Packet*>::value,
@@ -75,8 +79,15 @@ class Packet : public std::enable_shared_from_this<Packet> {
                   "Unable to specialize to something that isn't a packet");
     static_assert(std::is_convertible<T*, U*>::value,
                   "Can not convert between the two packet types.");
-    return std::shared_ptr<T>(
-        new T(pkt, pkt->packet_start_index_, pkt->packet_end_index_));
+
+    // Packet constructors aren't public, so std::make_shared can only reach
+    // them through a subclass.
+    struct Specialized : public T {
+      Specialized(const std::shared_ptr<U>& pkt, size_t start, size_t end)
+          : T(pkt, start, end) {}
+    };
+    return std::make_shared<Specialized>(pkt, pkt->packet_start_index_,
+                                         pkt->packet_end_index_);
   };
 
  protected:
@@ -87,8 +98,8 @@ class Packet : public std::enable_shared_from_this<Packet> {
 
  private:
   // Only Available to the iterators
-  virtual size_t get_length() const;
-  virtual uint8_t get_at_index(size_t index) const;
+  size_t get_length() const;
+  uint8_t get_at_index(size_t index) const;
 
   // Returns the begining and end indicies of the payload of the packet.
   // Used when constructing a packet from another packet when moving
@@ -31,12 +31,20 @@ bool PacketBuilder::AddPayloadOctets(const std::shared_ptr<Packet>& pkt,
                                      size_t octets, uint64_t value) {
   CHECK_LE(octets, sizeof(uint64_t));
 
+  uint8_t bytes[sizeof(uint64_t)];
   for (size_t i = 0; i < octets; i++) {
-    pkt->data_->push_back(value & 0xff);
-    pkt->packet_end_index_++;
+    bytes[i] = value & 0xff;
     value = value >> 8;
   }
 
+  return AddPayloadBytes(pkt, bytes, octets);
+}
+
+bool PacketBuilder::AddPayloadBytes(const std::shared_ptr<Packet>& pkt,
+                                    const uint8_t* bytes, size_t length) {
+  pkt->data_->insert(pkt->data_->end(), bytes, bytes + length);
+  pkt->packet_end_index_ += length;
+
   return true;
 }
 
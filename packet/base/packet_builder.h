@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 
 namespace bluetooth {
 
@@ -51,6 +53,15 @@ class PacketBuilder {
     return AddPayloadOctets(pkt, 8, value);
   }
 
+  // Add |length| bytes copied from |bytes| to the payload in one go.
+  bool AddPayloadBytes(const std::shared_ptr<Packet>& pkt,
+                       const uint8_t* bytes, size_t length);
+  bool AddPayloadString(const std::shared_ptr<Packet>& pkt,
+                        const std::string& str) {
+    return AddPayloadBytes(pkt, reinterpret_cast<const uint8_t*>(str.data()),
+                           str.size());
+  }
+
  private:
   // Add |octets| bytes to the payload.  Return true if:
   // - the value of |value| fits in |octets| bytes and
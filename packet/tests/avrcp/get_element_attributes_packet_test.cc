@@ -84,6 +84,9 @@ TEST(GetElementAttributesResponseBuilderTest, builderLengthTest) {
   ASSERT_EQ(builder->size(), 23u);
   builder->AddAttributeEntry(Attribute::ARTIST_NAME, "test");
   ASSERT_EQ(builder->size(), 35u);
+  // Only the first entry for an attribute is kept
+  builder->AddAttributeEntry(Attribute::ARTIST_NAME, "test again");
+  ASSERT_EQ(builder->size(), 35u);
 }
 
 TEST(GetElementAttributesResponseBuilderTest, builderTest) {
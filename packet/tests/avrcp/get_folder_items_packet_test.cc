@@ -100,6 +100,27 @@ TEST(GetFolderItemsResponseBuilderTest, builderFolderAddMtuTest) {
   ASSERT_TRUE(builder->AddFolder(folder1));
   ASSERT_FALSE(builder->AddFolder(folder2));
   ASSERT_TRUE(builder->AddFolder(folder3));
+  ASSERT_EQ(builder->size(), packet_size);
+}
+
+TEST(GetFolderItemsResponseBuilderTest, builderFirstItemMtuTest) {
+  FolderItem folder(0x01, 0x00, true, "Folder 1");
+
+  // The first item also brings in the UID Counter and Number of Items fields
+  auto packet_size = BrowsePacket::kMinSize() + 5 + folder.size();
+
+  auto builder = GetFolderItemsResponseBuilder::MakeVFSBuilder(
+      Status::NO_ERROR, 0x0000, packet_size - 1);
+  ASSERT_FALSE(builder->AddFolder(folder));
+
+  builder = GetFolderItemsResponseBuilder::MakeVFSBuilder(Status::NO_ERROR,
+                                                          0x0000, packet_size);
+  ASSERT_TRUE(builder->AddFolder(folder));
+  ASSERT_EQ(builder->size(), packet_size);
+
+  auto test_packet = TestGetFolderItemsReqPacket::Make();
+  builder->Serialize(test_packet);
+  ASSERT_EQ(test_packet->GetData().size(), packet_size);
 }
 
 TEST(GetFolderItemsResponseBuilderTest, builderSongSizeTest) {
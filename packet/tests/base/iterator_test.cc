@@ -87,6 +87,13 @@ TEST_P(IteratorTest, extractBoundsDeathTest) {
                "index_ != packet_->packet_end_index_");
   ASSERT_DEATH(bounds_test.extract<uint64_t>(),
                "index_ != packet_->packet_end_index_");
+
+  // Values that straddle the end of the packet can't be extracted either
+  bounds_test = packet->end() - static_cast<size_t>(1);
+  ASSERT_DEATH(bounds_test.extract<uint16_t>(),
+               "index_ != packet_->packet_end_index_");
+  ASSERT_EQ(bounds_test.extract<uint8_t>(),
+            test_l2cap_data[GetUpperBound() - 1]);
 }
 
 TEST_P(IteratorTest, dereferenceDeathTest) {
@@ -68,4 +68,22 @@ TEST(PacketBuilderTest, addPayloadOctetsTest) {
   }
 }
 
+TEST(PacketBuilderTest, addPayloadBytesTest) {
+  auto builder = TestPacketBuilder::MakeBuilder(test_l2cap_data);
+  auto packet = TestPacket::Make();
+
+  builder->AddPayloadOctets1(packet, 0x01u);
+  builder->AddPayloadBytes(packet, test_l2cap_data.data(),
+                           test_l2cap_data.size());
+  builder->AddPayloadString(packet, "Test");
+
+  ASSERT_EQ(packet->size(), 1 + test_l2cap_data.size() + 4);
+  ASSERT_EQ((*packet)[0], 0x01u);
+  for (size_t i = 0; i < test_l2cap_data.size(); i++) {
+    ASSERT_EQ((*packet)[i + 1], test_l2cap_data[i]);
+  }
+  ASSERT_EQ((*packet)[test_l2cap_data.size() + 1], 'T');
+  ASSERT_EQ((*packet)[test_l2cap_data.size() + 4], 't');
+}
+
 }  // namespace bluetooth
\ No newline at end of file
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "avrcp.h"
+
+namespace bluetooth {
+namespace avrcp {
+
+// Holds the last listing fetched from the Media Interface layer for a browse
+// scope so that a remote paging through a large folder, or asking for its
+// item count or for the attributes of a single item, doesn't pull the whole
+// list across again for every request. Items are indexed by media ID.
+//
+// Every invalidation bumps the generation. A fetch remembers the generation
+// it was started in and its result is only kept as valid if nothing was
+// invalidated while it was in flight, since the media layer may have changed
+// the content underneath it.
+template <typename T>
+class BrowseCache {
+ public:
+  uint32_t generation() const { return generation_; }
+
+  bool IsValid(int player_id, const std::string& folder) const {
+    return valid_ && player_id_ == player_id && folder_ == folder;
+  }
+
+  void Invalidate() {
+    valid_ = false;
+    generation_++;
+  }
+
+  void Update(uint32_t generation, int player_id, std::string folder,
+              std::string curr_media_id, std::vector<T> items) {
+    valid_ = (generation == generation_);
+    player_id_ = player_id;
+    folder_ = std::move(folder);
+    curr_media_id_ = std::move(curr_media_id);
+    items_ = std::move(items);
+
+    index_.clear();
+    index_.reserve(items_.size());
+    // Like a linear search for the last match, a repeated ID maps to the
+    // last item carrying it
+    for (size_t i = 0; i < items_.size(); i++) {
+      index_[media_id(items_[i])] = i;
+    }
+  }
+
+  const std::string& curr_media_id() const { return curr_media_id_; }
+  const std::vector<T>& items() const { return items_; }
+
+  // Returns nullptr if the listing has no item with the given media ID.
+  const T* Find(const std::string& id) const {
+    const auto& it = index_.find(id);
+    if (it == index_.end()) return nullptr;
+    return &items_[it->second];
+  }
+
+ private:
+  static const std::string& media_id(const SongInfo& song) {
+    return song.media_id;
+  }
+
+  static const std::string& media_id(const ListItem& item) {
+    return item.type == ListItem::FOLDER ? item.folder.media_id
+                                         : item.song.media_id;
+  }
+
+  bool valid_ = false;
+  uint32_t generation_ = 0;
+  int player_id_ = -1;
+  std::string folder_;
+  std::string curr_media_id_;
+  std::vector<T> items_;
+  std::unordered_map<std::string, size_t> index_;
+};
+
+}  // namespace avrcp
+}  // namespace bluetooth
@@ -29,6 +29,7 @@
 // handling.
 #include "bta/include/bta_av_api.h"
 #include "device/include/interop.h"
+#include "l2cdefs.h"
 #include "osi/include/allocator.h"
 #include "osi/include/properties.h"
 
@@ -502,18 +503,24 @@ void ConnectionHandler::SdpCb(const RawAddress& bdaddr, SdpCallback cb,
 void ConnectionHandler::SendMessage(
     uint8_t handle, uint8_t label, bool browse,
     std::unique_ptr<::bluetooth::PacketBuilder> message) {
-  std::shared_ptr<::bluetooth::Packet> packet = VectorPacket::Make();
+  // The builder reserves its exact size before serializing, so this is a
+  // single allocation that is then copied into a BT_HDR of matching size.
+  std::shared_ptr<VectorPacket> packet = VectorPacket::Make();
   message->Serialize(packet);
 
   uint8_t ctype = AVRC_RSP_ACCEPT;
   if (!browse) {
-    ctype =
-        (uint8_t)(::bluetooth::Packet::Specialize<Packet>(packet)->GetCType());
+    std::shared_ptr<::bluetooth::Packet> base_packet = packet;
+    ctype = (uint8_t)(::bluetooth::Packet::Specialize<Packet>(base_packet)
+                          ->GetCType());
   }
 
   DLOG(INFO) << "SendMessage to handle=" << loghex(handle);
 
-  BT_HDR* pkt = (BT_HDR*)osi_malloc(BT_DEFAULT_BUFFER_SIZE);
+  // Leave headroom for the AVCTP and L2CAP headers, and room after the
+  // payload for the FCS L2CAP appends in ERTM mode
+  BT_HDR* pkt = (BT_HDR*)osi_malloc(sizeof(BT_HDR) + AVCT_MSG_OFFSET +
+                                    packet->size() + L2CAP_FCS_LEN);
 
   pkt->offset = AVCT_MSG_OFFSET;
   // TODO (apanicke): Update this constant. Currently this is a unique event
@@ -531,9 +538,7 @@ void ConnectionHandler::SendMessage(
 
   pkt->len = packet->size();
   uint8_t* p_data = (uint8_t*)(pkt + 1) + pkt->offset;
-  for (auto it = packet->begin(); it != packet->end(); it++) {
-    *p_data++ = *it;
-  }
+  memcpy(p_data, packet->GetData().data(), pkt->len);
 
   avrc_->MsgReq(handle, label, ctype, pkt);
 }
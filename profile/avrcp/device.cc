@@ -695,6 +695,77 @@ void Device::BrowseMessageReceived(uint8_t label,
   }
 }
 
+void Device::GetFolderItemsCached(FolderItemsCachedCallback cb) {
+  int player_id = curr_browsed_player_id_;
+  std::string folder = CurrentFolder();
+
+  if (vfs_cache_.IsValid(player_id, folder)) {
+    DEVICE_VLOG(3) << __func__ << ": using cached listing of \"" << folder
+                   << "\"";
+    cb.Run(vfs_cache_.items());
+    return;
+  }
+
+  media_interface_->GetFolderItems(
+      player_id, folder,
+      base::Bind(&Device::FolderItemsFetched, weak_ptr_factory_.GetWeakPtr(),
+                 vfs_cache_.generation(), player_id, folder, cb));
+}
+
+void Device::FolderItemsFetched(uint32_t generation, int player_id,
+                                std::string folder,
+                                FolderItemsCachedCallback cb,
+                                std::vector<ListItem> items) {
+  DEVICE_VLOG(3) << __func__ << ": folder=\"" << folder
+                 << "\" num_items=" << items.size();
+
+  // Map every item to a UID once per fetch rather than on every page. Only
+  // the items of the listing that is cached can be referred to by UID, the
+  // ones of the listing it replaces are dropped along with it.
+  std::vector<std::string> media_ids;
+  media_ids.reserve(items.size());
+  for (const auto& item : items) {
+    if (item.type == ListItem::FOLDER) {
+      media_ids.push_back(item.folder.media_id);
+    } else if (item.type == ListItem::SONG) {
+      media_ids.push_back(item.song.media_id);
+    }
+  }
+  vfs_ids_.rebuild(media_ids);
+
+  vfs_cache_.Update(generation, player_id, std::move(folder), "",
+                    std::move(items));
+  cb.Run(vfs_cache_.items());
+}
+
+void Device::GetNowPlayingListCached(NowPlayingCachedCallback cb) {
+  if (now_playing_cache_.IsValid(-1, "")) {
+    DEVICE_VLOG(3) << __func__ << ": using cached now playing list";
+    cb.Run(now_playing_cache_.curr_media_id(), now_playing_cache_.items());
+    return;
+  }
+
+  media_interface_->GetNowPlayingList(
+      base::Bind(&Device::NowPlayingListFetched, weak_ptr_factory_.GetWeakPtr(),
+                 now_playing_cache_.generation(), cb));
+}
+
+void Device::NowPlayingListFetched(uint32_t generation,
+                                   NowPlayingCachedCallback cb,
+                                   std::string curr_song_id,
+                                   std::vector<SongInfo> song_list) {
+  DEVICE_VLOG(3) << __func__ << ": num_items=" << song_list.size();
+
+  now_playing_ids_.clear();
+  for (const SongInfo& song : song_list) {
+    now_playing_ids_.insert(song.media_id);
+  }
+
+  now_playing_cache_.Update(generation, -1, "", std::move(curr_song_id),
+                            std::move(song_list));
+  cb.Run(now_playing_cache_.curr_media_id(), now_playing_cache_.items());
+}
+
 void Device::HandleGetFolderItems(uint8_t label,
                                   std::shared_ptr<GetFolderItemsRequest> pkt) {
   DEVICE_VLOG(2) << __func__ << ": scope=" << pkt->GetScope();
@@ -706,15 +777,14 @@ void Device::HandleGetFolderItems(uint8_t label,
                      weak_ptr_factory_.GetWeakPtr(), label, pkt));
       break;
     case Scope::VFS:
-      media_interface_->GetFolderItems(
-          curr_browsed_player_id_, CurrentFolder(),
-          base::Bind(&Device::GetVFSListResponse,
-                     weak_ptr_factory_.GetWeakPtr(), label, pkt));
+      GetFolderItemsCached(base::Bind(&Device::GetVFSListResponse,
+                                      weak_ptr_factory_.GetWeakPtr(), label,
+                                      pkt));
       break;
     case Scope::NOW_PLAYING:
-      media_interface_->GetNowPlayingList(
-          base::Bind(&Device::GetNowPlayingListResponse,
-                     weak_ptr_factory_.GetWeakPtr(), label, pkt));
+      GetNowPlayingListCached(base::Bind(&Device::GetNowPlayingListResponse,
+                                         weak_ptr_factory_.GetWeakPtr(), label,
+                                         pkt));
       break;
     default:
       DEVICE_LOG(ERROR) << __func__ << ": " << pkt->GetScope();
@@ -734,13 +804,12 @@ void Device::HandleGetTotalNumberOfItems(
       break;
     }
     case Scope::VFS:
-      media_interface_->GetFolderItems(
-          curr_browsed_player_id_, CurrentFolder(),
+      GetFolderItemsCached(
           base::Bind(&Device::GetTotalNumberOfItemsVFSResponse,
                      weak_ptr_factory_.GetWeakPtr(), label));
       break;
     case Scope::NOW_PLAYING:
-      media_interface_->GetNowPlayingList(
+      GetNowPlayingListCached(
           base::Bind(&Device::GetTotalNumberOfItemsNowPlayingResponse,
                      weak_ptr_factory_.GetWeakPtr(), label));
       break;
@@ -759,8 +828,8 @@ void Device::GetTotalNumberOfItemsMediaPlayersResponse(
   send_message(label, true, std::move(builder));
 }
 
-void Device::GetTotalNumberOfItemsVFSResponse(uint8_t label,
-                                              std::vector<ListItem> list) {
+void Device::GetTotalNumberOfItemsVFSResponse(
+    uint8_t label, const std::vector<ListItem>& list) {
   DEVICE_VLOG(2) << __func__ << ": num_items=" << list.size();
 
   auto builder = GetTotalNumberOfItemsResponseBuilder::MakeBuilder(
@@ -769,7 +838,8 @@ void Device::GetTotalNumberOfItemsVFSResponse(uint8_t label,
 }
 
 void Device::GetTotalNumberOfItemsNowPlayingResponse(
-    uint8_t label, std::string curr_song_id, std::vector<SongInfo> list) {
+    uint8_t label, const std::string& curr_song_id,
+    const std::vector<SongInfo>& list) {
   DEVICE_VLOG(2) << __func__ << ": num_items=" << list.size();
 
   auto builder = GetTotalNumberOfItemsResponseBuilder::MakeBuilder(
@@ -811,15 +881,16 @@ void Device::HandleChangePath(uint8_t label,
                    << "\"";
   }
 
-  media_interface_->GetFolderItems(
-      curr_browsed_player_id_, CurrentFolder(),
-      base::Bind(&Device::ChangePathResponse, weak_ptr_factory_.GetWeakPtr(),
-                 label, pkt));
+  // Entering a folder always refreshes its listing, which then serves the
+  // item count and folder item requests that usually follow.
+  vfs_cache_.Invalidate();
+  GetFolderItemsCached(base::Bind(&Device::ChangePathResponse,
+                                  weak_ptr_factory_.GetWeakPtr(), label, pkt));
 }
 
 void Device::ChangePathResponse(uint8_t label,
                                 std::shared_ptr<ChangePathRequest> pkt,
-                                std::vector<ListItem> list) {
+                                const std::vector<ListItem>& list) {
   // TODO (apanicke): Reconstruct the VFS ID's here. Right now it gets
   // reconstructed in GetFolderItemsVFS
   auto builder =
@@ -841,7 +912,7 @@ void Device::HandleGetItemAttributes(
   }
   switch (pkt->GetScope()) {
     case Scope::NOW_PLAYING: {
-      media_interface_->GetNowPlayingList(
+      GetNowPlayingListCached(
           base::Bind(&Device::GetItemAttributesNowPlayingResponse,
                      weak_ptr_factory_.GetWeakPtr(), label, pkt));
     } break;
@@ -850,8 +921,7 @@ void Device::HandleGetItemAttributes(
       // then we can auto send the error without calling up. We do this check
       // later right now though in order to prevent race conditions with updates
       // on the media layer.
-      media_interface_->GetFolderItems(
-          curr_browsed_player_id_, CurrentFolder(),
+      GetFolderItemsCached(
           base::Bind(&Device::GetItemAttributesVFSResponse,
                      weak_ptr_factory_.GetWeakPtr(), label, pkt));
       break;
@@ -863,7 +933,7 @@ void Device::HandleGetItemAttributes(
 
 void Device::GetItemAttributesNowPlayingResponse(
     uint8_t label, std::shared_ptr<GetItemAttributesRequest> pkt,
-    std::string curr_media_id, std::vector<SongInfo> song_list) {
+    const std::string& curr_media_id, const std::vector<SongInfo>& song_list) {
   DEVICE_VLOG(2) << __func__ << ": uid=" << loghex(pkt->GetUid());
   auto builder = GetItemAttributesResponseBuilder::MakeBuilder(Status::NO_ERROR,
                                                                browse_mtu_);
@@ -875,12 +945,10 @@ void Device::GetItemAttributesNowPlayingResponse(
 
   DEVICE_VLOG(2) << __func__ << ": media_id=\"" << media_id << "\"";
 
+  // song_list is the cached now playing list, look the song up by its index
   SongInfo info;
-  for (const auto& temp : song_list) {
-    if (temp.media_id == media_id) {
-      info = temp;
-    }
-  }
+  const SongInfo* found = now_playing_cache_.Find(media_id);
+  if (found != nullptr) info = *found;
 
   auto attributes_requested = pkt->GetAttributesRequested();
   if (attributes_requested.size() != 0) {
@@ -902,7 +970,7 @@ void Device::GetItemAttributesNowPlayingResponse(
 
 void Device::GetItemAttributesVFSResponse(
     uint8_t label, std::shared_ptr<GetItemAttributesRequest> pkt,
-    std::vector<ListItem> item_list) {
+    const std::vector<ListItem>& item_list) {
   DEVICE_VLOG(2) << __func__ << ": uid=" << loghex(pkt->GetUid());
 
   auto media_id = vfs_ids_.get_media_id(pkt->GetUid());
@@ -917,13 +985,10 @@ void Device::GetItemAttributesVFSResponse(
   auto builder = GetItemAttributesResponseBuilder::MakeBuilder(Status::NO_ERROR,
                                                                browse_mtu_);
 
+  // item_list is the cached folder listing, look the item up by its index
   ListItem item_requested;
-  for (const auto& temp : item_list) {
-    if ((temp.type == ListItem::FOLDER && temp.folder.media_id == media_id) ||
-        (temp.type == ListItem::SONG && temp.song.media_id == media_id)) {
-      item_requested = temp;
-    }
-  }
+  const ListItem* found = vfs_cache_.Find(media_id);
+  if (found != nullptr) item_requested = *found;
 
   // TODO (apanicke): Add a helper function or allow adding a map
   // of attributes to GetItemAttributesResponseBuilder
@@ -1011,7 +1076,7 @@ std::set<AttributeEntry> filter_attributes_requested(
 
 void Device::GetVFSListResponse(uint8_t label,
                                 std::shared_ptr<GetFolderItemsRequest> pkt,
-                                std::vector<ListItem> items) {
+                                const std::vector<ListItem>& items) {
   DEVICE_VLOG(2) << __func__ << ": start_item=" << pkt->GetStartItem()
                  << " end_item=" << pkt->GetEndItem();
 
@@ -1019,21 +1084,10 @@ void Device::GetVFSListResponse(uint8_t label,
   auto builder = GetFolderItemsResponseBuilder::MakeVFSBuilder(
       Status::NO_ERROR, 0x0000, browse_mtu_);
 
-  // TODO (apanicke): Add test that checks if vfs_ids_ is the correct size after
-  // an operation.
-  for (const auto& item : items) {
-    if (item.type == ListItem::FOLDER) {
-      vfs_ids_.insert(item.folder.media_id);
-    } else if (item.type == ListItem::SONG) {
-      vfs_ids_.insert(item.song.media_id);
-    }
-  }
-
-  // Add the elements retrieved in the last get folder items request and map
-  // them to UIDs The maps will be cleared every time a directory change
-  // happens. These items do not need to correspond with the now playing list as
-  // the UID's only need to be unique in the context of the current scope and
-  // the current folder
+  // The elements retrieved in the last get folder items request were mapped
+  // to UIDs when the listing was fetched. These items do not need to
+  // correspond with the now playing list as the UID's only need to be unique
+  // in the context of the current scope and the current folder
   for (auto i = pkt->GetStartItem(); i <= pkt->GetEndItem() && i < items.size();
        i++) {
     if (items[i].type == ListItem::FOLDER) {
@@ -1043,7 +1097,7 @@ void Device::GetVFSListResponse(uint8_t label,
                              folder.is_playable, folder.name);
       builder->AddFolder(folder_item);
     } else if (items[i].type == ListItem::SONG) {
-      auto song = items[i].song;
+      const auto& song = items[i].song;
       auto title =
           song.attributes.find(Attribute::TITLE) != song.attributes.end()
               ? song.attributes.find(Attribute::TITLE)->value()
@@ -1052,7 +1106,7 @@ void Device::GetVFSListResponse(uint8_t label,
                                  std::set<AttributeEntry>());
 
       if (pkt->GetNumAttributes() == 0x00) {  // All attributes requested
-        song_item.attributes_ = std::move(song.attributes);
+        song_item.attributes_ = song.attributes;
       } else {
         song_item.attributes_ =
             filter_attributes_requested(song, pkt->GetAttributesRequested());
@@ -1067,26 +1121,22 @@ void Device::GetVFSListResponse(uint8_t label,
 
 void Device::GetNowPlayingListResponse(
     uint8_t label, std::shared_ptr<GetFolderItemsRequest> pkt,
-    std::string /* unused curr_song_id */, std::vector<SongInfo> song_list) {
+    const std::string& /* unused curr_song_id */,
+    const std::vector<SongInfo>& song_list) {
   DEVICE_VLOG(2) << __func__;
   auto builder = GetFolderItemsResponseBuilder::MakeNowPlayingBuilder(
       Status::NO_ERROR, 0x0000, browse_mtu_);
 
-  now_playing_ids_.clear();
-  for (const SongInfo& song : song_list) {
-    now_playing_ids_.insert(song.media_id);
-  }
-
   for (size_t i = pkt->GetStartItem();
        i <= pkt->GetEndItem() && i < song_list.size(); i++) {
-    auto song = song_list[i];
+    const auto& song = song_list[i];
     auto title = song.attributes.find(Attribute::TITLE) != song.attributes.end()
                      ? song.attributes.find(Attribute::TITLE)->value()
                      : "No Song Info";
 
     MediaElementItem item(i + 1, title, std::set<AttributeEntry>());
     if (pkt->GetNumAttributes() == 0x00) {
-      item.attributes_ = std::move(song.attributes);
+      item.attributes_ = song.attributes;
     } else {
       item.attributes_ =
           filter_attributes_requested(song, pkt->GetAttributesRequested());
@@ -1121,6 +1171,10 @@ void Device::SetBrowsedPlayerResponse(
 
   curr_browsed_player_id_ = pkt->GetPlayerId();
 
+  // UIDs are only unique within a player, start the mapping over.
+  vfs_cache_.Invalidate();
+  vfs_ids_.clear();
+
   // Clear the path and push the new root.
   current_path_ = std::stack<std::string>();
   current_path_.push(root_id);
@@ -1135,6 +1189,10 @@ void Device::SendMediaUpdate(bool metadata, bool play_status, bool queue) {
   DEVICE_VLOG(4) << __func__ << ": Metadata=" << metadata
                  << " : play_status= " << play_status << " : queue=" << queue;
 
+  // The now playing list carries the current song, so a track change makes
+  // the cached copy stale as well.
+  if (metadata || queue) now_playing_cache_.Invalidate();
+
   if (queue) {
     HandleNowPlayingUpdate();
   }
@@ -1152,6 +1210,13 @@ void Device::SendFolderUpdate(bool available_players, bool addressed_player,
   CHECK(media_interface_);
   DEVICE_VLOG(4) << __func__;
 
+  // The media layer reports any change to the browsable content as a UID
+  // change. A different addressed player has its own now playing list.
+  if (available_players || addressed_player || uids) {
+    vfs_cache_.Invalidate();
+    now_playing_cache_.Invalidate();
+  }
+
   if (available_players) {
     HandleAvailablePlayerUpdate();
   }
@@ -26,6 +26,7 @@
 #include "avrcp.h"
 #include "avrcp_internal.h"
 #include "avrcp_packet.h"
+#include "browse_cache.h"
 #include "media_id_map.h"
 #include "raw_address.h"
 
@@ -173,30 +174,32 @@ class Device {
       uint16_t curr_player, std::vector<MediaPlayerInfo> players);
   virtual void GetVFSListResponse(uint8_t label,
                                   std::shared_ptr<GetFolderItemsRequest> pkt,
-                                  std::vector<ListItem> items);
+                                  const std::vector<ListItem>& items);
   virtual void GetNowPlayingListResponse(
       uint8_t label, std::shared_ptr<GetFolderItemsRequest> pkt,
-      std::string curr_song_id, std::vector<SongInfo> song_list);
+      const std::string& curr_song_id, const std::vector<SongInfo>& song_list);
 
   // GET TOTAL NUMBER OF ITEMS
   virtual void HandleGetTotalNumberOfItems(
       uint8_t label, std::shared_ptr<GetTotalNumberOfItemsRequest> pkt);
   virtual void GetTotalNumberOfItemsMediaPlayersResponse(
       uint8_t label, uint16_t curr_player, std::vector<MediaPlayerInfo> list);
-  virtual void GetTotalNumberOfItemsVFSResponse(uint8_t label,
-                                                std::vector<ListItem> items);
+  virtual void GetTotalNumberOfItemsVFSResponse(
+      uint8_t label, const std::vector<ListItem>& items);
   virtual void GetTotalNumberOfItemsNowPlayingResponse(
-      uint8_t label, std::string curr_song_id, std::vector<SongInfo> song_list);
+      uint8_t label, const std::string& curr_song_id,
+      const std::vector<SongInfo>& song_list);
 
   // GET ITEM ATTRIBUTES
   virtual void HandleGetItemAttributes(
       uint8_t label, std::shared_ptr<GetItemAttributesRequest> request);
   virtual void GetItemAttributesNowPlayingResponse(
       uint8_t label, std::shared_ptr<GetItemAttributesRequest> pkt,
-      std::string curr_media_id, std::vector<SongInfo> song_list);
+      const std::string& curr_media_id,
+      const std::vector<SongInfo>& song_list);
   virtual void GetItemAttributesVFSResponse(
       uint8_t label, std::shared_ptr<GetItemAttributesRequest> pkt,
-      std::vector<ListItem> item_list);
+      const std::vector<ListItem>& item_list);
 
   // SET BROWSED PLAYER
   virtual void HandleSetBrowsedPlayer(
@@ -210,7 +213,7 @@ class Device {
                                 std::shared_ptr<ChangePathRequest> request);
   virtual void ChangePathResponse(uint8_t label,
                                   std::shared_ptr<ChangePathRequest> request,
-                                  std::vector<ListItem> list);
+                                  const std::vector<ListItem>& list);
 
   // PLAY ITEM
   virtual void HandlePlayItem(uint8_t label,
@@ -254,6 +257,22 @@ class Device {
     return current_path_.top();
   }
 
+  // Browsing requests go through these so the current folder listing and the
+  // now playing list are only fetched from the media layer when the cached
+  // copy was invalidated.
+  using FolderItemsCachedCallback =
+      base::Callback<void(const std::vector<ListItem>&)>;
+  using NowPlayingCachedCallback = base::Callback<void(
+      const std::string&, const std::vector<SongInfo>&)>;
+  void GetFolderItemsCached(FolderItemsCachedCallback cb);
+  void FolderItemsFetched(uint32_t generation, int player_id,
+                          std::string folder, FolderItemsCachedCallback cb,
+                          std::vector<ListItem> items);
+  void GetNowPlayingListCached(NowPlayingCachedCallback cb);
+  void NowPlayingListFetched(uint32_t generation, NowPlayingCachedCallback cb,
+                             std::string curr_song_id,
+                             std::vector<SongInfo> song_list);
+
   void send_message(uint8_t label, bool browse,
                     std::unique_ptr<::bluetooth::PacketBuilder> message) {
     active_labels_.erase(label);
@@ -290,6 +309,9 @@ class Device {
   MediaIdMap vfs_ids_;
   MediaIdMap now_playing_ids_;
 
+  BrowseCache<ListItem> vfs_cache_;
+  BrowseCache<SongInfo> now_playing_cache_;
+
   uint32_t play_pos_interval_ = 0;
 
   SongInfo last_song_info_;
@@ -16,19 +16,23 @@
 
 #pragma once
 
-#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace bluetooth {
 namespace avrcp {
 
 // A helper class to convert Media ID's (represented as strings) that are
 // received from the AVRCP Media Interface layer into UID's to be used
-// with connected devices.
+// with connected devices. UID's are handed out sequentially starting at 1
+// and are not reused until the map is cleared.
 class MediaIdMap {
  public:
   void clear() {
     media_id_to_uid_.clear();
     uid_to_media_id_.clear();
+    next_uid_ = 1;
   }
 
   std::string get_media_id(uint64_t uid) {
@@ -44,19 +48,39 @@ class MediaIdMap {
   }
 
   uint64_t insert(std::string media_id) {
-    if (media_id_to_uid_.find(media_id) != media_id_to_uid_.end()) {
-      return media_id_to_uid_[media_id];
-    }
+    const auto& media_id_it = media_id_to_uid_.find(media_id);
+    if (media_id_it != media_id_to_uid_.end()) return media_id_it->second;
 
-    uint64_t uid = media_id_to_uid_.size() + 1;
-    media_id_to_uid_.insert(std::pair<std::string, uint64_t>(media_id, uid));
-    uid_to_media_id_.insert(std::pair<uint64_t, std::string>(uid, media_id));
+    uint64_t uid = next_uid_++;
+    media_id_to_uid_.emplace(media_id, uid);
+    uid_to_media_id_.emplace(uid, std::move(media_id));
     return uid;
   }
 
+  // Maps exactly the given Media ID's. Those already mapped keep their UID,
+  // the others are dropped and their UID's are not handed out again, so a
+  // stale UID doesn't resolve to a different item.
+  void rebuild(const std::vector<std::string>& media_ids) {
+    std::unordered_map<std::string, uint64_t> media_id_to_uid;
+    std::unordered_map<uint64_t, std::string> uid_to_media_id;
+    for (const auto& media_id : media_ids) {
+      if (media_id_to_uid.count(media_id)) continue;
+
+      uint64_t uid = get_uid(media_id);
+      if (uid == 0) uid = next_uid_++;
+      media_id_to_uid.emplace(media_id, uid);
+      uid_to_media_id.emplace(uid, media_id);
+    }
+    media_id_to_uid_.swap(media_id_to_uid);
+    uid_to_media_id_.swap(uid_to_media_id);
+  }
+
+  size_t size() const { return uid_to_media_id_.size(); }
+
  private:
-  std::map<std::string, uint64_t> media_id_to_uid_;
-  std::map<uint64_t, std::string> uid_to_media_id_;
+  std::unordered_map<std::string, uint64_t> media_id_to_uid_;
+  std::unordered_map<uint64_t, std::string> uid_to_media_id_;
+  uint64_t next_uid_ = 1;
 };
 
 }  // namespace avrcp
@@ -833,6 +833,77 @@ TEST_F(AvrcpDeviceTest, getFolderItemsMtuTest) {
       1, TestBrowsePacket::Make(get_folder_items_request_vfs));
 }
 
+TEST_F(AvrcpDeviceTest, largeFolderListingCachedTest) {
+  MockMediaInterface interface;
+  NiceMock<MockA2dpInterface> a2dp_interface;
+
+  test_device->RegisterInterfaces(&interface, &a2dp_interface, nullptr);
+
+  std::vector<ListItem> list;
+  for (int i = 0; i < 10000; i++) {
+    std::string id = "test_id" + std::to_string(i);
+    list.push_back({ListItem::FOLDER,
+                    {id, true, "Test Folder" + std::to_string(i)},
+                    SongInfo()});
+  }
+
+  // Paging through the folder and asking for its size only fetches it once
+  EXPECT_CALL(interface, GetFolderItems(_, "", _))
+      .Times(1)
+      .WillOnce(InvokeCb<2>(list));
+
+  auto expected_response = GetFolderItemsResponseBuilder::MakeVFSBuilder(
+      Status::NO_ERROR, 0x0000, 0xFFFF);
+  expected_response->AddFolder(FolderItem(1, 0, true, "Test Folder0"));
+  expected_response->AddFolder(FolderItem(2, 0, true, "Test Folder1"));
+  EXPECT_CALL(response_cb,
+              Call(1, true, matchPacket(std::move(expected_response))))
+      .Times(1);
+  auto folder_request_builder =
+      GetFolderItemsRequestBuilder::MakeBuilder(Scope::VFS, 0, 1, {});
+  auto request = TestBrowsePacket::Make();
+  folder_request_builder->Serialize(request);
+  SendBrowseMessage(1, request);
+
+  expected_response = GetFolderItemsResponseBuilder::MakeVFSBuilder(
+      Status::NO_ERROR, 0x0000, 0xFFFF);
+  expected_response->AddFolder(FolderItem(5001, 0, true, "Test Folder5000"));
+  expected_response->AddFolder(FolderItem(5002, 0, true, "Test Folder5001"));
+  expected_response->AddFolder(FolderItem(5003, 0, true, "Test Folder5002"));
+  EXPECT_CALL(response_cb,
+              Call(2, true, matchPacket(std::move(expected_response))))
+      .Times(1);
+  folder_request_builder =
+      GetFolderItemsRequestBuilder::MakeBuilder(Scope::VFS, 5000, 5002, {});
+  request = TestBrowsePacket::Make();
+  folder_request_builder->Serialize(request);
+  SendBrowseMessage(2, request);
+
+  auto total_response = GetTotalNumberOfItemsResponseBuilder::MakeBuilder(
+      Status::NO_ERROR, 0, list.size());
+  EXPECT_CALL(response_cb,
+              Call(3, true, matchPacket(std::move(total_response))))
+      .Times(1);
+  SendBrowseMessage(
+      3, TestBrowsePacket::Make(get_total_number_of_items_request_vfs));
+  Mock::VerifyAndClearExpectations(&interface);
+
+  // A UID change invalidates the listing
+  list.resize(2);
+  EXPECT_CALL(interface, GetFolderItems(_, "", _))
+      .Times(1)
+      .WillOnce(InvokeCb<2>(list));
+  test_device->SendFolderUpdate(false, false, true);
+
+  total_response = GetTotalNumberOfItemsResponseBuilder::MakeBuilder(
+      Status::NO_ERROR, 0, list.size());
+  EXPECT_CALL(response_cb,
+              Call(4, true, matchPacket(std::move(total_response))))
+      .Times(1);
+  SendBrowseMessage(
+      4, TestBrowsePacket::Make(get_total_number_of_items_request_vfs));
+}
+
 TEST_F(AvrcpDeviceTest, changePathTest) {
   MockMediaInterface interface;
   NiceMock<MockA2dpInterface> a2dp_interface;
@@ -856,7 +927,7 @@ TEST_F(AvrcpDeviceTest, changePathTest) {
   ListItem item4 = {ListItem::FOLDER, info4, SongInfo()};
   std::vector<ListItem> list1 = {item2, item3, item4};
   EXPECT_CALL(interface, GetFolderItems(_, "test_id1", _))
-      .Times(3)
+      .Times(2)
       .WillRepeatedly(InvokeCb<2>(list1));
 
   std::vector<ListItem> list2 = {};
@@ -928,6 +999,103 @@ TEST_F(AvrcpDeviceTest, changePathTest) {
   SendBrowseMessage(5, request);
 }
 
+TEST_F(AvrcpDeviceTest, changePathDropsStaleUidsTest) {
+  MockMediaInterface interface;
+  NiceMock<MockA2dpInterface> a2dp_interface;
+
+  test_device->RegisterInterfaces(&interface, &a2dp_interface, nullptr);
+
+  FolderInfo info0 = {"test_id0", true, "Test Folder0"};
+  FolderInfo info1 = {"test_id1", true, "Test Folder1"};
+  ListItem item0 = {ListItem::FOLDER, info0, SongInfo()};
+  ListItem item1 = {ListItem::FOLDER, info1, SongInfo()};
+  std::vector<ListItem> list0 = {item0, item1};
+  EXPECT_CALL(interface, GetFolderItems(_, "", _))
+      .Times(1)
+      .WillOnce(InvokeCb<2>(list0));
+
+  FolderInfo info2 = {"test_id2", true, "Test Folder2"};
+  ListItem item2 = {ListItem::FOLDER, info2, SongInfo()};
+  std::vector<ListItem> list1 = {item2};
+  EXPECT_CALL(interface, GetFolderItems(_, "test_id1", _))
+      .Times(2)
+      .WillRepeatedly(InvokeCb<2>(list1));
+
+  std::vector<ListItem> list2 = {};
+  EXPECT_CALL(interface, GetFolderItems(_, "test_id2", _))
+      .Times(1)
+      .WillOnce(InvokeCb<2>(list2));
+
+  auto folder_items_response = GetFolderItemsResponseBuilder::MakeVFSBuilder(
+      Status::NO_ERROR, 0x0000, 0xFFFF);
+  folder_items_response->AddFolder(FolderItem(1, 0, true, "Test Folder0"));
+  folder_items_response->AddFolder(FolderItem(2, 0, true, "Test Folder1"));
+  EXPECT_CALL(response_cb,
+              Call(1, true, matchPacket(std::move(folder_items_response))))
+      .Times(1);
+  auto folder_request_builder =
+      GetFolderItemsRequestBuilder::MakeBuilder(Scope::VFS, 0, 3, {});
+  auto request = TestBrowsePacket::Make();
+  folder_request_builder->Serialize(request);
+  SendBrowseMessage(1, request);
+
+  // The listing of Test Folder1 replaces the root listing
+  auto change_path_response =
+      ChangePathResponseBuilder::MakeBuilder(Status::NO_ERROR, list1.size());
+  EXPECT_CALL(response_cb,
+              Call(2, true, matchPacket(std::move(change_path_response))));
+  auto path_request_builder =
+      ChangePathRequestBuilder::MakeBuilder(0, Direction::DOWN, 2);
+  request = TestBrowsePacket::Make();
+  path_request_builder->Serialize(request);
+  SendBrowseMessage(2, request);
+
+  // Test Folder0 was only in the root listing, its UID is gone with it
+  change_path_response =
+      ChangePathResponseBuilder::MakeBuilder(Status::DOES_NOT_EXIST, 0);
+  EXPECT_CALL(response_cb,
+              Call(3, true, matchPacket(std::move(change_path_response))));
+  path_request_builder =
+      ChangePathRequestBuilder::MakeBuilder(0, Direction::DOWN, 1);
+  request = TestBrowsePacket::Make();
+  path_request_builder->Serialize(request);
+  SendBrowseMessage(3, request);
+
+  // Test Folder2 got the next UID
+  change_path_response =
+      ChangePathResponseBuilder::MakeBuilder(Status::NO_ERROR, list2.size());
+  EXPECT_CALL(response_cb,
+              Call(4, true, matchPacket(std::move(change_path_response))));
+  path_request_builder =
+      ChangePathRequestBuilder::MakeBuilder(0, Direction::DOWN, 3);
+  request = TestBrowsePacket::Make();
+  path_request_builder->Serialize(request);
+  SendBrowseMessage(4, request);
+
+  // Back in Test Folder1 its item gets a UID that wasn't handed out yet
+  change_path_response =
+      ChangePathResponseBuilder::MakeBuilder(Status::NO_ERROR, list1.size());
+  EXPECT_CALL(response_cb,
+              Call(5, true, matchPacket(std::move(change_path_response))));
+  path_request_builder =
+      ChangePathRequestBuilder::MakeBuilder(0, Direction::UP, 0);
+  request = TestBrowsePacket::Make();
+  path_request_builder->Serialize(request);
+  SendBrowseMessage(5, request);
+
+  folder_items_response = GetFolderItemsResponseBuilder::MakeVFSBuilder(
+      Status::NO_ERROR, 0x0000, 0xFFFF);
+  folder_items_response->AddFolder(FolderItem(4, 0, true, "Test Folder2"));
+  EXPECT_CALL(response_cb,
+              Call(6, true, matchPacket(std::move(folder_items_response))))
+      .Times(1);
+  folder_request_builder =
+      GetFolderItemsRequestBuilder::MakeBuilder(Scope::VFS, 0, 3, {});
+  request = TestBrowsePacket::Make();
+  folder_request_builder->Serialize(request);
+  SendBrowseMessage(6, request);
+}
+
 TEST_F(AvrcpDeviceTest, getItemAttributesNowPlayingTest) {
   MockMediaInterface interface;
   NiceMock<MockA2dpInterface> a2dp_interface;
@@ -43,6 +43,20 @@
  */
 #define MAX_2MBPS_AVDTP_MTU 663
 
+/*
+ * Adaptive bit rate, constant bit rate mode only: the bit rate is stepped
+ * down while packets build up in the transmit queue, and stepped back up to
+ * the configured one after the queue has stayed drained for a while.
+ */
+#define A2DP_AAC_ABR_QUEUE_LENGTH_HIGH 3
+#define A2DP_AAC_ABR_QUEUE_LENGTH_LOW 1
+/* Steps and lowest bit rate, as fractions of the configured bit rate */
+#define A2DP_AAC_ABR_STEP_DIVISOR 8
+#define A2DP_AAC_ABR_MIN_DIVISOR 2
+/* Encoder ticks between two steps down, and drained ticks before a step up */
+#define A2DP_AAC_ABR_DOWN_TICKS 5
+#define A2DP_AAC_ABR_UP_TICKS 50
+
 // offset
 #if (BTA_AV_CO_CP_SCMS_T == TRUE)
 #define A2DP_AAC_OFFSET (AVDT_MEDIA_OFFSET + 1)
@@ -75,6 +89,8 @@ typedef struct {
   size_t media_read_total_dropped_packets;
   size_t media_read_total_actual_reads_count;
   size_t media_read_total_actual_read_bytes;
+
+  size_t abr_adjustments;
 } a2dp_aac_encoder_stats_t;
 
 typedef struct {
@@ -88,6 +104,13 @@ typedef struct {
   uint16_t peer_mtu;         // MTU of the A2DP peer
   uint32_t timestamp;        // Timestamp for the A2DP frames
 
+  size_t TxQueueLength;
+  bool abr_enabled;            // True in constant bit rate mode
+  int abr_max_bit_rate;        // The bit rate picked for the configuration
+  int abr_bit_rate;            // The bit rate the encoder is set to
+  uint32_t abr_ticks;          // Ticks since the bit rate was last changed
+  uint32_t abr_drained_ticks;  // Ticks the queue has stayed drained
+
   HANDLE_AACENCODER aac_handle;
   bool has_aac_handle;  // True if aac_handle is valid
 
@@ -109,6 +132,7 @@ static void a2dp_aac_get_num_frame_iteration(uint8_t* num_of_iterations,
                                              uint8_t* num_of_frames,
                                              uint64_t timestamp_us);
 static void a2dp_aac_encode_frames(uint8_t nb_frame);
+static void a2dp_aac_adjust_bit_rate(void);
 static bool a2dp_aac_read_feeding(uint8_t* read_buffer, uint32_t* bytes_read);
 
 bool A2DP_LoadEncoderAac(void) {
@@ -356,6 +380,10 @@ static void a2dp_aac_encoder_update(uint16_t peer_mtu,
               __func__, aac_param_value, aac_error);
     return;  // TODO: Return an error?
   }
+  a2dp_aac_encoder_cb.abr_max_bit_rate = aac_param_value;
+  a2dp_aac_encoder_cb.abr_bit_rate = aac_param_value;
+  a2dp_aac_encoder_cb.abr_ticks = 0;
+  a2dp_aac_encoder_cb.abr_drained_ticks = 0;
 
   // Set the encoder's parameters: PEAK Bit Rate
   aac_error = aacEncoder_SetParam(a2dp_aac_encoder_cb.aac_handle,
@@ -426,6 +454,8 @@ static void a2dp_aac_encoder_update(uint16_t peer_mtu,
               __func__, aac_param_value, aac_error);
     return;  // TODO: Return an error?
   }
+  // A variable bit rate already follows the audio, not the link
+  a2dp_aac_encoder_cb.abr_enabled = (aac_param_value == 0);
 
   // Mark the end of setting the encoder's parameters
   aac_error =
@@ -496,12 +526,62 @@ void a2dp_aac_send_frames(uint64_t timestamp_us) {
               __func__, nb_frame, nb_iterations);
   if (nb_frame == 0) return;
 
+  if (a2dp_aac_encoder_cb.abr_enabled) a2dp_aac_adjust_bit_rate();
+
   for (uint8_t counter = 0; counter < nb_iterations; counter++) {
     // Transcode frame and enqueue
     a2dp_aac_encode_frames(nb_frame);
   }
 }
 
+void a2dp_aac_set_transmit_queue_length(size_t transmit_queue_length) {
+  a2dp_aac_encoder_cb.TxQueueLength = transmit_queue_length;
+}
+
+// Steps the bit rate down while the transmit queue builds up and back up
+// once the queue has stayed drained for a while. The encoder picks up the
+// new bit rate with the next frame.
+static void a2dp_aac_adjust_bit_rate(void) {
+  int max_bit_rate = a2dp_aac_encoder_cb.abr_max_bit_rate;
+  int step = max_bit_rate / A2DP_AAC_ABR_STEP_DIVISOR;
+  int bit_rate = a2dp_aac_encoder_cb.abr_bit_rate;
+
+  a2dp_aac_encoder_cb.abr_ticks++;
+  if (a2dp_aac_encoder_cb.TxQueueLength >= A2DP_AAC_ABR_QUEUE_LENGTH_HIGH) {
+    a2dp_aac_encoder_cb.abr_drained_ticks = 0;
+    if (a2dp_aac_encoder_cb.abr_ticks >= A2DP_AAC_ABR_DOWN_TICKS) {
+      bit_rate = std::max(bit_rate - step,
+                          max_bit_rate / A2DP_AAC_ABR_MIN_DIVISOR);
+    }
+  } else if (a2dp_aac_encoder_cb.TxQueueLength <=
+             A2DP_AAC_ABR_QUEUE_LENGTH_LOW) {
+    a2dp_aac_encoder_cb.abr_drained_ticks++;
+    if (a2dp_aac_encoder_cb.abr_drained_ticks >= A2DP_AAC_ABR_UP_TICKS)
+      bit_rate = std::min(bit_rate + step, max_bit_rate);
+  } else {
+    a2dp_aac_encoder_cb.abr_drained_ticks = 0;
+  }
+  if (bit_rate == a2dp_aac_encoder_cb.abr_bit_rate) return;
+
+  LOG_DEBUG(LOG_TAG, "%s: queue length %zu, bit rate %d -> %d", __func__,
+            a2dp_aac_encoder_cb.TxQueueLength,
+            a2dp_aac_encoder_cb.abr_bit_rate, bit_rate);
+  AACENC_ERROR aac_error = aacEncoder_SetParam(
+      a2dp_aac_encoder_cb.aac_handle, AACENC_BITRATE, bit_rate);
+  if (aac_error != AACENC_OK) {
+    LOG_ERROR(LOG_TAG,
+              "%s: Cannot set AAC parameter AACENC_BITRATE to %d: "
+              "AAC error 0x%x",
+              __func__, bit_rate, aac_error);
+    a2dp_aac_encoder_cb.abr_enabled = false;
+    return;
+  }
+  a2dp_aac_encoder_cb.abr_bit_rate = bit_rate;
+  a2dp_aac_encoder_cb.abr_ticks = 0;
+  a2dp_aac_encoder_cb.abr_drained_ticks = 0;
+  a2dp_aac_encoder_cb.stats.abr_adjustments++;
+}
+
 // Obtains the number of frames to send and number of iterations
 // to be used. |num_of_iterations| and |num_of_frames| parameters
 // are used as output param for returning the respective values.
@@ -724,4 +804,14 @@ void A2dpCodecConfigAacSource::debug_codec_dump(int fd) {
           "%zu\n",
           stats->media_read_total_expected_read_bytes,
           stats->media_read_total_actual_read_bytes);
+
+  dprintf(fd,
+          "  AAC adaptive bit rate adjustments                       : %zu\n",
+          stats->abr_adjustments);
+
+  dprintf(fd,
+          "  AAC bit rate (current/max)                              : %d / "
+          "%d\n",
+          a2dp_aac_encoder_cb.abr_bit_rate,
+          a2dp_aac_encoder_cb.abr_max_bit_rate);
 }
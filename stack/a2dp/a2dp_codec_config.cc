@@ -1196,6 +1196,35 @@ bool A2DP_CodecEquals(const uint8_t* p_codec_info_a,
   return false;
 }
 
+bool A2DP_CodecFramesCompatible(const uint8_t* p_codec_info_frames,
+                                const uint8_t* p_codec_info_sink) {
+  if (!A2DP_CodecTypeEquals(p_codec_info_frames, p_codec_info_sink))
+    return false;
+
+  int sample_rate = A2DP_GetTrackSampleRate(p_codec_info_frames);
+  if (sample_rate < 0 ||
+      sample_rate != A2DP_GetTrackSampleRate(p_codec_info_sink)) {
+    return false;
+  }
+  int channel_count = A2DP_GetTrackChannelCount(p_codec_info_frames);
+  if (channel_count < 0 ||
+      channel_count != A2DP_GetTrackChannelCount(p_codec_info_sink)) {
+    return false;
+  }
+
+  if (A2DP_GetCodecType(p_codec_info_frames) != A2DP_MEDIA_CT_SBC) return true;
+
+  // The SBC encoder moves the bitpool within the configured range
+  if (A2DP_GetChannelModeCodeSbc(p_codec_info_frames) !=
+      A2DP_GetChannelModeCodeSbc(p_codec_info_sink)) {
+    return false;
+  }
+  return A2DP_GetMinBitpoolSbc(p_codec_info_frames) >=
+             A2DP_GetMinBitpoolSbc(p_codec_info_sink) &&
+         A2DP_GetMaxBitpoolSbc(p_codec_info_frames) <=
+             A2DP_GetMaxBitpoolSbc(p_codec_info_sink);
+}
+
 int A2DP_GetTrackSampleRate(const uint8_t* p_codec_info) {
   tA2DP_CODEC_TYPE codec_type = A2DP_GetCodecType(p_codec_info);
 
@@ -24,6 +24,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
 #include "a2dp_sbc.h"
 #include "a2dp_sbc_up_sample.h"
@@ -56,6 +57,20 @@
 /* Define the bitrate step when trying to match bitpool value */
 #define A2DP_SBC_BITRATE_STEP 5
 
+/*
+ * Adaptive bit rate: the bitpool is stepped down while packets build up in
+ * the transmit queue, and stepped back up to the configured one after the
+ * queue has stayed drained for a while.
+ */
+#define A2DP_SBC_ABR_QUEUE_LENGTH_HIGH 3
+#define A2DP_SBC_ABR_QUEUE_LENGTH_LOW 1
+#define A2DP_SBC_ABR_BITPOOL_STEP 5
+/* Lowest bitpool stepped down to, about 190 kbps for 44.1 kHz joint stereo */
+#define A2DP_SBC_ABR_MIN_BITPOOL 28
+/* Encoder ticks between two steps down, and drained ticks before a step up */
+#define A2DP_SBC_ABR_DOWN_TICKS 5
+#define A2DP_SBC_ABR_UP_TICKS 50
+
 /* Readability constants */
 #define A2DP_SBC_FRAME_HEADER_SIZE_BYTES 4  // A2DP Spec v1.3, 12.4, Table 12.12
 #define A2DP_SBC_SCALE_FACTOR_BITS 4        // A2DP Spec v1.3, 12.4, Table 12.13
@@ -92,6 +107,8 @@ typedef struct {
 
   size_t media_read_total_expected_frames;
   size_t media_read_total_dropped_frames;
+
+  size_t abr_adjustments;
 } a2dp_sbc_encoder_stats_t;
 
 typedef struct {
@@ -103,6 +120,13 @@ typedef struct {
   bool peer_supports_3mbps; /* True if the peer device supports 3Mbps EDR */
   uint16_t peer_mtu;        /* MTU of the A2DP peer */
   uint32_t timestamp;       /* Timestamp for the A2DP frames */
+
+  size_t TxQueueLength;
+  int16_t abr_max_bitpool;    /* The bitpool picked for the configuration */
+  int16_t abr_min_bitpool;
+  uint32_t abr_ticks;         /* Ticks since the bitpool was last changed */
+  uint32_t abr_drained_ticks; /* Ticks the queue has stayed drained */
+
   SBC_ENC_PARAMS sbc_encoder_params;
   tA2DP_FEEDING_PARAMS feeding_params;
   tA2DP_SBC_FEEDING_STATE feeding_state;
@@ -123,6 +147,7 @@ static void a2dp_sbc_encode_frames(uint8_t nb_frame);
 static void a2dp_sbc_get_num_frame_iteration(uint8_t* num_of_iterations,
                                              uint8_t* num_of_frames,
                                              uint64_t timestamp_us);
+static void a2dp_sbc_adjust_bitpool(void);
 static uint8_t calculate_max_frames_per_packet(void);
 static uint16_t a2dp_sbc_source_rate();
 static uint32_t a2dp_sbc_frame_length(void);
@@ -366,6 +391,13 @@ static void a2dp_sbc_encoder_update(uint16_t peer_mtu,
   /* Finally update the bitpool in the encoder structure */
   p_encoder_params->s16BitPool = s16BitPool;
 
+  /* The adaptive bit rate stays within the negotiated bitpool range */
+  a2dp_sbc_encoder_cb.abr_max_bitpool = s16BitPool;
+  a2dp_sbc_encoder_cb.abr_min_bitpool = std::max<int16_t>(
+      min_bitpool, std::min<int16_t>(A2DP_SBC_ABR_MIN_BITPOOL, s16BitPool));
+  a2dp_sbc_encoder_cb.abr_ticks = 0;
+  a2dp_sbc_encoder_cb.abr_drained_ticks = 0;
+
   LOG_DEBUG(LOG_TAG, "%s: final bit rate %d, final bit pool %d", __func__,
             p_encoder_params->u16BitRate, p_encoder_params->s16BitPool);
 
@@ -412,12 +444,56 @@ void a2dp_sbc_send_frames(uint64_t timestamp_us) {
               __func__, nb_frame, nb_iterations);
   if (nb_frame == 0) return;
 
+  a2dp_sbc_adjust_bitpool();
+
   for (uint8_t counter = 0; counter < nb_iterations; counter++) {
     // Transcode frame and enqueue
     a2dp_sbc_encode_frames(nb_frame);
   }
 }
 
+void a2dp_sbc_set_transmit_queue_length(size_t transmit_queue_length) {
+  a2dp_sbc_encoder_cb.TxQueueLength = transmit_queue_length;
+}
+
+// Steps the bitpool down while the transmit queue builds up and back up
+// once the queue has stayed drained for a while. The encoder picks up the
+// new bitpool with the next frame.
+static void a2dp_sbc_adjust_bitpool(void) {
+  SBC_ENC_PARAMS* p_encoder_params = &a2dp_sbc_encoder_cb.sbc_encoder_params;
+  int16_t bitpool = p_encoder_params->s16BitPool;
+
+  a2dp_sbc_encoder_cb.abr_ticks++;
+  if (a2dp_sbc_encoder_cb.TxQueueLength >= A2DP_SBC_ABR_QUEUE_LENGTH_HIGH) {
+    a2dp_sbc_encoder_cb.abr_drained_ticks = 0;
+    if (a2dp_sbc_encoder_cb.abr_ticks >= A2DP_SBC_ABR_DOWN_TICKS) {
+      bitpool = std::max<int16_t>(bitpool - A2DP_SBC_ABR_BITPOOL_STEP,
+                                  a2dp_sbc_encoder_cb.abr_min_bitpool);
+    }
+  } else if (a2dp_sbc_encoder_cb.TxQueueLength <=
+             A2DP_SBC_ABR_QUEUE_LENGTH_LOW) {
+    a2dp_sbc_encoder_cb.abr_drained_ticks++;
+    if (a2dp_sbc_encoder_cb.abr_drained_ticks >= A2DP_SBC_ABR_UP_TICKS) {
+      bitpool = std::min<int16_t>(bitpool + A2DP_SBC_ABR_BITPOOL_STEP,
+                                  a2dp_sbc_encoder_cb.abr_max_bitpool);
+    }
+  } else {
+    a2dp_sbc_encoder_cb.abr_drained_ticks = 0;
+  }
+  if (bitpool == p_encoder_params->s16BitPool) return;
+
+  LOG_DEBUG(LOG_TAG, "%s: queue length %zu, bitpool %d -> %d", __func__,
+            a2dp_sbc_encoder_cb.TxQueueLength, p_encoder_params->s16BitPool,
+            bitpool);
+  p_encoder_params->s16BitPool = bitpool;
+  a2dp_sbc_encoder_cb.abr_ticks = 0;
+  a2dp_sbc_encoder_cb.abr_drained_ticks = 0;
+  a2dp_sbc_encoder_cb.stats.abr_adjustments++;
+
+  // The frame length follows the bitpool
+  a2dp_sbc_encoder_cb.tx_sbc_frames = calculate_max_frames_per_packet();
+}
+
 // Obtains the number of frames to send and number of iterations
 // to be used. |num_of_iterations| and |num_of_frames| parameters
 // are used as output param for returning the respective values.
@@ -945,4 +1021,14 @@ void A2dpCodecConfigSbcSource::debug_codec_dump(int fd) {
           "%zu\n",
           stats->media_read_total_expected_frames,
           stats->media_read_total_dropped_frames);
+
+  dprintf(fd,
+          "  SBC adaptive bit rate adjustments                       : %zu\n",
+          stats->abr_adjustments);
+
+  dprintf(fd,
+          "  SBC bitpool (current/max)                               : %d / "
+          "%d\n",
+          a2dp_sbc_encoder_cb.sbc_encoder_params.s16BitPool,
+          a2dp_sbc_encoder_cb.abr_max_bitpool);
 }
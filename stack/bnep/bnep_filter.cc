@@ -0,0 +1,230 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the BNEP protocol and multicast filters set by the peer
+ *
+ ******************************************************************************/
+
+#include <base/logging.h>
+
+#include "bnep_int.h"
+#include "bt_common.h"
+#include "bt_types.h"
+
+/* Multicast addresses compare as big endian 48 bit integers, same as memcmp */
+static inline uint64_t bnepu_addr_to_u64(const RawAddress& addr) {
+  uint64_t value = 0;
+  for (int i = 0; i < BD_ADDR_LEN; i++) value = (value << 8) | addr.address[i];
+  return value;
+}
+
+/* Binary search for the last compiled range starting at or below proto */
+static bool bnepu_prot_in_ranges(const tBNEP_CONN* p_bcb, uint16_t proto) {
+  uint16_t lo = 0, hi = p_bcb->rcvd_prot_ranges;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (p_bcb->rcvd_prot_range_start[mid] <= proto)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo > 0 && proto <= p_bcb->rcvd_prot_range_end[lo - 1];
+}
+
+static bool bnepu_mcast_in_ranges(const tBNEP_CONN* p_bcb,
+                                  const RawAddress& addr) {
+  uint64_t value = bnepu_addr_to_u64(addr);
+  uint16_t lo = 0, hi = p_bcb->rcvd_mcast_ranges;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (p_bcb->rcvd_mcast_range_start[mid] <= value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo > 0 && value <= p_bcb->rcvd_mcast_range_end[lo - 1];
+}
+
+/*******************************************************************************
+ *
+ * Function         bnepu_compile_prot_filters
+ *
+ * Description      This function sorts and merges the protocol filter ranges
+ *                  received from the peer so bnep_is_packet_allowed() can
+ *                  binary search them, and precomputes the verdict for IPv4,
+ *                  ARP and IPv6.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void bnepu_compile_prot_filters(tBNEP_CONN* p_bcb) {
+  uint16_t start[BNEP_MAX_PROT_FILTERS], end[BNEP_MAX_PROT_FILTERS];
+  uint16_t xx, yy, num = p_bcb->rcvd_num_filters;
+
+  /* Insertion sort by range start, there are at most BNEP_MAX_PROT_FILTERS */
+  for (xx = 0; xx < num; xx++) {
+    for (yy = xx; yy > 0 && start[yy - 1] > p_bcb->rcvd_prot_filter_start[xx];
+         yy--) {
+      start[yy] = start[yy - 1];
+      end[yy] = end[yy - 1];
+    }
+    start[yy] = p_bcb->rcvd_prot_filter_start[xx];
+    end[yy] = p_bcb->rcvd_prot_filter_end[xx];
+  }
+
+  p_bcb->rcvd_prot_ranges = 0;
+  for (xx = 0; xx < num; xx++) {
+    yy = p_bcb->rcvd_prot_ranges;
+    if (yy && (uint32_t)p_bcb->rcvd_prot_range_end[yy - 1] + 1 >= start[xx]) {
+      if (end[xx] > p_bcb->rcvd_prot_range_end[yy - 1])
+        p_bcb->rcvd_prot_range_end[yy - 1] = end[xx];
+    } else {
+      p_bcb->rcvd_prot_range_start[yy] = start[xx];
+      p_bcb->rcvd_prot_range_end[yy] = end[xx];
+      p_bcb->rcvd_prot_ranges++;
+    }
+  }
+
+  p_bcb->rcvd_prot_allowed = 0;
+  if (bnepu_prot_in_ranges(p_bcb, BNEP_PROTOCOL_IPV4))
+    p_bcb->rcvd_prot_allowed |= BNEP_PROT_ALLOWED_IPV4;
+  if (bnepu_prot_in_ranges(p_bcb, BNEP_PROTOCOL_ARP))
+    p_bcb->rcvd_prot_allowed |= BNEP_PROT_ALLOWED_ARP;
+  if (bnepu_prot_in_ranges(p_bcb, BNEP_PROTOCOL_IPV6))
+    p_bcb->rcvd_prot_allowed |= BNEP_PROT_ALLOWED_IPV6;
+}
+
+/*******************************************************************************
+ *
+ * Function         bnepu_compile_mcast_filters
+ *
+ * Description      This function converts the multicast filter ranges
+ *                  received from the peer to integers, sorted by start with
+ *                  overlapping ranges merged.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void bnepu_compile_mcast_filters(tBNEP_CONN* p_bcb) {
+  uint64_t start[BNEP_MAX_MULTI_FILTERS], end[BNEP_MAX_MULTI_FILTERS];
+  uint16_t xx, yy, num;
+
+  p_bcb->rcvd_mcast_ranges = 0;
+  /* Either no filters or every multicast is dropped */
+  if (p_bcb->rcvd_mcast_filters == 0xFFFF) return;
+  num = p_bcb->rcvd_mcast_filters;
+
+  for (xx = 0; xx < num; xx++) {
+    uint64_t first = bnepu_addr_to_u64(p_bcb->rcvd_mcast_filter_start[xx]);
+    for (yy = xx; yy > 0 && start[yy - 1] > first; yy--) {
+      start[yy] = start[yy - 1];
+      end[yy] = end[yy - 1];
+    }
+    start[yy] = first;
+    end[yy] = bnepu_addr_to_u64(p_bcb->rcvd_mcast_filter_end[xx]);
+  }
+
+  for (xx = 0; xx < num; xx++) {
+    yy = p_bcb->rcvd_mcast_ranges;
+    if (yy && p_bcb->rcvd_mcast_range_end[yy - 1] + 1 >= start[xx]) {
+      if (end[xx] > p_bcb->rcvd_mcast_range_end[yy - 1])
+        p_bcb->rcvd_mcast_range_end[yy - 1] = end[xx];
+    } else {
+      p_bcb->rcvd_mcast_range_start[yy] = start[xx];
+      p_bcb->rcvd_mcast_range_end[yy] = end[xx];
+      p_bcb->rcvd_mcast_ranges++;
+    }
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         bnep_is_packet_allowed
+ *
+ * Description      This function verifies whether the protocol passes through
+ *                  the protocol filters set by the peer
+ *
+ * Returns          BNEP_SUCCESS          - if the protocol is allowed
+ *                  BNEP_IGNORE_CMD       - if the protocol is filtered out
+ *
+ ******************************************************************************/
+tBNEP_RESULT bnep_is_packet_allowed(tBNEP_CONN* p_bcb,
+                                    const RawAddress& p_dest_addr,
+                                    uint16_t protocol, bool fw_ext_present,
+                                    uint8_t* p_data) {
+  if (p_bcb->rcvd_num_filters) {
+    uint16_t proto;
+    bool allowed;
+
+    /* Findout the actual protocol to check for the filtering */
+    proto = protocol;
+    if (proto == BNEP_802_1_P_PROTOCOL) {
+      if (fw_ext_present) {
+        uint8_t len, ext;
+        /* parse the extension headers and findout actual protocol */
+        do {
+          ext = *p_data++;
+          len = *p_data++;
+          p_data += len;
+
+        } while (ext & 0x80);
+      }
+      p_data += 2;
+      BE_STREAM_TO_UINT16(proto, p_data);
+    }
+
+    switch (proto) {
+      case BNEP_PROTOCOL_IPV4:
+        allowed = p_bcb->rcvd_prot_allowed & BNEP_PROT_ALLOWED_IPV4;
+        break;
+      case BNEP_PROTOCOL_ARP:
+        allowed = p_bcb->rcvd_prot_allowed & BNEP_PROT_ALLOWED_ARP;
+        break;
+      case BNEP_PROTOCOL_IPV6:
+        allowed = p_bcb->rcvd_prot_allowed & BNEP_PROT_ALLOWED_IPV6;
+        break;
+      default:
+        allowed = bnepu_prot_in_ranges(p_bcb, proto);
+        break;
+    }
+
+    if (!allowed) {
+      BNEP_TRACE_DEBUG("Ignoring protocol 0x%x in BNEP data write", proto);
+      return BNEP_IGNORE_CMD;
+    }
+  }
+
+  /* Ckeck for multicast address filtering */
+  if ((p_dest_addr.address[0] & 0x01) && p_bcb->rcvd_mcast_filters) {
+    /*
+    ** If every multicast should be filtered or the address is not in the filter
+    *range
+    ** drop the packet
+    */
+    if ((p_bcb->rcvd_mcast_filters == 0xFFFF) ||
+        !bnepu_mcast_in_ranges(p_bcb, p_dest_addr)) {
+      VLOG(1) << "Ignoring multicast address " << p_dest_addr
+              << " in BNEP data write";
+      return BNEP_IGNORE_CMD;
+    }
+  }
+
+  return BNEP_SUCCESS;
+}
@@ -72,6 +72,11 @@
 /* 802.1p protocol packet will have actual protocol field in side the payload */
 #define BNEP_802_1_P_PROTOCOL 0x8100
 
+/* Protocols whose filter verdict is precomputed when the peer sets filters */
+#define BNEP_PROTOCOL_IPV4 0x0800
+#define BNEP_PROTOCOL_ARP 0x0806
+#define BNEP_PROTOCOL_IPV6 0x86DD
+
 /* Timeout definitions.  */
 /* Connection related timeout */
 #define BNEP_CONN_TIMEOUT_MS (20 * 1000)
@@ -146,6 +151,21 @@ typedef struct {
   RawAddress rcvd_mcast_filter_start[BNEP_MAX_MULTI_FILTERS];
   RawAddress rcvd_mcast_filter_end[BNEP_MAX_MULTI_FILTERS];
 
+  /* Peer filters compiled for bnep_is_packet_allowed(): ranges sorted by
+   * start with overlapping and adjacent ones merged, multicast addresses as
+   * 48 bit integers, and the verdict for the most common protocols */
+#define BNEP_PROT_ALLOWED_IPV4 0x01
+#define BNEP_PROT_ALLOWED_ARP 0x02
+#define BNEP_PROT_ALLOWED_IPV6 0x04
+  uint8_t rcvd_prot_allowed;
+  uint16_t rcvd_prot_ranges;
+  uint16_t rcvd_prot_range_start[BNEP_MAX_PROT_FILTERS];
+  uint16_t rcvd_prot_range_end[BNEP_MAX_PROT_FILTERS];
+
+  uint16_t rcvd_mcast_ranges;
+  uint64_t rcvd_mcast_range_start[BNEP_MAX_MULTI_FILTERS];
+  uint64_t rcvd_mcast_range_end[BNEP_MAX_MULTI_FILTERS];
+
   uint16_t bad_pkts_rcvd;
   uint8_t re_transmits;
   uint16_t handle;
@@ -226,6 +246,11 @@ extern uint8_t* bnep_process_control_packet(tBNEP_CONN* p_bcb, uint8_t* p,
 extern void bnep_sec_check_complete(const RawAddress* bd_addr,
                                     tBT_TRANSPORT trasnport, void* p_ref_data,
                                     uint8_t result);
+
+/* Functions provided by bnep_filter.cc
+*/
+extern void bnepu_compile_prot_filters(tBNEP_CONN* p_bcb);
+extern void bnepu_compile_mcast_filters(tBNEP_CONN* p_bcb);
 extern tBNEP_RESULT bnep_is_packet_allowed(tBNEP_CONN* p_bcb,
                                            const RawAddress& p_dest_addr,
                                            uint16_t protocol,
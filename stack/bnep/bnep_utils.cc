@@ -945,6 +945,7 @@ void bnepu_process_peer_filter_set(tBNEP_CONN* p_bcb, uint8_t* p_filters,
     p_bcb->rcvd_prot_filter_start[xx] = start;
     p_bcb->rcvd_prot_filter_end[xx] = end;
   }
+  bnepu_compile_prot_filters(p_bcb);
 
   bnepu_send_peer_filter_rsp(p_bcb, resp_code);
 }
@@ -1106,6 +1107,7 @@ void bnepu_process_peer_multicast_filter_set(tBNEP_CONN* p_bcb,
       break;
     }
   }
+  bnepu_compile_mcast_filters(p_bcb);
 
   BNEP_TRACE_EVENT("BNEP multicast filters %d", p_bcb->rcvd_mcast_filters);
   bnepu_send_peer_multicast_filter_rsp(p_bcb, resp_code);
@@ -1244,82 +1246,3 @@ void bnep_sec_check_complete(UNUSED_ATTR const RawAddress* bd_addr,
 
   return;
 }
-
-/*******************************************************************************
- *
- * Function         bnep_is_packet_allowed
- *
- * Description      This function verifies whether the protocol passes through
- *                  the protocol filters set by the peer
- *
- * Returns          BNEP_SUCCESS          - if the protocol is allowed
- *                  BNEP_IGNORE_CMD       - if the protocol is filtered out
- *
- ******************************************************************************/
-tBNEP_RESULT bnep_is_packet_allowed(tBNEP_CONN* p_bcb,
-                                    const RawAddress& p_dest_addr,
-                                    uint16_t protocol, bool fw_ext_present,
-                                    uint8_t* p_data) {
-  if (p_bcb->rcvd_num_filters) {
-    uint16_t i, proto;
-
-    /* Findout the actual protocol to check for the filtering */
-    proto = protocol;
-    if (proto == BNEP_802_1_P_PROTOCOL) {
-      if (fw_ext_present) {
-        uint8_t len, ext;
-        /* parse the extension headers and findout actual protocol */
-        do {
-          ext = *p_data++;
-          len = *p_data++;
-          p_data += len;
-
-        } while (ext & 0x80);
-      }
-      p_data += 2;
-      BE_STREAM_TO_UINT16(proto, p_data);
-    }
-
-    for (i = 0; i < p_bcb->rcvd_num_filters; i++) {
-      if ((p_bcb->rcvd_prot_filter_start[i] <= proto) &&
-          (proto <= p_bcb->rcvd_prot_filter_end[i]))
-        break;
-    }
-
-    if (i == p_bcb->rcvd_num_filters) {
-      BNEP_TRACE_DEBUG("Ignoring protocol 0x%x in BNEP data write", proto);
-      return BNEP_IGNORE_CMD;
-    }
-  }
-
-  /* Ckeck for multicast address filtering */
-  if ((p_dest_addr.address[0] & 0x01) && p_bcb->rcvd_mcast_filters) {
-    uint16_t i;
-
-    /* Check if every multicast should be filtered */
-    if (p_bcb->rcvd_mcast_filters != 0xFFFF) {
-      /* Check if the address is mentioned in the filter range */
-      for (i = 0; i < p_bcb->rcvd_mcast_filters; i++) {
-        if ((memcmp(p_bcb->rcvd_mcast_filter_start[i].address,
-                    p_dest_addr.address, BD_ADDR_LEN) <= 0) &&
-            (memcmp(p_bcb->rcvd_mcast_filter_end[i].address,
-                    p_dest_addr.address, BD_ADDR_LEN) >= 0))
-          break;
-      }
-    }
-
-    /*
-    ** If every multicast should be filtered or the address is not in the filter
-    *range
-    ** drop the packet
-    */
-    if ((p_bcb->rcvd_mcast_filters == 0xFFFF) ||
-        (i == p_bcb->rcvd_mcast_filters)) {
-      VLOG(1) << "Ignoring multicast address " << p_dest_addr
-              << " in BNEP data write";
-      return BNEP_IGNORE_CMD;
-    }
-  }
-
-  return BNEP_SUCCESS;
-}
@@ -24,13 +24,21 @@
 #include <string.h>
 #include "bt_target.h"
 
+#include <stdio.h>
+#include "btm_ble_api.h"
+
 #if (BLE_PRIVACY_SPT == TRUE)
+#include <base/bind.h>
+
 #include "ble_advertiser.h"
 #include "bt_types.h"
+#include "bta/include/bta_closure_api.h"
+#include "btm_ble_rl_edit_window.h"
 #include "btm_int.h"
 #include "btu.h"
 #include "device/include/controller.h"
 #include "hcimsgs.h"
+#include "osi/include/time.h"
 #include "vendor_hcidefs.h"
 
 /* RPA offload VSC specifics */
@@ -48,6 +56,25 @@
 #define BTM_BLE_META_READ_IRK_LEN 2
 #define BTM_BLE_META_ADD_WL_ATTR_LEN 9
 
+/* Resolving list edits made back to back share one window with activity
+ * suspended and address resolution disabled: the first edit opens it and a
+ * task queued behind whatever else is waiting for the bta thread closes it,
+ * re-enabling resolution and resuming activity once for all of them. */
+static BtmBleRlEditWindow rl_window;
+static bool rl_window_close_pending = false;
+
+/* Time scanning, initiating and advertising spent suspended for resolving
+ * list changes */
+static struct {
+  uint32_t windows;
+  uint32_t edits;
+  uint32_t outages;
+  period_ms_t outage_start_ms;
+  period_ms_t last_outage_ms;
+  period_ms_t max_outage_ms;
+  period_ms_t total_outage_ms;
+} rl_stats;
+
 /*******************************************************************************
  *         Functions implemented controller based privacy using Resolving List
  ******************************************************************************/
@@ -542,6 +569,9 @@ bool btm_ble_suspend_resolving_list_activity(void) {
   if (btm_ble_suspend_bg_conn())
     p_ble_cb->suspended_rl_state |= BTM_BLE_RL_INIT;
 
+  if (p_ble_cb->suspended_rl_state != BTM_BLE_RL_IDLE)
+    rl_stats.outage_start_ms = time_get_os_boottime_ms();
+
   return true;
 }
 
@@ -572,6 +602,15 @@ void btm_ble_resume_resolving_list_activity(void) {
 
   if (p_ble_cb->suspended_rl_state & BTM_BLE_RL_INIT) btm_ble_resume_bg_conn();
 
+  if (p_ble_cb->suspended_rl_state != BTM_BLE_RL_IDLE) {
+    period_ms_t outage_ms =
+        time_get_os_boottime_ms() - rl_stats.outage_start_ms;
+    rl_stats.outages++;
+    rl_stats.last_outage_ms = outage_ms;
+    rl_stats.total_outage_ms += outage_ms;
+    if (outage_ms > rl_stats.max_outage_ms) rl_stats.max_outage_ms = outage_ms;
+  }
+
   p_ble_cb->suspended_rl_state = BTM_BLE_RL_IDLE;
 }
 
@@ -668,6 +707,72 @@ bool btm_ble_disable_resolving_list(uint8_t rl_mask, bool to_resume) {
   return true;
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_ble_close_resolving_list_window
+ *
+ * Description      Re-enable address resolution and resume activity once the
+ *                  resolving list edits in the current window are done
+ *
+ * Returns          none
+ *
+ ******************************************************************************/
+static void btm_ble_close_resolving_list_window(void) {
+  rl_window_close_pending = false;
+  if (!rl_window.IsOpen()) return;
+
+  btm_ble_enable_resolving_list(rl_window.Close());
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_ble_begin_resolving_list_edit
+ *
+ * Description      Make the resolving list editable, opening an edit window
+ *                  unless one is open already
+ *
+ * Returns          true if the list can be edited; false otherwise
+ *
+ ******************************************************************************/
+static bool btm_ble_begin_resolving_list_edit(void) {
+  /* Also covers resolution having been turned back on while the window was
+   * open, e.g. by a background connection starting */
+  const uint8_t rl_state = btm_cb.ble_ctr_cb.rl_state;
+  if (rl_state && !btm_ble_disable_resolving_list(rl_state, false))
+    return false;
+
+  if (rl_window.BeginEdit(rl_state)) {
+    rl_stats.windows++;
+
+    if (!rl_window_close_pending &&
+        do_in_bta_thread(FROM_HERE,
+                         base::Bind(&btm_ble_close_resolving_list_window)) ==
+            BT_STATUS_SUCCESS) {
+      rl_window_close_pending = true;
+    }
+  }
+
+  rl_stats.edits++;
+  return true;
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_ble_end_resolving_list_edit
+ *
+ * Description      End a resolving list edit, |idle_mask| being the states
+ *                  to enable once the edit window closes if resolution was
+ *                  off when it opened. Closes the window straight away if no
+ *                  task could be queued to do it later.
+ *
+ * Returns          none
+ *
+ ******************************************************************************/
+static void btm_ble_end_resolving_list_edit(uint8_t idle_mask) {
+  rl_window.EndEdit(idle_mask);
+  if (!rl_window_close_pending) btm_ble_close_resolving_list_window();
+}
+
 /*******************************************************************************
  *
  * Function         btm_ble_resolving_list_load_dev
@@ -681,8 +786,6 @@ bool btm_ble_disable_resolving_list(uint8_t rl_mask, bool to_resume) {
  *
  ******************************************************************************/
 bool btm_ble_resolving_list_load_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
-  const uint8_t rl_state = btm_cb.ble_ctr_cb.rl_state;
-
   if (controller_get_interface()->get_ble_resolving_list_max_size() == 0) {
     BTM_TRACE_DEBUG(
         "%s: Controller does not support RPA offloading or privacy 1.2",
@@ -722,9 +825,7 @@ bool btm_ble_resolving_list_load_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
     return false;
   }
 
-  if (rl_state && !btm_ble_disable_resolving_list(rl_state, false)) {
-    return false;
-  }
+  if (!btm_ble_begin_resolving_list_edit()) return false;
 
   btm_ble_update_resolving_list(p_dev_rec->bd_addr, true);
   if (controller_get_interface()->supports_ble_privacy()) {
@@ -765,11 +866,8 @@ bool btm_ble_resolving_list_load_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
   btm_ble_enq_resolving_list_pending(p_dev_rec->bd_addr,
                                      BTM_BLE_META_ADD_IRK_ENTRY);
 
-  /* if resolving list has been turned on, re-enable it */
-  if (rl_state)
-    btm_ble_enable_resolving_list(rl_state);
-  else
-    btm_ble_enable_resolving_list(BTM_BLE_RL_INIT);
+  /* if resolving list was off, turn it on for initiating */
+  btm_ble_end_resolving_list_edit(BTM_BLE_RL_INIT);
 
   return true;
 }
@@ -786,12 +884,8 @@ bool btm_ble_resolving_list_load_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
  *
  ******************************************************************************/
 void btm_ble_resolving_list_remove_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
-  uint8_t rl_mask = btm_cb.ble_ctr_cb.rl_state;
-
   BTM_TRACE_EVENT("%s", __func__);
-  if (rl_mask) {
-    if (!btm_ble_disable_resolving_list(rl_mask, false)) return;
-  }
+  if (!btm_ble_begin_resolving_list_edit()) return;
 
   if ((p_dev_rec->ble.in_controller_list & BTM_RESOLVING_LIST_BIT) &&
       !btm_ble_brcm_find_resolving_pending_entry(
@@ -802,8 +896,7 @@ void btm_ble_resolving_list_remove_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
     BTM_TRACE_DEBUG("Device not in resolving list");
   }
 
-  /* if resolving list has been turned on, re-enable it */
-  if (rl_mask) btm_ble_enable_resolving_list(rl_mask);
+  btm_ble_end_resolving_list_edit(BTM_BLE_RL_IDLE);
 }
 
 /*******************************************************************************
@@ -935,5 +1028,30 @@ void btm_ble_resolving_list_cleanup(void) {
   controller_get_interface()->set_ble_resolving_list_max_size(0);
 
   osi_free_and_reset((void**)&btm_cb.ble_ctr_cb.irk_list_mask);
+
+  rl_window.Reset();
+  rl_window_close_pending = false;
 }
 #endif
+
+/*******************************************************************************
+ *
+ * Function         btm_ble_privacy_debug_dump
+ *
+ * Description      Dump resolving list edit and activity outage statistics
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_ble_privacy_debug_dump(int fd) {
+#if (BLE_PRIVACY_SPT == TRUE)
+  dprintf(fd, "\nLE Resolving List:\n");
+  dprintf(fd, "  Edits: %u in %u windows\n", rl_stats.edits,
+          rl_stats.windows);
+  dprintf(fd, "  Scan/initiate/advertise outages: %u\n", rl_stats.outages);
+  dprintf(fd, "  Outage duration (ms): last %llu, longest %llu, total %llu\n",
+          (unsigned long long)rl_stats.last_outage_ms,
+          (unsigned long long)rl_stats.max_outage_ms,
+          (unsigned long long)rl_stats.total_outage_ms);
+#endif
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btm_ble_rl_edit_window.h"
+
+#include "btm_ble_api.h"
+#include "btm_ble_int_types.h"
+
+bool BtmBleRlEditWindow::BeginEdit(uint8_t rl_state) {
+  if (open_) {
+    mask_ |= rl_state;
+    return false;
+  }
+
+  open_ = true;
+  pre_edit_state_ = rl_state;
+  mask_ = rl_state;
+  return true;
+}
+
+void BtmBleRlEditWindow::EndEdit(uint8_t idle_mask) {
+  if (pre_edit_state_ == BTM_BLE_RL_IDLE) mask_ |= idle_mask;
+}
+
+uint8_t BtmBleRlEditWindow::Close() {
+  uint8_t rl_mask = mask_;
+  Reset();
+  return rl_mask;
+}
+
+void BtmBleRlEditWindow::Reset() {
+  open_ = false;
+  pre_edit_state_ = BTM_BLE_RL_IDLE;
+  mask_ = BTM_BLE_RL_IDLE;
+}
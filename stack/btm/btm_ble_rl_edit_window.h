@@ -0,0 +1,55 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTM_BLE_RL_EDIT_WINDOW_H
+#define BTM_BLE_RL_EDIT_WINDOW_H
+
+#include <stdint.h>
+
+/* Tracks the window shared by back to back resolving list edits, during which
+ * address resolution is disabled. Resolution states are BTM_BLE_RL_* masks.
+ *
+ * The state resolution was in when the window opened is recorded once, so the
+ * states re-enabled when it closes do not depend on how many edits it held. */
+class BtmBleRlEditWindow {
+ public:
+  /* Starts an edit while resolution is in |rl_state|, which the edit is about
+   * to disable. States turned back on while the window was open are added to
+   * the ones to re-enable.
+   * Returns true if this edit opened the window. */
+  bool BeginEdit(uint8_t rl_state);
+
+  /* Ends an edit. |idle_mask| is re-enabled when the window closes if
+   * resolution was off when the window opened. */
+  void EndEdit(uint8_t idle_mask);
+
+  /* Closes the window.
+   * Returns the resolution states to re-enable. */
+  uint8_t Close();
+
+  bool IsOpen() const { return open_; }
+
+  void Reset();
+
+ private:
+  bool open_ = false;
+  uint8_t pre_edit_state_ = 0;
+  uint8_t mask_ = 0;
+};
+
+#endif /* BTM_BLE_RL_EDIT_WINDOW_H */
@@ -41,9 +41,11 @@
 #include "bt_common.h"
 #include "bt_types.h"
 #include "bt_utils.h"
+#include "bta/include/bta_closure_api.h"
 #include "btm_api.h"
 #include "btm_int.h"
 #include "btu.h"
+#include "btu_nocp_credits.h"
 #include "device/include/controller.h"
 #include "hci_layer.h"
 #include "hcimsgs.h"
@@ -128,17 +130,11 @@ static void btu_ble_rc_param_req_evt(uint8_t* p);
 static void btu_ble_proc_enhanced_conn_cmpl(uint8_t* p, uint16_t evt_len);
 #endif
 
-static void do_in_hci_thread(const tracked_objects::Location& from_here,
-                             const base::Closure& task) {
-  base::MessageLoop* hci_message_loop = get_message_loop();
-  if (!hci_message_loop || !hci_message_loop->task_runner().get()) {
-    LOG_ERROR(LOG_TAG, "%s: HCI message loop not running, accessed from %s",
-              __func__, from_here.ToString().c_str());
-    return;
-  }
+static void btu_hcif_nocp_flush_task(void);
 
-  hci_message_loop->task_runner()->PostTask(from_here, task);
-}
+static BtuNocpCredits btu_nocp_credits(l2c_link_process_num_completed_pkts);
+/* A task handing the credits over is queued on the bta thread */
+static bool btu_nocp_flush_pending = false;
 
 /*******************************************************************************
  *
@@ -157,6 +153,8 @@ void btu_hcif_process_event(UNUSED_ATTR uint8_t controller_id, BT_HDR* p_msg) {
   STREAM_TO_UINT8(hci_evt_code, p);
   STREAM_TO_UINT8(hci_evt_len, p);
 
+  btu_nocp_credits.BeforeEvent(hci_evt_code);
+
   switch (hci_evt_code) {
     case HCI_INQUIRY_COMP_EVT:
       btu_hcif_inquiry_comp_evt(p);
@@ -435,7 +433,7 @@ static void btu_hcif_command_complete_evt_with_cb_on_task(BT_HDR* event,
 
 static void btu_hcif_command_complete_evt_with_cb(BT_HDR* response,
                                                   void* context) {
-  do_in_hci_thread(FROM_HERE,
+  do_in_bta_thread(FROM_HERE,
                    base::Bind(btu_hcif_command_complete_evt_with_cb_on_task,
                               response, context));
 }
@@ -468,7 +466,7 @@ static void btu_hcif_command_status_evt_with_cb(uint8_t status, BT_HDR* command,
     return;
   }
 
-  do_in_hci_thread(
+  do_in_bta_thread(
       FROM_HERE, base::Bind(btu_hcif_command_status_evt_with_cb_on_task, status,
                             command, context));
 }
@@ -1088,7 +1086,7 @@ static void btu_hcif_command_complete_evt_on_task(BT_HDR* event,
 }
 
 static void btu_hcif_command_complete_evt(BT_HDR* response, void* context) {
-  do_in_hci_thread(FROM_HERE, base::Bind(btu_hcif_command_complete_evt_on_task,
+  do_in_bta_thread(FROM_HERE, base::Bind(btu_hcif_command_complete_evt_on_task,
                                          response, context));
 }
 
@@ -1263,7 +1261,7 @@ static void btu_hcif_command_status_evt_on_task(uint8_t status, BT_HDR* event,
 
 static void btu_hcif_command_status_evt(uint8_t status, BT_HDR* command,
                                         void* context) {
-  do_in_hci_thread(FROM_HERE, base::Bind(btu_hcif_command_status_evt_on_task,
+  do_in_bta_thread(FROM_HERE, base::Bind(btu_hcif_command_status_evt_on_task,
                                          status, command, context));
 }
 
@@ -1330,13 +1328,61 @@ static void btu_hcif_role_change_evt(uint8_t* p) {
  *
  ******************************************************************************/
 static void btu_hcif_num_compl_data_pkts_evt(uint8_t* p) {
-  /* Process for L2CAP and SCO */
-  l2c_link_process_num_completed_pkts(p);
+  btu_nocp_credits.AddEvent(p);
+
+  if (btu_nocp_flush_pending || btu_nocp_credits.IsEmpty()) return;
+
+  /* Process for L2CAP and SCO once the events already queued have been seen */
+  if (do_in_bta_thread(FROM_HERE, base::Bind(&btu_hcif_nocp_flush_task)) ==
+      BT_STATUS_SUCCESS) {
+    btu_nocp_flush_pending = true;
+  } else {
+    btu_nocp_credits.Flush();
+  }
 
   /* Send on to SCO */
   /*?? No SCO for now */
 }
 
+static void btu_hcif_nocp_flush_task(void) {
+  btu_nocp_flush_pending = false;
+  btu_nocp_credits.Flush();
+}
+
+/*******************************************************************************
+ *
+ * Function         btu_hcif_init
+ *
+ * Description      Drop Number Of Completed Packets credits left over from
+ *                  when the stack was last running
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btu_hcif_init(void) {
+  btu_nocp_credits.Reset();
+  btu_nocp_flush_pending = false;
+}
+
+/*******************************************************************************
+ *
+ * Function         btu_hcif_debug_dump
+ *
+ * Description      Dump HCI event coalescing statistics
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btu_hcif_debug_dump(int fd) {
+  dprintf(fd, "\nHCI Event Coalescing:\n");
+  dprintf(fd, "  Number Of Completed Packets events: %llu\n",
+          (unsigned long long)btu_nocp_credits.events());
+  dprintf(fd, "  Events coalesced with the previous ones: %llu\n",
+          (unsigned long long)btu_nocp_credits.events_coalesced());
+  dprintf(fd, "  L2CAP link scheduler runs avoided: %llu\n",
+          (unsigned long long)btu_nocp_credits.link_runs_avoided());
+}
+
 /*******************************************************************************
  *
  * Function         btu_hcif_mode_change_evt
@@ -73,6 +73,8 @@ void btu_init_core(void) {
   SMP_Init();
 
   btm_ble_init();
+
+  btu_hcif_init();
 }
 
 /*****************************************************************************
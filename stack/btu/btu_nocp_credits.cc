@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btu_nocp_credits.h"
+
+#include "bt_types.h"
+#include "hcidefs.h"
+
+constexpr uint8_t BtuNocpCredits::kMaxHandles;
+
+void BtuNocpCredits::AddEvent(uint8_t* p) {
+  uint8_t num_handles;
+  STREAM_TO_UINT8(num_handles, p);
+
+  events_.fetch_add(1, std::memory_order_relaxed);
+  if (num_handles_ > 0)
+    events_coalesced_.fetch_add(1, std::memory_order_relaxed);
+
+  for (uint8_t xx = 0; xx < num_handles; xx++) {
+    uint16_t handle, num_sent;
+    STREAM_TO_UINT16(handle, p);
+    STREAM_TO_UINT16(num_sent, p);
+
+    uint8_t yy = 0;
+    while (yy < num_handles_ && credits_[yy].handle != handle) yy++;
+
+    if (yy < num_handles_) {
+      credits_[yy].num_sent += num_sent;
+      link_runs_avoided_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (num_handles_ == kMaxHandles) Flush();
+    credits_[num_handles_].handle = handle;
+    credits_[num_handles_].num_sent = num_sent;
+    num_handles_++;
+  }
+}
+
+void BtuNocpCredits::BeforeEvent(uint8_t evt_code) {
+  if (evt_code != HCI_NUM_COMPL_DATA_PKTS_EVT) Flush();
+}
+
+void BtuNocpCredits::Flush() {
+  if (num_handles_ == 0) return;
+
+  /* Laid out like the event parameters L2CAP takes */
+  uint8_t params[1 + kMaxHandles * 4];
+  uint8_t* p = params;
+  UINT8_TO_STREAM(p, num_handles_);
+  for (uint8_t xx = 0; xx < num_handles_; xx++) {
+    UINT16_TO_STREAM(p, credits_[xx].handle);
+    UINT16_TO_STREAM(p, credits_[xx].num_sent);
+  }
+  num_handles_ = 0;
+
+  p_flush_(params);
+}
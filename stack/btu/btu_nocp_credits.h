@@ -0,0 +1,78 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTU_NOCP_CREDITS_H
+#define BTU_NOCP_CREDITS_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+/* Hands the parameters of a Number Of Completed Packets event to L2CAP */
+typedef void(tBTU_NOCP_FLUSH_CBACK)(uint8_t* p);
+
+/* Credits from back to back Number Of Completed Packets events are added up
+ * per connection handle and handed to L2CAP together, so that a burst of them
+ * runs the L2CAP scheduler once per link rather than once per link per event.
+ * They are handed over before any other HCI event is processed, or when the
+ * owner flushes them. */
+class BtuNocpCredits {
+ public:
+  static constexpr uint8_t kMaxHandles = 16;
+
+  explicit BtuNocpCredits(tBTU_NOCP_FLUSH_CBACK* p_flush) : p_flush_(p_flush) {}
+
+  /* Adds the credits of a Number Of Completed Packets event, |p| pointing at
+   * its parameters. When a new handle doesn't fit in the table the credits
+   * collected so far are handed over first. */
+  void AddEvent(uint8_t* p);
+
+  /* Called before an HCI event with |evt_code| is processed. Anything but
+   * another Number Of Completed Packets event may depend on the credits
+   * having been returned. */
+  void BeforeEvent(uint8_t evt_code);
+
+  /* Hands the credits collected so far to L2CAP in one event */
+  void Flush();
+
+  bool IsEmpty() const { return num_handles_ == 0; }
+
+  /* Drops the credits collected so far */
+  void Reset() { num_handles_ = 0; }
+
+  /* Statistics, may be read from any thread */
+  uint64_t events() const { return events_; }
+  uint64_t events_coalesced() const { return events_coalesced_; }
+  uint64_t link_runs_avoided() const { return link_runs_avoided_; }
+
+ private:
+  struct Credits {
+    uint16_t handle;
+    uint16_t num_sent;
+  };
+
+  tBTU_NOCP_FLUSH_CBACK* p_flush_;
+  Credits credits_[kMaxHandles];
+  uint8_t num_handles_ = 0;
+
+  std::atomic<uint64_t> events_{0};
+  std::atomic<uint64_t> events_coalesced_{0};
+  std::atomic<uint64_t> link_runs_avoided_{0};
+};
+
+#endif /* BTU_NOCP_CREDITS_H */
@@ -88,6 +88,7 @@ base::MessageLoop* get_message_loop() { return message_loop_; }
 void btu_message_loop_run(UNUSED_ATTR void* context) {
   message_loop_ = new base::MessageLoop();
   run_loop_ = new base::RunLoop();
+  bta_sys_work_start();
 
   // Inform the bt jni thread initialization is ok.
   message_loop_->task_runner()->PostTask(
@@ -95,6 +96,7 @@ void btu_message_loop_run(UNUSED_ATTR void* context) {
                             btif_init_ok, 0, nullptr, 0, nullptr));
 
   run_loop_->Run();
+  bta_sys_work_stop();
 
   delete message_loop_;
   message_loop_ = NULL;
@@ -633,6 +633,15 @@ bool A2DP_CodecTypeEquals(const uint8_t* p_codec_info_a,
 bool A2DP_CodecEquals(const uint8_t* p_codec_info_a,
                       const uint8_t* p_codec_info_b);
 
+// Checks whether a peer configured with |p_codec_info_sink| can decode the
+// frames encoded for the A2DP codec |p_codec_info_frames|: both have the
+// same codec type, sample rate and channel mode, and for SBC the bitpool
+// range of the frames is within the range of the peer.
+// Returns true if the peer can decode the frames, otherwise false.
+// If the codec type is not recognized, the return value is false.
+bool A2DP_CodecFramesCompatible(const uint8_t* p_codec_info_frames,
+                                const uint8_t* p_codec_info_sink);
+
 // Gets the track sample rate value for the A2DP codec.
 // |p_codec_info| is a pointer to the codec_info to decode.
 // Returns the track sample rate on success, or -1 if |p_codec_info|
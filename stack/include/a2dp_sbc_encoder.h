@@ -60,6 +60,9 @@ period_ms_t a2dp_sbc_get_encoder_interval_ms(void);
 // |timestamp_us| is the current timestamp (in microseconds).
 void a2dp_sbc_send_frames(uint64_t timestamp_us);
 
+// Set transmit queue length for the A2DP SBC adaptive bit rate.
+void a2dp_sbc_set_transmit_queue_length(size_t transmit_queue_length);
+
 // Get SBC bitrate
 // Returns |uint32_t| bitrate in bits per second
 uint32_t a2dp_sbc_get_bitrate();
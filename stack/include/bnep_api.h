@@ -301,7 +301,9 @@ extern tBNEP_RESULT BNEP_Disconnect(uint16_t handle);
  *                  BNEP_MTU_EXCEDED        - If the data length is greater
  *                                            than MTU
  *                  BNEP_IGNORE_CMD         - If the packet is filtered out
- *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full
+ *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full, the buffer
+ *                                            is not freed and is left
+ *                                            untouched for the caller to retry
  *                  BNEP_SUCCESS            - If written successfully
  *
  ******************************************************************************/
@@ -861,4 +861,6 @@ extern void BTM_BleSetPhy(const RawAddress& bd_addr, uint8_t tx_phys,
 
 extern void btm_ble_multi_adv_cleanup(void);
 
+extern void btm_ble_privacy_debug_dump(int fd);
+
 #endif
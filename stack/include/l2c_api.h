@@ -803,6 +803,20 @@ extern bool L2CA_SetTxPriority(uint16_t cid, tL2CAP_CHNL_PRIORITY priority);
  ******************************************************************************/
 extern bool L2CA_RegForNoCPEvt(tL2CA_NOCP_CB* p_cb, const RawAddress& p_bda);
 
+/*******************************************************************************
+ *
+ * Function         L2CA_SetTxLatencyTarget
+ *
+ * Description      Sets the transmit latency target for a channel. A channel
+ *                  whose oldest queued buffer waited longer than |target_ms|
+ *                  is served ahead of the priority round robin of its link.
+ *                  A target of 0 removes it.
+ *
+ * Returns          true if a valid channel, else false
+ *
+ ******************************************************************************/
+extern bool L2CA_SetTxLatencyTarget(uint16_t cid, uint16_t target_ms);
+
 /*******************************************************************************
  *
  * Function         L2CA_SetChnlDataRate
@@ -1283,4 +1297,17 @@ extern uint16_t L2CA_GetDisconnectReason(const RawAddress& remote_bda,
 extern void L2CA_AdjustConnectionIntervals(uint16_t* min_interval,
                                            uint16_t* max_interval,
                                            uint16_t floor_interval);
+
+/*******************************************************************************
+ *
+ * Function         stack_debug_l2cap_api_dump
+ *
+ * Description      Dump the transmit scheduling state of the L2CAP channels,
+ *                  with the time their buffers spent in the transmit queue,
+ *                  to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void stack_debug_l2cap_api_dump(int fd);
 #endif /* L2C_API_H */
@@ -1407,6 +1407,35 @@ bool L2CA_SetTxPriority(uint16_t cid, tL2CAP_CHNL_PRIORITY priority) {
   return (true);
 }
 
+/*******************************************************************************
+ *
+ * Function         L2CA_SetTxLatencyTarget
+ *
+ * Description      Sets the transmit latency target for a channel. Once the
+ *                  oldest queued buffer of the channel waited longer than
+ *                  |target_ms| the channel is served ahead of the priority
+ *                  round robin of its link. A target of 0 removes it.
+ *
+ * Returns          true if a valid channel, else false
+ *
+ ******************************************************************************/
+bool L2CA_SetTxLatencyTarget(uint16_t cid, uint16_t target_ms) {
+  L2CAP_TRACE_API("L2CA_SetTxLatencyTarget()  CID: 0x%04x, target:%u ms", cid,
+                  target_ms);
+
+  /* Find the channel control block. We don't know the link it is on. */
+  tL2C_CCB* p_ccb = l2cu_find_ccb_by_cid(NULL, cid);
+  if (p_ccb == NULL) {
+    L2CAP_TRACE_WARNING("L2CAP - no CCB for L2CA_SetTxLatencyTarget, CID: %d",
+                        cid);
+    return (false);
+  }
+
+  p_ccb->tx_latency_target_ms = target_ms;
+
+  return (true);
+}
+
 /*******************************************************************************
  *
  * Function         L2CA_SetChnlDataRate
@@ -2261,3 +2290,50 @@ uint16_t L2CA_FlushChannel(uint16_t lcid, uint16_t num_to_flush) {
 
   return (num_left);
 }
+
+/* Print a transmit queueing delay histogram, see tL2C_CCB.tx_delay_hist */
+static void l2c_debug_dump_tx_delay(int fd, const uint32_t* hist) {
+  dprintf(fd, "      Transmit queueing delay (ms):");
+  for (int i = 0; i < L2CAP_TX_DELAY_HIST_BUCKETS - 1; i++)
+    dprintf(fd, " <%u: %u", 1u << i, hist[i]);
+  dprintf(fd, " >=%u: %u\n", 1u << (L2CAP_TX_DELAY_HIST_BUCKETS - 2),
+          hist[L2CAP_TX_DELAY_HIST_BUCKETS - 1]);
+}
+
+/* Print the transmit scheduling state of one channel */
+static void l2c_debug_dump_ccb(int fd, const tL2C_CCB* p_ccb) {
+  dprintf(fd, "    CID: 0x%04x PSM: 0x%04x\n", p_ccb->local_cid,
+          p_ccb->p_rcb ? p_ccb->p_rcb->psm : 0);
+  dprintf(fd, "      Priority: %d Tx data rate: %d\n", p_ccb->ccb_priority,
+          p_ccb->tx_data_rate);
+  dprintf(fd, "      Latency target: %u ms\n", p_ccb->tx_latency_target_ms);
+  dprintf(fd, "      Queued buffers: %zu\n",
+          fixed_queue_length(p_ccb->xmit_hold_q));
+  l2c_debug_dump_tx_delay(fd, p_ccb->tx_delay_hist);
+}
+
+void stack_debug_l2cap_api_dump(int fd) {
+  dprintf(fd, "\nL2CAP Transmit Scheduling:\n");
+
+  for (int i = 0; i < MAX_L2CAP_LINKS; i++) {
+    const tL2C_LCB* p_lcb = &l2cb.lcb_pool[i];
+    if (!p_lcb->in_use) continue;
+
+    dprintf(fd, "  Link: %s handle: 0x%04x\n",
+            p_lcb->remote_bd_addr.ToString().c_str(), p_lcb->handle);
+
+#if (L2CAP_NUM_FIXED_CHNLS > 0)
+    for (int xx = 0; xx < L2CAP_NUM_FIXED_CHNLS; xx++) {
+      if (p_lcb->p_fixed_ccbs[xx] != NULL)
+        l2c_debug_dump_ccb(fd, p_lcb->p_fixed_ccbs[xx]);
+    }
+#endif
+
+    for (const tL2C_CCB* p_ccb = p_lcb->ccb_queue.p_first_ccb; p_ccb;
+         p_ccb = p_ccb->p_next_ccb)
+      l2c_debug_dump_ccb(fd, p_ccb);
+  }
+
+  dprintf(fd, "  Released channels:\n");
+  l2c_debug_dump_tx_delay(fd, l2cb.tx_delay_hist);
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the CRC computation for the L2CAP ERTM and streaming
+ *  mode Frame Check Sequence.
+ *
+ ******************************************************************************/
+
+#include "l2c_fcr_crc.h"
+
+namespace {
+
+struct CrcTables {
+  uint16_t t[8][256];
+};
+
+/* t[0] is the classic byte-wise table. t[k][n] is the CRC of byte n followed
+ * by k zero bytes, which lets eight input bytes be folded in with eight
+ * independent lookups. */
+constexpr CrcTables make_crc_tables() {
+  CrcTables tables{};
+  for (int n = 0; n < 256; n++) {
+    uint16_t crc = n;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    tables.t[0][n] = crc;
+  }
+  for (int k = 1; k < 8; k++) {
+    for (int n = 0; n < 256; n++) {
+      uint16_t prev = tables.t[k - 1][n];
+      tables.t[k][n] = (prev >> 8) ^ tables.t[0][prev & 0xff];
+    }
+  }
+  return tables;
+}
+
+constexpr CrcTables crc_tables = make_crc_tables();
+
+}  // namespace
+
+uint16_t l2c_fcr_updcrc(uint16_t crc, const uint8_t* p, size_t len) {
+  const auto& t = crc_tables.t;
+
+  while (len >= 8) {
+    crc = t[7][p[0] ^ (crc & 0xff)] ^ t[6][p[1] ^ (crc >> 8)] ^ t[5][p[2]] ^
+          t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+    len -= 8;
+  }
+
+  while (len--) crc = (crc >> 8) ^ t[0][(crc & 0xff) ^ *p++];
+
+  return crc;
+}
@@ -0,0 +1,35 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_updcrc
+ *
+ * Description      Continues the L2CAP FCS (CRC-16, polynomial 0x8005,
+ *                  reflected) computation from |crc| over |len| bytes at |p|.
+ *                  Eight bytes are consumed per step using slice-by-8 tables.
+ *
+ * Returns          CRC
+ *
+ ******************************************************************************/
+uint16_t l2c_fcr_updcrc(uint16_t crc, const uint8_t* p, size_t len);
@@ -260,6 +260,18 @@ typedef struct {
   void* p_ref_data;
 } tL2CAP_SEC_DATA;
 
+/* Number of buckets of the per-channel transmit queueing delay histogram */
+#define L2CAP_TX_DELAY_HIST_BUCKETS 12
+
+/* Number of queued buffers per channel whose enqueue time is kept */
+#define L2CAP_TX_STAMPS 32
+
+/* Time a buffer entered the transmit queue of a channel */
+typedef struct {
+  const BT_HDR* p_buf;
+  uint32_t enqueued_ms;
+} tL2C_TX_STAMP;
+
 /* Define a channel control block (CCB). There may be many channel control
  * blocks between the same two Bluetooth devices (i.e. on the same link).
  * Each CCB has unique local and remote CIDs. All channel control blocks on
@@ -313,6 +325,21 @@ typedef struct t_l2c_ccb {
   tL2CAP_CHNL_DATA_RATE tx_data_rate; /* Channel Tx data rate */
   tL2CAP_CHNL_DATA_RATE rx_data_rate; /* Channel Rx data rate */
 
+  /* Channels with a latency target are served ahead of the round robin once
+   * the head of their transmit queue waited that long. 0 means no target. */
+  uint16_t tx_latency_target_ms;
+  /* Time buffers spent in xmit_hold_q, bucket i counts delays below 2^i ms */
+  uint32_t tx_delay_hist[L2CAP_TX_DELAY_HIST_BUCKETS];
+  /* Enqueue times of the buffers in xmit_hold_q, oldest first. A buffer
+   * queued while the ring is full is not timed. */
+  tL2C_TX_STAMP tx_stamps[L2CAP_TX_STAMPS];
+  uint8_t tx_stamp_first;
+  uint8_t tx_stamp_count;
+
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+  int32_t tx_deficit; /* Bytes left in the round robin turn of the channel */
+#endif
+
   /* Fields used for eL2CAP */
   tL2CAP_ERTM_INFO ertm_info;
   tL2C_FCRB fcrb;
@@ -360,6 +387,12 @@ typedef struct {
 #define L2CAP_GET_PRIORITY_QUOTA(pri) \
   ((L2CAP_NUM_CHNL_PRIORITY - (pri)) * L2CAP_CHNL_PRIORITY_WEIGHT)
 
+/* Bytes a channel may send in its round robin turn, per unit of the Tx data
+ * rate set with L2CA_SetChnlDataRate() */
+#ifndef L2CAP_CHNL_DRR_QUANTUM
+#define L2CAP_CHNL_DRR_QUANTUM 1024
+#endif
+
 /* CCBs within the same LCB are served in round robin with priority It will make
  * sure that low priority channel (for example, HF signaling on RFCOMM) can be
  * sent to the headset even if higher priority channel (for example, AV media
@@ -525,6 +558,9 @@ typedef struct {
   uint16_t le_dyn_psm; /* Next LE dynamic PSM value to try to assign */
   bool le_dyn_psm_assigned[LE_DYNAMIC_PSM_RANGE]; /* Table of assigned LE PSM */
 
+  /* Transmit queueing delay of the channels released so far */
+  uint32_t tx_delay_hist[L2CAP_TX_DELAY_HIST_BUCKETS];
+
 } tL2C_CB;
 
 /* Define a structure that contains the information about a connection.
@@ -637,6 +673,7 @@ extern void l2cu_check_channel_congestion(tL2C_CCB* p_ccb);
 extern void l2cu_disconnect_chnl(tL2C_CCB* p_ccb);
 
 extern void l2cu_tx_complete(tL2C_TX_COMPLETE_CB_INFO* p_cbi);
+extern void l2cu_tx_delay_dump(tL2C_CCB* p_ccb);
 
 #if (L2CAP_NON_FLUSHABLE_PB_INCLUDED == TRUE)
 extern void l2cu_set_non_flushable_pbf(bool);
@@ -698,6 +735,21 @@ extern void l2cu_resubmit_pending_sec_req(const RawAddress* p_bda);
 extern void l2cu_initialize_amp_ccb(tL2C_LCB* p_lcb);
 extern void l2cu_adjust_out_mps(tL2C_CCB* p_ccb);
 
+/* Functions provided by l2c_tx_sched.cc
+ ***********************************
+*/
+extern bool l2cu_ccb_has_data_to_send(tL2C_CCB* p_ccb);
+extern tL2C_CCB* l2cu_get_overdue_channel(tL2C_LCB* p_lcb);
+extern void l2cu_stamp_tx_buf(tL2C_CCB* p_ccb, const BT_HDR* p_buf);
+extern bool l2cu_get_tx_stamp(tL2C_CCB* p_ccb, const BT_HDR* p_buf,
+                              uint32_t* p_stamp_ms);
+extern void l2cu_clear_tx_stamps(tL2C_CCB* p_ccb);
+extern void l2cu_record_tx_delay(tL2C_CCB* p_ccb, const BT_HDR* p_head);
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+extern void l2cu_rr_charge(tL2C_CCB* p_ccb, uint16_t len);
+extern tL2C_CCB* l2cu_get_next_channel_in_rr(tL2C_LCB* p_lcb);
+#endif
+
 /* Functions provided by l2c_link.cc
  ***********************************
 */
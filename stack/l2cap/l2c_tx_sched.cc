@@ -0,0 +1,366 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the choice of the dynamic channel a link sends on next:
+ *  latency targets, deficit round robin and the transmit queueing delays.
+ *
+ ******************************************************************************/
+
+#include "bt_common.h"
+#include "bt_types.h"
+#include "l2c_int.h"
+#include "osi/include/time.h"
+
+/******************************************************************************
+ *
+ * Function         l2cu_ccb_has_data_to_send
+ *
+ * Description      check whether a dynamic channel is open and allowed to send
+ *                  its next buffer.
+ *
+ * Returns          true if the channel can be served
+ *
+ ******************************************************************************/
+bool l2cu_ccb_has_data_to_send(tL2C_CCB* p_ccb) {
+  if (p_ccb->chnl_state != CST_OPEN) return false;
+
+  if (p_ccb->p_lcb->transport == BT_TRANSPORT_LE)
+    return !fixed_queue_is_empty(p_ccb->xmit_hold_q) &&
+           p_ccb->peer_conn_cfg.credits != 0;
+
+  /* eL2CAP option in use */
+  if (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_BASIC_MODE) {
+    if (p_ccb->fcrb.wait_ack || p_ccb->fcrb.remote_busy) return false;
+
+    if (!fixed_queue_is_empty(p_ccb->fcrb.retrans_q)) return true;
+
+    if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) return false;
+
+    /* If in eRTM mode, check for window closure */
+    if ((p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE) &&
+        (l2c_fcr_is_flow_controlled(p_ccb)))
+      return false;
+
+    return true;
+  }
+
+  return !fixed_queue_is_empty(p_ccb->xmit_hold_q);
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_get_overdue_channel
+ *
+ * Description      get the channel on a link whose head of line buffer is the
+ *                  furthest past its latency target, so latency sensitive
+ *                  traffic (e.g. A2DP media) is not held behind bulk channels
+ *                  by the round robin.
+ *
+ * Returns          pointer to CCB or NULL
+ *
+ ******************************************************************************/
+tL2C_CCB* l2cu_get_overdue_channel(tL2C_LCB* p_lcb) {
+  tL2C_CCB* p_serve_ccb = NULL;
+  uint32_t max_overdue_ms = 0;
+  uint32_t now_ms = 0;
+
+  for (tL2C_CCB* p_ccb = p_lcb->ccb_queue.p_first_ccb; p_ccb;
+       p_ccb = p_ccb->p_next_ccb) {
+    if (p_ccb->tx_latency_target_ms == 0) continue;
+
+    BT_HDR* p_head = (BT_HDR*)fixed_queue_try_peek_first(p_ccb->xmit_hold_q);
+    uint32_t stamp_ms;
+    if (p_head == NULL || !l2cu_get_tx_stamp(p_ccb, p_head, &stamp_ms))
+      continue;
+
+    if (now_ms == 0) now_ms = time_get_os_boottime_ms();
+    uint32_t waited_ms = now_ms - stamp_ms;
+    if (waited_ms < p_ccb->tx_latency_target_ms) continue;
+
+    uint32_t overdue_ms = waited_ms - p_ccb->tx_latency_target_ms;
+    if (p_serve_ccb && overdue_ms <= max_overdue_ms) continue;
+
+    if (!l2cu_ccb_has_data_to_send(p_ccb)) continue;
+
+    p_serve_ccb = p_ccb;
+    max_overdue_ms = overdue_ms;
+  }
+
+  return p_serve_ccb;
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_stamp_tx_buf
+ *
+ * Description      record the time a buffer enters the transmit queue of a
+ *                  channel. The time is kept in the CCB: the buffer headroom
+ *                  belongs to the upper layers until L2CAP adds its headers.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2cu_stamp_tx_buf(tL2C_CCB* p_ccb, const BT_HDR* p_buf) {
+  /* Whatever is left belongs to buffers flushed or moved out of the queue */
+  if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) l2cu_clear_tx_stamps(p_ccb);
+
+  if (p_ccb->tx_stamp_count == L2CAP_TX_STAMPS) return;
+
+  int i = (p_ccb->tx_stamp_first + p_ccb->tx_stamp_count) % L2CAP_TX_STAMPS;
+  p_ccb->tx_stamps[i].p_buf = p_buf;
+  p_ccb->tx_stamps[i].enqueued_ms = time_get_os_boottime_ms();
+  p_ccb->tx_stamp_count++;
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_find_tx_stamp
+ *
+ * Description      find the stamp of a queued buffer. The newest entry wins,
+ *                  older ones for the same address belong to a freed buffer.
+ *
+ * Returns          position of the stamp from the oldest one, or -1
+ *
+ ******************************************************************************/
+static int l2cu_find_tx_stamp(tL2C_CCB* p_ccb, const BT_HDR* p_buf) {
+  for (int pos = p_ccb->tx_stamp_count - 1; pos >= 0; pos--) {
+    int i = (p_ccb->tx_stamp_first + pos) % L2CAP_TX_STAMPS;
+    if (p_ccb->tx_stamps[i].p_buf == p_buf) return pos;
+  }
+  return -1;
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_get_tx_stamp
+ *
+ * Description      get the time a queued buffer was stamped with by
+ *                  l2cu_stamp_tx_buf().
+ *
+ * Returns          true and the boot time in ms in |p_stamp_ms|, or false if
+ *                  the buffer was not timed
+ *
+ ******************************************************************************/
+bool l2cu_get_tx_stamp(tL2C_CCB* p_ccb, const BT_HDR* p_buf,
+                       uint32_t* p_stamp_ms) {
+  int pos = l2cu_find_tx_stamp(p_ccb, p_buf);
+  if (pos < 0) return false;
+
+  int i = (p_ccb->tx_stamp_first + pos) % L2CAP_TX_STAMPS;
+  *p_stamp_ms = p_ccb->tx_stamps[i].enqueued_ms;
+  return true;
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_clear_tx_stamps
+ *
+ * Description      forget the enqueue times of all the buffers of a channel.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2cu_clear_tx_stamps(tL2C_CCB* p_ccb) {
+  p_ccb->tx_stamp_first = 0;
+  p_ccb->tx_stamp_count = 0;
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_record_tx_delay
+ *
+ * Description      account the time the buffer |p_head| spent in the transmit
+ *                  queue of a channel, once it has left the queue. Segmented
+ *                  SDUs leave it with their last segment. |p_head| is only
+ *                  compared, it may have been freed already.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2cu_record_tx_delay(tL2C_CCB* p_ccb, const BT_HDR* p_head) {
+  if (p_head == NULL ||
+      fixed_queue_try_peek_first(p_ccb->xmit_hold_q) == p_head)
+    return;
+
+  int pos = l2cu_find_tx_stamp(p_ccb, p_head);
+  if (pos < 0) return;
+
+  int i = (p_ccb->tx_stamp_first + pos) % L2CAP_TX_STAMPS;
+  uint32_t delay_ms =
+      time_get_os_boottime_ms() - p_ccb->tx_stamps[i].enqueued_ms;
+
+  /* Older stamps are of buffers flushed before they were sent */
+  p_ccb->tx_stamp_first = (i + 1) % L2CAP_TX_STAMPS;
+  p_ccb->tx_stamp_count -= pos + 1;
+
+  int bucket = 0;
+  while (bucket < L2CAP_TX_DELAY_HIST_BUCKETS - 1 && (delay_ms >> bucket) != 0)
+    bucket++;
+  p_ccb->tx_delay_hist[bucket]++;
+}
+
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+
+/******************************************************************************
+ *
+ * Function         l2cu_rr_serve_next
+ *
+ * Description      end the round robin turn of a channel, the next channel of
+ *                  its priority group is served next.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void l2cu_rr_serve_next(tL2C_LCB* p_lcb, tL2C_CCB* p_ccb) {
+  tL2C_RR_SERV* p_serv = &p_lcb->rr_serv[p_ccb->ccb_priority];
+
+  /* this channel is the last channel of its priority group */
+  if ((p_ccb->p_next_ccb == NULL) ||
+      (p_ccb->p_next_ccb->ccb_priority != p_ccb->ccb_priority)) {
+    /* next serving channel is set to the first channel in the group */
+    p_serv->p_serve_ccb = p_serv->p_first_ccb;
+  } else {
+    /* next serving channel is set to the next channel in the group */
+    p_serv->p_serve_ccb = p_ccb->p_next_ccb;
+  }
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_rr_quantum
+ *
+ * Description      get the bytes a channel may send in its round robin turn.
+ *                  Channels with a higher Tx data rate get a larger turn.
+ *
+ * Returns          quantum in bytes
+ *
+ ******************************************************************************/
+static int32_t l2cu_rr_quantum(tL2C_CCB* p_ccb) {
+  if (p_ccb->tx_data_rate <= L2CAP_CHNL_DATA_RATE_LOW)
+    return L2CAP_CHNL_DRR_QUANTUM;
+
+  return p_ccb->tx_data_rate * L2CAP_CHNL_DRR_QUANTUM;
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_rr_charge
+ *
+ * Description      charge a buffer of |len| bytes sent on a channel to its
+ *                  round robin turn (deficit round robin). The turn ends once
+ *                  the channel used up its quantum, so channels of the same
+ *                  priority get the link in proportion to their Tx data rate
+ *                  whatever the size of their buffers.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void l2cu_rr_charge(tL2C_CCB* p_ccb, uint16_t len) {
+  int32_t quantum = l2cu_rr_quantum(p_ccb);
+
+  /* Buffers larger than the quantum are paid back over the next turn only:
+   * every turn still sends at least one buffer, so the link does not stay
+   * idle while data is queued. */
+  p_ccb->tx_deficit -= len;
+  if (p_ccb->tx_deficit < 1 - quantum) p_ccb->tx_deficit = 1 - quantum;
+  if (p_ccb->tx_deficit > 0) return;
+
+  tL2C_LCB* p_lcb = p_ccb->p_lcb;
+  if (p_lcb->rr_serv[p_ccb->ccb_priority].p_serve_ccb == p_ccb)
+    l2cu_rr_serve_next(p_lcb, p_ccb);
+}
+
+/******************************************************************************
+ *
+ * Function         l2cu_get_next_channel_in_rr
+ *
+ * Description      get the next channel to send on a link. It also adjusts the
+ *                  CCB queue to do a basic priority and round-robin scheduling.
+ *                  A channel stays the serving channel of its group until
+ *                  l2cu_rr_charge() ends its turn.
+ *
+ * Returns          pointer to CCB or NULL
+ *
+ ******************************************************************************/
+tL2C_CCB* l2cu_get_next_channel_in_rr(tL2C_LCB* p_lcb) {
+  tL2C_CCB* p_serve_ccb = NULL;
+  tL2C_CCB* p_ccb;
+
+  int i, j;
+
+  /* scan all of priority until finding a channel to serve */
+  for (i = 0; (i < L2CAP_NUM_CHNL_PRIORITY) && (!p_serve_ccb); i++) {
+    /* scan all channel within serving priority group until finding a channel to
+     * serve */
+    for (j = 0; (j < p_lcb->rr_serv[p_lcb->rr_pri].num_ccb) && (!p_serve_ccb);
+         j++) {
+      /* scaning from next serving channel */
+      p_ccb = p_lcb->rr_serv[p_lcb->rr_pri].p_serve_ccb;
+
+      if (!p_ccb) {
+        L2CAP_TRACE_ERROR("p_serve_ccb is NULL, rr_pri=%d", p_lcb->rr_pri);
+        return NULL;
+      }
+
+      L2CAP_TRACE_DEBUG("RR scan pri=%d, lcid=0x%04x, q_cout=%d",
+                        p_ccb->ccb_priority, p_ccb->local_cid,
+                        fixed_queue_length(p_ccb->xmit_hold_q));
+
+      if (!l2cu_ccb_has_data_to_send(p_ccb)) {
+        /* an idle channel does not save its turn for later */
+        if (fixed_queue_is_empty(p_ccb->xmit_hold_q) &&
+            fixed_queue_is_empty(p_ccb->fcrb.retrans_q))
+          p_ccb->tx_deficit = 0;
+
+        l2cu_rr_serve_next(p_lcb, p_ccb);
+        continue;
+      }
+
+      /* start of its turn, grant the channel its quantum */
+      if (p_ccb->tx_deficit <= 0) p_ccb->tx_deficit += l2cu_rr_quantum(p_ccb);
+
+      /* found a channel to serve */
+      p_serve_ccb = p_ccb;
+      /* decrease quota of its priority group */
+      p_lcb->rr_serv[p_lcb->rr_pri].quota--;
+    }
+
+    /* if there is no more quota of the priority group or no channel to have
+     * data to send */
+    if ((p_lcb->rr_serv[p_lcb->rr_pri].quota == 0) || (!p_serve_ccb)) {
+      /* serve next priority group */
+      p_lcb->rr_pri = (p_lcb->rr_pri + 1) % L2CAP_NUM_CHNL_PRIORITY;
+      /* initialize its quota */
+      p_lcb->rr_serv[p_lcb->rr_pri].quota =
+          L2CAP_GET_PRIORITY_QUOTA(p_lcb->rr_pri);
+    }
+  }
+
+  if (p_serve_ccb) {
+    L2CAP_TRACE_DEBUG("RR service pri=%d, quota=%d, deficit=%d, lcid=0x%04x",
+                      p_serve_ccb->ccb_priority,
+                      p_lcb->rr_serv[p_serve_ccb->ccb_priority].quota,
+                      p_serve_ccb->tx_deficit, p_serve_ccb->local_cid);
+  }
+
+  return p_serve_ccb;
+}
+
+#endif /* (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE) */
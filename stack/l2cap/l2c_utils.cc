@@ -1488,6 +1488,13 @@ tL2C_CCB* l2cu_allocate_ccb(tL2C_LCB* p_lcb, uint16_t cid) {
   p_ccb->cong_sent = false;
   p_ccb->buff_quota = 2; /* This gets set after config */
 
+  p_ccb->tx_latency_target_ms = 0;
+  memset(p_ccb->tx_delay_hist, 0, sizeof(p_ccb->tx_delay_hist));
+  l2cu_clear_tx_stamps(p_ccb);
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+  p_ccb->tx_deficit = 0;
+#endif
+
   /* If CCB was reserved Config_Done can already have some value */
   if (cid == 0)
     p_ccb->config_done = 0;
@@ -1592,6 +1599,8 @@ void l2cu_release_ccb(tL2C_CCB* p_ccb) {
   alarm_free(p_ccb->l2c_ccb_timer);
   p_ccb->l2c_ccb_timer = NULL;
 
+  l2cu_tx_delay_dump(p_ccb);
+
   fixed_queue_free(p_ccb->xmit_hold_q, osi_free);
   p_ccb->xmit_hold_q = NULL;
 
@@ -3079,106 +3088,30 @@ tL2C_CCB* l2cu_find_ccb_by_cid(tL2C_LCB* p_lcb, uint16_t local_cid) {
   return (p_ccb);
 }
 
-#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
-
 /******************************************************************************
  *
- * Function         l2cu_get_next_channel_in_rr
+ * Function         l2cu_tx_delay_dump
  *
- * Description      get the next channel to send on a link. It also adjusts the
- *                  CCB queue to do a basic priority and round-robin scheduling.
+ * Description      log the transmit queueing delay histogram of a channel
+ *                  being released, and add it to the totals of l2cb.
  *
- * Returns          pointer to CCB or NULL
+ * Returns          void
  *
  ******************************************************************************/
-static tL2C_CCB* l2cu_get_next_channel_in_rr(tL2C_LCB* p_lcb) {
-  tL2C_CCB* p_serve_ccb = NULL;
-  tL2C_CCB* p_ccb;
-
-  int i, j;
-
-  /* scan all of priority until finding a channel to serve */
-  for (i = 0; (i < L2CAP_NUM_CHNL_PRIORITY) && (!p_serve_ccb); i++) {
-    /* scan all channel within serving priority group until finding a channel to
-     * serve */
-    for (j = 0; (j < p_lcb->rr_serv[p_lcb->rr_pri].num_ccb) && (!p_serve_ccb);
-         j++) {
-      /* scaning from next serving channel */
-      p_ccb = p_lcb->rr_serv[p_lcb->rr_pri].p_serve_ccb;
-
-      if (!p_ccb) {
-        L2CAP_TRACE_ERROR("p_serve_ccb is NULL, rr_pri=%d", p_lcb->rr_pri);
-        return NULL;
-      }
-
-      L2CAP_TRACE_DEBUG("RR scan pri=%d, lcid=0x%04x, q_cout=%d",
-                        p_ccb->ccb_priority, p_ccb->local_cid,
-                        fixed_queue_length(p_ccb->xmit_hold_q));
-
-      /* store the next serving channel */
-      /* this channel is the last channel of its priority group */
-      if ((p_ccb->p_next_ccb == NULL) ||
-          (p_ccb->p_next_ccb->ccb_priority != p_ccb->ccb_priority)) {
-        /* next serving channel is set to the first channel in the group */
-        p_lcb->rr_serv[p_lcb->rr_pri].p_serve_ccb =
-            p_lcb->rr_serv[p_lcb->rr_pri].p_first_ccb;
-      } else {
-        /* next serving channel is set to the next channel in the group */
-        p_lcb->rr_serv[p_lcb->rr_pri].p_serve_ccb = p_ccb->p_next_ccb;
-      }
-
-      if (p_ccb->chnl_state != CST_OPEN) continue;
-
-      if (p_ccb->p_lcb->transport == BT_TRANSPORT_LE) {
-        L2CAP_TRACE_DEBUG("%s : Connection oriented channel", __func__);
-        if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) continue;
-
-      } else {
-        /* eL2CAP option in use */
-        if (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_BASIC_MODE) {
-          if (p_ccb->fcrb.wait_ack || p_ccb->fcrb.remote_busy) continue;
-
-          if (fixed_queue_is_empty(p_ccb->fcrb.retrans_q)) {
-            if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) continue;
-
-            /* If in eRTM mode, check for window closure */
-            if ((p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE) &&
-                (l2c_fcr_is_flow_controlled(p_ccb)))
-              continue;
-          }
-        } else {
-          if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) continue;
-        }
-      }
-
-      /* found a channel to serve */
-      p_serve_ccb = p_ccb;
-      /* decrease quota of its priority group */
-      p_lcb->rr_serv[p_lcb->rr_pri].quota--;
-    }
+void l2cu_tx_delay_dump(tL2C_CCB* p_ccb) {
+  const uint32_t* h = p_ccb->tx_delay_hist;
 
-    /* if there is no more quota of the priority group or no channel to have
-     * data to send */
-    if ((p_lcb->rr_serv[p_lcb->rr_pri].quota == 0) || (!p_serve_ccb)) {
-      /* serve next priority group */
-      p_lcb->rr_pri = (p_lcb->rr_pri + 1) % L2CAP_NUM_CHNL_PRIORITY;
-      /* initialize its quota */
-      p_lcb->rr_serv[p_lcb->rr_pri].quota =
-          L2CAP_GET_PRIORITY_QUOTA(p_lcb->rr_pri);
-    }
-  }
+  for (int i = 0; i < L2CAP_TX_DELAY_HIST_BUCKETS; i++)
+    l2cb.tx_delay_hist[i] += h[i];
 
-  if (p_serve_ccb) {
-    L2CAP_TRACE_DEBUG("RR service pri=%d, quota=%d, lcid=0x%04x",
-                      p_serve_ccb->ccb_priority,
-                      p_lcb->rr_serv[p_serve_ccb->ccb_priority].quota,
-                      p_serve_ccb->local_cid);
-  }
-
-  return p_serve_ccb;
+  L2CAP_TRACE_EVENT(
+      "%s: cid 0x%04x target %u ms, delay <1:%u <2:%u <4:%u <8:%u <16:%u "
+      "<32:%u <64:%u <128:%u <256:%u <512:%u <1024:%u >=1024:%u",
+      __func__, p_ccb->local_cid, p_ccb->tx_latency_target_ms, h[0], h[1],
+      h[2], h[3], h[4], h[5], h[6], h[7], h[8], h[9], h[10], h[11]);
 }
 
-#else  /* (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE) */
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE != TRUE)
 
 /******************************************************************************
  *
@@ -3215,7 +3148,7 @@ static tL2C_CCB* l2cu_get_next_channel(tL2C_LCB* p_lcb) {
 
   return NULL;
 }
-#endif /* (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE) */
+#endif /* (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE != TRUE) */
 
 void l2cu_tx_complete(tL2C_TX_COMPLETE_CB_INFO* p_cbi) {
   if (p_cbi->cb != NULL) p_cbi->cb(p_cbi->local_cid, p_cbi->num_sdu);
@@ -3260,8 +3193,11 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
           continue;
       }
 
+      BT_HDR* p_head = (BT_HDR*)fixed_queue_try_peek_first(p_ccb->xmit_hold_q);
+
       p_buf = l2c_fcr_get_next_xmit_sdu_seg(p_ccb, 0);
       if (p_buf != NULL) {
+        l2cu_record_tx_delay(p_ccb, p_head);
         l2cu_check_channel_congestion(p_ccb);
         l2cu_set_acl_hci_header(p_buf, p_ccb);
         return (p_buf);
@@ -3273,6 +3209,7 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
           L2CAP_TRACE_ERROR("%s: No data to be sent", __func__);
           return (NULL);
         }
+        l2cu_record_tx_delay(p_ccb, p_buf);
 
         /* Prepare callback info for TX completion */
         p_cbi->cb = l2cb.fixed_reg[xx].pL2CA_FixedTxComplete_Cb;
@@ -3287,16 +3224,22 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
   }
 #endif
 
+  /* Channels past their latency target go first */
+  p_ccb = l2cu_get_overdue_channel(p_lcb);
+  if (p_ccb == NULL) {
 #if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
-  /* get next serving channel in round-robin */
-  p_ccb = l2cu_get_next_channel_in_rr(p_lcb);
+    /* get next serving channel in round-robin */
+    p_ccb = l2cu_get_next_channel_in_rr(p_lcb);
 #else
-  p_ccb = l2cu_get_next_channel(p_lcb);
+    p_ccb = l2cu_get_next_channel(p_lcb);
 #endif
+  }
 
   /* Return if no buffer */
   if (p_ccb == NULL) return (NULL);
 
+  BT_HDR* p_head = (BT_HDR*)fixed_queue_try_peek_first(p_ccb->xmit_hold_q);
+
   if (p_ccb->p_lcb->transport == BT_TRANSPORT_LE) {
     /* Check credits */
     if (p_ccb->peer_conn_cfg.credits == 0) {
@@ -3326,6 +3269,11 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
     }
   }
 
+  l2cu_record_tx_delay(p_ccb, p_head);
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+  l2cu_rr_charge(p_ccb, p_buf->len);
+#endif
+
   if (p_ccb->p_rcb && p_ccb->p_rcb->api.pL2CA_TxComplete_Cb &&
       (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_ERTM_MODE))
     (*p_ccb->p_rcb->api.pL2CA_TxComplete_Cb)(p_ccb->local_cid, 1);
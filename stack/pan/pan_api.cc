@@ -472,7 +472,9 @@ tPAN_RESULT PAN_Write(uint16_t handle, const RawAddress& dst,
   memcpy((uint8_t*)buffer + sizeof(BT_HDR) + buffer->offset, p_data,
          buffer->len);
 
-  return PAN_WriteBuf(handle, dst, src, protocol, buffer, ext);
+  tPAN_RESULT result = PAN_WriteBuf(handle, dst, src, protocol, buffer, ext);
+  if (result == PAN_Q_SIZE_EXCEEDED) osi_free(buffer);
+  return result;
 }
 
 /*******************************************************************************
@@ -496,6 +498,8 @@ tPAN_RESULT PAN_Write(uint16_t handle, const RawAddress& dst,
  * Returns          PAN_SUCCESS       - if the data is sent successfully
  *                  PAN_FAILURE       - if the connection is not found or
  *                                           there is an error in sending data
+ *                  PAN_Q_SIZE_EXCEEDED - if the transmit queue is full; the
+ *                                           buffer is not freed
  *
  ******************************************************************************/
 tPAN_RESULT PAN_WriteBuf(uint16_t handle, const RawAddress& dst,
@@ -26,9 +26,9 @@
 
 #include <base/logging.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include "osi/include/log.h"
-#include "osi/include/mutex.h"
 
 #include "bt_common.h"
 #include "btm_api.h"
@@ -43,6 +43,9 @@
 /* duration of break in 200ms units */
 #define PORT_BREAK_DURATION 1
 
+/* Maximum number of buffers filled by one call-out in PORT_WriteDataCO */
+#define PORT_DATA_CO_MAX_BUFS PORT_TX_BUF_HIGH_WM
+
 #define info(fmt, ...) LOG_INFO(LOG_TAG, "%s: " fmt, __func__, ##__VA_ARGS__)
 #define debug(fmt, ...) LOG_DEBUG(LOG_TAG, "%s: " fmt, __func__, ##__VA_ARGS__)
 #define error(fmt, ...) \
@@ -1086,7 +1089,7 @@ int PORT_Purge(uint16_t handle, uint8_t purge_flags) {
   }
 
   if (purge_flags & PORT_PURGE_RXCLEAR) {
-    mutex_global_lock(); /* to prevent missing credit */
+    port_data_lock(p_port); /* to prevent missing credit */
 
     count = fixed_queue_length(p_port->rx.queue);
 
@@ -1095,21 +1098,21 @@ int PORT_Purge(uint16_t handle, uint8_t purge_flags) {
 
     p_port->rx.queue_size = 0;
 
-    mutex_global_unlock();
+    port_data_unlock(p_port);
 
     /* If we flowed controlled peer based on rx_queue size enable data again */
     if (count) port_flow_control_peer(p_port, true, count);
   }
 
   if (purge_flags & PORT_PURGE_TXCLEAR) {
-    mutex_global_lock(); /* to prevent tx.queue_size from being negative */
+    port_data_lock(p_port); /* to prevent tx.queue_size from being negative */
 
     while ((p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_port->tx.queue)) != NULL)
       osi_free(p_buf);
 
     p_port->tx.queue_size = 0;
 
-    mutex_global_unlock();
+    port_data_unlock(p_port);
 
     events = PORT_EV_TXEMPTY;
 
@@ -1178,11 +1181,11 @@ int PORT_ReadData(uint16_t handle, char* p_data, uint16_t max_len,
 
       *p_len += max_len;
 
-      mutex_global_lock();
+      port_data_lock(p_port);
 
       p_port->rx.queue_size -= max_len;
 
-      mutex_global_unlock();
+      port_data_unlock(p_port);
 
       break;
     } else {
@@ -1191,7 +1194,7 @@ int PORT_ReadData(uint16_t handle, char* p_data, uint16_t max_len,
       *p_len += p_buf->len;
       max_len -= p_buf->len;
 
-      mutex_global_lock();
+      port_data_lock(p_port);
 
       p_port->rx.queue_size -= p_buf->len;
 
@@ -1201,7 +1204,7 @@ int PORT_ReadData(uint16_t handle, char* p_data, uint16_t max_len,
 
       osi_free(fixed_queue_try_dequeue(p_port->rx.queue));
 
-      mutex_global_unlock();
+      port_data_unlock(p_port);
 
       count++;
     }
@@ -1253,25 +1256,77 @@ int PORT_Read(uint16_t handle, BT_HDR** pp_buf) {
     return (PORT_LINE_ERR);
   }
 
-  mutex_global_lock();
+  port_data_lock(p_port);
 
   p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_port->rx.queue);
   if (p_buf) {
     p_port->rx.queue_size -= p_buf->len;
 
-    mutex_global_unlock();
+    port_data_unlock(p_port);
 
     /* If rfcomm suspended traffic from the peer based on the rx_queue_size */
     /* check if it can be resumed now */
     port_flow_control_peer(p_port, true, 1);
   } else {
-    mutex_global_unlock();
+    port_data_unlock(p_port);
   }
 
   *pp_buf = p_buf;
   return (PORT_SUCCESS);
 }
 
+/*******************************************************************************
+ *
+ * Function         port_holds_tx_data
+ *
+ * Description      Checks whether data written to the port has to wait in the
+ *                  tx queue rather than go out right away.
+ *
+ * Parameters:      p_port     - pointer to address of port control block
+ *
+ ******************************************************************************/
+static bool port_holds_tx_data(tPORT* p_port) {
+  /* Keep the data in pending queue if peer does not allow data, or */
+  /* Peer is not ready or Port is not yet opened or initial port control */
+  /* command has not been sent */
+  return p_port->tx.peer_fc || !p_port->rfc.p_mcb ||
+         !p_port->rfc.p_mcb->peer_ready ||
+         (p_port->rfc.state != RFC_STATE_OPENED) ||
+         ((p_port->port_ctrl & (PORT_CTRL_REQ_SENT | PORT_CTRL_IND_RECEIVED)) !=
+          (PORT_CTRL_REQ_SENT | PORT_CTRL_IND_RECEIVED));
+}
+
+/*******************************************************************************
+ *
+ * Function         port_write_refuses
+ *
+ * Description      Checks whether port_write() would refuse a buffer once the
+ *                  tx queue holds |queue_size| bytes in |queue_count|
+ *                  buffers, so that callers can stop before reading data they
+ *                  cannot queue. Keep in line with port_write().
+ *
+ * Parameters:      p_port      - pointer to address of port control block
+ *                  queue_size  - bytes in the tx queue
+ *                  queue_count - buffers in the tx queue
+ *
+ * Returns          PORT_SUCCESS if the buffer would be taken, otherwise the
+ *                  error port_write() would return
+ *
+ ******************************************************************************/
+static int port_write_refuses(tPORT* p_port, uint32_t queue_size,
+                              size_t queue_count) {
+  /* We should not allow to write data in to server port when connection is not
+   * opened */
+  if (p_port->is_server && (p_port->rfc.state != RFC_STATE_OPENED))
+    return (PORT_CLOSED);
+
+  if (port_holds_tx_data(p_port) && ((queue_size > PORT_TX_CRITICAL_WM) ||
+                                     (queue_count > PORT_TX_BUF_CRITICAL_WM)))
+    return (PORT_TX_FULL);
+
+  return (PORT_SUCCESS);
+}
+
 /*******************************************************************************
  *
  * Function         port_write
@@ -1291,14 +1346,7 @@ static int port_write(tPORT* p_port, BT_HDR* p_buf) {
     return (PORT_CLOSED);
   }
 
-  /* Keep the data in pending queue if peer does not allow data, or */
-  /* Peer is not ready or Port is not yet opened or initial port control */
-  /* command has not been sent */
-  if (p_port->tx.peer_fc || !p_port->rfc.p_mcb ||
-      !p_port->rfc.p_mcb->peer_ready ||
-      (p_port->rfc.state != RFC_STATE_OPENED) ||
-      ((p_port->port_ctrl & (PORT_CTRL_REQ_SENT | PORT_CTRL_IND_RECEIVED)) !=
-       (PORT_CTRL_REQ_SENT | PORT_CTRL_IND_RECEIVED))) {
+  if (port_holds_tx_data(p_port)) {
     if ((p_port->tx.queue_size > PORT_TX_CRITICAL_WM) ||
         (fixed_queue_length(p_port->tx.queue) > PORT_TX_BUF_CRITICAL_WM)) {
       RFCOMM_TRACE_WARNING("PORT_Write: Queue size: %d", p_port->tx.queue_size);
@@ -1405,6 +1453,7 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
   BT_HDR* p_buf;
   uint32_t event = 0;
   int rc = 0;
+  int result = PORT_SUCCESS;
   uint16_t length;
 
   RFCOMM_TRACE_API("PORT_WriteDataCO() handle:%d", handle);
@@ -1426,6 +1475,13 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
     RFCOMM_TRACE_ERROR("PORT_WriteDataByFd() peer_mtu:%d", p_port->peer_mtu);
     return (PORT_UNKNOWN_ERROR);
   }
+
+  /* Leave the data in the app socket, port_write() would drop it */
+  if (port_write_refuses(p_port, p_port->tx.queue_size,
+                         fixed_queue_length(p_port->tx.queue)) == PORT_CLOSED) {
+    RFCOMM_TRACE_WARNING("PORT_WriteDataCO() server port not opened");
+    return (PORT_CLOSED);
+  }
   int available = 0;
   // if(ioctl(fd, FIONREAD, &available) < 0)
   if (!p_port->p_data_co_callback(handle, (uint8_t*)&available,
@@ -1445,7 +1501,7 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
 
   /* If there are buffers scheduled for transmission check if requested */
   /* data fits into the end of the queue */
-  mutex_global_lock();
+  port_data_lock(p_port);
 
   p_buf = (BT_HDR*)fixed_queue_try_peek_last(p_port->tx.queue);
   if ((p_buf != NULL) &&
@@ -1462,7 +1518,7 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
           "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING failed, "
           "available:%d",
           available);
-      mutex_global_unlock();
+      port_data_unlock(p_port);
       return (PORT_UNKNOWN_ERROR);
     }
     // memcpy ((uint8_t *)(p_buf + 1) + p_buf->offset + p_buf->len, p_data,
@@ -1472,17 +1528,19 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
     *p_len = available;
     p_buf->len += (uint16_t)available;
 
-    mutex_global_unlock();
+    port_data_unlock(p_port);
 
     return (PORT_SUCCESS);
   }
 
-  mutex_global_unlock();
+  port_data_unlock(p_port);
 
   // int max_read = length < p_port->peer_mtu ? length : p_port->peer_mtu;
 
   // max_read = available < max_read ? available : max_read;
 
+  if (p_port->peer_mtu < length) length = p_port->peer_mtu;
+
   while (available) {
     /* if we're over buffer high water mark, we're done */
     if ((p_port->tx.queue_size > PORT_TX_HIGH_WM) ||
@@ -1496,41 +1554,83 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
       break;
     }
 
-    /* continue with rfcomm data write */
-    p_buf = (BT_HDR*)osi_malloc(RFCOMM_DATA_BUF_SIZE);
-    p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
-    p_buf->layer_specific = handle;
+    /* Fill as many peer MTU sized buffers as the tx queue has room for with a
+     * single call-out, so the app socket is read once per batch. Only read
+     * what port_write() will take: data read from the socket cannot be put
+     * back */
+    BT_HDR* bufs[PORT_DATA_CO_MAX_BUFS];
+    struct iovec iov[PORT_DATA_CO_MAX_BUFS];
+    int count = 0;
+    int batch = 0;
+    int queued = (int)fixed_queue_length(p_port->tx.queue);
+    while (count < PORT_DATA_CO_MAX_BUFS && batch < available &&
+           (int)p_port->tx.queue_size + batch <= PORT_TX_HIGH_WM &&
+           queued + count <= PORT_TX_BUF_HIGH_WM &&
+           port_write_refuses(p_port, p_port->tx.queue_size + batch,
+                              queued + count) == PORT_SUCCESS) {
+      uint16_t buf_len = length;
+      if (available - batch < (int)buf_len)
+        buf_len = (uint16_t)(available - batch);
+
+      p_buf = (BT_HDR*)osi_malloc(RFCOMM_DATA_BUF_SIZE);
+      p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
+      p_buf->layer_specific = handle;
+      p_buf->len = buf_len;
+      p_buf->event = BT_EVT_TO_BTU_SP_DATA;
+
+      bufs[count] = p_buf;
+      iov[count].iov_base = (uint8_t*)(p_buf + 1) + p_buf->offset;
+      iov[count].iov_len = buf_len;
+      count++;
+      batch += buf_len;
+    }
 
-    if (p_port->peer_mtu < length) length = p_port->peer_mtu;
-    if (available < (int)length) length = (uint16_t)available;
-    p_buf->len = length;
-    p_buf->event = BT_EVT_TO_BTU_SP_DATA;
+    if (count == 0) {
+      port_flow_control_user(p_port);
+      event |= PORT_EV_FC;
+      RFCOMM_TRACE_EVENT("tx queue is critical,tx.queue_size:%d,available:%d",
+                         p_port->tx.queue_size, available);
+      break;
+    }
 
-    // memcpy ((uint8_t *)(p_buf + 1) + p_buf->offset, p_data, length);
-    // if(recv(fd, (uint8_t *)(p_buf + 1) + p_buf->offset, (int)length, 0) !=
-    // (int)length)
-    if (!p_port->p_data_co_callback(handle,
-                                    (uint8_t*)(p_buf + 1) + p_buf->offset,
-                                    length, DATA_CO_CALLBACK_TYPE_OUTGOING)) {
+    if (!p_port->p_data_co_callback(handle, (uint8_t*)iov, count,
+                                    DATA_CO_CALLBACK_TYPE_OUTGOING_IOV)) {
       error(
-          "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING failed, length:%d",
-          length);
+          "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING_IOV failed, "
+          "length:%d",
+          batch);
+      for (int i = 0; i < count; i++) osi_free(bufs[i]);
       return (PORT_UNKNOWN_ERROR);
     }
 
-    RFCOMM_TRACE_EVENT("PORT_WriteData %d bytes", length);
+    RFCOMM_TRACE_EVENT("PORT_WriteData %d bytes in %d buffers", batch, count);
 
-    rc = port_write(p_port, p_buf);
+    int i;
+    for (i = 0; i < count; i++) {
+      uint16_t buf_len = bufs[i]->len;
+      rc = port_write(p_port, bufs[i]);
 
-    /* If queue went below the threashold need to send flow control */
-    event |= port_flow_control_user(p_port);
+      /* If queue went below the threashold need to send flow control */
+      event |= port_flow_control_user(p_port);
 
-    if (rc == PORT_SUCCESS) event |= PORT_EV_TXCHAR;
+      if (rc == PORT_SUCCESS) event |= PORT_EV_TXCHAR;
 
-    if ((rc != PORT_SUCCESS) && (rc != PORT_CMD_PENDING)) break;
+      if ((rc != PORT_SUCCESS) && (rc != PORT_CMD_PENDING)) break;
 
-    *p_len += length;
-    available -= (int)length;
+      *p_len += buf_len;
+      available -= (int)buf_len;
+    }
+
+    if (i < count) {
+      /* The batch was sized to what port_write() takes, so this should not
+       * happen. port_write() freed the failed buffer, the rest of the batch
+       * cannot follow it without leaving a hole in the stream */
+      error("port_write failed rc:%d, dropping %d of %d buffers", rc,
+            count - i, count);
+      while (++i < count) osi_free(bufs[i]);
+      result = rc;
+      break;
+    }
   }
   if (!available && (rc != PORT_CMD_PENDING) && (rc != PORT_TX_QUEUE_DISABLED))
     event |= PORT_EV_TXEMPTY;
@@ -1541,7 +1641,7 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
   /* Send event to the application */
   if (p_port->p_callback && event) (p_port->p_callback)(event, p_port->inx);
 
-  return (PORT_SUCCESS);
+  return (result);
 }
 
 /*******************************************************************************
@@ -1592,7 +1692,7 @@ int PORT_WriteData(uint16_t handle, const char* p_data, uint16_t max_len,
 
   /* If there are buffers scheduled for transmission check if requested */
   /* data fits into the end of the queue */
-  mutex_global_lock();
+  port_data_lock(p_port);
 
   p_buf = (BT_HDR*)fixed_queue_try_peek_last(p_port->tx.queue);
   if ((p_buf != NULL) && ((p_buf->len + max_len) <= p_port->peer_mtu) &&
@@ -1603,12 +1703,12 @@ int PORT_WriteData(uint16_t handle, const char* p_data, uint16_t max_len,
     *p_len = max_len;
     p_buf->len += max_len;
 
-    mutex_global_unlock();
+    port_data_unlock(p_port);
 
     return (PORT_SUCCESS);
   }
 
-  mutex_global_unlock();
+  port_data_unlock(p_port);
 
   while (max_len) {
     /* if we're over buffer high water mark, we're done */
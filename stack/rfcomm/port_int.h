@@ -229,6 +229,8 @@ extern uint32_t port_get_signal_changes(tPORT* p_port, uint8_t old_signals,
                                         uint8_t signal);
 extern uint32_t port_flow_control_user(tPORT* p_port);
 extern void port_flow_control_peer(tPORT* p_port, bool enable, uint16_t count);
+extern void port_data_lock(tPORT* p_port);
+extern void port_data_unlock(tPORT* p_port);
 
 /*
  * Functions provided by the port_rfc.cc
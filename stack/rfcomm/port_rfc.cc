@@ -25,7 +25,6 @@
 #include <base/logging.h>
 #include <string.h>
 
-#include "osi/include/mutex.h"
 #include "osi/include/osi.h"
 
 #include "bt_common.h"
@@ -814,12 +813,12 @@ void PORT_DataInd(tRFC_MCB* p_mcb, uint8_t dlci, BT_HDR* p_buf) {
     }
   }
 
-  mutex_global_lock();
+  port_data_lock(p_port);
 
   fixed_queue_enqueue(p_port->rx.queue, p_buf);
   p_port->rx.queue_size += p_buf->len;
 
-  mutex_global_unlock();
+  port_data_unlock(p_port);
 
   /* perform flow control procedures if necessary */
   port_flow_control_peer(p_port, false, 0);
@@ -908,13 +907,13 @@ uint32_t port_rfc_send_tx_data(tPORT* p_port) {
     while (!p_port->tx.peer_fc && p_port->rfc.p_mcb &&
            p_port->rfc.p_mcb->peer_ready) {
       /* get data from tx queue and send it */
-      mutex_global_lock();
+      port_data_lock(p_port);
 
       p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_port->tx.queue);
       if (p_buf != NULL) {
         p_port->tx.queue_size -= p_buf->len;
 
-        mutex_global_unlock();
+        port_data_unlock(p_port);
 
         RFCOMM_TRACE_DEBUG("Sending RFCOMM_DataReq tx.queue_size=%d",
                            p_port->tx.queue_size);
@@ -930,7 +929,7 @@ uint32_t port_rfc_send_tx_data(tPORT* p_port) {
       }
       /* queue is empty-- all data sent */
       else {
-        mutex_global_unlock();
+        port_data_unlock(p_port);
 
         events |= PORT_EV_TXEMPTY;
         break;
@@ -24,7 +24,7 @@
 #include <base/logging.h>
 #include <string.h>
 
-#include "osi/include/mutex.h"
+#include <mutex>
 
 #include "bt_common.h"
 #include "bt_target.h"
@@ -48,6 +48,11 @@ static const tPORT_STATE default_port_pars = {
     PORT_XOFF_DC3,
 };
 
+/* Guards the rx/tx data queues and queue sizes, one lock per port so that
+ * traffic on one port never waits for another. Kept outside tPORT because
+ * port control blocks are reset with memset. */
+static std::mutex port_data_mutex[MAX_RFC_PORTS];
+
 /*******************************************************************************
  *
  * Function         port_allocate_port
@@ -205,7 +210,7 @@ void port_release_port(tPORT* p_port) {
   RFCOMM_TRACE_DEBUG("%s p_port: %p state: %d keep_handle: %d", __func__,
                      p_port, p_port->rfc.state, p_port->keep_port_handle);
 
-  mutex_global_lock();
+  port_data_lock(p_port);
   BT_HDR* p_buf;
   while ((p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_port->rx.queue)) !=
          nullptr) {
@@ -218,7 +223,7 @@ void port_release_port(tPORT* p_port) {
     osi_free(p_buf);
   }
   p_port->tx.queue_size = 0;
-  mutex_global_unlock();
+  port_data_unlock(p_port);
 
   alarm_cancel(p_port->rfc.port_timer);
 
@@ -234,12 +239,12 @@ void port_release_port(tPORT* p_port) {
 
     rfc_port_timer_stop(p_port);
 
-    mutex_global_lock();
+    port_data_lock(p_port);
     fixed_queue_free(p_port->tx.queue, nullptr);
     p_port->tx.queue = nullptr;
     fixed_queue_free(p_port->rx.queue, nullptr);
     p_port->rx.queue = nullptr;
-    mutex_global_unlock();
+    port_data_unlock(p_port);
 
     if (p_port->keep_port_handle) {
       RFCOMM_TRACE_DEBUG("%s Re-initialize handle: %d", __func__, p_port->inx);
@@ -524,3 +529,26 @@ void port_flow_control_peer(tPORT* p_port, bool enable, uint16_t count) {
     }
   }
 }
+
+/*******************************************************************************
+ *
+ * Function         port_data_lock
+ *
+ * Description      Acquire the lock that guards the rx and tx data queues of
+ *                  the port.
+ *
+ ******************************************************************************/
+void port_data_lock(tPORT* p_port) {
+  port_data_mutex[p_port - rfc_cb.port.port].lock();
+}
+
+/*******************************************************************************
+ *
+ * Function         port_data_unlock
+ *
+ * Description      Release the lock acquired by port_data_lock.
+ *
+ ******************************************************************************/
+void port_data_unlock(tPORT* p_port) {
+  port_data_mutex[p_port - rfc_cb.port.port].unlock();
+}
@@ -259,12 +259,14 @@ extern tRFC_CB rfc_cb;
 #else
 
 extern uint8_t rfc_calc_fcs(uint16_t len, uint8_t* p);
+extern uint8_t rfc_calc_uih_fcs(uint8_t address, uint8_t control);
 
 #define RFCOMM_SABME_FCS(p_data, cr, dlci) rfc_calc_fcs(3, p_data)
 #define RFCOMM_UA_FCS(p_data, cr, dlci) rfc_calc_fcs(3, p_data)
 #define RFCOMM_DM_FCS(p_data, cr, dlci) rfc_calc_fcs(3, p_data)
 #define RFCOMM_DISC_FCS(p_data, cr, dlci) rfc_calc_fcs(3, p_data)
-#define RFCOMM_UIH_FCS(p_data, dlci) rfc_calc_fcs(2, p_data)
+#define RFCOMM_UIH_FCS(p_data, dlci) \
+  rfc_calc_uih_fcs((p_data)[0], (p_data)[1])
 
 #endif
 
@@ -493,6 +493,73 @@ void rfc_send_credit(tRFC_MCB* p_mcb, uint8_t dlci, uint8_t credit) {
   rfc_check_send_cmd(p_mcb, p_buf);
 }
 
+/*******************************************************************************
+ *
+ * Function         rfc_parse_uih_data
+ *
+ * Description      Fast path of rfc_parse_data for UIH frames on a data
+ *                  channel, which carry nearly all of the traffic. The caller
+ *                  has checked that the frame has a one byte address field,
+ *                  a UIH control field and at least RFCOMM_CTRL_FRAME_LEN
+ *                  bytes.
+ *
+ ******************************************************************************/
+static uint8_t rfc_parse_uih_data(tRFC_MCB* p_mcb, MX_FRAME* p_frame,
+                                  BT_HDR* p_buf, uint8_t* p_data) {
+  uint8_t address = p_data[0];
+  uint8_t control = p_data[1];
+  uint16_t len;
+  uint8_t header_len;
+
+  p_frame->cr = (address & RFCOMM_CR_MASK) >> RFCOMM_SHIFT_CR;
+  p_frame->dlci = address >> RFCOMM_SHIFT_DLCI;
+  p_frame->type = RFCOMM_UIH;
+  p_frame->pf = (control & RFCOMM_PF) != 0;
+
+  if (p_data[2] & RFCOMM_EA) {
+    len = p_data[2] >> RFCOMM_SHIFT_LENGTH1;
+    header_len = 3;
+  } else if (p_buf->len > RFCOMM_CTRL_FRAME_LEN) {
+    len = (p_data[2] >> RFCOMM_SHIFT_LENGTH1) +
+          (p_data[3] << RFCOMM_SHIFT_LENGTH2);
+    header_len = 4;
+  } else {
+    RFCOMM_TRACE_ERROR("Bad Length when EAL = 0: %d", p_buf->len);
+    android_errorWriteLog(0x534e4554, "78288018");
+    return RFC_EVENT_BAD_FRAME;
+  }
+
+  p_buf->len -= header_len + 1; /* Additional 1 for FCS */
+  p_buf->offset += header_len;
+
+  /* handle credit if credit based flow control */
+  if ((p_mcb->flow == PORT_FC_CREDIT) && p_frame->pf) {
+    p_frame->credit = p_data[header_len];
+    p_buf->len--;
+    p_buf->offset++;
+    header_len++;
+  } else
+    p_frame->credit = 0;
+
+  if (p_buf->len != len) {
+    RFCOMM_TRACE_ERROR("Bad Length2 %d %d", p_buf->len, len);
+    return (RFC_EVENT_BAD_FRAME);
+  }
+
+  if (!RFCOMM_VALID_DLCI(p_frame->dlci)) {
+    RFCOMM_TRACE_ERROR("Bad UIH - invalid DLCI");
+    return (RFC_EVENT_BAD_FRAME);
+  }
+
+  if (p_data[header_len + len] != rfc_calc_uih_fcs(address, control)) {
+    RFCOMM_TRACE_ERROR("Bad UIH - FCS");
+    return (RFC_EVENT_BAD_FRAME);
+  }
+
+  /* Responses are accepted to allow bad implementations to work */
+  return (RFC_EVENT_UIH);
+}
+
 /*******************************************************************************
  *
  * Function         rfc_parse_data
@@ -511,6 +578,12 @@ uint8_t rfc_parse_data(tRFC_MCB* p_mcb, MX_FRAME* p_frame, BT_HDR* p_buf) {
     return (RFC_EVENT_BAD_FRAME);
   }
 
+  if ((p_data[0] & RFCOMM_EA) &&
+      (p_data[0] >> RFCOMM_SHIFT_DLCI) != RFCOMM_MX_DLCI &&
+      (p_data[1] & ~RFCOMM_PF) == RFCOMM_UIH) {
+    return rfc_parse_uih_data(p_mcb, p_frame, p_buf, p_data);
+  }
+
   RFCOMM_PARSE_CTRL_FIELD(ead, p_frame->cr, p_frame->dlci, p_data);
   if (!ead) {
     RFCOMM_TRACE_ERROR("Bad Address(EA must be 1)");
@@ -45,7 +45,7 @@
  * Description      Reversed CRC Table , 8-bit, poly=0x07
  *                  (GSM 07.10 TS 101 369 V6.3.0)
  ******************************************************************************/
-static const uint8_t rfc_crctable[] = {
+static constexpr uint8_t rfc_crctable[] = {
     0x00, 0x91, 0xE3, 0x72, 0x07, 0x96, 0xE4, 0x75, 0x0E, 0x9F, 0xED,
     0x7C, 0x09, 0x98, 0xEA, 0x7B, 0x1C, 0x8D, 0xFF, 0x6E, 0x1B, 0x8A,
     0xF8, 0x69, 0x12, 0x83, 0xF1, 0x60, 0x15, 0x84, 0xF6, 0x67, 0x38,
@@ -74,6 +74,29 @@ static const uint8_t rfc_crctable[] = {
     0xA1, 0x30, 0x42, 0xD3, 0xB4, 0x25, 0x57, 0xC6, 0xB3, 0x22, 0x50,
     0xC1, 0xBA, 0x2B, 0x59, 0xC8, 0xBD, 0x2C, 0x5E, 0xCF};
 
+/* UIH frames only cover the address and control fields with the FCS, and the
+ * control field is either UIH or UIH with P/F set. Precompute the FCS of every
+ * such header, indexed by P/F bit and address field. */
+struct tRFC_UIH_FCS_TABLE {
+  uint8_t fcs[2][256];
+};
+
+static constexpr tRFC_UIH_FCS_TABLE rfc_make_uih_fcs_table() {
+  tRFC_UIH_FCS_TABLE table = {};
+  for (int pf = 0; pf < 2; pf++) {
+    uint8_t control = RFCOMM_UIH | (pf ? RFCOMM_PF : 0);
+    for (int address = 0; address < 256; address++) {
+      uint8_t fcs = rfc_crctable[0xFF ^ address];
+      fcs = rfc_crctable[fcs ^ control];
+      table.fcs[pf][address] = 0xFF - fcs;
+    }
+  }
+  return table;
+}
+
+static constexpr tRFC_UIH_FCS_TABLE rfc_uih_fcs_table =
+    rfc_make_uih_fcs_table();
+
 /*******************************************************************************
  *
  * Function         rfc_calc_fcs
@@ -96,6 +119,22 @@ uint8_t rfc_calc_fcs(uint16_t len, uint8_t* p) {
   return (0xFF - fcs);
 }
 
+/*******************************************************************************
+ *
+ * Function         rfc_calc_uih_fcs
+ *
+ * Description      This function returns the FCS of a UIH frame, which only
+ *                  covers its address and control fields
+ *
+ * Input            address - address field of the frame
+ *                  control - control field of the frame, UIH with or without
+ *                            the P/F bit
+ *
+ ******************************************************************************/
+uint8_t rfc_calc_uih_fcs(uint8_t address, uint8_t control) {
+  return rfc_uih_fcs_table.fcs[(control & RFCOMM_PF) != 0][address];
+}
+
 /*******************************************************************************
  *
  * Function         rfc_check_fcs
@@ -0,0 +1,285 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "bnep_int.h"
+#include "bt_common.h"
+
+tBNEP_CB bnep_cb;
+
+// Require bte_logmsg.cc to run, here is just to fake it as we don't care about
+// trace in unit test
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+namespace {
+
+const RawAddress kUnicast({0x00, 0x11, 0x22, 0x33, 0x44, 0x55});
+
+RawAddress AddrFromU64(uint64_t value) {
+  RawAddress addr;
+  for (int i = BD_ADDR_LEN - 1; i >= 0; i--) {
+    addr.address[i] = value & 0xFF;
+    value >>= 8;
+  }
+  return addr;
+}
+
+/* The filtering bnep_is_packet_allowed() did before the filters were
+ * compiled: a linear scan of the ranges as the peer sent them */
+bool LinearProtAllowed(const tBNEP_CONN& bcb, uint16_t proto) {
+  if (!bcb.rcvd_num_filters) return true;
+  for (uint16_t i = 0; i < bcb.rcvd_num_filters; i++) {
+    if ((bcb.rcvd_prot_filter_start[i] <= proto) &&
+        (proto <= bcb.rcvd_prot_filter_end[i]))
+      return true;
+  }
+  return false;
+}
+
+bool LinearMcastAllowed(const tBNEP_CONN& bcb, const RawAddress& dest) {
+  if (!(dest.address[0] & 0x01) || !bcb.rcvd_mcast_filters) return true;
+  if (bcb.rcvd_mcast_filters == 0xFFFF) return false;
+  for (uint16_t i = 0; i < bcb.rcvd_mcast_filters; i++) {
+    if ((memcmp(bcb.rcvd_mcast_filter_start[i].address, dest.address,
+                BD_ADDR_LEN) <= 0) &&
+        (memcmp(bcb.rcvd_mcast_filter_end[i].address, dest.address,
+                BD_ADDR_LEN) >= 0))
+      return true;
+  }
+  return false;
+}
+
+class BnepFilterTest : public ::testing::Test {
+ protected:
+  void SetUp() override { memset(&bcb_, 0, sizeof(bcb_)); }
+
+  /* Sets the protocol ranges the way bnepu_process_peer_filter_set() does */
+  void SetProtFilters(const std::vector<std::pair<uint16_t, uint16_t>>& f) {
+    ASSERT_LE(f.size(), (size_t)BNEP_MAX_PROT_FILTERS);
+    bcb_.rcvd_num_filters = f.size();
+    for (size_t i = 0; i < f.size(); i++) {
+      bcb_.rcvd_prot_filter_start[i] = f[i].first;
+      bcb_.rcvd_prot_filter_end[i] = f[i].second;
+    }
+    bnepu_compile_prot_filters(&bcb_);
+  }
+
+  void SetMcastFilters(const std::vector<std::pair<uint64_t, uint64_t>>& f) {
+    ASSERT_LE(f.size(), (size_t)BNEP_MAX_MULTI_FILTERS);
+    bcb_.rcvd_mcast_filters = f.size();
+    for (size_t i = 0; i < f.size(); i++) {
+      bcb_.rcvd_mcast_filter_start[i] = AddrFromU64(f[i].first);
+      bcb_.rcvd_mcast_filter_end[i] = AddrFromU64(f[i].second);
+    }
+    bnepu_compile_mcast_filters(&bcb_);
+  }
+
+  bool ProtAllowed(uint16_t proto) {
+    return bnep_is_packet_allowed(&bcb_, kUnicast, proto, false, NULL) ==
+           BNEP_SUCCESS;
+  }
+
+  bool McastAllowed(uint64_t dest) {
+    return bnep_is_packet_allowed(&bcb_, AddrFromU64(dest), 0x0800, false,
+                                  NULL) == BNEP_SUCCESS;
+  }
+
+  /* Every protocol gets the verdict of the linear scan */
+  void ExpectSameProtVerdicts() {
+    for (uint32_t proto = 0; proto <= 0xFFFF; proto++) {
+      if (proto == BNEP_802_1_P_PROTOCOL) continue;
+      ASSERT_EQ(LinearProtAllowed(bcb_, proto), ProtAllowed(proto))
+          << "protocol 0x" << std::hex << proto;
+    }
+  }
+
+  /* Every range edge, and the addresses right around it, gets the verdict of
+   * the linear scan */
+  void ExpectSameMcastVerdicts() {
+    std::vector<uint64_t> probes = {0x010000000000, 0xFFFFFFFFFFFF};
+    for (uint16_t i = 0; i < bcb_.rcvd_mcast_filters; i++) {
+      for (const RawAddress* edge : {&bcb_.rcvd_mcast_filter_start[i],
+                                     &bcb_.rcvd_mcast_filter_end[i]}) {
+        uint64_t value = 0;
+        for (int b = 0; b < BD_ADDR_LEN; b++)
+          value = (value << 8) | edge->address[b];
+        probes.push_back(value - 1);
+        probes.push_back(value);
+        probes.push_back(value + 1);
+      }
+    }
+    for (uint64_t dest : probes) {
+      dest &= 0xFFFFFFFFFFFF;
+      ASSERT_EQ(LinearMcastAllowed(bcb_, AddrFromU64(dest)),
+                McastAllowed(dest))
+          << "address 0x" << std::hex << dest;
+    }
+  }
+
+  tBNEP_CONN bcb_;
+};
+
+}  // namespace
+
+TEST_F(BnepFilterTest, no_prot_filters_allow_everything) {
+  SetProtFilters({});
+  EXPECT_EQ(0, bcb_.rcvd_prot_ranges);
+  EXPECT_TRUE(ProtAllowed(0x0000));
+  EXPECT_TRUE(ProtAllowed(BNEP_PROTOCOL_IPV4));
+  EXPECT_TRUE(ProtAllowed(0xFFFF));
+}
+
+TEST_F(BnepFilterTest, prot_range_edges) {
+  SetProtFilters({{BNEP_PROTOCOL_IPV4, BNEP_PROTOCOL_ARP}});
+  EXPECT_FALSE(ProtAllowed(BNEP_PROTOCOL_IPV4 - 1));
+  EXPECT_TRUE(ProtAllowed(BNEP_PROTOCOL_IPV4));
+  EXPECT_TRUE(ProtAllowed(BNEP_PROTOCOL_ARP));
+  EXPECT_FALSE(ProtAllowed(BNEP_PROTOCOL_ARP + 1));
+  EXPECT_FALSE(ProtAllowed(BNEP_PROTOCOL_IPV6));
+
+  SetProtFilters({{0x0000, 0x0000}, {0xFFFF, 0xFFFF}});
+  EXPECT_TRUE(ProtAllowed(0x0000));
+  EXPECT_FALSE(ProtAllowed(0x0001));
+  EXPECT_FALSE(ProtAllowed(0xFFFE));
+  EXPECT_TRUE(ProtAllowed(0xFFFF));
+
+  SetProtFilters({{0x0000, 0xFFFF}});
+  ExpectSameProtVerdicts();
+}
+
+TEST_F(BnepFilterTest, unsorted_and_overlapping_prot_ranges) {
+  SetProtFilters({{0x9000, 0x9FFF},
+                  {BNEP_PROTOCOL_IPV6, BNEP_PROTOCOL_IPV6},
+                  {0x0801, 0x0900},
+                  {0x0100, 0x0800},
+                  {0x9800, 0xA000}});
+  /* Overlapping and adjacent ranges are merged */
+  EXPECT_EQ(3, bcb_.rcvd_prot_ranges);
+  ExpectSameProtVerdicts();
+
+  /* A range contained in another one, and duplicates */
+  SetProtFilters({{0x0100, 0x0200},
+                  {0x0000, 0x1000},
+                  {0x0100, 0x0200},
+                  {0x2000, 0x2001},
+                  {0x2002, 0x2002}});
+  EXPECT_EQ(2, bcb_.rcvd_prot_ranges);
+  ExpectSameProtVerdicts();
+}
+
+TEST_F(BnepFilterTest, random_prot_ranges_match_linear_scan) {
+  srand(1);
+  for (int round = 0; round < 20; round++) {
+    std::vector<std::pair<uint16_t, uint16_t>> filters;
+    int num = 1 + rand() % BNEP_MAX_PROT_FILTERS;
+    for (int i = 0; i < num; i++) {
+      uint16_t start = rand() & 0xFFFF;
+      uint16_t end = start + (rand() & 0x0FFF);
+      if (end < start) end = 0xFFFF;
+      filters.emplace_back(start, end);
+    }
+    SetProtFilters(filters);
+    ExpectSameProtVerdicts();
+  }
+}
+
+TEST_F(BnepFilterTest, prot_filters_apply_to_the_8021q_payload) {
+  SetProtFilters({{BNEP_PROTOCOL_IPV6, BNEP_PROTOCOL_IPV6}});
+
+  uint8_t ipv4[] = {0x00, 0x01, 0x08, 0x00};
+  uint8_t ipv6[] = {0x00, 0x01, 0x86, 0xDD};
+  EXPECT_EQ(BNEP_IGNORE_CMD,
+            bnep_is_packet_allowed(&bcb_, kUnicast, BNEP_802_1_P_PROTOCOL,
+                                   false, ipv4));
+  EXPECT_EQ(BNEP_SUCCESS,
+            bnep_is_packet_allowed(&bcb_, kUnicast, BNEP_802_1_P_PROTOCOL,
+                                   false, ipv6));
+
+  /* Two extension headers ahead of the 802.1Q header */
+  uint8_t ext_ipv6[] = {0x80, 0x01, 0xAA, 0x00, 0x02, 0xBB,
+                        0xCC, 0x00, 0x01, 0x86, 0xDD};
+  EXPECT_EQ(BNEP_SUCCESS,
+            bnep_is_packet_allowed(&bcb_, kUnicast, BNEP_802_1_P_PROTOCOL,
+                                   true, ext_ipv6));
+}
+
+TEST_F(BnepFilterTest, no_mcast_filters_allow_everything) {
+  SetMcastFilters({});
+  EXPECT_EQ(0, bcb_.rcvd_mcast_ranges);
+  EXPECT_TRUE(McastAllowed(0x01005E000001));
+  EXPECT_TRUE(McastAllowed(0xFFFFFFFFFFFF));
+}
+
+TEST_F(BnepFilterTest, all_mcast_filtered) {
+  /* What bnepu_process_peer_multicast_filter_set() leaves for an all zero
+   * range */
+  bcb_.rcvd_mcast_filters = 0xFFFF;
+  bnepu_compile_mcast_filters(&bcb_);
+  EXPECT_EQ(0, bcb_.rcvd_mcast_ranges);
+  EXPECT_FALSE(McastAllowed(0x01005E000001));
+  EXPECT_FALSE(McastAllowed(0xFFFFFFFFFFFF));
+  EXPECT_TRUE(McastAllowed(0x001122334455));
+}
+
+TEST_F(BnepFilterTest, mcast_range_edges) {
+  SetMcastFilters({{0x01005E000000, 0x01005E7FFFFF}});
+  EXPECT_FALSE(McastAllowed(0x01005DFFFFFF));
+  EXPECT_TRUE(McastAllowed(0x01005E000000));
+  EXPECT_TRUE(McastAllowed(0x01005E7FFFFF));
+  EXPECT_FALSE(McastAllowed(0x01005E800000));
+  /* Unicast destinations aren't subject to the multicast filters */
+  EXPECT_TRUE(McastAllowed(0x00005E800000));
+
+  SetMcastFilters({{0xFFFFFFFFFFFF, 0xFFFFFFFFFFFF}});
+  EXPECT_FALSE(McastAllowed(0xFFFFFFFFFFFE));
+  EXPECT_TRUE(McastAllowed(0xFFFFFFFFFFFF));
+}
+
+TEST_F(BnepFilterTest, unsorted_and_overlapping_mcast_ranges) {
+  SetMcastFilters({{0x333300000000, 0x3333FFFFFFFF},
+                   {0x01005E000000, 0x01005E7FFFFF},
+                   {0x01005E400000, 0x01005EFFFFFF},
+                   {0xFFFFFFFFFFFF, 0xFFFFFFFFFFFF},
+                   {0x01005F000000, 0x01005F000000}});
+  /* Overlapping and adjacent ranges are merged */
+  EXPECT_EQ(3, bcb_.rcvd_mcast_ranges);
+  ExpectSameMcastVerdicts();
+}
+
+TEST_F(BnepFilterTest, random_mcast_ranges_match_linear_scan) {
+  srand(1);
+  for (int round = 0; round < 200; round++) {
+    std::vector<std::pair<uint64_t, uint64_t>> filters;
+    int num = 1 + rand() % BNEP_MAX_MULTI_FILTERS;
+    for (int i = 0; i < num; i++) {
+      /* A narrow address space, so ranges do overlap */
+      uint64_t start = 0x010000000000 | (rand() & 0xFF);
+      filters.emplace_back(start, start + (rand() & 0x3F));
+    }
+    SetMcastFilters(filters);
+    for (uint64_t dest = 0x010000000000; dest < 0x010000000180; dest++)
+      ASSERT_EQ(LinearMcastAllowed(bcb_, AddrFromU64(dest)),
+                McastAllowed(dest));
+  }
+}
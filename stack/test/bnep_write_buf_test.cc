@@ -0,0 +1,223 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include "bnep_api.h"
+#include "bnep_int.h"
+#include "bt_common.h"
+#include "device/include/controller.h"
+#include "mock_l2cap_layer.h"
+#include "osi/include/allocation_tracker.h"
+#include "osi/include/allocator.h"
+#include "osi/include/fixed_queue.h"
+
+using testing::_;
+using testing::Invoke;
+
+tBNEP_CB bnep_cb;
+
+// Require bte_logmsg.cc to run, here is just to fake it as we don't care about
+// trace in unit test
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+// bnep_main.cc is not built into this test
+tBNEP_RESULT bnep_register_with_l2cap(void) { return BNEP_SUCCESS; }
+void bnep_conn_timer_timeout(void* data) {}
+void bnep_connected(tBNEP_CONN* p_bcb) {}
+
+// Not in the L2CAP mock, BNEP_Deregister() is not tested here
+void L2CA_Deregister(uint16_t psm) {}
+
+namespace {
+
+const RawAddress kLocalAddr({0x11, 0x22, 0x33, 0x44, 0x55, 0x66});
+const RawAddress kPeerAddr({0x00, 0x01, 0x02, 0x03, 0x04, 0x05});
+const uint16_t kL2capCid = 0x0040;
+
+const RawAddress* get_address(void) { return &kLocalAddr; }
+
+controller_t fake_controller;
+
+}  // namespace
+
+const controller_t* controller_get_interface() {
+  fake_controller.get_address = get_address;
+  return &fake_controller;
+}
+
+namespace {
+
+class BnepWriteBufTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    allocation_tracker_init();
+    allocation_tracker_reset();
+    bluetooth::l2cap::SetMockInterface(&l2cap_interface_);
+
+    memset(&bnep_cb, 0, sizeof(bnep_cb));
+    p_bcb_ = &bnep_cb.bcb[0];
+    p_bcb_->handle = 1;
+    p_bcb_->con_state = BNEP_STATE_CONNECTED;
+    p_bcb_->l2cap_cid = kL2capCid;
+    p_bcb_->rem_bda = kPeerAddr;
+    p_bcb_->xmit_q = fixed_queue_new(SIZE_MAX);
+  }
+
+  void TearDown() override {
+    while (!fixed_queue_is_empty(p_bcb_->xmit_q))
+      osi_free(fixed_queue_try_dequeue(p_bcb_->xmit_q));
+    fixed_queue_free(p_bcb_->xmit_q, NULL);
+    bluetooth::l2cap::SetMockInterface(nullptr);
+    EXPECT_EQ(0U, allocation_tracker_expect_no_allocations())
+        << "not all memory freed";
+  }
+
+  /* A frame laid out the way btif_pan hands it to PAN_WriteBuf */
+  BT_HDR* NewFrame(uint16_t len) {
+    BT_HDR* p_buf = (BT_HDR*)osi_malloc(BNEP_BUF_SIZE);
+    p_buf->offset = BNEP_MINIMUM_OFFSET;
+    p_buf->len = len;
+    memset((uint8_t*)(p_buf + 1) + p_buf->offset, 0xA5, len);
+    return p_buf;
+  }
+
+  tBNEP_RESULT Write(BT_HDR* p_buf, uint16_t protocol = 0x0800,
+                     bool fw_ext_present = false) {
+    return BNEP_WriteBuf(p_bcb_->handle, kPeerAddr, p_buf, protocol,
+                         &kLocalAddr, fw_ext_present);
+  }
+
+  /* Fills the transmit queue the way a congested L2CAP channel does */
+  void Congest() {
+    p_bcb_->con_flags |= BNEP_FLAGS_L2CAP_CONGESTED;
+    while (fixed_queue_length(p_bcb_->xmit_q) < BNEP_MAX_XMITQ_DEPTH)
+      ASSERT_EQ(BNEP_SUCCESS, Write(NewFrame(64)));
+  }
+
+  bluetooth::l2cap::MockL2capInterface l2cap_interface_;
+  tBNEP_CONN* p_bcb_;
+};
+
+/* L2CAP owns the buffer from here on, so the mock releases it */
+uint8_t FreeDataWrite(uint16_t cid, BT_HDR* p_buf) {
+  osi_free(p_buf);
+  return L2CAP_DW_SUCCESS;
+}
+
+}  // namespace
+
+TEST_F(BnepWriteBufTest, buffer_goes_to_l2cap) {
+  BT_HDR* p_buf = NewFrame(64);
+  EXPECT_CALL(l2cap_interface_, DataWrite(kL2capCid, p_buf))
+      .WillOnce(Invoke(FreeDataWrite));
+  EXPECT_EQ(BNEP_SUCCESS, Write(p_buf));
+}
+
+TEST_F(BnepWriteBufTest, congested_channel_queues_the_buffer) {
+  p_bcb_->con_flags |= BNEP_FLAGS_L2CAP_CONGESTED;
+  EXPECT_CALL(l2cap_interface_, DataWrite(_, _)).Times(0);
+
+  BT_HDR* p_buf = NewFrame(64);
+  EXPECT_EQ(BNEP_SUCCESS, Write(p_buf));
+  EXPECT_EQ(1U, fixed_queue_length(p_bcb_->xmit_q));
+  EXPECT_EQ(p_buf, fixed_queue_try_peek_last(p_bcb_->xmit_q));
+}
+
+TEST_F(BnepWriteBufTest, full_queue_leaves_the_buffer_with_the_caller) {
+  EXPECT_CALL(l2cap_interface_, DataWrite(_, _)).Times(0);
+  Congest();
+
+  BT_HDR* p_buf = NewFrame(64);
+  BT_HDR saved_hdr = *p_buf;
+  uint8_t saved_data[64];
+  memcpy(saved_data, (uint8_t*)(p_buf + 1) + p_buf->offset, 64);
+
+  EXPECT_EQ(BNEP_Q_SIZE_EXCEEDED, Write(p_buf));
+  EXPECT_EQ(BNEP_MAX_XMITQ_DEPTH, fixed_queue_length(p_bcb_->xmit_q));
+
+  /* Untouched: no BNEP header prepended, nothing freed */
+  EXPECT_EQ(saved_hdr.offset, p_buf->offset);
+  EXPECT_EQ(saved_hdr.len, p_buf->len);
+  EXPECT_EQ(0, memcmp(saved_data, (uint8_t*)(p_buf + 1) + p_buf->offset, 64));
+
+  /* The caller giving up on it frees it */
+  osi_free(p_buf);
+}
+
+TEST_F(BnepWriteBufTest, congested_buffer_is_retried_once_the_queue_drains) {
+  EXPECT_CALL(l2cap_interface_, DataWrite(_, _)).Times(0);
+  Congest();
+
+  /* What btif_pan keeps as its congest_buf */
+  BT_HDR* p_buf = NewFrame(64);
+  EXPECT_EQ(BNEP_Q_SIZE_EXCEEDED, Write(p_buf));
+  EXPECT_EQ(BNEP_Q_SIZE_EXCEEDED, Write(p_buf));
+
+  /* L2CAP took one buffer off the queue */
+  osi_free(fixed_queue_try_dequeue(p_bcb_->xmit_q));
+
+  EXPECT_EQ(BNEP_SUCCESS, Write(p_buf));
+  EXPECT_EQ(BNEP_MAX_XMITQ_DEPTH, fixed_queue_length(p_bcb_->xmit_q));
+  EXPECT_EQ(p_buf, fixed_queue_try_peek_last(p_bcb_->xmit_q));
+}
+
+TEST_F(BnepWriteBufTest, congestion_cleared_sends_straight_to_l2cap) {
+  p_bcb_->con_flags |= BNEP_FLAGS_L2CAP_CONGESTED;
+  ASSERT_EQ(BNEP_SUCCESS, Write(NewFrame(64)));
+  p_bcb_->con_flags &= ~BNEP_FLAGS_L2CAP_CONGESTED;
+
+  BT_HDR* p_buf = NewFrame(64);
+  EXPECT_CALL(l2cap_interface_, DataWrite(kL2capCid, p_buf))
+      .WillOnce(Invoke(FreeDataWrite));
+  EXPECT_EQ(BNEP_SUCCESS, Write(p_buf));
+  EXPECT_EQ(1U, fixed_queue_length(p_bcb_->xmit_q));
+}
+
+TEST_F(BnepWriteBufTest, other_failures_free_the_buffer) {
+  EXPECT_CALL(l2cap_interface_, DataWrite(_, _)).Times(0);
+
+  EXPECT_EQ(BNEP_WRONG_HANDLE,
+            BNEP_WriteBuf(0, kPeerAddr, NewFrame(64), 0x0800, &kLocalAddr,
+                          false));
+  EXPECT_EQ(BNEP_WRONG_HANDLE,
+            BNEP_WriteBuf(BNEP_MAX_CONNECTIONS + 1, kPeerAddr, NewFrame(64),
+                          0x0800, &kLocalAddr, false));
+  EXPECT_EQ(BNEP_MTU_EXCEDED, Write(NewFrame(BNEP_MTU_SIZE + 1)));
+
+  /* Only IPv6 passes the peer's protocol filters */
+  p_bcb_->rcvd_num_filters = 1;
+  p_bcb_->rcvd_prot_filter_start[0] = BNEP_PROTOCOL_IPV6;
+  p_bcb_->rcvd_prot_filter_end[0] = BNEP_PROTOCOL_IPV6;
+  bnepu_compile_prot_filters(p_bcb_);
+  EXPECT_EQ(BNEP_IGNORE_CMD, Write(NewFrame(64), BNEP_PROTOCOL_IPV4));
+
+  /* A filtered 802.1Q frame with an extension header but no room for the
+   * 802.1Q header behind it */
+  BT_HDR* p_buf = NewFrame(4);
+  uint8_t* p = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  const uint8_t frame[] = {0x00, 0x00, 0x00, 0x01, 0x08, 0x00};
+  memcpy(p, frame, sizeof(frame));
+  EXPECT_EQ(BNEP_IGNORE_CMD, Write(p_buf, BNEP_802_1_P_PROTOCOL, true));
+
+  /* Everything above was freed by BNEP_WriteBuf */
+  EXPECT_EQ(0U, fixed_queue_length(p_bcb_->xmit_q));
+}
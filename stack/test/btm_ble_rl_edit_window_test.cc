@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "btm_ble_api.h"
+#include "btm_ble_int_types.h"
+#include "btm_ble_rl_edit_window.h"
+
+TEST(BtmBleRlEditWindowTest, single_add_from_idle_enables_initiating) {
+  BtmBleRlEditWindow window;
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_IDLE));
+  window.EndEdit(BTM_BLE_RL_INIT);
+  EXPECT_TRUE(window.IsOpen());
+  EXPECT_EQ(BTM_BLE_RL_INIT, window.Close());
+  EXPECT_FALSE(window.IsOpen());
+}
+
+TEST(BtmBleRlEditWindowTest, single_add_restores_pre_edit_state) {
+  BtmBleRlEditWindow window;
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_SCAN));
+  window.EndEdit(BTM_BLE_RL_INIT);
+  EXPECT_EQ(BTM_BLE_RL_SCAN, window.Close());
+}
+
+TEST(BtmBleRlEditWindowTest, back_to_back_adds_restore_pre_edit_state) {
+  BtmBleRlEditWindow window;
+  // Only scanning had resolution on. The first edit disables it, so every
+  // later edit in the window sees it off.
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_SCAN));
+  window.EndEdit(BTM_BLE_RL_INIT);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_FALSE(window.BeginEdit(BTM_BLE_RL_IDLE));
+    window.EndEdit(BTM_BLE_RL_INIT);
+  }
+  EXPECT_EQ(BTM_BLE_RL_SCAN, window.Close());
+}
+
+TEST(BtmBleRlEditWindowTest, back_to_back_add_and_remove) {
+  BtmBleRlEditWindow window;
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_IDLE));
+  window.EndEdit(BTM_BLE_RL_IDLE);
+  EXPECT_FALSE(window.BeginEdit(BTM_BLE_RL_IDLE));
+  window.EndEdit(BTM_BLE_RL_INIT);
+  EXPECT_EQ(BTM_BLE_RL_INIT, window.Close());
+}
+
+TEST(BtmBleRlEditWindowTest, state_turned_on_inside_window_is_restored) {
+  BtmBleRlEditWindow window;
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_SCAN));
+  window.EndEdit(BTM_BLE_RL_INIT);
+  // A background connection turned resolution back on for initiating
+  EXPECT_FALSE(window.BeginEdit(BTM_BLE_RL_INIT));
+  window.EndEdit(BTM_BLE_RL_IDLE);
+  EXPECT_EQ(BTM_BLE_RL_SCAN | BTM_BLE_RL_INIT, window.Close());
+}
+
+TEST(BtmBleRlEditWindowTest, next_window_records_its_own_state) {
+  BtmBleRlEditWindow window;
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_SCAN | BTM_BLE_RL_ADV));
+  window.EndEdit(BTM_BLE_RL_INIT);
+  EXPECT_EQ(BTM_BLE_RL_SCAN | BTM_BLE_RL_ADV, window.Close());
+
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_IDLE));
+  window.EndEdit(BTM_BLE_RL_INIT);
+  EXPECT_EQ(BTM_BLE_RL_INIT, window.Close());
+}
+
+TEST(BtmBleRlEditWindowTest, reset_drops_the_window) {
+  BtmBleRlEditWindow window;
+  window.BeginEdit(BTM_BLE_RL_SCAN);
+  window.Reset();
+  EXPECT_FALSE(window.IsOpen());
+  EXPECT_TRUE(window.BeginEdit(BTM_BLE_RL_IDLE));
+  EXPECT_EQ(BTM_BLE_RL_IDLE, window.Close());
+}
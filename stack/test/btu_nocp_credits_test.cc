@@ -0,0 +1,168 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+#include "bt_types.h"
+#include "btu_nocp_credits.h"
+#include "hcidefs.h"
+
+namespace {
+
+constexpr uint16_t kHandleA = 0x0001;
+constexpr uint16_t kHandleB = 0x0002;
+constexpr uint16_t kHandleC = 0x0003;
+
+typedef std::vector<std::pair<uint16_t, uint16_t>> Credits;
+
+/* The events L2CAP was handed, as (handle, num_sent) pairs */
+std::vector<Credits> flushed;
+
+void Flushed(uint8_t* p) {
+  uint8_t num_handles;
+  STREAM_TO_UINT8(num_handles, p);
+  Credits credits;
+  for (uint8_t i = 0; i < num_handles; i++) {
+    uint16_t handle, num_sent;
+    STREAM_TO_UINT16(handle, p);
+    STREAM_TO_UINT16(num_sent, p);
+    credits.emplace_back(handle, num_sent);
+  }
+  flushed.push_back(credits);
+}
+
+}  // namespace
+
+class BtuNocpCreditsTest : public ::testing::Test {
+ protected:
+  void SetUp() override { flushed.clear(); }
+
+  /* Feeds a Number Of Completed Packets event the way btu_hcif does */
+  void Event(const Credits& credits) {
+    credits_.BeforeEvent(HCI_NUM_COMPL_DATA_PKTS_EVT);
+    std::vector<uint8_t> params(1 + credits.size() * 4);
+    uint8_t* p = params.data();
+    UINT8_TO_STREAM(p, credits.size());
+    for (const auto& c : credits) {
+      UINT16_TO_STREAM(p, c.first);
+      UINT16_TO_STREAM(p, c.second);
+    }
+    credits_.AddEvent(params.data());
+  }
+
+  BtuNocpCredits credits_{Flushed};
+};
+
+TEST_F(BtuNocpCreditsTest, single_event_is_handed_over_as_is) {
+  Event({{kHandleA, 2}, {kHandleB, 1}});
+  EXPECT_TRUE(flushed.empty());
+  EXPECT_FALSE(credits_.IsEmpty());
+
+  credits_.Flush();
+  ASSERT_EQ(1u, flushed.size());
+  EXPECT_EQ(Credits({{kHandleA, 2}, {kHandleB, 1}}), flushed[0]);
+  EXPECT_TRUE(credits_.IsEmpty());
+}
+
+TEST_F(BtuNocpCreditsTest, credits_are_merged_per_handle) {
+  Event({{kHandleA, 2}});
+  Event({{kHandleB, 1}, {kHandleA, 3}});
+  Event({{kHandleA, 1}, {kHandleC, 4}, {kHandleB, 2}});
+
+  credits_.Flush();
+  ASSERT_EQ(1u, flushed.size());
+  /* In the order the handles were first seen */
+  EXPECT_EQ(Credits({{kHandleA, 6}, {kHandleB, 3}, {kHandleC, 4}}), flushed[0]);
+
+  EXPECT_EQ(3u, credits_.events());
+  EXPECT_EQ(2u, credits_.events_coalesced());
+  EXPECT_EQ(3u, credits_.link_runs_avoided());
+}
+
+TEST_F(BtuNocpCreditsTest, other_event_flushes_first) {
+  Event({{kHandleA, 2}});
+  Event({{kHandleA, 1}});
+  EXPECT_TRUE(flushed.empty());
+
+  credits_.BeforeEvent(HCI_DISCONNECTION_COMP_EVT);
+  ASSERT_EQ(1u, flushed.size());
+  EXPECT_EQ(Credits({{kHandleA, 3}}), flushed[0]);
+
+  /* Nothing left for the next one */
+  credits_.BeforeEvent(HCI_CONNECTION_COMP_EVT);
+  credits_.Flush();
+  EXPECT_EQ(1u, flushed.size());
+
+  /* Credits after the other event start over */
+  Event({{kHandleA, 5}});
+  credits_.Flush();
+  ASSERT_EQ(2u, flushed.size());
+  EXPECT_EQ(Credits({{kHandleA, 5}}), flushed[1]);
+}
+
+TEST_F(BtuNocpCreditsTest, table_overflow_flushes_collected_credits) {
+  Credits first;
+  for (uint16_t handle = 1; handle <= BtuNocpCredits::kMaxHandles; handle++)
+    first.emplace_back(handle, 1);
+  Event(first);
+  EXPECT_TRUE(flushed.empty());
+
+  /* Known handles still fit in a full table */
+  Event({{1, 1}});
+  EXPECT_TRUE(flushed.empty());
+
+  /* A new one doesn't */
+  Event({{2, 1}, {0x0100, 7}});
+  ASSERT_EQ(1u, flushed.size());
+  ASSERT_EQ(BtuNocpCredits::kMaxHandles, flushed[0].size());
+  EXPECT_EQ(std::make_pair(uint16_t{1}, uint16_t{2}), flushed[0][0]);
+  EXPECT_EQ(std::make_pair(uint16_t{2}, uint16_t{2}), flushed[0][1]);
+
+  credits_.Flush();
+  ASSERT_EQ(2u, flushed.size());
+  EXPECT_EQ(Credits({{0x0100, 7}}), flushed[1]);
+}
+
+TEST_F(BtuNocpCreditsTest, overflow_within_one_event) {
+  Credits credits;
+  for (uint16_t handle = 1; handle <= BtuNocpCredits::kMaxHandles + 2;
+       handle++)
+    credits.emplace_back(handle, handle);
+  Event(credits);
+
+  credits_.Flush();
+  ASSERT_EQ(2u, flushed.size());
+  EXPECT_EQ(Credits(credits.begin(),
+                    credits.begin() + BtuNocpCredits::kMaxHandles),
+            flushed[0]);
+  EXPECT_EQ(Credits(credits.begin() + BtuNocpCredits::kMaxHandles,
+                    credits.end()),
+            flushed[1]);
+}
+
+TEST_F(BtuNocpCreditsTest, reset_drops_credits) {
+  Event({{kHandleA, 2}});
+  credits_.Reset();
+  EXPECT_TRUE(credits_.IsEmpty());
+
+  credits_.Flush();
+  EXPECT_TRUE(flushed.empty());
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "l2c_fcr_crc.h"
+
+namespace {
+
+/* Bit-at-a-time reference for the L2CAP FCS */
+uint16_t reference_crc(uint16_t crc, const uint8_t* p, size_t len) {
+  while (len--) {
+    crc ^= *p++;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+}  // namespace
+
+TEST(L2capFcrCrcTest, check_value) {
+  const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  EXPECT_EQ(0xBB3D, l2c_fcr_updcrc(0, data, sizeof(data)));
+}
+
+TEST(L2capFcrCrcTest, empty_input) {
+  EXPECT_EQ(0x0000, l2c_fcr_updcrc(0x0000, nullptr, 0));
+  EXPECT_EQ(0x1234, l2c_fcr_updcrc(0x1234, nullptr, 0));
+}
+
+TEST(L2capFcrCrcTest, random_frames_match_reference) {
+  std::mt19937 gen(0x4c324341);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> length(0, 1100);
+
+  for (int i = 0; i < 2000; i++) {
+    std::vector<uint8_t> frame(length(gen));
+    for (uint8_t& b : frame) b = byte(gen);
+    uint16_t init = byte(gen) | (byte(gen) << 8);
+
+    ASSERT_EQ(reference_crc(init, frame.data(), frame.size()),
+              l2c_fcr_updcrc(init, frame.data(), frame.size()))
+        << "length " << frame.size();
+  }
+}
+
+TEST(L2capFcrCrcTest, incremental_matches_single_pass) {
+  std::vector<uint8_t> frame(257);
+  for (size_t i = 0; i < frame.size(); i++) frame[i] = i * 31 + 7;
+
+  uint16_t whole = l2c_fcr_updcrc(0, frame.data(), frame.size());
+  for (size_t split = 0; split <= frame.size(); split++) {
+    uint16_t crc = l2c_fcr_updcrc(0, frame.data(), split);
+    crc = l2c_fcr_updcrc(crc, frame.data() + split, frame.size() - split);
+    ASSERT_EQ(whole, crc) << "split at " << split;
+  }
+}
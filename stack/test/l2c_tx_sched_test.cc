@@ -0,0 +1,282 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include "bt_common.h"
+#include "l2c_int.h"
+#include "osi/include/allocator.h"
+#include "osi/include/time.h"
+
+tL2C_CB l2cb;
+
+bool l2c_fcr_is_flow_controlled(tL2C_CCB* p_ccb) { return false; }
+
+// Require bte_logmsg.cc to run, here is just to fake it as we don't care about
+// trace in unit test
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+namespace {
+
+class L2capTxSchedTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    memset(&lcb_, 0, sizeof(lcb_));
+    memset(ccbs_, 0, sizeof(ccbs_));
+
+    lcb_.transport = BT_TRANSPORT_BR_EDR;
+    lcb_.ccb_queue.p_first_ccb = &ccbs_[0];
+    lcb_.ccb_queue.p_last_ccb = &ccbs_[1];
+
+    for (tL2C_CCB& ccb : ccbs_) {
+      ccb.in_use = true;
+      ccb.p_lcb = &lcb_;
+      ccb.chnl_state = CST_OPEN;
+      ccb.peer_cfg.fcr.mode = L2CAP_FCR_BASIC_MODE;
+      ccb.xmit_hold_q = fixed_queue_new(SIZE_MAX);
+      ccb.ccb_priority = L2CAP_CHNL_PRIORITY_MEDIUM;
+      ccb.tx_data_rate = L2CAP_CHNL_DATA_RATE_LOW;
+    }
+    ccbs_[0].local_cid = 0x0040;
+    ccbs_[0].p_next_ccb = &ccbs_[1];
+    ccbs_[1].local_cid = 0x0041;
+    ccbs_[1].p_prev_ccb = &ccbs_[0];
+
+    tL2C_RR_SERV* p_serv = &lcb_.rr_serv[L2CAP_CHNL_PRIORITY_MEDIUM];
+    p_serv->p_first_ccb = &ccbs_[0];
+    p_serv->p_serve_ccb = &ccbs_[0];
+    p_serv->num_ccb = 2;
+    lcb_.rr_pri = L2CAP_CHNL_PRIORITY_MEDIUM;
+    p_serv->quota = L2CAP_GET_PRIORITY_QUOTA(L2CAP_CHNL_PRIORITY_MEDIUM);
+  }
+
+  void TearDown() override {
+    for (tL2C_CCB& ccb : ccbs_) fixed_queue_free(ccb.xmit_hold_q, osi_free);
+  }
+
+  BT_HDR* Queue(tL2C_CCB* p_ccb, uint16_t len, uint16_t offset = 0) {
+    BT_HDR* p_buf = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + offset + len);
+    p_buf->offset = offset;
+    p_buf->len = len;
+    l2cu_stamp_tx_buf(p_ccb, p_buf);
+    fixed_queue_enqueue(p_ccb->xmit_hold_q, p_buf);
+    return p_buf;
+  }
+
+  void QueueMany(tL2C_CCB* p_ccb, int count, uint16_t len) {
+    for (int i = 0; i < count; i++) Queue(p_ccb, len);
+  }
+
+  // Pretend the buffers queued on |p_ccb| waited |ms| longer
+  void Backdate(tL2C_CCB* p_ccb, uint32_t ms) {
+    for (tL2C_TX_STAMP& stamp : p_ccb->tx_stamps) stamp.enqueued_ms -= ms;
+  }
+
+  // Sends one buffer the way l2cu_get_next_buffer_to_send() picks it
+  tL2C_CCB* Send() {
+    tL2C_CCB* p_ccb = l2cu_get_overdue_channel(&lcb_);
+    if (p_ccb == NULL) p_ccb = l2cu_get_next_channel_in_rr(&lcb_);
+    if (p_ccb == NULL) return NULL;
+
+    BT_HDR* p_head = (BT_HDR*)fixed_queue_try_peek_first(p_ccb->xmit_hold_q);
+    BT_HDR* p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_ccb->xmit_hold_q);
+    l2cu_record_tx_delay(p_ccb, p_head);
+    l2cu_rr_charge(p_ccb, p_buf->len);
+    sent_bytes_[p_ccb - ccbs_] += p_buf->len;
+    osi_free(p_buf);
+    return p_ccb;
+  }
+
+  tL2C_LCB lcb_;
+  tL2C_CCB ccbs_[2];
+  uint32_t sent_bytes_[2] = {0, 0};
+};
+
+}  // namespace
+
+TEST_F(L2capTxSchedTest, drr_shares_link_by_data_rate) {
+  ccbs_[1].tx_data_rate = L2CAP_CHNL_DATA_RATE_HIGH;
+  QueueMany(&ccbs_[0], 1000, 1000);
+  QueueMany(&ccbs_[1], 5000, 300);
+
+  for (int i = 0; i < 2000; i++) ASSERT_NE(nullptr, Send());
+
+  double share = (double)sent_bytes_[1] / sent_bytes_[0];
+  EXPECT_NEAR(3.0, share, 0.1);
+}
+
+TEST_F(L2capTxSchedTest, drr_equal_rates_share_bytes_not_buffers) {
+  QueueMany(&ccbs_[0], 1000, 1000);
+  QueueMany(&ccbs_[1], 5000, 100);
+
+  for (int i = 0; i < 2000; i++) ASSERT_NE(nullptr, Send());
+
+  double share = (double)sent_bytes_[1] / sent_bytes_[0];
+  EXPECT_NEAR(1.0, share, 0.1);
+}
+
+TEST_F(L2capTxSchedTest, drr_oversized_buffer_debt_is_capped) {
+  QueueMany(&ccbs_[0], 10, 5000);
+  QueueMany(&ccbs_[1], 1000, 100);
+
+  // Each turn of channel 0 sends one buffer, paid back by the next turn only,
+  // so channel 1 never sends more than its own quantum in between.
+  int run = 0;
+  for (int i = 0; i < 100; i++) {
+    tL2C_CCB* p_ccb = Send();
+    ASSERT_NE(nullptr, p_ccb);
+    if (p_ccb == &ccbs_[0]) {
+      if (i > 0) EXPECT_LE(1, run);
+      run = 0;
+    } else {
+      run++;
+      EXPECT_LE(run * 100, L2CAP_CHNL_DRR_QUANTUM + 100);
+    }
+    EXPECT_GT(ccbs_[0].tx_deficit, -L2CAP_CHNL_DRR_QUANTUM);
+  }
+}
+
+TEST_F(L2capTxSchedTest, drr_idle_channel_does_not_bank_its_turn) {
+  QueueMany(&ccbs_[1], 100, 100);
+  for (int i = 0; i < 50; i++) ASSERT_EQ(&ccbs_[1], Send());
+  EXPECT_LE(ccbs_[0].tx_deficit, 0);
+
+  QueueMany(&ccbs_[0], 100, 100);
+  int run = 0;
+  while (Send() == &ccbs_[0]) run++;
+  EXPECT_LE(run * 100, L2CAP_CHNL_DRR_QUANTUM + 100);
+}
+
+TEST_F(L2capTxSchedTest, overdue_channel_preempts_round_robin) {
+  ccbs_[1].tx_latency_target_ms = 20;
+  QueueMany(&ccbs_[0], 10, 100);
+  QueueMany(&ccbs_[1], 10, 100);
+  Backdate(&ccbs_[1], 50);
+
+  EXPECT_EQ(&ccbs_[1], l2cu_get_overdue_channel(&lcb_));
+  EXPECT_EQ(&ccbs_[1], Send());
+}
+
+TEST_F(L2capTxSchedTest, channel_under_target_waits_its_turn) {
+  ccbs_[1].tx_latency_target_ms = 1000;
+  QueueMany(&ccbs_[0], 10, 100);
+  QueueMany(&ccbs_[1], 10, 100);
+
+  EXPECT_EQ(nullptr, l2cu_get_overdue_channel(&lcb_));
+  EXPECT_EQ(&ccbs_[0], Send());
+}
+
+TEST_F(L2capTxSchedTest, furthest_overdue_channel_goes_first) {
+  ccbs_[0].tx_latency_target_ms = 10;
+  ccbs_[1].tx_latency_target_ms = 40;
+  Queue(&ccbs_[0], 100);
+  Queue(&ccbs_[1], 100);
+
+  Backdate(&ccbs_[0], 30);
+  Backdate(&ccbs_[1], 100);
+  EXPECT_EQ(&ccbs_[1], l2cu_get_overdue_channel(&lcb_));
+
+  Backdate(&ccbs_[0], 100);
+  EXPECT_EQ(&ccbs_[0], l2cu_get_overdue_channel(&lcb_));
+}
+
+TEST_F(L2capTxSchedTest, overdue_channel_that_cannot_send_is_skipped) {
+  ccbs_[1].tx_latency_target_ms = 20;
+  QueueMany(&ccbs_[1], 10, 100);
+  Backdate(&ccbs_[1], 50);
+
+  ccbs_[1].chnl_state = CST_CONFIG;
+  EXPECT_EQ(nullptr, l2cu_get_overdue_channel(&lcb_));
+}
+
+TEST_F(L2capTxSchedTest, stamp_leaves_buffer_headroom_alone) {
+  BT_HDR* p_buf = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + 12 + 100);
+  p_buf->offset = 12;
+  p_buf->len = 100;
+  uint8_t* p_headroom = (uint8_t*)(p_buf + 1);
+  memset(p_headroom, 0xA5, 12);
+
+  l2cu_stamp_tx_buf(&ccbs_[0], p_buf);
+  fixed_queue_enqueue(ccbs_[0].xmit_hold_q, p_buf);
+
+  uint32_t stamp_ms;
+  EXPECT_TRUE(l2cu_get_tx_stamp(&ccbs_[0], p_buf, &stamp_ms));
+  for (int i = 0; i < 12; i++) EXPECT_EQ(0xA5, p_headroom[i]);
+}
+
+TEST_F(L2capTxSchedTest, sent_buffer_drops_stamps_of_flushed_ones) {
+  BT_HDR* p_flushed = Queue(&ccbs_[0], 100);
+  BT_HDR* p_sent = Queue(&ccbs_[0], 100);
+  BT_HDR* p_next = Queue(&ccbs_[0], 100);
+
+  fixed_queue_try_dequeue(ccbs_[0].xmit_hold_q);
+  fixed_queue_try_dequeue(ccbs_[0].xmit_hold_q);
+  l2cu_record_tx_delay(&ccbs_[0], p_sent);
+
+  uint32_t stamp_ms;
+  EXPECT_FALSE(l2cu_get_tx_stamp(&ccbs_[0], p_flushed, &stamp_ms));
+  EXPECT_FALSE(l2cu_get_tx_stamp(&ccbs_[0], p_sent, &stamp_ms));
+  EXPECT_TRUE(l2cu_get_tx_stamp(&ccbs_[0], p_next, &stamp_ms));
+  EXPECT_EQ(1, ccbs_[0].tx_stamp_count);
+
+  uint32_t recorded = 0;
+  for (uint32_t count : ccbs_[0].tx_delay_hist) recorded += count;
+  EXPECT_EQ(1u, recorded);
+
+  osi_free(p_flushed);
+  osi_free(p_sent);
+}
+
+TEST_F(L2capTxSchedTest, reused_buffer_address_gets_the_new_stamp) {
+  BT_HDR* p_buf = Queue(&ccbs_[0], 100);
+  Queue(&ccbs_[0], 100);
+  Backdate(&ccbs_[0], 500);
+
+  // Flushed, then queued again at the same address
+  fixed_queue_try_dequeue(ccbs_[0].xmit_hold_q);
+  l2cu_stamp_tx_buf(&ccbs_[0], p_buf);
+  fixed_queue_enqueue(ccbs_[0].xmit_hold_q, p_buf);
+
+  uint32_t stamp_ms;
+  ASSERT_TRUE(l2cu_get_tx_stamp(&ccbs_[0], p_buf, &stamp_ms));
+  EXPECT_LT(time_get_os_boottime_ms() - stamp_ms, 500u);
+}
+
+TEST_F(L2capTxSchedTest, buffers_past_the_stamp_ring_are_not_timed) {
+  ccbs_[0].tx_latency_target_ms = 20;
+  QueueMany(&ccbs_[0], L2CAP_TX_STAMPS, 100);
+  BT_HDR* p_untimed = Queue(&ccbs_[0], 100);
+  Backdate(&ccbs_[0], 50);
+
+  uint32_t stamp_ms;
+  EXPECT_FALSE(l2cu_get_tx_stamp(&ccbs_[0], p_untimed, &stamp_ms));
+
+  for (int i = 0; i < L2CAP_TX_STAMPS; i++) {
+    EXPECT_EQ(&ccbs_[0], l2cu_get_overdue_channel(&lcb_));
+    ASSERT_EQ(&ccbs_[0], Send());
+  }
+  EXPECT_EQ(nullptr, l2cu_get_overdue_channel(&lcb_));
+  EXPECT_EQ(0, ccbs_[0].tx_stamp_count);
+
+  // Once the queue drains the ring starts over
+  ASSERT_EQ(&ccbs_[0], Send());
+  BT_HDR* p_timed = Queue(&ccbs_[0], 100);
+  EXPECT_TRUE(l2cu_get_tx_stamp(&ccbs_[0], p_timed, &stamp_ms));
+}
@@ -19,6 +19,7 @@
 #include <base/logging.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <sys/uio.h>
 
 #include "bt_types.h"
 #include "btm_api.h"
@@ -121,6 +122,49 @@ void port_event_cback_1(uint32_t code, uint16_t port_handle) {
   rfcomm_callback->PortEventCallback(code, port_handle, 1);
 }
 
+// The app socket PORT_WriteDataCO() reads from
+struct FakeAppSocket {
+  std::string data;
+  size_t bytes_read = 0;
+};
+FakeAppSocket* app_socket = nullptr;
+
+int port_data_co_cback(uint16_t port_handle, uint8_t* p_buf, uint16_t len,
+                       int type) {
+  switch (type) {
+    case DATA_CO_CALLBACK_TYPE_OUTGOING_SIZE:
+      *(int*)p_buf = app_socket->data.size() - app_socket->bytes_read;
+      return true;
+    case DATA_CO_CALLBACK_TYPE_OUTGOING:
+      memcpy(p_buf, app_socket->data.data() + app_socket->bytes_read, len);
+      app_socket->bytes_read += len;
+      return true;
+    case DATA_CO_CALLBACK_TYPE_OUTGOING_IOV: {
+      struct iovec* iov = (struct iovec*)p_buf;
+      for (uint16_t i = 0; i < len; i++) {
+        memcpy(iov[i].iov_base,
+               app_socket->data.data() + app_socket->bytes_read,
+               iov[i].iov_len);
+        app_socket->bytes_read += iov[i].iov_len;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+// Takes the data held in the tx queue of |p_port|
+std::string DequeueTxData(tPORT* p_port) {
+  std::string data;
+  while (!fixed_queue_is_empty(p_port->tx.queue)) {
+    BT_HDR* p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_port->tx.queue);
+    data.append((char*)(p_buf + 1) + p_buf->offset, p_buf->len);
+    osi_free(p_buf);
+  }
+  p_port->tx.queue_size = 0;
+  return data;
+}
+
 RawAddress GetTestAddress(int index) {
   CHECK_LT(index, UINT8_MAX);
   RawAddress result = {
@@ -595,6 +639,49 @@ TEST_F(StackRfcommTest, SameServerPortMultiDeviceHelloWorld) {
       acl_handle_1, lcid_1));
 }
 
+TEST_F(StackRfcommTest, PortDataLockDoesNotBlockOtherPorts) {
+  static const uint16_t acl_handle = 0x0009;
+  static const uint16_t lcid = 0x0054;
+  static const uint16_t test_mtu = 1600;
+  static const RawAddress test_address = GetTestAddress(0);
+
+  uint16_t server_handle_0 = 0;
+  static const uint8_t test_scn_0 = 8;
+  static const uint16_t test_uuid_0 = 0x1112;
+  ASSERT_NO_FATAL_FAILURE(StartServerPort(test_uuid_0, test_scn_0, test_mtu,
+                                          port_mgmt_cback_0, port_event_cback_0,
+                                          &server_handle_0));
+  ASSERT_NO_FATAL_FAILURE(ConnectServerL2cap(test_address, acl_handle, lcid));
+  ASSERT_NO_FATAL_FAILURE(ConnectServerPort(test_address, server_handle_0,
+                                            test_scn_0, test_mtu, acl_handle,
+                                            lcid, 0));
+
+  uint16_t server_handle_1 = 0;
+  static const uint8_t test_scn_1 = 10;
+  static const uint16_t test_uuid_1 = 0x111F;
+  ASSERT_NO_FATAL_FAILURE(StartServerPort(test_uuid_1, test_scn_1, test_mtu,
+                                          port_mgmt_cback_1, port_event_cback_1,
+                                          &server_handle_1));
+  ASSERT_NO_FATAL_FAILURE(ConnectServerPort(test_address, server_handle_1,
+                                            test_scn_1, test_mtu, acl_handle,
+                                            lcid, 1));
+
+  // Data on port 1 must flow while port 0 holds its data lock
+  tPORT* p_port_0 = &rfc_cb.port.port[server_handle_0 - 1];
+  port_data_lock(p_port_0);
+  ASSERT_NO_FATAL_FAILURE(ReceiveAndVerifyIncomingTransmission(
+      server_handle_1, false, test_scn_1, true, "Hello World1!\r", 50,
+      acl_handle, lcid, 1));
+  ASSERT_NO_FATAL_FAILURE(SendAndVerifyOutgoingTransmission(
+      server_handle_1, false, test_scn_1, false, "\r!1dlroW olleH", 4,
+      acl_handle, lcid));
+  port_data_unlock(p_port_0);
+
+  ASSERT_NO_FATAL_FAILURE(ReceiveAndVerifyIncomingTransmission(
+      server_handle_0, false, test_scn_0, true, "Hello World0!\r", 50,
+      acl_handle, lcid, 0));
+}
+
 TEST_F(StackRfcommTest, SingleClientConnectionHelloWorld) {
   static const uint16_t acl_handle = 0x0009;
   static const uint16_t lcid = 0x0054;
@@ -889,4 +976,87 @@ TEST_F(StackRfcommTest, TestConnectionCollision) {
   l2cap_appl_info_.pL2CA_DataInd_Cb(new_lcid, uih_msc_rsp_from_peer);
 }
 
+TEST_F(StackRfcommTest, WriteDataCOReadsOnlyWhatTheTxQueueTakes) {
+  static const uint16_t acl_handle = 0x0009;
+  static const uint16_t lcid = 0x0054;
+  static const uint16_t test_uuid = 0x1112;
+  static const uint8_t test_scn = 8;
+  static const uint16_t test_mtu = 1600;
+  static const RawAddress test_address = GetTestAddress(0);
+  uint16_t server_handle = 0;
+  ASSERT_NO_FATAL_FAILURE(StartServerPort(test_uuid, test_scn, test_mtu,
+                                          port_mgmt_cback_0, port_event_cback_0,
+                                          &server_handle));
+  ASSERT_NO_FATAL_FAILURE(ConnectServerL2cap(test_address, acl_handle, lcid));
+  ASSERT_NO_FATAL_FAILURE(ConnectServerPort(
+      test_address, server_handle, test_scn, test_mtu, acl_handle, lcid, 0));
+  ASSERT_EQ(PORT_SetDataCOCallback(server_handle, port_data_co_cback),
+            PORT_SUCCESS);
+
+  // More than the tx queue takes, in a pattern that shows holes and reorders
+  FakeAppSocket socket;
+  for (int i = 0; i < 2 * PORT_TX_CRITICAL_WM; i++)
+    socket.data.push_back(static_cast<char>(i % 251));
+  app_socket = &socket;
+
+  // The peer flow controls us, so all data waits in the tx queue
+  tPORT* p_port = &rfc_cb.port.port[server_handle - 1];
+  p_port->tx.peer_fc = true;
+
+  int length = 0;
+  ASSERT_EQ(PORT_WriteDataCO(server_handle, &length), PORT_SUCCESS);
+  EXPECT_GT(length, 0);
+  EXPECT_LT(length, (int)socket.data.size());
+  // Nothing was read from the socket that didn't make it into the queue
+  EXPECT_EQ((size_t)length, socket.bytes_read);
+  EXPECT_EQ((uint32_t)length, p_port->tx.queue_size);
+  EXPECT_LE(fixed_queue_length(p_port->tx.queue),
+            (size_t)PORT_TX_BUF_CRITICAL_WM);
+  EXPECT_LE(p_port->tx.queue_size, (uint32_t)PORT_TX_CRITICAL_WM);
+
+  // With the queue full, the rest stays in the socket
+  int more = 0;
+  ASSERT_EQ(PORT_WriteDataCO(server_handle, &more), PORT_SUCCESS);
+  EXPECT_EQ(0, more);
+  EXPECT_EQ((size_t)length, socket.bytes_read);
+
+  EXPECT_EQ(socket.data.substr(0, length), DequeueTxData(p_port));
+  app_socket = nullptr;
+}
+
+TEST_F(StackRfcommTest, WriteDataCOLeavesDataOfAClosedServerPort) {
+  static const uint16_t acl_handle = 0x0009;
+  static const uint16_t lcid = 0x0054;
+  static const uint16_t test_uuid = 0x1112;
+  static const uint8_t test_scn = 8;
+  static const uint16_t test_mtu = 1600;
+  static const RawAddress test_address = GetTestAddress(0);
+  uint16_t server_handle = 0;
+  ASSERT_NO_FATAL_FAILURE(StartServerPort(test_uuid, test_scn, test_mtu,
+                                          port_mgmt_cback_0, port_event_cback_0,
+                                          &server_handle));
+  ASSERT_NO_FATAL_FAILURE(ConnectServerL2cap(test_address, acl_handle, lcid));
+  ASSERT_NO_FATAL_FAILURE(ConnectServerPort(
+      test_address, server_handle, test_scn, test_mtu, acl_handle, lcid, 0));
+  ASSERT_EQ(PORT_SetDataCOCallback(server_handle, port_data_co_cback),
+            PORT_SUCCESS);
+
+  FakeAppSocket socket;
+  socket.data = "Hello World!";
+  app_socket = &socket;
+
+  // The DLC is going down, port_write() would drop the data
+  tPORT* p_port = &rfc_cb.port.port[server_handle - 1];
+  p_port->rfc.state = RFC_STATE_DISC_WAIT_UA;
+
+  int length = 0;
+  EXPECT_EQ(PORT_WriteDataCO(server_handle, &length), PORT_CLOSED);
+  EXPECT_EQ(0, length);
+  EXPECT_EQ(0u, socket.bytes_read);
+  EXPECT_TRUE(fixed_queue_is_empty(p_port->tx.queue));
+
+  p_port->rfc.state = RFC_STATE_OPENED;
+  app_socket = nullptr;
+}
+
 }  // namespace
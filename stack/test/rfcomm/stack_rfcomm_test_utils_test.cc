@@ -21,6 +21,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "rfc_int.h"
 #include "rfcdefs.h"
 #include "stack_rfcomm_test_utils.h"
 #include "stack_test_packet_utils.h"
@@ -243,4 +244,15 @@ TEST(RfcommTestPacketGeneratorTest, TestQuickGenerateDataPacket) {
               ElementsAreArray(kIncomingBrsfFrame));
 }
 
-}  // namespace
\ No newline at end of file
+TEST(RfcommFcsTest, UihHeaderFcsMatchesGenericFcs) {
+  for (int address = 0; address < 256; address++) {
+    for (uint8_t control : {RFCOMM_UIH, RFCOMM_UIH | RFCOMM_PF}) {
+      uint8_t header[] = {static_cast<uint8_t>(address), control};
+      EXPECT_EQ(rfc_calc_uih_fcs(header[0], header[1]),
+                rfc_calc_fcs(sizeof(header), header))
+          << "address=" << address << " control=" << +control;
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,322 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+// Drives the SBC and AAC encoders through their adaptive bit rate steps:
+// the rate goes down while the transmit queue builds up, back up once it
+// stays drained, and never past the floor or the configured ceiling.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "osi/include/allocator.h"
+#include "stack/include/a2dp_codec_api.h"
+#include "stack/include/bt_types.h"
+
+namespace {
+const uint8_t codec_info_sbc[AVDT_CODEC_SIZE] = {
+    6,                   // Length (A2DP_SBC_INFO_LEN)
+    0,                   // Media Type: AVDT_MEDIA_TYPE_AUDIO
+    0,                   // Media Codec Type: A2DP_MEDIA_CT_SBC
+    0x20 | 0x01,         // Sample Frequency: A2DP_SBC_IE_SAMP_FREQ_44 |
+                         // Channel Mode: A2DP_SBC_IE_CH_MD_JOINT
+    0x10 | 0x04 | 0x01,  // Block Length: A2DP_SBC_IE_BLOCKS_16 |
+                         // Subbands: A2DP_SBC_IE_SUBBAND_8 |
+                         // Allocation Method: A2DP_SBC_IE_ALLOC_MD_L
+    2,                   // MinimumBitpool Value: A2DP_SBC_IE_MIN_BITPOOL
+    53,                  // Maximum Bitpool Value: A2DP_SBC_MAX_BITPOOL
+    7,                   // Dummy
+    8,                   // Dummy
+    9                    // Dummy
+};
+
+const uint8_t codec_info_aac[AVDT_CODEC_SIZE] = {
+    8,           // Length (A2DP_AAC_INFO_LEN)
+    0,           // Media Type: AVDT_MEDIA_TYPE_AUDIO
+    2,           // Media Codec Type: A2DP_MEDIA_CT_AAC
+    0x80,        // Object Type: A2DP_AAC_OBJECT_TYPE_MPEG2_LC
+    0x01,        // Sampling Frequency: A2DP_AAC_SAMPLING_FREQ_44100
+    0x04,        // Channels: A2DP_AAC_CHANNEL_MODE_STEREO
+    0x00 | 0x4,  // Variable Bit Rate:
+                 // A2DP_AAC_VARIABLE_BIT_RATE_DISABLED
+                 // Bit Rate: 320000 = 0x4e200
+    0xe2,        // Bit Rate: 320000 = 0x4e200
+    0x00,        // Bit Rate: 320000 = 0x4e200
+    7,           // Dummy
+    8,           // Dummy
+    9            // Dummy
+};
+
+// The thresholds of a2dp_sbc_encoder.cc and a2dp_aac_encoder.cc
+constexpr size_t kQueueLengthHigh = 3;
+constexpr size_t kQueueLengthMid = 2;
+constexpr size_t kQueueLengthLow = 1;
+constexpr int kDownTicks = 5;
+constexpr int kUpTicks = 50;
+constexpr int kSbcBitpoolStep = 5;
+constexpr int kSbcMinBitpool = 28;
+constexpr int kAacStepDivisor = 8;
+constexpr int kAacMinDivisor = 2;
+
+const char kSbcRateLabel[] = "SBC bitpool (current/max)";
+const char kAacRateLabel[] = "AAC bit rate (current/max)";
+
+const tA2DP_ENCODER_INIT_PEER_PARAMS kPeerParams = {
+    true,  // is_peer_edr
+    true,  // peer_supports_3mbps
+    895,   // peer_mtu
+};
+
+uint32_t ReadPcm(uint8_t* p_buf, uint32_t len) {
+  memset(p_buf, 0, len);
+  return len;
+}
+
+// The packets encoded on the last tick
+std::vector<BT_HDR*> packets;
+bool EnqueuePacket(BT_HDR* p_buf, size_t frames_n, uint32_t bytes_read) {
+  packets.push_back(p_buf);
+  return true;
+}
+
+void FreePackets() {
+  for (BT_HDR* p_buf : packets) osi_free(p_buf);
+  packets.clear();
+}
+
+// An encoder set up the way the A2DP source media task sets it up
+class Encoder {
+ public:
+  explicit Encoder(const char* rate_label) : rate_label_(rate_label) {}
+
+  bool Init(const uint8_t* p_codec_info) {
+    uint8_t result_codec_info[AVDT_CODEC_SIZE];
+    codecs_.reset(new A2dpCodecs(std::vector<btav_a2dp_codec_config_t>()));
+    if (!codecs_->init()) return false;
+    if (!codecs_->setCodecConfig(p_codec_info, false /* is_capability */,
+                                 result_codec_info,
+                                 true /* select_current_codec */)) {
+      return false;
+    }
+    encoder_interface_ = A2DP_GetEncoderInterface(p_codec_info);
+    if (encoder_interface_ == nullptr) return false;
+    encoder_interface_->encoder_init(&kPeerParams,
+                                     codecs_->getCurrentCodecConfig(),
+                                     ReadPcm, EnqueuePacket);
+    encoder_interface_->feeding_reset();
+    int rate = ReadRate(&max_rate_);
+    return rate > 0 && rate == max_rate_;
+  }
+
+  ~Encoder() {
+    FreePackets();
+    if (encoder_interface_ != nullptr) encoder_interface_->encoder_cleanup();
+  }
+
+  // Runs media ticks with |queue_length| packets queued until one encodes
+  // frames, the encoder only adapts its rate on those
+  void Tick(size_t queue_length) {
+    FreePackets();
+    encoder_interface_->set_transmit_queue_length(queue_length);
+    do {
+      timestamp_us_ += encoder_interface_->get_encoder_interval_ms() * 1000;
+      encoder_interface_->send_frames(timestamp_us_);
+    } while (packets.empty());
+  }
+
+  void Ticks(size_t queue_length, int ticks) {
+    for (int i = 0; i < ticks; i++) Tick(queue_length);
+  }
+
+  // The rate the codec dump reports
+  int Rate() {
+    int max_rate;
+    return ReadRate(&max_rate);
+  }
+
+  int MaxRate() const { return max_rate_; }
+
+ private:
+  // Returns the current rate, or -1 if the dump has no line for it
+  int ReadRate(int* p_max_rate) {
+    int rate = -1;
+    FILE* fp = tmpfile();
+    if (fp == nullptr) return rate;
+    codecs_->debug_codec_dump(fileno(fp));
+    rewind(fp);
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+      if (strstr(line, rate_label_) == nullptr) continue;
+      const char* p = strchr(line, ':');
+      if (p == nullptr || sscanf(p + 1, "%d / %d", &rate, p_max_rate) != 2)
+        rate = -1;
+      break;
+    }
+    fclose(fp);
+    return rate;
+  }
+
+  const char* rate_label_;
+  std::unique_ptr<A2dpCodecs> codecs_;
+  const tA2DP_ENCODER_INTERFACE* encoder_interface_ = nullptr;
+  uint64_t timestamp_us_ = 1000000;
+  int max_rate_ = -1;
+};
+
+// The bitpool in the header of each SBC frame of the last tick's packets
+std::vector<int> PacketBitpools() {
+  std::vector<int> bitpools;
+  for (BT_HDR* p_buf : packets) {
+    const uint8_t* p = (const uint8_t*)(p_buf + 1) + p_buf->offset;
+    bitpools.push_back(p[2]);
+  }
+  return bitpools;
+}
+
+}  // namespace
+
+class StackA2dpEncoderAbrTest : public ::testing::Test {
+ protected:
+  // Fills the queue until the rate reaches |min_rate|, checking each step
+  // waits for |kDownTicks| ticks and takes |step| off the rate
+  void StepDown(Encoder* encoder, int step, int min_rate) {
+    int rate = encoder->Rate();
+    while (rate > min_rate) {
+      encoder->Ticks(kQueueLengthHigh, kDownTicks - 1);
+      ASSERT_EQ(rate, encoder->Rate());
+      encoder->Tick(kQueueLengthHigh);
+      rate = std::max(rate - step, min_rate);
+      ASSERT_EQ(rate, encoder->Rate());
+    }
+  }
+
+  // Drains the queue until the rate reaches the ceiling, checking each step
+  // waits for |kUpTicks| ticks and adds |step| to the rate
+  void StepUp(Encoder* encoder, int step) {
+    int rate = encoder->Rate();
+    while (rate < encoder->MaxRate()) {
+      encoder->Ticks(kQueueLengthLow, kUpTicks - 1);
+      ASSERT_EQ(rate, encoder->Rate());
+      encoder->Tick(kQueueLengthLow);
+      rate = std::min(rate + step, encoder->MaxRate());
+      ASSERT_EQ(rate, encoder->Rate());
+    }
+  }
+
+  // A queue that stops being drained, even for a single tick, restarts the
+  // wait for the next step up
+  void CheckUpHysteresis(Encoder* encoder, int step) {
+    int rate = encoder->Rate();
+    ASSERT_LT(rate, encoder->MaxRate());
+    encoder->Ticks(kQueueLengthLow, kUpTicks - 1);
+    encoder->Tick(kQueueLengthMid);
+    encoder->Ticks(kQueueLengthLow, kUpTicks - 1);
+    EXPECT_EQ(rate, encoder->Rate());
+    encoder->Tick(kQueueLengthHigh);
+    encoder->Ticks(kQueueLengthLow, kUpTicks - 1);
+    EXPECT_EQ(rate, encoder->Rate());
+    encoder->Tick(kQueueLengthLow);
+    EXPECT_EQ(std::min(rate + step, encoder->MaxRate()), encoder->Rate());
+  }
+};
+
+TEST_F(StackA2dpEncoderAbrTest, sbc_full_queue_steps_down_to_floor) {
+  Encoder encoder(kSbcRateLabel);
+  ASSERT_TRUE(encoder.Init(codec_info_sbc));
+  ASSERT_GT(encoder.MaxRate(), kSbcMinBitpool);
+
+  StepDown(&encoder, kSbcBitpoolStep, kSbcMinBitpool);
+
+  // The frames are encoded with the new bitpool
+  for (int bitpool : PacketBitpools()) EXPECT_EQ(kSbcMinBitpool, bitpool);
+
+  encoder.Ticks(kQueueLengthHigh, kDownTicks * 2);
+  EXPECT_EQ(kSbcMinBitpool, encoder.Rate());
+}
+
+TEST_F(StackA2dpEncoderAbrTest, sbc_drained_queue_steps_up_to_ceiling) {
+  Encoder encoder(kSbcRateLabel);
+  ASSERT_TRUE(encoder.Init(codec_info_sbc));
+
+  StepDown(&encoder, kSbcBitpoolStep, kSbcMinBitpool);
+  StepUp(&encoder, kSbcBitpoolStep);
+
+  for (int bitpool : PacketBitpools()) EXPECT_EQ(encoder.MaxRate(), bitpool);
+
+  // A drained queue leaves the configured bitpool alone
+  encoder.Ticks(kQueueLengthLow, kUpTicks * 2);
+  EXPECT_EQ(encoder.MaxRate(), encoder.Rate());
+}
+
+TEST_F(StackA2dpEncoderAbrTest, sbc_step_up_waits_for_a_drained_queue) {
+  Encoder encoder(kSbcRateLabel);
+  ASSERT_TRUE(encoder.Init(codec_info_sbc));
+
+  StepDown(&encoder, kSbcBitpoolStep, kSbcMinBitpool);
+
+  // A queue between the thresholds holds the bitpool where it is
+  encoder.Ticks(kQueueLengthMid, kUpTicks * 2);
+  EXPECT_EQ(kSbcMinBitpool, encoder.Rate());
+
+  CheckUpHysteresis(&encoder, kSbcBitpoolStep);
+}
+
+TEST_F(StackA2dpEncoderAbrTest, aac_full_queue_steps_down_to_floor) {
+  Encoder encoder(kAacRateLabel);
+  ASSERT_TRUE(encoder.Init(codec_info_aac));
+  int max_bit_rate = encoder.MaxRate();
+  ASSERT_GT(max_bit_rate, 0);
+
+  StepDown(&encoder, max_bit_rate / kAacStepDivisor,
+           max_bit_rate / kAacMinDivisor);
+
+  encoder.Ticks(kQueueLengthHigh, kDownTicks * 2);
+  EXPECT_EQ(max_bit_rate / kAacMinDivisor, encoder.Rate());
+}
+
+TEST_F(StackA2dpEncoderAbrTest, aac_drained_queue_steps_up_to_ceiling) {
+  Encoder encoder(kAacRateLabel);
+  ASSERT_TRUE(encoder.Init(codec_info_aac));
+  int max_bit_rate = encoder.MaxRate();
+
+  StepDown(&encoder, max_bit_rate / kAacStepDivisor,
+           max_bit_rate / kAacMinDivisor);
+  StepUp(&encoder, max_bit_rate / kAacStepDivisor);
+
+  encoder.Ticks(kQueueLengthLow, kUpTicks * 2);
+  EXPECT_EQ(max_bit_rate, encoder.Rate());
+}
+
+TEST_F(StackA2dpEncoderAbrTest, aac_step_up_waits_for_a_drained_queue) {
+  Encoder encoder(kAacRateLabel);
+  ASSERT_TRUE(encoder.Init(codec_info_aac));
+  int max_bit_rate = encoder.MaxRate();
+
+  StepDown(&encoder, max_bit_rate / kAacStepDivisor,
+           max_bit_rate / kAacMinDivisor);
+
+  encoder.Ticks(kQueueLengthMid, kUpTicks * 2);
+  EXPECT_EQ(max_bit_rate / kAacMinDivisor, encoder.Rate());
+
+  CheckUpHysteresis(&encoder, max_bit_rate / kAacStepDivisor);
+}
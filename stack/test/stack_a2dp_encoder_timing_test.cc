@@ -0,0 +1,205 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+// Measures the CPU cost of streaming to a second A2DP sink: a sink sharing
+// the active peer's frames costs a packet copy per frame, a sink needing
+// a configuration of its own costs a second encoder run over the same PCM.
+
+#include <string.h>
+#include <time.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "osi/include/allocator.h"
+#include "stack/include/a2dp_codec_api.h"
+#include "stack/include/bt_types.h"
+
+namespace {
+const uint8_t codec_info_sbc[AVDT_CODEC_SIZE] = {
+    6,                   // Length (A2DP_SBC_INFO_LEN)
+    0,                   // Media Type: AVDT_MEDIA_TYPE_AUDIO
+    0,                   // Media Codec Type: A2DP_MEDIA_CT_SBC
+    0x20 | 0x01,         // Sample Frequency: A2DP_SBC_IE_SAMP_FREQ_44 |
+                         // Channel Mode: A2DP_SBC_IE_CH_MD_JOINT
+    0x10 | 0x04 | 0x01,  // Block Length: A2DP_SBC_IE_BLOCKS_16 |
+                         // Subbands: A2DP_SBC_IE_SUBBAND_8 |
+                         // Allocation Method: A2DP_SBC_IE_ALLOC_MD_L
+    2,                   // MinimumBitpool Value: A2DP_SBC_IE_MIN_BITPOOL
+    53,                  // Maximum Bitpool Value: A2DP_SBC_MAX_BITPOOL
+    7,                   // Dummy
+    8,                   // Dummy
+    9                    // Dummy
+};
+
+const uint8_t codec_info_aac[AVDT_CODEC_SIZE] = {
+    8,           // Length (A2DP_AAC_INFO_LEN)
+    0,           // Media Type: AVDT_MEDIA_TYPE_AUDIO
+    2,           // Media Codec Type: A2DP_MEDIA_CT_AAC
+    0x80,        // Object Type: A2DP_AAC_OBJECT_TYPE_MPEG2_LC
+    0x01,        // Sampling Frequency: A2DP_AAC_SAMPLING_FREQ_44100
+    0x04,        // Channels: A2DP_AAC_CHANNEL_MODE_STEREO
+    0x00 | 0x4,  // Variable Bit Rate:
+                 // A2DP_AAC_VARIABLE_BIT_RATE_DISABLED
+                 // Bit Rate: 320000 = 0x4e200
+    0xe2,        // Bit Rate: 320000 = 0x4e200
+    0x00,        // Bit Rate: 320000 = 0x4e200
+    7,           // Dummy
+    8,           // Dummy
+    9            // Dummy
+};
+
+// Ten seconds of audio at the 20 ms media tick
+constexpr size_t kTicks = 500;
+constexpr uint64_t kStartUs = 1000000;
+
+const tA2DP_ENCODER_INIT_PEER_PARAMS kPeerParams = {
+    true,  // is_peer_edr
+    true,  // peer_supports_3mbps
+    895,   // peer_mtu
+};
+
+uint64_t ThreadCpuUs() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Noise keeps the encoders from taking shortcuts on silence
+uint32_t pcm_seed = 1;
+uint32_t ReadPcm(uint8_t* p_buf, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    pcm_seed = pcm_seed * 1103515245 + 12345;
+    p_buf[i] = static_cast<uint8_t>(pcm_seed >> 16);
+  }
+  return len;
+}
+
+// The packets encoded on the current tick
+std::vector<BT_HDR*> packets;
+bool EnqueuePacket(BT_HDR* p_buf, size_t frames_n, uint32_t bytes_read) {
+  packets.push_back(p_buf);
+  return true;
+}
+
+void FreePackets() {
+  for (BT_HDR* p_buf : packets) osi_free(p_buf);
+  packets.clear();
+}
+
+// Copies a packet for another sink the way bta_av_dup_audio_buf() does
+BT_HDR* CopyPacket(const BT_HDR* p_buf) {
+  size_t copy_size = BT_HDR_SIZE + p_buf->len + p_buf->offset;
+  BT_HDR* p_new = static_cast<BT_HDR*>(osi_malloc(copy_size));
+  memcpy(p_new, p_buf, copy_size);
+  return p_new;
+}
+
+// An encoder set up the way the A2DP source media task sets it up
+class Encoder {
+ public:
+  bool Init(const uint8_t* p_codec_info) {
+    uint8_t result_codec_info[AVDT_CODEC_SIZE];
+    codecs_.reset(new A2dpCodecs(std::vector<btav_a2dp_codec_config_t>()));
+    if (!codecs_->init()) return false;
+    if (!codecs_->setCodecConfig(p_codec_info, false /* is_capability */,
+                                 result_codec_info,
+                                 true /* select_current_codec */)) {
+      return false;
+    }
+    encoder_interface_ = A2DP_GetEncoderInterface(p_codec_info);
+    if (encoder_interface_ == nullptr) return false;
+    encoder_interface_->encoder_init(&kPeerParams,
+                                     codecs_->getCurrentCodecConfig(),
+                                     ReadPcm, EnqueuePacket);
+    encoder_interface_->feeding_reset();
+    return true;
+  }
+
+  ~Encoder() {
+    if (encoder_interface_ != nullptr) encoder_interface_->encoder_cleanup();
+  }
+
+  // Encodes one media tick, returns the CPU time it took
+  uint64_t SendFrames(uint64_t timestamp_us) {
+    uint64_t start_us = ThreadCpuUs();
+    encoder_interface_->send_frames(timestamp_us);
+    return ThreadCpuUs() - start_us;
+  }
+
+  uint64_t IntervalUs() const {
+    return encoder_interface_->get_encoder_interval_ms() * 1000;
+  }
+
+ private:
+  std::unique_ptr<A2dpCodecs> codecs_;
+  const tA2DP_ENCODER_INTERFACE* encoder_interface_ = nullptr;
+};
+
+}  // namespace
+
+class StackA2dpEncoderTimingTest : public ::testing::Test {
+ protected:
+  void TearDown() override { FreePackets(); }
+
+  // Reports a CPU time measured over |kTicks| ticks
+  void Report(const char* name, uint64_t cpu_us) {
+    RecordProperty(name, static_cast<int>(cpu_us));
+  }
+};
+
+TEST_F(StackA2dpEncoderTimingTest, shared_config_against_distinct_config) {
+  Encoder active;
+  Encoder distinct;
+  ASSERT_TRUE(active.Init(codec_info_sbc));
+  ASSERT_TRUE(distinct.Init(codec_info_aac));
+
+  uint64_t active_us = 0;
+  uint64_t shared_us = 0;
+  uint64_t distinct_us = 0;
+  size_t active_packets = 0;
+  size_t distinct_packets = 0;
+  uint64_t timestamp_us = kStartUs;
+  for (size_t tick = 0; tick < kTicks; tick++) {
+    timestamp_us += active.IntervalUs();
+
+    // The active peer's frames, copied for a sink sharing its configuration
+    active_us += active.SendFrames(timestamp_us);
+    active_packets += packets.size();
+    uint64_t start_us = ThreadCpuUs();
+    size_t encoded_n = packets.size();
+    for (size_t i = 0; i < encoded_n; i++)
+      packets.push_back(CopyPacket(packets[i]));
+    shared_us += ThreadCpuUs() - start_us;
+    FreePackets();
+
+    // The frames of a sink with a configuration of its own
+    distinct_us += distinct.SendFrames(timestamp_us);
+    distinct_packets += packets.size();
+    FreePackets();
+  }
+
+  Report("active_peer_encoding_cpu_us", active_us);
+  Report("shared_config_sink_cpu_us", shared_us);
+  Report("distinct_config_sink_cpu_us", distinct_us);
+
+  EXPECT_GT(active_packets, 0u);
+  EXPECT_GT(distinct_packets, 0u);
+}
@@ -520,6 +520,44 @@ TEST_F(StackA2dpTest, test_a2dp_codec_equals) {
   EXPECT_TRUE(A2DP_CodecEquals(codec_info_aac, codec_info_aac_test));
 }
 
+TEST_F(StackA2dpTest, test_a2dp_codec_frames_compatible) {
+  uint8_t codec_info_sbc_test[AVDT_CODEC_SIZE];
+  uint8_t codec_info_aac_test[AVDT_CODEC_SIZE];
+
+  EXPECT_TRUE(A2DP_CodecFramesCompatible(codec_info_sbc, codec_info_sbc));
+  EXPECT_TRUE(A2DP_CodecFramesCompatible(codec_info_aac, codec_info_aac));
+  EXPECT_FALSE(A2DP_CodecFramesCompatible(codec_info_sbc, codec_info_aac));
+  EXPECT_FALSE(A2DP_CodecFramesCompatible(codec_info_non_a2dp,
+                                          codec_info_non_a2dp));
+
+  // SBC frames with a narrower bitpool range can be decoded by the sink
+  memcpy(codec_info_sbc_test, codec_info_sbc, sizeof(codec_info_sbc));
+  codec_info_sbc_test[5] = 10;  // MinimumBitpool Value
+  codec_info_sbc_test[6] = 35;  // Maximum Bitpool Value
+  EXPECT_FALSE(A2DP_CodecEquals(codec_info_sbc_test, codec_info_sbc));
+  EXPECT_TRUE(A2DP_CodecFramesCompatible(codec_info_sbc_test, codec_info_sbc));
+  // Frames with a wider bitpool range cannot
+  EXPECT_FALSE(
+      A2DP_CodecFramesCompatible(codec_info_sbc, codec_info_sbc_test));
+
+  // Nor can SBC frames with another sample rate or channel mode
+  memcpy(codec_info_sbc_test, codec_info_sbc, sizeof(codec_info_sbc));
+  codec_info_sbc_test[3] = 0x10 | 0x01;  // A2DP_SBC_IE_SAMP_FREQ_48 |
+                                         // A2DP_SBC_IE_CH_MD_JOINT
+  EXPECT_FALSE(A2DP_CodecFramesCompatible(codec_info_sbc, codec_info_sbc_test));
+  codec_info_sbc_test[3] = 0x20 | 0x02;  // A2DP_SBC_IE_SAMP_FREQ_44 |
+                                         // A2DP_SBC_IE_CH_MD_STEREO
+  EXPECT_FALSE(A2DP_CodecFramesCompatible(codec_info_sbc, codec_info_sbc_test));
+
+  // AAC frames at another bit rate can be decoded, mono ones cannot
+  memcpy(codec_info_aac_test, codec_info_aac, sizeof(codec_info_aac));
+  codec_info_aac_test[7] = 0x71;  // Bit Rate: 160000 = 0x27100
+  codec_info_aac_test[6] = 0x02;
+  EXPECT_TRUE(A2DP_CodecFramesCompatible(codec_info_aac_test, codec_info_aac));
+  codec_info_aac_test[5] = 0x08;  // Channels: A2DP_AAC_CHANNEL_MODE_MONO
+  EXPECT_FALSE(A2DP_CodecFramesCompatible(codec_info_aac_test, codec_info_aac));
+}
+
 TEST_F(StackA2dpTest, test_a2dp_get_track_sample_rate) {
   EXPECT_EQ(A2DP_GetTrackSampleRate(codec_info_sbc), 44100);
   EXPECT_EQ(A2DP_GetTrackSampleRate(codec_info_aac), 44100);
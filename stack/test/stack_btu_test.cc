@@ -77,6 +77,8 @@ void btif_init_ok(unsigned short, char*){};
 void BTE_InitStack(){};
 void bta_sys_init(){};
 void bta_sys_free(){};
+void bta_sys_work_start(){};
+void bta_sys_work_stop(){};
 void btu_free_core(){};
 const module_t* get_module(const char*) { return nullptr; };
 bool module_init(module_t const*) { return true; };
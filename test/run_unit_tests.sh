@@ -7,14 +7,26 @@ known_tests=(
   net_test_bluetooth
   net_test_btcore
   net_test_bta
+  net_test_bta_gatt_queue
+  net_test_bta_sys_work
   net_test_btif
   net_test_btif_profile_queue
+  net_test_btif_a2dp_source_queue
+  net_test_btif_a2dp_source_streams
+  net_test_btif_gatt_notify_batch
+  net_test_btif_bonded_properties
   net_test_btif_state_machine
   net_test_device
   net_test_hci
   net_test_stack
   net_test_stack_multi_adv
   net_test_stack_ad_parser
+  net_test_stack_l2cap_fcr_crc
+  net_test_stack_l2cap_tx_sched
+  net_test_stack_bnep_filter
+  net_test_stack_bnep_write_buf
+  net_test_stack_btm_rl_edit_window
+  net_test_stack_btu_nocp_credits
   net_test_stack_smp
   net_test_types
   net_test_btu_message_loop
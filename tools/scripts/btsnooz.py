@@ -19,9 +19,18 @@ base64 {
 
 where the file_header and record_header are modified versions of
 the btsnoop headers.
+
+The script also converts compressed btsnoop captures (btsnoop_hci.log.sz,
+written when persist.bluetooth.btsnoopcompressed is set) back to btsnoop.
+Those files are a sequence of independently deflated chunks followed by an
+index, so --start and --end (seconds since the Unix epoch) only decompress
+the chunks that overlap the requested time range:
+
+  btsnooz.py [--start SECONDS] [--end SECONDS] btsnoop_hci.log.sz
 """
 
 
+import argparse
 import base64
 import fileinput
 import struct
@@ -39,6 +48,19 @@ TYPE_OUT_CMD = 0x20
 TYPE_OUT_ACL = 0x21
 TYPE_OUT_SCO = 0x22
 
+# Layout of compressed btsnoop captures, see hci/include/btsnoop_sz.h.
+SZ_FILE_MAGIC = b'btsnoopz'
+SZ_FILE_HEADER = '<8sII'
+SZ_CHUNK_MAGIC = 0x43525a42
+SZ_CHUNK_HEADER = '<IIIIQQQ'
+SZ_INDEX_MAGIC = 0x49525a42
+SZ_INDEX_ENTRY = '<QQQQII'
+SZ_TRAILER = '<QII'
+
+BTSNOOP_FILE_HEADER = b'btsnoop\x00\x00\x00\x00\x01\x00\x00\x03\xea'
+BTSNOOP_RECORD_HEADER = '>IIIIQ'
+BTSNOOP_EPOCH_DELTA = 0x00dcddb30f2f8000
+
 
 def type_to_direction(type):
   """
@@ -140,12 +162,100 @@ def decode_snooz_v2(decompressed, last_timestamp_ms):
     offset += length - 1
 
 
-def main():
-  if len(sys.argv) > 2:
-    sys.stderr.write('Usage: %s [bugreport]\n' % sys.argv[0])
+def read_snoopz_index(f):
+  """
+  Returns (offset, first_timestamp_us, last_timestamp_us) for every chunk of a
+  compressed btsnoop capture. Uses the index at the end of the file when
+  present, otherwise walks the chunk headers without decompressing them.
+  """
+  f.seek(0, 2)
+  file_size = f.tell()
+
+  trailer_size = struct.calcsize(SZ_TRAILER)
+  if file_size >= struct.calcsize(SZ_FILE_HEADER) + trailer_size:
+    f.seek(file_size - trailer_size)
+    index_offset, entry_count, magic = struct.unpack(SZ_TRAILER, f.read(trailer_size))
+    entry_size = struct.calcsize(SZ_INDEX_ENTRY)
+    if magic == SZ_INDEX_MAGIC and index_offset + entry_count * entry_size + trailer_size == file_size:
+      f.seek(index_offset)
+      index = []
+      for _ in range(entry_count):
+        offset, first_packet, first_us, last_us, packet_count, reserved = struct.unpack(
+            SZ_INDEX_ENTRY, f.read(entry_size))
+        index.append((offset, first_us, last_us))
+      return index
+
+  # No index, the capture was not closed cleanly.
+  index = []
+  offset = struct.calcsize(SZ_FILE_HEADER)
+  header_size = struct.calcsize(SZ_CHUNK_HEADER)
+  while offset + header_size <= file_size:
+    f.seek(offset)
+    (magic, compressed_length, uncompressed_length, packet_count, first_packet,
+     first_us, last_us) = struct.unpack(SZ_CHUNK_HEADER, f.read(header_size))
+    if magic != SZ_CHUNK_MAGIC or offset + header_size + compressed_length > file_size:
+      break
+    index.append((offset, first_us, last_us))
+    offset += header_size + compressed_length
+  return index
+
+
+def decode_snoopz(f, start_us, end_us):
+  """
+  Decodes the packets of a compressed btsnoop capture captured between
+  |start_us| and |end_us| (either may be None) into a btsnoop file.
+  """
+  magic, version, datalink = struct.unpack(SZ_FILE_HEADER, f.read(struct.calcsize(SZ_FILE_HEADER)))
+  if version != 1:
+    sys.stderr.write('Unsupported compressed btsnoop version: %s\n' % version)
     exit(1)
 
-  iterator = fileinput.input()
+  out = getattr(sys.stdout, 'buffer', sys.stdout)
+  out.write(BTSNOOP_FILE_HEADER)
+
+  header_size = struct.calcsize(SZ_CHUNK_HEADER)
+  record_header_size = struct.calcsize(BTSNOOP_RECORD_HEADER)
+  for offset, first_us, last_us in read_snoopz_index(f):
+    if (start_us is not None and last_us < start_us) or (end_us is not None and first_us > end_us):
+      continue
+
+    f.seek(offset)
+    compressed_length = struct.unpack(SZ_CHUNK_HEADER, f.read(header_size))[1]
+    records = zlib.decompress(f.read(compressed_length))
+
+    # Chunks entirely inside the range are copied as-is.
+    if (start_us is None or first_us >= start_us) and (end_us is None or last_us <= end_us):
+      out.write(records)
+      continue
+
+    record_offset = 0
+    while record_offset < len(records):
+      length_original, length_captured, flags, dropped, timestamp = struct.unpack_from(
+          BTSNOOP_RECORD_HEADER, records, record_offset)
+      record_end = record_offset + record_header_size + length_captured
+      timestamp_us = timestamp - BTSNOOP_EPOCH_DELTA
+      if (start_us is None or timestamp_us >= start_us) and (end_us is None or timestamp_us <= end_us):
+        out.write(records[record_offset:record_end])
+      record_offset = record_end
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Extract btsnooz content from a bugreport, or decode a compressed btsnoop capture.')
+  parser.add_argument('--start', type=float, help='first packet time, in seconds since the Unix epoch')
+  parser.add_argument('--end', type=float, help='last packet time, in seconds since the Unix epoch')
+  parser.add_argument('file', nargs='?', help='bugreport or btsnoop_hci.log.sz (default: stdin)')
+  args = parser.parse_args()
+
+  if args.file:
+    with open(args.file, 'rb') as f:
+      if f.read(len(SZ_FILE_MAGIC)) == SZ_FILE_MAGIC:
+        f.seek(0)
+        to_us = lambda seconds: None if seconds is None else int(seconds * 1000000)
+        decode_snoopz(f, to_us(args.start), to_us(args.end))
+        sys.exit(0)
+
+  iterator = fileinput.input(args.file or '-')
   found = False
   base64_string = ""
   for line in iterator: